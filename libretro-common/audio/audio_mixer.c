@@ -25,16 +25,35 @@
 
 #include <formats/rwav.h>
 #include <memalign.h>
+#include <memmap.h>
+#include <retro_endianness.h>
+#include <queues/spsc_queue.h>
 
 #ifdef HAVE_THREADS
 #include <rthreads/rthreads.h>
 #endif
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+#include <arm_neon.h>
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 
+#if defined(HAVE_MMAN) && !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#else
+#include <streams/file_stream.h>
+#endif
+
 #ifdef HAVE_CONFIG_H
 #include "../../config.h"
 #endif
@@ -64,11 +83,22 @@
 
 #define AUDIO_MIXER_MAX_VOICES      8
 #define AUDIO_MIXER_TEMP_BUFFER 8192
+#define AUDIO_MIXER_MAX_COMMANDS   64
+
+/* A voice is only played again once the mixer released it, and is
+ * stopped at most once per play, so at most a stop command from its
+ * previous play, a play and a stop command are queued for each voice.
+ * Those must always fit, volume changes are dropped instead when the
+ * mixer doesn't keep up. */
+#define AUDIO_MIXER_RESERVED_COMMANDS (3 * AUDIO_MIXER_MAX_VOICES)
 
 struct audio_mixer_sound
 {
    enum audio_mixer_type type;
 
+   /* Next sound destroyed, but not freed yet. */
+   struct audio_mixer_sound *next_retired;
+
    union
    {
       struct
@@ -78,6 +108,16 @@ struct audio_mixer_sound
          const float* pcm;
       } wav;
 
+      struct
+      {
+         /* wav, converted while mixing */
+         unsigned size;
+         const void* data;
+         /* data is a mapping of the file, not a heap buffer */
+         bool mapped;
+         rwav_t wav;
+      } wav_stream;
+
 #ifdef HAVE_STB_VORBIS
       struct
       {
@@ -124,6 +164,16 @@ struct audio_mixer_voice
    audio_mixer_sound_t *sound;
    audio_mixer_stop_cb_t stop_cb;
 
+   /* Set by audio_mixer_play(), cleared by the mixer once the voice
+    * is done and it won't touch it anymore. */
+   volatile size_t busy;
+   /* A stop command was posted since the voice was played. Only
+    * used by the thread controlling the voices. */
+   bool stopping;
+   /* Sound last played on the voice, only used by the thread
+    * controlling the voices. The mixer's own copy is sound. */
+   audio_mixer_sound_t *owner;
+
    union
    {
       struct
@@ -131,6 +181,18 @@ struct audio_mixer_voice
          unsigned position;
       } wav;
 
+      struct
+      {
+         unsigned    position;
+         unsigned    samples;
+         unsigned    buf_samples;
+         size_t      frame;
+         float*      buffer;
+         float       ratio;
+         void       *resampler_data;
+         const retro_resampler_t *resampler;
+      } wav_stream;
+
 #ifdef HAVE_STB_VORBIS
       struct
       {
@@ -186,33 +248,210 @@ struct audio_mixer_voice
    } types;
 };
 
+enum audio_mixer_command_type
+{
+   AUDIO_MIXER_COMMAND_PLAY = 0,
+   AUDIO_MIXER_COMMAND_STOP,
+   AUDIO_MIXER_COMMAND_VOLUME
+};
+
+/* Voice changes, posted by the controlling thread and applied by
+ * audio_mixer_mix() before mixing. */
+struct audio_mixer_command
+{
+   enum audio_mixer_command_type type;
+   bool     repeat;
+   float    volume;
+   audio_mixer_voice_t *voice;
+   audio_mixer_sound_t *sound;
+   audio_mixer_stop_cb_t stop_cb;
+};
+
 static struct audio_mixer_voice s_voices[AUDIO_MIXER_MAX_VOICES];
+static spsc_queue_t s_commands;
 static unsigned s_rate = 0;
+/* Sounds waiting for the mixer to release their voices before they
+ * can be freed, protected by s_locker. */
+static audio_mixer_sound_t *s_retired = NULL;
+/* Sounds passed to audio_mixer_destroy(), pushed without taking
+ * s_locker and taken over by the next audio_mixer_play() or
+ * audio_mixer_done() call. */
+static volatile size_t s_destroyed    = 0;
 
 #ifdef HAVE_THREADS
+/* Serializes the threads posting commands, the mixer never takes it. */
 static slock_t* s_locker = NULL;
 #endif
 
-static bool wav2float(const rwav_t* wav, float** pcm, size_t samples_out)
+/* Adds samples of a voice, scaled by volume, to the mix buffer. */
+static void audio_mixer_accumulate(float *out, const float *in,
+      unsigned samples, float volume)
 {
-   size_t i;
-   /* Allocate on a 16-byte boundary, and pad to a multiple of 16 bytes */
-   float *f           = (float*)memalign_alloc(16,
-         ((samples_out + 15) & ~15) * sizeof(float));
+   unsigned i = 0;
+#if defined(__AVX__)
+   __m256 vol = _mm256_set1_ps(volume);
 
-   if (!f)
-      return false;
+   for (; i + 16 <= samples; i += 16)
+   {
+      __m256 a = _mm256_loadu_ps(out + i);
+      __m256 b = _mm256_loadu_ps(out + i + 8);
+      a        = _mm256_add_ps(a, _mm256_mul_ps(vol, _mm256_loadu_ps(in + i)));
+      b        = _mm256_add_ps(b, _mm256_mul_ps(vol, _mm256_loadu_ps(in + i + 8)));
+      _mm256_storeu_ps(out + i, a);
+      _mm256_storeu_ps(out + i + 8, b);
+   }
+#elif defined(__SSE2__)
+   __m128 vol = _mm_set1_ps(volume);
 
-   *pcm = f;
+   for (; i + 8 <= samples; i += 8)
+   {
+      __m128 a = _mm_loadu_ps(out + i);
+      __m128 b = _mm_loadu_ps(out + i + 4);
+      a        = _mm_add_ps(a, _mm_mul_ps(vol, _mm_loadu_ps(in + i)));
+      b        = _mm_add_ps(b, _mm_mul_ps(vol, _mm_loadu_ps(in + i + 4)));
+      _mm_storeu_ps(out + i, a);
+      _mm_storeu_ps(out + i + 4, b);
+   }
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+   float32x4_t vol = vdupq_n_f32(volume);
+
+   for (; i + 8 <= samples; i += 8)
+   {
+      float32x4_t a = vld1q_f32(out + i);
+      float32x4_t b = vld1q_f32(out + i + 4);
+      a             = vmlaq_f32(a, vld1q_f32(in + i), vol);
+      b             = vmlaq_f32(b, vld1q_f32(in + i + 4), vol);
+      vst1q_f32(out + i, a);
+      vst1q_f32(out + i + 4, b);
+   }
+#endif
+
+   for (; i < samples; i++)
+      out[i] += in[i] * volume;
+}
+
+#ifdef HAVE_IBXM
+/* Same as audio_mixer_accumulate(), for the 16-bit range integer
+ * samples the module player outputs. */
+static void audio_mixer_accumulate_s32(float *out, const int *in,
+      unsigned samples, float volume)
+{
+   unsigned i = 0;
+#if defined(__SSE2__)
+   __m128 vol   = _mm_set1_ps(volume);
+   __m128 bias  = _mm_set1_ps(32768.0f);
+   __m128 range = _mm_set1_ps(65535.0f);
+   __m128 two   = _mm_set1_ps(2.0f);
+   __m128 one   = _mm_set1_ps(1.0f);
+
+   for (; i + 4 <= samples; i += 4)
+   {
+      /* Scaled samples are truncated back to integers first,
+       * like the scalar loop does. */
+      __m128 s = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(in + i)));
+      s        = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(s, vol)));
+      s        = _mm_div_ps(_mm_add_ps(s, bias), range);
+      s        = _mm_sub_ps(_mm_mul_ps(s, two), one);
+      _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), s));
+   }
+#endif
+
+   for (; i < samples; i++)
+   {
+      int samplei   = in[i] * volume;
+      float samplef = (float)(samplei + 32768) / 65535.0f;
+      out[i]       += samplef * 2.0f - 1.0f;
+   }
+}
+#endif
+
+/* Limits the final mix to [-1.0, 1.0]. */
+static void audio_mixer_clamp(float *buffer, size_t samples)
+{
+   size_t i = 0;
+#if defined(__AVX__)
+   __m256 lo = _mm256_set1_ps(-1.0f);
+   __m256 hi = _mm256_set1_ps( 1.0f);
+
+   for (; i + 16 <= samples; i += 16)
+   {
+      __m256 a = _mm256_loadu_ps(buffer + i);
+      __m256 b = _mm256_loadu_ps(buffer + i + 8);
+      _mm256_storeu_ps(buffer + i,     _mm256_min_ps(_mm256_max_ps(a, lo), hi));
+      _mm256_storeu_ps(buffer + i + 8, _mm256_min_ps(_mm256_max_ps(b, lo), hi));
+   }
+#elif defined(__SSE2__)
+   __m128 lo = _mm_set1_ps(-1.0f);
+   __m128 hi = _mm_set1_ps( 1.0f);
+
+   for (; i + 8 <= samples; i += 8)
+   {
+      __m128 a = _mm_loadu_ps(buffer + i);
+      __m128 b = _mm_loadu_ps(buffer + i + 4);
+      _mm_storeu_ps(buffer + i,     _mm_min_ps(_mm_max_ps(a, lo), hi));
+      _mm_storeu_ps(buffer + i + 4, _mm_min_ps(_mm_max_ps(b, lo), hi));
+   }
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+   float32x4_t lo = vdupq_n_f32(-1.0f);
+   float32x4_t hi = vdupq_n_f32( 1.0f);
+
+   for (; i + 8 <= samples; i += 8)
+   {
+      float32x4_t a = vld1q_f32(buffer + i);
+      float32x4_t b = vld1q_f32(buffer + i + 4);
+      vst1q_f32(buffer + i,     vminq_f32(vmaxq_f32(a, lo), hi));
+      vst1q_f32(buffer + i + 4, vminq_f32(vmaxq_f32(b, lo), hi));
+   }
+#endif
+
+   for (; i < samples; i++)
+   {
+      if (buffer[i] < -1.0f)
+         buffer[i] = -1.0f;
+      else if (buffer[i] > 1.0f)
+         buffer[i] = 1.0f;
+   }
+}
+
+/* Called by the mixer when a voice of the given type stopped playing,
+ * it's free to be played again afterwards. */
+static void audio_mixer_release(audio_mixer_voice_t* voice, unsigned type)
+{
+   switch (type)
+   {
+      case AUDIO_MIXER_TYPE_WAV_STREAM:
+         if (voice->types.wav_stream.resampler)
+            voice->types.wav_stream.resampler->free(
+                  voice->types.wav_stream.resampler_data);
+         memalign_free(voice->types.wav_stream.buffer);
+         voice->types.wav_stream.resampler      = NULL;
+         voice->types.wav_stream.resampler_data = NULL;
+         voice->types.wav_stream.buffer         = NULL;
+         break;
+      default:
+         break;
+   }
+
+   retro_atomic_store_release(&voice->busy, 0);
+}
+
+/* Converts frames of 8-bit or 16-bit mono or stereo PCM, starting at
+ * frame, to stereo float. 16-bit samples are in host order, or in the
+ * little-endian order of the file if swap is set. */
+static void wav_to_float(const rwav_t* wav, size_t frame, size_t frames,
+      bool swap, float *f)
+{
+   size_t i;
 
    if (wav->bitspersample == 8)
    {
       float sample      = 0.0f;
-      const uint8_t *u8 = (const uint8_t*)wav->samples;
+      const uint8_t *u8 = (const uint8_t*)wav->samples
+         + frame * wav->numchannels;
 
       if (wav->numchannels == 1)
       {
-         for (i = wav->numsamples; i != 0; i--)
+         for (i = frames; i != 0; i--)
          {
             sample = (float)*u8++ / 255.0f;
             sample = sample * 2.0f - 1.0f;
@@ -222,7 +461,7 @@ static bool wav2float(const rwav_t* wav, float** pcm, size_t samples_out)
       }
       else if (wav->numchannels == 2)
       {
-         for (i = wav->numsamples; i != 0; i--)
+         for (i = frames; i != 0; i--)
          {
             sample = (float)*u8++ / 255.0f;
             sample = sample * 2.0f - 1.0f;
@@ -239,11 +478,23 @@ static bool wav2float(const rwav_t* wav, float** pcm, size_t samples_out)
        * functions here? */
 
       float sample       = 0.0f;
-      const int16_t *s16 = (const int16_t*)wav->samples;
+      const int16_t *s16 = (const int16_t*)wav->samples
+         + frame * wav->numchannels;
 
-      if (wav->numchannels == 1)
+      if (swap && wav->numchannels <= 2)
+      {
+         for (i = frames * wav->numchannels; i != 0; i--)
+         {
+            sample = (float)((int)(int16_t)swap_if_big16(*s16++) + 32768) / 65535.0f;
+            sample = sample * 2.0f - 1.0f;
+            *f++   = sample;
+            if (wav->numchannels == 1)
+               *f++ = sample;
+         }
+      }
+      else if (wav->numchannels == 1)
       {
-         for (i = wav->numsamples; i != 0; i--)
+         for (i = frames; i != 0; i--)
          {
             sample = (float)((int)*s16++ + 32768) / 65535.0f;
             sample = sample * 2.0f - 1.0f;
@@ -253,7 +504,7 @@ static bool wav2float(const rwav_t* wav, float** pcm, size_t samples_out)
       }
       else if (wav->numchannels == 2)
       {
-         for (i = wav->numsamples; i != 0; i--)
+         for (i = frames; i != 0; i--)
          {
             sample = (float)((int)*s16++ + 32768) / 65535.0f;
             sample = sample * 2.0f - 1.0f;
@@ -264,7 +515,20 @@ static bool wav2float(const rwav_t* wav, float** pcm, size_t samples_out)
          }
       }
    }
+}
+
+static bool wav2float(const rwav_t* wav, float** pcm, size_t samples_out)
+{
+   /* Allocate on a 16-byte boundary, and pad to a multiple of 16 bytes */
+   float *f           = (float*)memalign_alloc(16,
+         ((samples_out + 15) & ~15) * sizeof(float));
+
+   if (!f)
+      return false;
 
+   *pcm = f;
+
+   wav_to_float(wav, 0, wav->numsamples, false, f);
    return true;
 }
 
@@ -306,6 +570,62 @@ static bool one_shot_resample(const float* in, size_t samples_in,
    return true;
 }
 
+static void audio_mixer_free_sound(audio_mixer_sound_t* sound)
+{
+   void *handle = NULL;
+
+   switch (sound->type)
+   {
+      case AUDIO_MIXER_TYPE_WAV:
+         handle = (void*)sound->types.wav.pcm;
+         if (handle)
+            memalign_free(handle);
+         break;
+      case AUDIO_MIXER_TYPE_WAV_STREAM:
+         handle = (void*)sound->types.wav_stream.data;
+#if defined(HAVE_MMAN) && !defined(_WIN32)
+         if (sound->types.wav_stream.mapped)
+            munmap(handle, sound->types.wav_stream.size);
+         else
+#endif
+         if (handle)
+            free(handle);
+         break;
+      case AUDIO_MIXER_TYPE_OGG:
+#ifdef HAVE_STB_VORBIS
+         handle = (void*)sound->types.ogg.data;
+         if (handle)
+            free(handle);
+#endif
+         break;
+      case AUDIO_MIXER_TYPE_MOD:
+#ifdef HAVE_IBXM
+         handle = (void*)sound->types.mod.data;
+         if (handle)
+            free(handle);
+#endif
+         break;
+      case AUDIO_MIXER_TYPE_FLAC:
+#ifdef HAVE_DR_FLAC
+         handle = (void*)sound->types.flac.data;
+         if (handle)
+            free(handle);
+#endif
+         break;
+      case AUDIO_MIXER_TYPE_MP3:
+#ifdef HAVE_DR_MP3
+         handle = (void*)sound->types.mp3.data;
+         if (handle)
+            free(handle);
+#endif
+         break;
+      case AUDIO_MIXER_TYPE_NONE:
+         break;
+   }
+
+   free(sound);
+}
+
 void audio_mixer_init(unsigned rate)
 {
    unsigned i;
@@ -313,7 +633,13 @@ void audio_mixer_init(unsigned rate)
    s_rate = rate;
 
    for (i = 0; i < AUDIO_MIXER_MAX_VOICES; i++)
+   {
       s_voices[i].type = AUDIO_MIXER_TYPE_NONE;
+      s_voices[i].busy = 0;
+   }
+
+   spsc_queue_init(&s_commands,
+         AUDIO_MIXER_MAX_COMMANDS * sizeof(struct audio_mixer_command));
 
 #ifdef HAVE_THREADS
    s_locker = slock_new();
@@ -330,8 +656,35 @@ void audio_mixer_done(void)
    s_locker = NULL;
 #endif
 
+   spsc_queue_deinit(&s_commands);
+
+   /* Voices whose play command was never applied are still busy,
+    * with their type unset. The sound is valid until the retired ones
+    * are freed below. */
    for (i = 0; i < AUDIO_MIXER_MAX_VOICES; i++)
-      s_voices[i].type = AUDIO_MIXER_TYPE_NONE;
+   {
+      if (s_voices[i].busy)
+         audio_mixer_release(&s_voices[i], s_voices[i].owner->type);
+      s_voices[i].type  = AUDIO_MIXER_TYPE_NONE;
+      s_voices[i].busy  = 0;
+      s_voices[i].owner = NULL;
+   }
+
+   while (s_retired)
+   {
+      audio_mixer_sound_t *sound = s_retired;
+      s_retired                  = sound->next_retired;
+      audio_mixer_free_sound(sound);
+   }
+
+   s_retired = (audio_mixer_sound_t*)retro_atomic_exchange(&s_destroyed, 0);
+
+   while (s_retired)
+   {
+      audio_mixer_sound_t *sound = s_retired;
+      s_retired                  = sound->next_retired;
+      audio_mixer_free_sound(sound);
+   }
 }
 
 audio_mixer_sound_t* audio_mixer_load_wav(void *buffer, int32_t size)
@@ -382,6 +735,89 @@ audio_mixer_sound_t* audio_mixer_load_wav(void *buffer, int32_t size)
    return sound;
 }
 
+static audio_mixer_sound_t* audio_mixer_new_wav_stream(const void *buffer,
+      size_t size, bool mapped)
+{
+   rwav_t wav;
+   audio_mixer_sound_t* sound = NULL;
+
+   if (rwav_parse(&wav, buffer, size) != RWAV_ITERATE_DONE)
+      return NULL;
+
+   if (wav.numsamples == 0 || wav.samplerate == 0 ||
+         (wav.numchannels != 1 && wav.numchannels != 2))
+      return NULL;
+
+   sound = (audio_mixer_sound_t*)calloc(1, sizeof(*sound));
+
+   if (!sound)
+      return NULL;
+
+   sound->type                    = AUDIO_MIXER_TYPE_WAV_STREAM;
+   sound->types.wav_stream.size   = (unsigned)size;
+   sound->types.wav_stream.data   = buffer;
+   sound->types.wav_stream.mapped = mapped;
+   sound->types.wav_stream.wav    = wav;
+
+   return sound;
+}
+
+audio_mixer_sound_t* audio_mixer_load_wav_stream(void *buffer, int32_t size)
+{
+   return audio_mixer_new_wav_stream(buffer, size, false);
+}
+
+audio_mixer_sound_t* audio_mixer_load_wav_file(const char *path)
+{
+#if defined(HAVE_MMAN) && !defined(_WIN32)
+   struct stat st;
+   void *data                 = NULL;
+   audio_mixer_sound_t* sound = NULL;
+   int fd                     = open(path, O_RDONLY);
+
+   if (fd < 0)
+      return NULL;
+
+   if (fstat(fd, &st) != 0 || st.st_size <= 0 || st.st_size > INT32_MAX)
+   {
+      close(fd);
+      return NULL;
+   }
+
+   data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+
+   if (data == MAP_FAILED)
+      return NULL;
+
+#ifdef MADV_WILLNEED
+   /* Start reading ahead now, so the mixer rarely waits on the disk
+    * when it first touches a page. */
+   madvise(data, (size_t)st.st_size, MADV_WILLNEED);
+#endif
+
+   if (!(sound = audio_mixer_new_wav_stream(data, (size_t)st.st_size, true)))
+      munmap(data, (size_t)st.st_size);
+
+   return sound;
+#else
+   void *data                 = NULL;
+   int64_t len                = 0;
+   audio_mixer_sound_t* sound = NULL;
+
+   if (!filestream_read_file(path, &data, &len) || len > INT32_MAX)
+   {
+      free(data);
+      return NULL;
+   }
+
+   if (!(sound = audio_mixer_new_wav_stream(data, (size_t)len, false)))
+      free(data);
+
+   return sound;
+#endif
+}
+
 audio_mixer_sound_t* audio_mixer_load_ogg(void *buffer, int32_t size)
 {
 #ifdef HAVE_STB_VORBIS
@@ -455,59 +891,56 @@ audio_mixer_sound_t* audio_mixer_load_mod(void *buffer, int32_t size)
 #endif
 }
 
-void audio_mixer_destroy(audio_mixer_sound_t* sound)
+static bool audio_mixer_play_wav(audio_mixer_sound_t* sound,
+      audio_mixer_voice_t* voice, bool repeat, float volume,
+      audio_mixer_stop_cb_t stop_cb)
 {
-   void *handle = NULL;
-   if (!sound)
-      return;
-
-   switch (sound->type)
-   {
-      case AUDIO_MIXER_TYPE_WAV:
-         handle = (void*)sound->types.wav.pcm;
-         if (handle)
-            memalign_free(handle);
-         break;
-      case AUDIO_MIXER_TYPE_OGG:
-#ifdef HAVE_STB_VORBIS
-         handle = (void*)sound->types.ogg.data;
-         if (handle)
-            free(handle);
-#endif
-         break;
-      case AUDIO_MIXER_TYPE_MOD:
-#ifdef HAVE_IBXM
-         handle = (void*)sound->types.mod.data;
-         if (handle)
-            free(handle);
-#endif
-         break;
-      case AUDIO_MIXER_TYPE_FLAC:
-#ifdef HAVE_DR_FLAC
-         handle = (void*)sound->types.flac.data;
-         if (handle)
-            free(handle);
-#endif
-         break;
-      case AUDIO_MIXER_TYPE_MP3:
-#ifdef HAVE_DR_MP3
-         handle = (void*)sound->types.mp3.data;
-         if (handle)
-            free(handle);
-#endif
-         break;
-      case AUDIO_MIXER_TYPE_NONE:
-         break;
-   }
-
-   free(sound);
+   voice->types.wav.position = 0;
+   return true;
 }
 
-static bool audio_mixer_play_wav(audio_mixer_sound_t* sound,
+static bool audio_mixer_play_wav_stream(audio_mixer_sound_t* sound,
       audio_mixer_voice_t* voice, bool repeat, float volume,
       audio_mixer_stop_cb_t stop_cb)
 {
-   voice->types.wav.position = 0;
+   float ratio                     = 1.0f;
+   unsigned samples                = AUDIO_MIXER_TEMP_BUFFER;
+   void *wav_buffer                = NULL;
+   void *resampler_data            = NULL;
+   const retro_resampler_t* resamp = NULL;
+   unsigned rate                   = sound->types.wav_stream.wav.samplerate;
+
+   if (rate != s_rate)
+   {
+      ratio = (double)s_rate / (double)rate;
+
+      if (!retro_resampler_realloc(&resampler_data,
+               &resamp, NULL, RESAMPLER_QUALITY_DONTCARE,
+               ratio))
+         return false;
+
+      /* Resamplers may output a few frames more than the ratio says. */
+      samples = (unsigned)(AUDIO_MIXER_TEMP_BUFFER * ratio) + 16;
+   }
+
+   wav_buffer = memalign_alloc(16, ((samples + 15) & ~15) * sizeof(float));
+
+   if (!wav_buffer)
+   {
+      if (resamp)
+         resamp->free(resampler_data);
+      return false;
+   }
+
+   voice->types.wav_stream.resampler      = resamp;
+   voice->types.wav_stream.resampler_data = resampler_data;
+   voice->types.wav_stream.buffer         = (float*)wav_buffer;
+   voice->types.wav_stream.buf_samples    = samples;
+   voice->types.wav_stream.ratio          = ratio;
+   voice->types.wav_stream.frame          = 0;
+   voice->types.wav_stream.position       = 0;
+   voice->types.wav_stream.samples        = 0;
+
    return true;
 }
 
@@ -746,10 +1179,113 @@ error:
 #endif
 
 
+/* Posts a command for the next audio_mixer_mix() call.
+ * The caller must hold s_locker. */
+static bool audio_mixer_post(const struct audio_mixer_command *cmd,
+      size_t reserved)
+{
+   if (spsc_queue_write_avail(&s_commands) < (reserved + 1) * sizeof(*cmd))
+      return false;
+
+   spsc_queue_write(&s_commands, cmd, sizeof(*cmd));
+   return true;
+}
+
+/* Returns true while a voice the mixer hasn't released yet plays
+ * sound. The caller must hold s_locker. */
+static bool audio_mixer_sound_in_use(const audio_mixer_sound_t* sound)
+{
+   unsigned i;
+
+   for (i = 0; i < AUDIO_MIXER_MAX_VOICES; i++)
+   {
+      if (     s_voices[i].owner == sound
+            && retro_atomic_load_acquire(&s_voices[i].busy))
+         return true;
+   }
+
+   return false;
+}
+
+/* Stops the voices still playing the destroyed sounds and moves
+ * them to the retired ones, freeing those the mixer is done with.
+ * The caller must hold s_locker. */
+static void audio_mixer_free_retired(void)
+{
+   audio_mixer_sound_t **link     = &s_retired;
+   audio_mixer_sound_t *destroyed = (audio_mixer_sound_t*)
+      retro_atomic_exchange(&s_destroyed, 0);
+
+   while (destroyed)
+   {
+      unsigned i;
+      struct audio_mixer_command cmd;
+      audio_mixer_sound_t *sound = destroyed;
+
+      destroyed   = sound->next_retired;
+
+      /* The mixer may still be reading the sound, or hasn't seen the
+       * stop command of one of its voices yet. Stop whatever still
+       * plays it and free it once the mixer let go of all of them. */
+      cmd.type    = AUDIO_MIXER_COMMAND_STOP;
+      cmd.repeat  = false;
+      cmd.volume  = 0.0f;
+      cmd.sound   = NULL;
+      cmd.stop_cb = NULL;
+
+      for (i = 0; i < AUDIO_MIXER_MAX_VOICES; i++)
+      {
+         audio_mixer_voice_t *voice = &s_voices[i];
+
+         if (     voice->owner != sound
+               || voice->stopping
+               || !retro_atomic_load_acquire(&voice->busy))
+            continue;
+
+         cmd.voice       = voice;
+         audio_mixer_post(&cmd, 0);
+         voice->stopping = true;
+      }
+
+      sound->next_retired = s_retired;
+      s_retired           = sound;
+   }
+
+   while (*link)
+   {
+      audio_mixer_sound_t *sound = *link;
+
+      if (audio_mixer_sound_in_use(sound))
+         link  = &sound->next_retired;
+      else
+      {
+         *link = sound->next_retired;
+         audio_mixer_free_sound(sound);
+      }
+   }
+}
+
+void audio_mixer_destroy(audio_mixer_sound_t* sound)
+{
+   size_t head;
+
+   if (!sound)
+      return;
+
+   /* Doesn't take s_locker, so that stop callbacks can call it
+    * while another thread is in audio_mixer_play(). */
+   do
+   {
+      head                = retro_atomic_load_acquire(&s_destroyed);
+      sound->next_retired = (audio_mixer_sound_t*)head;
+   } while (!retro_atomic_cas(&s_destroyed, head, (size_t)sound));
+}
+
 audio_mixer_voice_t* audio_mixer_play(audio_mixer_sound_t* sound, bool repeat,
       float volume, audio_mixer_stop_cb_t stop_cb)
 {
    unsigned i;
+   struct audio_mixer_command cmd;
    bool res                   = false;
    audio_mixer_voice_t* voice = s_voices;
 
@@ -760,9 +1296,23 @@ audio_mixer_voice_t* audio_mixer_play(audio_mixer_sound_t* sound, bool repeat,
    slock_lock(s_locker);
 #endif
 
+   audio_mixer_free_retired();
+
+   /* Check for room before setting up a voice, only the mixer changes
+    * the free space meanwhile and it only adds to it. */
+   if (spsc_queue_write_avail(&s_commands) < sizeof(cmd))
+   {
+#ifdef HAVE_THREADS
+      slock_unlock(s_locker);
+#endif
+      return NULL;
+   }
+
+   /* Voices only become free in the mixer, which doesn't look at them
+    * again, so they can be set up here while it keeps running. */
    for (i = 0; i < AUDIO_MIXER_MAX_VOICES; i++, voice++)
    {
-      if (voice->type != AUDIO_MIXER_TYPE_NONE)
+      if (retro_atomic_load_acquire(&voice->busy))
          continue;
 
       switch (sound->type)
@@ -770,6 +1320,9 @@ audio_mixer_voice_t* audio_mixer_play(audio_mixer_sound_t* sound, bool repeat,
          case AUDIO_MIXER_TYPE_WAV:
             res = audio_mixer_play_wav(sound, voice, repeat, volume, stop_cb);
             break;
+         case AUDIO_MIXER_TYPE_WAV_STREAM:
+            res = audio_mixer_play_wav_stream(sound, voice, repeat, volume, stop_cb);
+            break;
          case AUDIO_MIXER_TYPE_OGG:
 #ifdef HAVE_STB_VORBIS
             res = audio_mixer_play_ogg(sound, voice, repeat, volume, stop_cb);
@@ -799,11 +1352,22 @@ audio_mixer_voice_t* audio_mixer_play(audio_mixer_sound_t* sound, bool repeat,
 
    if (res)
    {
-      voice->type     = sound->type;
-      voice->repeat   = repeat;
-      voice->volume   = volume;
-      voice->sound    = sound;
-      voice->stop_cb  = stop_cb;
+      voice->busy     = 1;
+      voice->stopping = false;
+      voice->owner    = sound;
+
+      cmd.type        = AUDIO_MIXER_COMMAND_PLAY;
+      cmd.repeat      = repeat;
+      cmd.volume      = volume;
+      cmd.voice       = voice;
+      cmd.sound       = sound;
+      cmd.stop_cb     = stop_cb;
+
+      if (!audio_mixer_post(&cmd, 0))
+      {
+         audio_mixer_release(voice, sound->type);
+         voice = NULL;
+      }
    }
    else
       voice = NULL;
@@ -817,26 +1381,95 @@ audio_mixer_voice_t* audio_mixer_play(audio_mixer_sound_t* sound, bool repeat,
 
 void audio_mixer_stop(audio_mixer_voice_t* voice)
 {
-   audio_mixer_stop_cb_t stop_cb = NULL;
-   audio_mixer_sound_t* sound    = NULL;
+   struct audio_mixer_command cmd;
+
+   if (!voice)
+      return;
+
+   cmd.type    = AUDIO_MIXER_COMMAND_STOP;
+   cmd.repeat  = false;
+   cmd.volume  = 0.0f;
+   cmd.voice   = voice;
+   cmd.sound   = NULL;
+   cmd.stop_cb = NULL;
 
-   if (voice)
+#ifdef HAVE_THREADS
+   slock_lock(s_locker);
+#endif
+
+   if (!voice->stopping)
    {
-      stop_cb = voice->stop_cb;
-      sound   = voice->sound;
+      audio_mixer_post(&cmd, 0);
+      voice->stopping = true;
+   }
 
 #ifdef HAVE_THREADS
-      slock_lock(s_locker);
+   slock_unlock(s_locker);
 #endif
+}
 
-      voice->type = AUDIO_MIXER_TYPE_NONE;
+void audio_mixer_voice_set_volume(audio_mixer_voice_t* voice, float volume)
+{
+   struct audio_mixer_command cmd;
+
+   if (!voice)
+      return;
+
+   cmd.type    = AUDIO_MIXER_COMMAND_VOLUME;
+   cmd.repeat  = false;
+   cmd.volume  = volume;
+   cmd.voice   = voice;
+   cmd.sound   = NULL;
+   cmd.stop_cb = NULL;
 
 #ifdef HAVE_THREADS
-      slock_unlock(s_locker);
+   slock_lock(s_locker);
 #endif
 
-      if (stop_cb)
-         stop_cb(sound, AUDIO_MIXER_SOUND_STOPPED);
+   /* Keep room for the play and stop commands, see above. */
+   audio_mixer_post(&cmd, AUDIO_MIXER_RESERVED_COMMANDS);
+
+#ifdef HAVE_THREADS
+   slock_unlock(s_locker);
+#endif
+}
+
+static void audio_mixer_apply_commands(void)
+{
+   struct audio_mixer_command cmd;
+
+   while (spsc_queue_read(&s_commands, &cmd, sizeof(cmd)) == sizeof(cmd))
+   {
+      audio_mixer_voice_t *voice = cmd.voice;
+
+      switch (cmd.type)
+      {
+         case AUDIO_MIXER_COMMAND_PLAY:
+            voice->type    = cmd.sound->type;
+            voice->repeat  = cmd.repeat;
+            voice->volume  = cmd.volume;
+            voice->sound   = cmd.sound;
+            voice->stop_cb = cmd.stop_cb;
+            break;
+         case AUDIO_MIXER_COMMAND_STOP:
+            {
+               unsigned type = voice->type;
+
+               if (type == AUDIO_MIXER_TYPE_NONE)
+                  break;
+
+               voice->type = AUDIO_MIXER_TYPE_NONE;
+
+               if (voice->stop_cb)
+                  voice->stop_cb(voice->sound, AUDIO_MIXER_SOUND_STOPPED);
+
+               audio_mixer_release(voice, type);
+            }
+            break;
+         case AUDIO_MIXER_COMMAND_VOLUME:
+            voice->volume  = cmd.volume;
+            break;
+      }
    }
 }
 
@@ -844,7 +1477,6 @@ static void audio_mixer_mix_wav(float* buffer, size_t num_frames,
       audio_mixer_voice_t* voice,
       float volume)
 {
-   int i;
    unsigned buf_free                = (unsigned)(num_frames * 2);
    const audio_mixer_sound_t* sound = voice->sound;
    unsigned pcm_available           = sound->types.wav.frames
@@ -855,8 +1487,8 @@ static void audio_mixer_mix_wav(float* buffer, size_t num_frames,
 again:
    if (pcm_available < buf_free)
    {
-      for (i = pcm_available; i != 0; i--)
-         *buffer++ += *pcm++ * volume;
+      audio_mixer_accumulate(buffer, pcm, pcm_available, volume);
+      buffer += pcm_available;
 
       if (voice->repeat)
       {
@@ -877,19 +1509,99 @@ again:
    }
    else
    {
-      for (i = buf_free; i != 0; i--)
-         *buffer++ += *pcm++ * volume;
-
+      audio_mixer_accumulate(buffer, pcm, buf_free, volume);
       voice->types.wav.position += buf_free;
    }
 }
 
+static void audio_mixer_mix_wav_stream(float* buffer, size_t num_frames,
+      audio_mixer_voice_t* voice,
+      float volume)
+{
+   struct resampler_data info = { 0 };
+   float temp_buffer[AUDIO_MIXER_TEMP_BUFFER];
+   unsigned buf_free                = (unsigned)(num_frames * 2);
+   size_t frames                    = 0;
+   float* pcm                       = NULL;
+   const rwav_t* wav                = &voice->sound->types.wav_stream.wav;
+
+   if (voice->types.wav_stream.samples == 0)
+   {
+again:
+      frames = wav->numsamples - voice->types.wav_stream.frame;
+
+      if (frames > AUDIO_MIXER_TEMP_BUFFER / 2)
+         frames = AUDIO_MIXER_TEMP_BUFFER / 2;
+
+      if (frames == 0)
+      {
+         if (voice->repeat)
+         {
+            if (voice->stop_cb)
+               voice->stop_cb(voice->sound, AUDIO_MIXER_SOUND_REPEATED);
+
+            voice->types.wav_stream.frame = 0;
+            goto again;
+         }
+         else
+         {
+            if (voice->stop_cb)
+               voice->stop_cb(voice->sound, AUDIO_MIXER_SOUND_FINISHED);
+
+            voice->type = AUDIO_MIXER_TYPE_NONE;
+            return;
+         }
+      }
+
+      if (voice->types.wav_stream.resampler)
+      {
+         wav_to_float(wav, voice->types.wav_stream.frame, frames,
+               true, temp_buffer);
+
+         info.data_in              = temp_buffer;
+         info.data_out             = voice->types.wav_stream.buffer;
+         info.input_frames         = frames;
+         info.output_frames        = 0;
+         info.ratio                = voice->types.wav_stream.ratio;
+
+         voice->types.wav_stream.resampler->process(
+               voice->types.wav_stream.resampler_data, &info);
+         voice->types.wav_stream.samples = (unsigned)(info.output_frames * 2);
+      }
+      else
+      {
+         wav_to_float(wav, voice->types.wav_stream.frame, frames,
+               true, voice->types.wav_stream.buffer);
+         voice->types.wav_stream.samples = (unsigned)(frames * 2);
+      }
+
+      voice->types.wav_stream.frame   += frames;
+      voice->types.wav_stream.position = 0;
+   }
+
+   pcm = voice->types.wav_stream.buffer + voice->types.wav_stream.position;
+
+   if (voice->types.wav_stream.samples < buf_free)
+   {
+      audio_mixer_accumulate(buffer, pcm,
+            voice->types.wav_stream.samples, volume);
+      buffer   += voice->types.wav_stream.samples;
+      buf_free -= voice->types.wav_stream.samples;
+      goto again;
+   }
+   else
+   {
+      audio_mixer_accumulate(buffer, pcm, buf_free, volume);
+      voice->types.wav_stream.position += buf_free;
+      voice->types.wav_stream.samples  -= buf_free;
+   }
+}
+
 #ifdef HAVE_STB_VORBIS
 static void audio_mixer_mix_ogg(float* buffer, size_t num_frames,
       audio_mixer_voice_t* voice,
       float volume)
 {
-   int i;
    struct resampler_data info = { 0 };
    float temp_buffer[AUDIO_MIXER_TEMP_BUFFER] = { 0 };
    unsigned buf_free                = (unsigned)(num_frames * 2);
@@ -941,18 +1653,15 @@ again:
 
    if (voice->types.ogg.samples < buf_free)
    {
-      for (i = voice->types.ogg.samples; i != 0; i--)
-         *buffer++ += *pcm++ * volume;
-
+      audio_mixer_accumulate(buffer, pcm,
+            voice->types.ogg.samples, volume);
+      buffer   += voice->types.ogg.samples;
       buf_free -= voice->types.ogg.samples;
       goto again;
    }
    else
    {
-      int i;
-      for (i = buf_free; i != 0; --i )
-         *buffer++ += *pcm++ * volume;
-
+      audio_mixer_accumulate(buffer, pcm, buf_free, volume);
       voice->types.ogg.position += buf_free;
       voice->types.ogg.samples  -= buf_free;
    }
@@ -964,9 +1673,6 @@ static void audio_mixer_mix_mod(float* buffer, size_t num_frames,
       audio_mixer_voice_t* voice,
       float volume)
 {
-   int i;
-   float samplef                    = 0.0f;
-   int samplei                      = 0;
    unsigned temp_samples            = 0;
    unsigned buf_free                = (unsigned)(num_frames * 2);
    int* pcm                         = NULL;
@@ -1006,28 +1712,15 @@ again:
 
    if (voice->types.mod.samples < buf_free)
    {
-      for (i = voice->types.mod.samples; i != 0; i--)
-      {
-         samplei     = *pcm++ * volume;
-         samplef     = (float)((int)samplei + 32768) / 65535.0f;
-         samplef     = samplef * 2.0f - 1.0f;
-         *buffer++  += samplef;
-      }
-
+      audio_mixer_accumulate_s32(buffer, pcm,
+            voice->types.mod.samples, volume);
+      buffer   += voice->types.mod.samples;
       buf_free -= voice->types.mod.samples;
       goto again;
    }
    else
    {
-      int i;
-      for (i = buf_free; i != 0; --i )
-      {
-         samplei     = *pcm++ * volume;
-         samplef     = (float)((int)samplei + 32768) / 65535.0f;
-         samplef     = samplef * 2.0f - 1.0f;
-         *buffer++  += samplef;
-      }
-
+      audio_mixer_accumulate_s32(buffer, pcm, buf_free, volume);
       voice->types.mod.position += buf_free;
       voice->types.mod.samples  -= buf_free;
    }
@@ -1039,7 +1732,6 @@ static void audio_mixer_mix_flac(float* buffer, size_t num_frames,
       audio_mixer_voice_t* voice,
       float volume)
 {
-   int i;
    struct resampler_data info = { 0 };
    float temp_buffer[AUDIO_MIXER_TEMP_BUFFER] = { 0 };
    unsigned buf_free                = (unsigned)(num_frames * 2);
@@ -1088,18 +1780,15 @@ again:
 
    if (voice->types.flac.samples < buf_free)
    {
-      for (i = voice->types.flac.samples; i != 0; i--)
-         *buffer++ += *pcm++ * volume;
-
+      audio_mixer_accumulate(buffer, pcm,
+            voice->types.flac.samples, volume);
+      buffer   += voice->types.flac.samples;
       buf_free -= voice->types.flac.samples;
       goto again;
    }
    else
    {
-      int i;
-      for (i = buf_free; i != 0; --i )
-         *buffer++ += *pcm++ * volume;
-
+      audio_mixer_accumulate(buffer, pcm, buf_free, volume);
       voice->types.flac.position += buf_free;
       voice->types.flac.samples  -= buf_free;
    }
@@ -1111,7 +1800,6 @@ static void audio_mixer_mix_mp3(float* buffer, size_t num_frames,
       audio_mixer_voice_t* voice,
       float volume)
 {
-   int i;
    struct resampler_data info = { 0 };
    float temp_buffer[AUDIO_MIXER_TEMP_BUFFER] = { 0 };
    unsigned buf_free                = (unsigned)(num_frames * 2);
@@ -1161,18 +1849,15 @@ again:
 
    if (voice->types.mp3.samples < buf_free)
    {
-      for (i = voice->types.mp3.samples; i != 0; i--)
-         *buffer++ += *pcm++ * volume;
-
+      audio_mixer_accumulate(buffer, pcm,
+            voice->types.mp3.samples, volume);
+      buffer   += voice->types.mp3.samples;
       buf_free -= voice->types.mp3.samples;
       goto again;
    }
    else
    {
-      int i;
-      for (i = buf_free; i != 0; --i )
-         *buffer++ += *pcm++ * volume;
-
+      audio_mixer_accumulate(buffer, pcm, buf_free, volume);
       voice->types.mp3.position += buf_free;
       voice->types.mp3.samples  -= buf_free;
    }
@@ -1182,23 +1867,26 @@ again:
 void audio_mixer_mix(float* buffer, size_t num_frames, float volume_override, bool override)
 {
    unsigned i;
-   size_t j                   = 0;
-   float* sample              = NULL;
    audio_mixer_voice_t* voice = s_voices;
 
-#ifdef HAVE_THREADS
-   slock_lock(s_locker);
-#endif
+   audio_mixer_apply_commands();
 
    for (i = 0; i < AUDIO_MIXER_MAX_VOICES; i++, voice++)
    {
-      float volume = (override) ? volume_override : voice->volume;
+      float volume  = (override) ? volume_override : voice->volume;
+      unsigned type = voice->type;
 
-      switch (voice->type)
+      if (type == AUDIO_MIXER_TYPE_NONE)
+         continue;
+
+      switch (type)
       {
          case AUDIO_MIXER_TYPE_WAV:
             audio_mixer_mix_wav(buffer, num_frames, voice, volume);
             break;
+         case AUDIO_MIXER_TYPE_WAV_STREAM:
+            audio_mixer_mix_wav_stream(buffer, num_frames, voice, volume);
+            break;
          case AUDIO_MIXER_TYPE_OGG:
 #ifdef HAVE_STB_VORBIS
             audio_mixer_mix_ogg(buffer, num_frames, voice, volume);
@@ -1222,17 +1910,11 @@ void audio_mixer_mix(float* buffer, size_t num_frames, float volume_override, bo
          case AUDIO_MIXER_TYPE_NONE:
             break;
       }
-   }
 
-#ifdef HAVE_THREADS
-   slock_unlock(s_locker);
-#endif
-
-   for (j = 0, sample = buffer; j < num_frames; j++, sample++)
-   {
-      if (*sample < -1.0f)
-         *sample = -1.0f;
-      else if (*sample > 1.0f)
-         *sample = 1.0f;
+      /* The voice finished playing during this pass. */
+      if (voice->type == AUDIO_MIXER_TYPE_NONE)
+         audio_mixer_release(voice, type);
    }
+
+   audio_mixer_clamp(buffer, num_frames * 2);
 }
@@ -0,0 +1,198 @@
+/* Copyright  (C) 2010-2018 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (audio_pipeline.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+
+#include <memalign.h>
+#include <retro_miscellaneous.h>
+
+#include <audio/audio_pipeline.h>
+#include <audio/conversion/float_to_s16.h>
+#include <audio/conversion/s16_to_float.h>
+
+/* Resamplers may output a few frames more than the ratio says. */
+#define AUDIO_PIPELINE_RESAMPLE_SLACK 16
+
+#define AUDIO_PIPELINE_MAX_STAGES 2
+
+/* Takes a block of float samples, and points it to the stage's
+ * output. */
+typedef void (*audio_pipeline_stage_t)(audio_pipeline_t *pipe,
+      float **samples, size_t *frames);
+
+struct audio_pipeline
+{
+   /* Scratch space, holding the converted and resampled blocks. */
+   float *arena;
+   float *block;
+   float *resampled;
+   size_t block_out_frames;
+
+   audio_pipeline_stage_t stages[AUDIO_PIPELINE_MAX_STAGES];
+   unsigned num_stages;
+
+   const retro_resampler_t *resampler;
+   void *resampler_data;
+   double ratio;
+   double max_ratio;
+
+   retro_dsp_filter_t *dsp;
+   float gain;
+};
+
+static void audio_pipeline_resample(audio_pipeline_t *pipe,
+      float **samples, size_t *frames)
+{
+   struct resampler_data data;
+
+   data.data_in       = *samples;
+   data.data_out      = pipe->resampled;
+   data.input_frames  = *frames;
+   data.output_frames = 0;
+   data.ratio         = pipe->ratio;
+
+   pipe->resampler->process(pipe->resampler_data, &data);
+
+   *samples           = pipe->resampled;
+   *frames            = data.output_frames;
+}
+
+static void audio_pipeline_filter(audio_pipeline_t *pipe,
+      float **samples, size_t *frames)
+{
+   struct retro_dsp_data data;
+
+   data.input         = *samples;
+   data.input_frames  = (unsigned)*frames;
+   data.output        = NULL;
+   data.output_frames = 0;
+
+   retro_dsp_filter_process(pipe->dsp, &data);
+
+   *samples           = data.output;
+   *frames            = data.output_frames;
+}
+
+audio_pipeline_t *audio_pipeline_new(const struct audio_pipeline_config *config)
+{
+   size_t resampled_frames = 0;
+   audio_pipeline_t *pipe  = (audio_pipeline_t*)calloc(1, sizeof(*pipe));
+
+   if (!pipe)
+      return NULL;
+
+   /* The output is only sized for filters keeping the frame count. */
+   if (config->dsp && !retro_dsp_filter_in_place(config->dsp))
+      goto error;
+
+   pipe->dsp              = config->dsp;
+   pipe->gain             = config->gain;
+   pipe->block_out_frames = AUDIO_PIPELINE_BLOCK_FRAMES;
+
+   if (config->max_ratio > 0.0)
+   {
+      if (!retro_resampler_realloc(&pipe->resampler_data,
+               &pipe->resampler, config->resampler_ident,
+               config->quality, config->max_ratio))
+         goto error;
+
+      pipe->max_ratio        = config->max_ratio;
+      resampled_frames       = (size_t)(AUDIO_PIPELINE_BLOCK_FRAMES
+            * config->max_ratio) + AUDIO_PIPELINE_RESAMPLE_SLACK;
+      pipe->block_out_frames = resampled_frames;
+
+      pipe->stages[pipe->num_stages++] = audio_pipeline_resample;
+   }
+
+   if (pipe->dsp)
+      pipe->stages[pipe->num_stages++] = audio_pipeline_filter;
+
+   pipe->arena = (float*)memalign_alloc(64,
+         (AUDIO_PIPELINE_BLOCK_FRAMES + resampled_frames)
+         * 2 * sizeof(float));
+
+   if (!pipe->arena)
+      goto error;
+
+   pipe->block     = pipe->arena;
+   pipe->resampled = pipe->arena + AUDIO_PIPELINE_BLOCK_FRAMES * 2;
+
+   convert_s16_to_float_init_simd();
+   convert_float_to_s16_init_simd();
+
+   return pipe;
+
+error:
+   audio_pipeline_free(pipe);
+   return NULL;
+}
+
+void audio_pipeline_free(audio_pipeline_t *pipe)
+{
+   if (!pipe)
+      return;
+
+   if (pipe->resampler && pipe->resampler_data)
+      pipe->resampler->free(pipe->resampler_data);
+
+   memalign_free(pipe->arena);
+   free(pipe);
+}
+
+size_t audio_pipeline_max_output_frames(audio_pipeline_t *pipe,
+      size_t frames)
+{
+   size_t blocks = (frames + AUDIO_PIPELINE_BLOCK_FRAMES - 1)
+      / AUDIO_PIPELINE_BLOCK_FRAMES;
+
+   return blocks * pipe->block_out_frames;
+}
+
+size_t audio_pipeline_process(audio_pipeline_t *pipe, int16_t *out,
+      const int16_t *in, size_t frames, double ratio)
+{
+   size_t written = 0;
+
+   /* Higher ratios would overrun the resampled block. */
+   pipe->ratio    = MIN(ratio, pipe->max_ratio);
+
+   while (frames)
+   {
+      unsigned i;
+      size_t block    = MIN(frames, AUDIO_PIPELINE_BLOCK_FRAMES);
+      size_t n        = block;
+      float *samples  = pipe->block;
+
+      convert_s16_to_float(samples, in, block * 2, pipe->gain);
+
+      for (i = 0; i < pipe->num_stages; i++)
+         pipe->stages[i](pipe, &samples, &n);
+
+      convert_float_to_s16(out + written * 2, samples, n * 2);
+
+      written        += n;
+      in             += block * 2;
+      frames         -= block;
+   }
+
+   return written;
+}
@@ -22,20 +22,461 @@
 #include <stdint.h>
 #include <stddef.h>
 
-#if defined(__SSE2__)
+#include <math.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
 #include <emmintrin.h>
 #elif defined(__ALTIVEC__)
 #include <altivec.h>
 #endif
 
+#include <retro_inline.h>
 #include <features/features_cpu.h>
 #include <audio/conversion/float_to_s16.h>
 
 #if defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+#include <arm_neon.h>
+
 static bool float_to_s16_neon_enabled = false;
 void convert_float_s16_asm(int16_t *out, const float *in, size_t samples);
 #endif
 
+/* Seeds of the xorshift32 generators of a new dithering state. */
+static const uint32_t float_to_s16_seeds[16] = {
+   0x9E3779B9, 0x7F4A7C15, 0x85EBCA6B, 0xC2B2AE35,
+   0x27D4EB2F, 0x165667B1, 0xD3A2646C, 0xFD7046C5,
+   0xB55A4F09, 0x8F1BBCDC, 0x6ED9EBA1, 0x5A827999,
+   0xCA62C1D6, 0x243F6A88, 0x13198A2E, 0x03707344
+};
+
+/* Triangular noise in [-1, 1) LSB is the sum of two random bytes
+ * minus 255, in 1/256 LSB. Each 32-bit draw dithers two samples,
+ * with its low and its high half. */
+#define FLOAT_TO_S16_TPDF_BIAS  255
+#define FLOAT_TO_S16_TPDF_SCALE (1.0f / 256.0f)
+
+/* The error feedback of noise shaping is a chain of dependent
+ * operations for each channel, so the SIMD paths split the buffer
+ * into this many parts, shaped side by side. Only the first sample
+ * of each part doesn't get the error of the one before it. */
+#define FLOAT_TO_S16_SHAPE_PARTS 8
+
+/* Parts shorter than this are not worth the trouble. */
+#define FLOAT_TO_S16_SHAPE_MIN_FRAMES 16
+
+#if defined(__SSE2__)
+static INLINE __m128i float_to_s16_next_sse2(__m128i *seed)
+{
+   __m128i x = *seed;
+
+   x     = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+   x     = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+   x     = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+   *seed = x;
+   return x;
+}
+
+/* Dither from the low and the high half of each draw, in 1/256 LSB,
+ * with @offset added. Both byte sums are made at once, in 16 bits. */
+static INLINE void float_to_s16_tpdf_sse2(__m128i x, __m128i offset,
+      __m128i *lo, __m128i *hi)
+{
+   __m128i mask = _mm_set1_epi32(0x00FF00FF);
+   __m128i sum  = _mm_add_epi16(_mm_and_si128(x, mask),
+         _mm_and_si128(_mm_srli_epi32(x, 8), mask));
+
+   sum = _mm_add_epi16(sum, offset);
+   *lo = _mm_srai_epi32(_mm_slli_epi32(sum, 16), 16);
+   *hi = _mm_srai_epi32(sum, 16);
+}
+
+/* One frame of two parts, in the low and high half of the vector.
+ * @dither is in 1/256 LSB, without the bias. */
+static INLINE void float_to_s16_shape_sse2(int16_t *out_a, int16_t *out_b,
+      const float *in_a, const float *in_b, __m128 *error, __m128i dither)
+{
+   __m128 lo   = _mm_set1_ps(-32768.0f);
+   __m128 hi   = _mm_set1_ps( 32767.0f);
+   __m128 x    = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(),
+            (const __m64*)in_a), (const __m64*)in_b);
+   __m128 d    = _mm_mul_ps(_mm_cvtepi32_ps(dither),
+         _mm_set1_ps(FLOAT_TO_S16_TPDF_SCALE));
+   __m128i q;
+   __m128 v;
+
+   /* Clipping is left out of the error, so that it can't grow. */
+   x      = _mm_min_ps(_mm_max_ps(
+            _mm_mul_ps(x, _mm_set1_ps((float)0x8000)), lo), hi);
+   v      = _mm_sub_ps(x, *error);
+   q      = _mm_cvtps_epi32(_mm_add_ps(v, d));
+   *error = _mm_sub_ps(_mm_cvtepi32_ps(q), v);
+   q      = _mm_packs_epi32(q, q);
+
+   _mm_store_ss((float*)out_a, _mm_castsi128_ps(q));
+   _mm_store_ss((float*)out_b, _mm_castsi128_ps(_mm_srli_si128(q, 4)));
+}
+#endif
+
+#if defined(__AVX2__)
+static INLINE __m256i float_to_s16_next_avx2(__m256i *seed)
+{
+   __m256i x = *seed;
+
+   x     = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+   x     = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+   x     = _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+   *seed = x;
+   return x;
+}
+
+/* See float_to_s16_tpdf_sse2(). */
+static INLINE void float_to_s16_tpdf_avx2(__m256i x, __m256i offset,
+      __m256i *lo, __m256i *hi)
+{
+   __m256i mask = _mm256_set1_epi32(0x00FF00FF);
+   __m256i sum  = _mm256_add_epi16(_mm256_and_si256(x, mask),
+         _mm256_and_si256(_mm256_srli_epi32(x, 8), mask));
+
+   sum = _mm256_add_epi16(sum, offset);
+   *lo = _mm256_srai_epi32(_mm256_slli_epi32(sum, 16), 16);
+   *hi = _mm256_srai_epi32(sum, 16);
+}
+#endif
+
+#if defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+static INLINE uint32x4_t float_to_s16_next_neon(uint32x4_t *seed)
+{
+   uint32x4_t x = *seed;
+
+   x     = veorq_u32(x, vshlq_n_u32(x, 13));
+   x     = veorq_u32(x, vshrq_n_u32(x, 17));
+   x     = veorq_u32(x, vshlq_n_u32(x, 5));
+   *seed = x;
+   return x;
+}
+
+/* Dither from the low half of each draw, in LSB. */
+static INLINE float32x4_t float_to_s16_tpdf_lo_neon(uint32x4_t x)
+{
+   uint32x4_t mask = vdupq_n_u32(0xFF);
+   int32x4_t sum   = vreinterpretq_s32_u32(vaddq_u32(vandq_u32(x, mask),
+            vandq_u32(vshrq_n_u32(x, 8), mask)));
+
+   return vmulq_n_f32(vcvtq_f32_s32(vsubq_s32(sum,
+               vdupq_n_s32(FLOAT_TO_S16_TPDF_BIAS))), FLOAT_TO_S16_TPDF_SCALE);
+}
+
+/* Same, from the high half. */
+static INLINE float32x4_t float_to_s16_tpdf_hi_neon(uint32x4_t x)
+{
+   int32x4_t sum = vreinterpretq_s32_u32(vaddq_u32(vandq_u32(
+               vshrq_n_u32(x, 16), vdupq_n_u32(0xFF)), vshrq_n_u32(x, 24)));
+
+   return vmulq_n_f32(vcvtq_f32_s32(vsubq_s32(sum,
+               vdupq_n_s32(FLOAT_TO_S16_TPDF_BIAS))), FLOAT_TO_S16_TPDF_SCALE);
+}
+
+/* NEON converts towards zero, adding and removing 1.5 * 2^23 rounds
+ * to the nearest integer instead. */
+static INLINE float32x4_t float_to_s16_round_neon(float32x4_t w)
+{
+   float32x4_t magic = vdupq_n_f32(12582912.0f);
+   return vsubq_f32(vaddq_f32(w, magic), magic);
+}
+
+/* See float_to_s16_shape_sse2(), with @dither in LSB. */
+static INLINE void float_to_s16_shape_neon(int16_t *out_a, int16_t *out_b,
+      const float *in_a, const float *in_b, float32x4_t *error,
+      float32x4_t dither)
+{
+   float32x4_t x = vcombine_f32(vld1_f32(in_a), vld1_f32(in_b));
+   float32x4_t v, q;
+   int16x4_t packed;
+
+   x      = vminq_f32(vmaxq_f32(vmulq_n_f32(x, (float)0x8000),
+            vdupq_n_f32(-32768.0f)), vdupq_n_f32(32767.0f));
+   v      = vsubq_f32(x, *error);
+   q      = float_to_s16_round_neon(vaddq_f32(v, dither));
+   *error = vsubq_f32(q, v);
+   packed = vqmovn_s32(vcvtq_s32_f32(q));
+
+   vst1_lane_s32((int32_t*)out_a, vreinterpret_s32_s16(packed), 0);
+   vst1_lane_s32((int32_t*)out_b, vreinterpret_s32_s16(packed), 1);
+}
+#endif
+
+/* Noise shaping of interleaved stereo, several parts at a time.
+ * Returns the number of samples done. */
+static size_t convert_float_to_s16_shape_stereo(
+      struct convert_float_to_s16_dither_state *state,
+      int16_t *out, const float *in, size_t samples)
+{
+   size_t len  = samples / (2 * FLOAT_TO_S16_SHAPE_PARTS);
+   size_t part = len * 2;
+   size_t n;
+
+   if (len < FLOAT_TO_S16_SHAPE_MIN_FRAMES)
+      return 0;
+
+#if defined(__SSE2__)
+   {
+      __m128i bias    = _mm_set1_epi16(-FLOAT_TO_S16_TPDF_BIAS);
+      __m128i seed0   = _mm_loadu_si128((const __m128i*)state->seed);
+      __m128i seed1   = _mm_loadu_si128((const __m128i*)state->seed + 1);
+      __m128 error[4] = { _mm_setzero_ps(), _mm_setzero_ps(),
+                          _mm_setzero_ps(), _mm_setzero_ps() };
+
+      error[0] = _mm_loadl_pi(error[0], (const __m64*)state->error);
+
+      for (n = 0; n < part; n += 2)
+      {
+         __m128i d[4];
+
+         float_to_s16_tpdf_sse2(float_to_s16_next_sse2(&seed0), bias,
+               &d[0], &d[1]);
+         float_to_s16_tpdf_sse2(float_to_s16_next_sse2(&seed1), bias,
+               &d[2], &d[3]);
+
+         float_to_s16_shape_sse2(out + n, out + n + part,
+               in + n, in + n + part, &error[0], d[0]);
+         float_to_s16_shape_sse2(out + n + 2 * part, out + n + 3 * part,
+               in + n + 2 * part, in + n + 3 * part, &error[1], d[1]);
+         float_to_s16_shape_sse2(out + n + 4 * part, out + n + 5 * part,
+               in + n + 4 * part, in + n + 5 * part, &error[2], d[2]);
+         float_to_s16_shape_sse2(out + n + 6 * part, out + n + 7 * part,
+               in + n + 6 * part, in + n + 7 * part, &error[3], d[3]);
+      }
+
+      _mm_storeu_si128((__m128i*)state->seed, seed0);
+      _mm_storeu_si128((__m128i*)state->seed + 1, seed1);
+      _mm_storeh_pi((__m64*)state->error, error[3]);
+      return FLOAT_TO_S16_SHAPE_PARTS * part;
+   }
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+   {
+      uint32x4_t seed0     = vld1q_u32(state->seed);
+      uint32x4_t seed1     = vld1q_u32(state->seed + 4);
+      float32x4_t error[4] = { vdupq_n_f32(0.0f), vdupq_n_f32(0.0f),
+                               vdupq_n_f32(0.0f), vdupq_n_f32(0.0f) };
+
+      error[0] = vcombine_f32(vld1_f32(state->error), vdup_n_f32(0.0f));
+
+      for (n = 0; n < part; n += 2)
+      {
+         uint32x4_t x0 = float_to_s16_next_neon(&seed0);
+         uint32x4_t x1 = float_to_s16_next_neon(&seed1);
+
+         float_to_s16_shape_neon(out + n, out + n + part,
+               in + n, in + n + part, &error[0],
+               float_to_s16_tpdf_lo_neon(x0));
+         float_to_s16_shape_neon(out + n + 2 * part, out + n + 3 * part,
+               in + n + 2 * part, in + n + 3 * part, &error[1],
+               float_to_s16_tpdf_hi_neon(x0));
+         float_to_s16_shape_neon(out + n + 4 * part, out + n + 5 * part,
+               in + n + 4 * part, in + n + 5 * part, &error[2],
+               float_to_s16_tpdf_lo_neon(x1));
+         float_to_s16_shape_neon(out + n + 6 * part, out + n + 7 * part,
+               in + n + 6 * part, in + n + 7 * part, &error[3],
+               float_to_s16_tpdf_hi_neon(x1));
+      }
+
+      vst1q_u32(state->seed, seed0);
+      vst1q_u32(state->seed + 4, seed1);
+      vst1_f32(state->error, vget_high_f32(error[3]));
+      return FLOAT_TO_S16_SHAPE_PARTS * part;
+   }
+#else
+   (void)state;
+   (void)out;
+   (void)in;
+   (void)n;
+   return 0;
+#endif
+}
+
+/* TPDF dither without shaping. Returns the number of samples done. */
+static size_t convert_float_to_s16_tpdf(
+      struct convert_float_to_s16_dither_state *state,
+      int16_t *out, const float *in, size_t samples)
+{
+   size_t i = 0;
+#if defined(__AVX2__)
+   /* Converted with 8 bits below the LSB, to which the dither and
+    * half an LSB are added before shifting them out. */
+   __m256 factor  = _mm256_set1_ps((float)0x8000 * 256.0f);
+   __m256i offset = _mm256_set1_epi16(128 - FLOAT_TO_S16_TPDF_BIAS);
+   __m256i seed0  = _mm256_loadu_si256((const __m256i*)state->seed);
+   __m256i seed1  = _mm256_loadu_si256((const __m256i*)state->seed + 1);
+
+   for (; i + 32 <= samples; i += 32)
+   {
+      __m256i da, db, dc, dd;
+      __m256i a  = _mm256_cvtps_epi32(_mm256_mul_ps(
+               _mm256_loadu_ps(in + i), factor));
+      __m256i b  = _mm256_cvtps_epi32(_mm256_mul_ps(
+               _mm256_loadu_ps(in + i + 8), factor));
+      __m256i c  = _mm256_cvtps_epi32(_mm256_mul_ps(
+               _mm256_loadu_ps(in + i + 16), factor));
+      __m256i d  = _mm256_cvtps_epi32(_mm256_mul_ps(
+               _mm256_loadu_ps(in + i + 24), factor));
+
+      float_to_s16_tpdf_avx2(float_to_s16_next_avx2(&seed0), offset,
+            &da, &db);
+      float_to_s16_tpdf_avx2(float_to_s16_next_avx2(&seed1), offset,
+            &dc, &dd);
+
+      a = _mm256_srai_epi32(_mm256_add_epi32(a, da), 8);
+      b = _mm256_srai_epi32(_mm256_add_epi32(b, db), 8);
+      c = _mm256_srai_epi32(_mm256_add_epi32(c, dc), 8);
+      d = _mm256_srai_epi32(_mm256_add_epi32(d, dd), 8);
+
+      /* packs works within 128-bit lanes, put them back in order. */
+      _mm256_storeu_si256((__m256i*)(out + i),
+            _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8));
+      _mm256_storeu_si256((__m256i*)(out + i + 16),
+            _mm256_permute4x64_epi64(_mm256_packs_epi32(c, d), 0xD8));
+   }
+
+   _mm256_storeu_si256((__m256i*)state->seed, seed0);
+   _mm256_storeu_si256((__m256i*)state->seed + 1, seed1);
+#elif defined(__SSE2__)
+   /* See above. */
+   __m128 factor  = _mm_set1_ps((float)0x8000 * 256.0f);
+   __m128i offset = _mm_set1_epi16(128 - FLOAT_TO_S16_TPDF_BIAS);
+   __m128i seed0  = _mm_loadu_si128((const __m128i*)state->seed);
+   __m128i seed1  = _mm_loadu_si128((const __m128i*)state->seed + 1);
+
+   for (; i + 16 <= samples; i += 16)
+   {
+      __m128i da, db, dc, dd;
+      __m128i a  = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i), factor));
+      __m128i b  = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i + 4), factor));
+      __m128i c  = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i + 8), factor));
+      __m128i d  = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i + 12), factor));
+
+      float_to_s16_tpdf_sse2(float_to_s16_next_sse2(&seed0), offset,
+            &da, &db);
+      float_to_s16_tpdf_sse2(float_to_s16_next_sse2(&seed1), offset,
+            &dc, &dd);
+
+      a = _mm_srai_epi32(_mm_add_epi32(a, da), 8);
+      b = _mm_srai_epi32(_mm_add_epi32(b, db), 8);
+      c = _mm_srai_epi32(_mm_add_epi32(c, dc), 8);
+      d = _mm_srai_epi32(_mm_add_epi32(d, dd), 8);
+
+      _mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(a, b));
+      _mm_storeu_si128((__m128i*)(out + i + 8), _mm_packs_epi32(c, d));
+   }
+
+   _mm_storeu_si128((__m128i*)state->seed, seed0);
+   _mm_storeu_si128((__m128i*)state->seed + 1, seed1);
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+   uint32x4_t seed0 = vld1q_u32(state->seed);
+   uint32x4_t seed1 = vld1q_u32(state->seed + 4);
+
+   for (; i + 16 <= samples; i += 16)
+   {
+      uint32x4_t x0 = float_to_s16_next_neon(&seed0);
+      uint32x4_t x1 = float_to_s16_next_neon(&seed1);
+      float32x4_t a = vaddq_f32(vmulq_n_f32(vld1q_f32(in + i),
+               (float)0x8000), float_to_s16_tpdf_lo_neon(x0));
+      float32x4_t b = vaddq_f32(vmulq_n_f32(vld1q_f32(in + i + 4),
+               (float)0x8000), float_to_s16_tpdf_hi_neon(x0));
+      float32x4_t c = vaddq_f32(vmulq_n_f32(vld1q_f32(in + i + 8),
+               (float)0x8000), float_to_s16_tpdf_lo_neon(x1));
+      float32x4_t d = vaddq_f32(vmulq_n_f32(vld1q_f32(in + i + 12),
+               (float)0x8000), float_to_s16_tpdf_hi_neon(x1));
+
+      vst1q_s16(out + i, vcombine_s16(
+               vqmovn_s32(vcvtq_s32_f32(float_to_s16_round_neon(a))),
+               vqmovn_s32(vcvtq_s32_f32(float_to_s16_round_neon(b)))));
+      vst1q_s16(out + i + 8, vcombine_s16(
+               vqmovn_s32(vcvtq_s32_f32(float_to_s16_round_neon(c))),
+               vqmovn_s32(vcvtq_s32_f32(float_to_s16_round_neon(d)))));
+   }
+
+   vst1q_u32(state->seed, seed0);
+   vst1q_u32(state->seed + 4, seed1);
+#else
+   (void)state;
+   (void)out;
+   (void)in;
+   (void)samples;
+#endif
+
+   return i;
+}
+
+/**
+ * convert_float_to_s16_dithered:
+ * @state             : dithering state of the stream
+ * @out               : output buffer
+ * @in                : input buffer
+ * @samples           : size of samples to be converted
+ *
+ * Same as convert_float_to_s16(), dithering as set up
+ * in @state.
+ **/
+void convert_float_to_s16_dithered(
+      struct convert_float_to_s16_dither_state *state,
+      int16_t *out, const float *in, size_t samples)
+{
+   size_t i        = 0;
+   unsigned ch     = 0;
+   bool shaped     = state->dither == CONVERT_FLOAT_TO_S16_DITHER_TPDF_SHAPED;
+
+   if (state->dither == CONVERT_FLOAT_TO_S16_DITHER_NONE)
+   {
+      convert_float_to_s16(out, in, samples);
+      return;
+   }
+
+   if (!shaped)
+      i = convert_float_to_s16_tpdf(state, out, in, samples);
+   else if (state->channels == 2)
+      i = convert_float_to_s16_shape_stereo(state, out, in, samples);
+
+   /* The SIMD paths only stop at frame boundaries. */
+   for (; i < samples; i++)
+   {
+      int32_t val;
+      uint32_t x   = state->seed[0];
+      float sample = in[i] * 0x8000;
+      float dither;
+
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      state->seed[0] = x;
+      dither = (float)((int32_t)((x & 0xFF) + ((x >> 8) & 0xFF))
+            - FLOAT_TO_S16_TPDF_BIAS) * FLOAT_TO_S16_TPDF_SCALE;
+
+      if (!shaped)
+      {
+         val = (int32_t)floorf(sample + dither + 0.5f);
+         out[i] = (val > 0x7FFF) ? 0x7FFF :
+            (val < -0x8000 ? -0x8000 : (int16_t)val);
+         continue;
+      }
+
+      if (sample > 32767.0f)
+         sample = 32767.0f;
+      else if (sample < -32768.0f)
+         sample = -32768.0f;
+
+      sample          -= state->error[ch];
+      val              = (int32_t)floorf(sample + dither + 0.5f);
+      out[i]           = (val > 0x7FFF) ? 0x7FFF :
+         (val < -0x8000 ? -0x8000 : (int16_t)val);
+      state->error[ch] = (float)val - sample;
+
+      if (++ch == state->channels)
+         ch = 0;
+   }
+}
+
 /**
  * convert_float_to_s16:
  * @out               : output buffer
@@ -53,7 +494,9 @@ void convert_float_to_s16(int16_t *out,
    size_t i      = 0;
 #if defined(__SSE2__)
    __m128 factor = _mm_set1_ps((float)0x8000);
+#endif
 
+#if defined(__SSE2__)
    for (i = 0; i + 8 <= samples; i += 8, in += 8, out += 8)
    {
       __m128 input_l = _mm_loadu_ps(in + 0);
@@ -158,3 +601,28 @@ void convert_float_to_s16_init_simd(void)
       float_to_s16_neon_enabled = true;
 #endif
 }
+
+/**
+ * convert_float_to_s16_init_dither:
+ * @state             : dithering state to set up
+ * @dither            : dithering to use
+ * @channels          : number of interleaved channels
+ *
+ * Sets up the dithering state of a stream.
+ **/
+void convert_float_to_s16_init_dither(
+      struct convert_float_to_s16_dither_state *state,
+      enum convert_float_to_s16_dither dither, unsigned channels)
+{
+   unsigned i;
+
+   state->dither   = dither;
+   state->channels = channels < 1 ? 1
+      : (channels > CONVERT_FLOAT_TO_S16_MAX_CHANNELS
+            ? CONVERT_FLOAT_TO_S16_MAX_CHANNELS : channels);
+
+   for (i = 0; i < 16; i++)
+      state->seed[i] = float_to_s16_seeds[i];
+   for (i = 0; i < CONVERT_FLOAT_TO_S16_MAX_CHANNELS; i++)
+      state->error[i] = 0.0f;
+}
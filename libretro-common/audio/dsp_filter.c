@@ -21,6 +21,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <retro_miscellaneous.h>
 
@@ -34,6 +35,10 @@
 #include <string/stdstring.h>
 #include <libretro_dspfilter.h>
 
+#ifdef HAVE_THREADS
+#include <rthreads/rthreads.h>
+#endif
+
 #include <audio/dsp_filter.h>
 
 struct retro_dsp_plug
@@ -44,12 +49,103 @@ struct retro_dsp_plug
    const struct dspfilter_implementation *impl;
 };
 
+/* Largest block run through a sequence of in-place filters at once,
+ * small enough for it to stay in the cache from one filter to the
+ * next. */
+#define DSP_FILTER_BLOCK_FRAMES 256
+
+/* Most frames the branches take at once. Their buffers are allocated
+ * for it up front, longer inputs go through them in slices. */
+#define DSP_FILTER_SLICE_FRAMES 2048
+
+/* Jobs are only spread over the workers once they take more than
+ * this share of the time the block plays for. Below that, waking
+ * the workers costs more than it saves. */
+#define DSP_FILTER_PARALLEL_SHARE 4
+
 struct retro_dsp_instance
 {
    const struct dspfilter_implementation *impl;
    void *impl_data;
+   unsigned flags;
+   struct dspfilter_properties props;
+   /* Number of in-place instances starting with this one. */
+   unsigned in_place_run;
+};
+
+/* Filters run one after another. */
+struct retro_dsp_chain
+{
+   struct retro_dsp_instance *instances;
+   unsigned num_instances;
+
+   /* Frames each in-place run is cut into. */
+   unsigned block_frames;
+   unsigned latency;
 };
 
+struct retro_dsp_lane;
+
+/* One of several chains fed with the same input, whose outputs are
+ * mixed together. */
+struct retro_dsp_branch
+{
+   struct retro_dsp_chain chain;
+   struct retro_dsp_lane *lane;
+   float gain;
+
+   /* The branch's own copy of the slice, processed in place. */
+   float *buffer;
+
+   /* Ring buffer delaying the output to line up with the branch
+    * with the most latency. */
+   float *delay;
+   unsigned delay_frames;
+   unsigned delay_pos;
+};
+
+/* The graph of one channel pair. */
+struct retro_dsp_lane
+{
+   struct retro_dsp_chain chain;
+
+   struct retro_dsp_branch *branches;
+   unsigned num_branches;
+
+   /* Part of the chain's output the branches are working on. */
+   unsigned slice_pos;
+   unsigned slice_frames;
+
+   /* Samples being processed, NULL if the pair isn't in use. */
+   struct retro_dsp_data *data;
+};
+
+struct retro_dsp_job
+{
+   void (*func)(void *arg);
+   void *arg;
+   /* Running average of how long the job took, in microseconds. */
+   retro_time_t cost;
+};
+
+#ifdef HAVE_THREADS
+struct retro_dsp_pool
+{
+   sthread_t **threads;
+   unsigned num_threads;
+
+   slock_t *lock;
+   scond_t *work_cond;
+   scond_t *done_cond;
+
+   struct retro_dsp_job *jobs;
+   unsigned num_jobs;
+   unsigned next_job;
+   unsigned pending;
+   bool quit;
+};
+#endif
+
 struct retro_dsp_filter
 {
    config_file_t *conf;
@@ -57,8 +153,21 @@ struct retro_dsp_filter
    struct retro_dsp_plug *plugs;
    unsigned num_plugs;
 
-   struct retro_dsp_instance *instances;
-   unsigned num_instances;
+   struct retro_dsp_lane *lanes;
+   unsigned num_lanes;
+
+   /* One job per lane running its chain, then one per branch. */
+   struct retro_dsp_job *chain_jobs;
+   struct retro_dsp_job *branch_jobs;
+   unsigned num_branch_jobs;
+
+   float sample_rate;
+   unsigned latency;
+
+#ifdef HAVE_THREADS
+   /* NULL when running single-threaded. */
+   struct retro_dsp_pool *pool;
+#endif
 };
 
 static const struct dspfilter_implementation *find_implementation(
@@ -83,21 +192,56 @@ static const struct dspfilter_config dspfilter_config = {
    config_userdata_free,
 };
 
-static bool create_filter_graph(retro_dsp_filter_t *dsp, float sample_rate)
+/* Gathers what the instances need, and finds the runs of in-place
+ * ones, which are then taken through a block at a time all in the
+ * same buffer. Only filters that bring their own buffer make the
+ * data move elsewhere. */
+static void plan_filter_chain(struct retro_dsp_chain *chain)
 {
    unsigned i;
-   struct retro_dsp_instance *instances = NULL;
-   unsigned filters                     = 0;
+   unsigned run = 0;
 
-   if (!config_get_uint(dsp->conf, "filters", &filters))
-      return false;
+   chain->block_frames = DSP_FILTER_BLOCK_FRAMES;
+   chain->latency      = 0;
 
-   instances = (struct retro_dsp_instance*)calloc(filters, sizeof(*instances));
-   if (!instances)
-      return false;
+   for (i = chain->num_instances; i-- > 0; )
+   {
+      struct retro_dsp_instance *inst = &chain->instances[i];
+
+      memset(&inst->props, 0, sizeof(inst->props));
+      inst->flags = 0;
+
+      if (inst->impl->api_version >= 2)
+      {
+         inst->flags = inst->impl->flags;
+         if (inst->impl->query)
+            inst->impl->query(inst->impl_data, &inst->props);
+      }
+
+      run                = (inst->flags & DSPFILTER_FLAG_IN_PLACE) ? run + 1 : 0;
+      inst->in_place_run = run;
 
-   dsp->instances     = instances;
-   dsp->num_instances = filters;
+      if (run && inst->props.max_frames)
+         chain->block_frames = MIN(chain->block_frames, inst->props.max_frames);
+
+      chain->latency += inst->props.latency;
+   }
+}
+
+static bool create_filter_chain(retro_dsp_filter_t *dsp,
+      struct retro_dsp_chain *chain, const char *prefix, unsigned filters)
+{
+   unsigned i;
+
+   if (filters)
+   {
+      chain->instances = (struct retro_dsp_instance*)
+         calloc(filters, sizeof(*chain->instances));
+      if (!chain->instances)
+         return false;
+   }
+
+   chain->num_instances = filters;
 
    for (i = 0; i < filters; i++)
    {
@@ -108,28 +252,465 @@ static bool create_filter_graph(retro_dsp_filter_t *dsp, float sample_rate)
 
       key[0] = name[0] = '\0';
 
-      info.input_rate  = sample_rate;
+      info.input_rate  = dsp->sample_rate;
 
-      snprintf(key, sizeof(key), "filter%u", i);
+      snprintf(key, sizeof(key), "%sfilter%u", prefix, i);
 
       if (!config_get_array(dsp->conf, key, name, sizeof(name)))
          return false;
 
-      dsp->instances[i].impl = find_implementation(dsp, name);
-      if (!dsp->instances[i].impl)
+      chain->instances[i].impl = find_implementation(dsp, name);
+      if (!chain->instances[i].impl)
          return false;
 
       userdata.conf = dsp->conf;
       /* Index-specific configs take priority over ident-specific. */
       userdata.prefix[0] = key;
-      userdata.prefix[1] = dsp->instances[i].impl->short_ident;
+      userdata.prefix[1] = chain->instances[i].impl->short_ident;
 
-      dsp->instances[i].impl_data = dsp->instances[i].impl->init(&info,
+      chain->instances[i].impl_data = chain->instances[i].impl->init(&info,
             &dspfilter_config, &userdata);
-      if (!dsp->instances[i].impl_data)
+      if (!chain->instances[i].impl_data)
          return false;
    }
 
+   plan_filter_chain(chain);
+   return true;
+}
+
+static void free_filter_chain(struct retro_dsp_chain *chain)
+{
+   unsigned i;
+
+   for (i = 0; i < chain->num_instances; i++)
+   {
+      if (chain->instances[i].impl_data && chain->instances[i].impl)
+         chain->instances[i].impl->free(chain->instances[i].impl_data);
+   }
+   free(chain->instances);
+}
+
+static bool create_branches(retro_dsp_filter_t *dsp,
+      struct retro_dsp_lane *lane, unsigned branches)
+{
+   unsigned i, j;
+   unsigned latency = 0;
+
+   lane->branches = (struct retro_dsp_branch*)
+      calloc(branches, sizeof(*lane->branches));
+   if (!lane->branches)
+      return false;
+
+   lane->num_branches = branches;
+
+   for (i = 0; i < branches; i++)
+   {
+      char key[64];
+      char prefix[32];
+      unsigned filters                = 0;
+      struct retro_dsp_branch *branch = &lane->branches[i];
+
+      branch->lane = lane;
+      branch->gain = 1.0f;
+
+      snprintf(key, sizeof(key), "branch%u_filters", i);
+      config_get_uint(dsp->conf, key, &filters);
+      snprintf(key, sizeof(key), "branch%u_mix", i);
+      config_get_float(dsp->conf, key, &branch->gain);
+
+      snprintf(prefix, sizeof(prefix), "branch%u_", i);
+      if (!create_filter_chain(dsp, &branch->chain, prefix, filters))
+         return false;
+
+      /* Branch outputs are added up frame by frame, so they have to
+       * keep the frame count, which only in-place filters promise. */
+      for (j = 0; j < branch->chain.num_instances; j++)
+      {
+         if (!(branch->chain.instances[j].flags & DSPFILTER_FLAG_IN_PLACE))
+            return false;
+      }
+
+      branch->buffer = (float*)malloc(
+            DSP_FILTER_SLICE_FRAMES * 2 * sizeof(float));
+      if (!branch->buffer)
+         return false;
+
+      latency = MAX(latency, branch->chain.latency);
+   }
+
+   for (i = 0; i < branches; i++)
+   {
+      struct retro_dsp_branch *branch = &lane->branches[i];
+
+      branch->delay_frames = latency - branch->chain.latency;
+      if (!branch->delay_frames)
+         continue;
+
+      branch->delay = (float*)calloc(branch->delay_frames, 2 * sizeof(float));
+      if (!branch->delay)
+         return false;
+   }
+
+   return true;
+}
+
+static void process_filter_chain(const struct retro_dsp_chain *chain,
+      float **samples, unsigned *frames)
+{
+   unsigned i                     = 0;
+   struct dspfilter_output output = {0};
+   struct dspfilter_input input   = {0};
+
+   output.samples = *samples;
+   output.frames  = *frames;
+
+   while (i < chain->num_instances)
+   {
+      unsigned run = chain->instances[i].in_place_run;
+
+      if (run)
+      {
+         unsigned pos;
+         float *block_samples = output.samples;
+         unsigned block_total = output.frames;
+         unsigned end         = i + run;
+
+         for (pos = 0; pos < block_total; pos += chain->block_frames)
+         {
+            unsigned j;
+
+            input.samples = block_samples + 2 * pos;
+            input.frames  = MIN(block_total - pos, chain->block_frames);
+
+            for (j = i; j < end; j++)
+               chain->instances[j].impl->process(
+                     chain->instances[j].impl_data, &output, &input);
+         }
+
+         /* The process calls pointed these at the last block. */
+         output.samples = block_samples;
+         output.frames  = block_total;
+         i              = end;
+         continue;
+      }
+
+      input.samples = output.samples;
+      input.frames  = output.frames;
+      chain->instances[i].impl->process(
+            chain->instances[i].impl_data, &output, &input);
+      i++;
+   }
+
+   *samples = output.samples;
+   *frames  = output.frames;
+}
+
+static void run_lane_chain(void *arg)
+{
+   struct retro_dsp_lane *lane = (struct retro_dsp_lane*)arg;
+   struct retro_dsp_data *data = lane->data;
+
+   if (!data)
+      return;
+
+   data->output        = data->input;
+   data->output_frames = data->input_frames;
+   process_filter_chain(&lane->chain, &data->output, &data->output_frames);
+}
+
+static void run_branch(void *arg)
+{
+   unsigned i;
+   struct retro_dsp_branch *branch = (struct retro_dsp_branch*)arg;
+   struct retro_dsp_lane *lane     = branch->lane;
+   unsigned frames                 = lane->slice_frames;
+   float *samples                  = branch->buffer;
+
+   if (!lane->data || !frames)
+      return;
+
+   memcpy(samples, lane->data->output + 2 * lane->slice_pos,
+         frames * 2 * sizeof(float));
+
+   /* Only in-place filters, so this stays in the buffer. */
+   process_filter_chain(&branch->chain, &samples, &frames);
+
+   for (i = 0; branch->delay_frames && i < frames; i++)
+   {
+      float *slot        = branch->delay + 2 * branch->delay_pos;
+      float left         = slot[0];
+      float right        = slot[1];
+
+      slot[0]            = samples[2 * i + 0];
+      slot[1]            = samples[2 * i + 1];
+      samples[2 * i + 0] = left;
+      samples[2 * i + 1] = right;
+
+      if (++branch->delay_pos == branch->delay_frames)
+         branch->delay_pos = 0;
+   }
+}
+
+/* Every branch has its own copy of the slice by now, so the mix goes
+ * right back over it. */
+static void mix_branches(struct retro_dsp_lane *lane)
+{
+   unsigned i, j;
+   float *out      = lane->data->output + 2 * lane->slice_pos;
+   unsigned frames = lane->slice_frames;
+
+   memset(out, 0, frames * 2 * sizeof(float));
+
+   for (i = 0; i < lane->num_branches; i++)
+   {
+      const struct retro_dsp_branch *branch = &lane->branches[i];
+
+      for (j = 0; j < frames * 2; j++)
+         out[j] += branch->gain * branch->buffer[j];
+   }
+}
+
+static void run_job(struct retro_dsp_job *job)
+{
+   retro_time_t start = cpu_features_get_time_usec();
+
+   job->func(job->arg);
+
+   job->cost = (3 * job->cost + cpu_features_get_time_usec() - start) / 4;
+}
+
+#ifdef HAVE_THREADS
+static void retro_dsp_pool_worker(void *data)
+{
+   struct retro_dsp_pool *pool = (struct retro_dsp_pool*)data;
+
+   slock_lock(pool->lock);
+
+   for (;;)
+   {
+      struct retro_dsp_job *job = NULL;
+
+      while (!pool->quit && pool->next_job >= pool->num_jobs)
+         scond_wait(pool->work_cond, pool->lock);
+
+      if (pool->quit)
+         break;
+
+      job = &pool->jobs[pool->next_job++];
+
+      slock_unlock(pool->lock);
+      run_job(job);
+      slock_lock(pool->lock);
+
+      if (!--pool->pending)
+         scond_signal(pool->done_cond);
+   }
+
+   slock_unlock(pool->lock);
+}
+
+static void retro_dsp_pool_free(struct retro_dsp_pool *pool)
+{
+   unsigned i;
+
+   if (!pool)
+      return;
+
+   if (pool->lock)
+   {
+      slock_lock(pool->lock);
+      pool->quit = true;
+      if (pool->work_cond)
+         scond_broadcast(pool->work_cond);
+      slock_unlock(pool->lock);
+   }
+
+   for (i = 0; i < pool->num_threads; i++)
+      sthread_join(pool->threads[i]);
+
+   if (pool->work_cond)
+      scond_free(pool->work_cond);
+   if (pool->done_cond)
+      scond_free(pool->done_cond);
+   if (pool->lock)
+      slock_free(pool->lock);
+
+   free(pool->threads);
+   free(pool);
+}
+
+static struct retro_dsp_pool *retro_dsp_pool_new(unsigned threads)
+{
+   struct retro_dsp_pool *pool = (struct retro_dsp_pool*)
+      calloc(1, sizeof(*pool));
+
+   if (!pool)
+      return NULL;
+
+   pool->threads   = (sthread_t**)calloc(threads, sizeof(*pool->threads));
+   pool->lock      = slock_new();
+   pool->work_cond = scond_new();
+   pool->done_cond = scond_new();
+
+   if (!pool->threads || !pool->lock || !pool->work_cond || !pool->done_cond)
+      goto error;
+
+   for (; pool->num_threads < threads; pool->num_threads++)
+   {
+      pool->threads[pool->num_threads] = sthread_create(
+            retro_dsp_pool_worker, pool);
+      if (!pool->threads[pool->num_threads])
+         goto error;
+   }
+
+   return pool;
+
+error:
+   retro_dsp_pool_free(pool);
+   return NULL;
+}
+
+static void retro_dsp_pool_run(struct retro_dsp_pool *pool,
+      struct retro_dsp_job *jobs, unsigned num_jobs)
+{
+   slock_lock(pool->lock);
+
+   pool->jobs     = jobs;
+   pool->num_jobs = num_jobs;
+   pool->next_job = 0;
+   pool->pending  = num_jobs;
+   scond_broadcast(pool->work_cond);
+
+   /* Lend a hand rather than just wait. */
+   while (pool->next_job < pool->num_jobs)
+   {
+      struct retro_dsp_job *job = &pool->jobs[pool->next_job++];
+
+      slock_unlock(pool->lock);
+      run_job(job);
+      slock_lock(pool->lock);
+
+      pool->pending--;
+   }
+
+   while (pool->pending)
+      scond_wait(pool->done_cond, pool->lock);
+
+   slock_unlock(pool->lock);
+}
+#endif
+
+/* Runs independent jobs, on the workers if they are likely to be
+ * needed to make it in time for @deadline microseconds. */
+static void run_jobs(retro_dsp_filter_t *dsp, struct retro_dsp_job *jobs,
+      unsigned num_jobs, retro_time_t deadline)
+{
+   unsigned i;
+   retro_time_t total = 0;
+
+   /* Longest first, so the one that takes longest isn't started last,
+    * going by how long each took before. */
+   for (i = 0; i < num_jobs; i++)
+   {
+      unsigned j               = i;
+      struct retro_dsp_job job = jobs[i];
+
+      for (; j > 0 && jobs[j - 1].cost < job.cost; j--)
+         jobs[j] = jobs[j - 1];
+      jobs[j] = job;
+
+      total  += job.cost;
+   }
+
+#ifdef HAVE_THREADS
+   if (dsp->pool && num_jobs > 1
+         && total * DSP_FILTER_PARALLEL_SHARE > deadline)
+   {
+      retro_dsp_pool_run(dsp->pool, jobs, num_jobs);
+      return;
+   }
+#endif
+
+   for (i = 0; i < num_jobs; i++)
+      run_job(&jobs[i]);
+}
+
+static bool create_filter_graph(retro_dsp_filter_t *dsp, float sample_rate)
+{
+   unsigned i, j;
+   unsigned filters  = 0;
+   unsigned branches = 0;
+   unsigned pairs    = 1;
+   unsigned threads  = 0;
+
+   config_get_uint(dsp->conf, "branches", &branches);
+   if (!config_get_uint(dsp->conf, "filters", &filters) && !branches)
+      return false;
+
+   config_get_uint(dsp->conf, "channel_pairs", &pairs);
+   pairs             = MAX(pairs, 1);
+
+   dsp->sample_rate  = sample_rate;
+   dsp->lanes        = (struct retro_dsp_lane*)calloc(pairs, sizeof(*dsp->lanes));
+   dsp->chain_jobs   = (struct retro_dsp_job*)calloc(pairs, sizeof(*dsp->chain_jobs));
+   if (!dsp->lanes || !dsp->chain_jobs)
+      return false;
+
+   dsp->num_lanes    = pairs;
+
+   if (branches)
+   {
+      dsp->branch_jobs = (struct retro_dsp_job*)
+         calloc(pairs * branches, sizeof(*dsp->branch_jobs));
+      if (!dsp->branch_jobs)
+         return false;
+   }
+
+   /* Each channel pair has filters of its own, set up the same way. */
+   for (i = 0; i < pairs; i++)
+   {
+      struct retro_dsp_lane *lane = &dsp->lanes[i];
+
+      if (!create_filter_chain(dsp, &lane->chain, "", filters))
+         return false;
+
+      dsp->chain_jobs[i].func = run_lane_chain;
+      dsp->chain_jobs[i].arg  = lane;
+
+      if (!branches)
+         continue;
+
+      if (!create_branches(dsp, lane, branches))
+         return false;
+
+      for (j = 0; j < branches; j++)
+      {
+         struct retro_dsp_job *job = &dsp->branch_jobs[dsp->num_branch_jobs++];
+         job->func                 = run_branch;
+         job->arg                  = &lane->branches[j];
+      }
+   }
+
+   /* All branches are lined up with the slowest one. */
+   dsp->latency = dsp->lanes[0].chain.latency;
+   if (branches)
+      dsp->latency += dsp->lanes[0].branches[0].chain.latency
+         + dsp->lanes[0].branches[0].delay_frames;
+
+#ifdef HAVE_THREADS
+   config_get_uint(dsp->conf, "threads", &threads);
+   if (!threads)
+      threads = MIN(cpu_features_get_core_amount(),
+            MAX(pairs, dsp->num_branch_jobs));
+
+   /* The calling thread takes jobs as well. Without workers,
+    * everything simply runs on it. */
+   if (threads > 1)
+      dsp->pool = retro_dsp_pool_new(threads - 1);
+#else
+   (void)threads;
+#endif
+
    return true;
 }
 
@@ -141,6 +722,9 @@ extern const struct dspfilter_implementation *phaser_dspfilter_get_implementatio
 extern const struct dspfilter_implementation *wahwah_dspfilter_get_implementation(dspfilter_simd_mask_t mask);
 extern const struct dspfilter_implementation *eq_dspfilter_get_implementation(dspfilter_simd_mask_t mask);
 extern const struct dspfilter_implementation *chorus_dspfilter_get_implementation(dspfilter_simd_mask_t mask);
+extern const struct dspfilter_implementation *fdnreverb_dspfilter_get_implementation(dspfilter_simd_mask_t mask);
+extern const struct dspfilter_implementation *loudnorm_dspfilter_get_implementation(dspfilter_simd_mask_t mask);
+extern const struct dspfilter_implementation *wsola_dspfilter_get_implementation(dspfilter_simd_mask_t mask);
 
 static const dspfilter_get_implementation_t dsp_plugs_builtin[] = {
    panning_dspfilter_get_implementation,
@@ -150,6 +734,9 @@ static const dspfilter_get_implementation_t dsp_plugs_builtin[] = {
    wahwah_dspfilter_get_implementation,
    eq_dspfilter_get_implementation,
    chorus_dspfilter_get_implementation,
+   fdnreverb_dspfilter_get_implementation,
+   loudnorm_dspfilter_get_implementation,
+   wsola_dspfilter_get_implementation,
 };
 
 static bool append_plugs(retro_dsp_filter_t *dsp, struct string_list *list)
@@ -206,7 +793,7 @@ static bool append_plugs(retro_dsp_filter_t *dsp, struct string_list *list)
          continue;
       }
 
-      if (impl->api_version != DSPFILTER_API_VERSION)
+      if (impl->api_version < 1 || impl->api_version > DSPFILTER_API_VERSION)
       {
          dylib_close(lib);
          continue;
@@ -276,16 +863,32 @@ error:
 
 void retro_dsp_filter_free(retro_dsp_filter_t *dsp)
 {
-   unsigned i;
+   unsigned i, j;
    if (!dsp)
       return;
 
-   for (i = 0; i < dsp->num_instances; i++)
+#ifdef HAVE_THREADS
+   retro_dsp_pool_free(dsp->pool);
+#endif
+
+   for (i = 0; dsp->lanes && i < dsp->num_lanes; i++)
    {
-      if (dsp->instances[i].impl_data && dsp->instances[i].impl)
-         dsp->instances[i].impl->free(dsp->instances[i].impl_data);
+      struct retro_dsp_lane *lane = &dsp->lanes[i];
+
+      free_filter_chain(&lane->chain);
+
+      for (j = 0; j < lane->num_branches; j++)
+      {
+         free_filter_chain(&lane->branches[j].chain);
+         free(lane->branches[j].buffer);
+         free(lane->branches[j].delay);
+      }
+
+      free(lane->branches);
    }
-   free(dsp->instances);
+   free(dsp->lanes);
+   free(dsp->chain_jobs);
+   free(dsp->branch_jobs);
 
 #ifdef HAVE_DYLIB
    for (i = 0; i < dsp->num_plugs; i++)
@@ -302,24 +905,158 @@ void retro_dsp_filter_free(retro_dsp_filter_t *dsp)
    free(dsp);
 }
 
-void retro_dsp_filter_process(retro_dsp_filter_t *dsp,
-      struct retro_dsp_data *data)
+bool retro_dsp_filter_in_place(retro_dsp_filter_t *dsp)
+{
+   /* Branches only take in-place filters already, and every lane is
+    * set up the same way. */
+   const struct retro_dsp_chain *chain = &dsp->lanes[0].chain;
+
+   return !chain->num_instances
+      || chain->instances[0].in_place_run == chain->num_instances;
+}
+
+unsigned retro_dsp_filter_latency(retro_dsp_filter_t *dsp)
+{
+   return dsp->latency;
+}
+
+/* Hands @string to the filters taking strings if not NULL, or
+ * @value to those taking floats. */
+static bool set_chain_setting(struct retro_dsp_chain *chain,
+      const char *key, float value, const char *string)
 {
    unsigned i;
-   struct dspfilter_output output = {0};
-   struct dspfilter_input input   = {0};
+   bool known = false;
+
+   for (i = 0; i < chain->num_instances; i++)
+   {
+      const struct dspfilter_implementation *impl = chain->instances[i].impl;
+      void *data                                  = chain->instances[i].impl_data;
+
+      if (string)
+      {
+         if (impl->api_version >= 4 && impl->set_string
+               && impl->set_string(data, key, string))
+            known = true;
+      }
+      else if (impl->api_version >= 3 && impl->set_float
+            && impl->set_float(data, key, value))
+         known = true;
+   }
 
-   output.samples = data->input;
-   output.frames  = data->input_frames;
+   return known;
+}
+
+static bool set_setting(retro_dsp_filter_t *dsp,
+      const char *key, float value, const char *string)
+{
+   unsigned i, j;
+   bool known = false;
 
-   for (i = 0; i < dsp->num_instances; i++)
+   for (i = 0; i < dsp->num_lanes; i++)
    {
-      input.samples = output.samples;
-      input.frames  = output.frames;
-      dsp->instances[i].impl->process(
-            dsp->instances[i].impl_data, &output, &input);
+      struct retro_dsp_lane *lane = &dsp->lanes[i];
+
+      if (set_chain_setting(&lane->chain, key, value, string))
+         known = true;
+
+      for (j = 0; j < lane->num_branches; j++)
+      {
+         if (set_chain_setting(&lane->branches[j].chain,
+                  key, value, string))
+            known = true;
+      }
    }
 
-   data->output        = output.samples;
-   data->output_frames = output.frames;
+   return known;
+}
+
+bool retro_dsp_filter_set_float(retro_dsp_filter_t *dsp,
+      const char *key, float value)
+{
+   return set_setting(dsp, key, value, NULL);
+}
+
+bool retro_dsp_filter_set_string(retro_dsp_filter_t *dsp,
+      const char *key, const char *value)
+{
+   return set_setting(dsp, key, 0.0f, value);
+}
+
+unsigned retro_dsp_filter_channel_pairs(retro_dsp_filter_t *dsp)
+{
+   return dsp->num_lanes;
+}
+
+void retro_dsp_filter_process_pairs(retro_dsp_filter_t *dsp,
+      struct retro_dsp_data *data, unsigned num_pairs)
+{
+   unsigned i, pos;
+   unsigned frames = 0;
+
+   /* A single chain runs right here, as it always did. */
+   if (num_pairs == 1 && !dsp->num_branch_jobs)
+   {
+      dsp->lanes[0].data = data;
+      run_lane_chain(&dsp->lanes[0]);
+      return;
+   }
+
+   for (i = 0; i < dsp->num_lanes; i++)
+   {
+      dsp->lanes[i].data = i < num_pairs ? &data[i] : NULL;
+      if (i < num_pairs)
+         frames = MAX(frames, data[i].input_frames);
+   }
+
+   /* Pairs without filters of their own go through untouched. */
+   for (; i < num_pairs; i++)
+   {
+      data[i].output        = data[i].input;
+      data[i].output_frames = data[i].input_frames;
+   }
+
+   run_jobs(dsp, dsp->chain_jobs, dsp->num_lanes,
+         (retro_time_t)(frames * 1000000.0 / dsp->sample_rate));
+
+   if (!dsp->num_branch_jobs)
+      return;
+
+   /* The chains may have changed the frame counts. */
+   for (i = 0, frames = 0; i < dsp->num_lanes; i++)
+   {
+      if (dsp->lanes[i].data)
+         frames = MAX(frames, dsp->lanes[i].data->output_frames);
+   }
+
+   for (pos = 0; pos < frames; pos += DSP_FILTER_SLICE_FRAMES)
+   {
+      unsigned slice = MIN(frames - pos, DSP_FILTER_SLICE_FRAMES);
+
+      for (i = 0; i < dsp->num_lanes; i++)
+      {
+         struct retro_dsp_lane *lane = &dsp->lanes[i];
+         unsigned lane_frames        = lane->data
+            ? lane->data->output_frames : 0;
+
+         lane->slice_pos    = pos;
+         lane->slice_frames = pos < lane_frames
+            ? MIN(lane_frames - pos, DSP_FILTER_SLICE_FRAMES) : 0;
+      }
+
+      run_jobs(dsp, dsp->branch_jobs, dsp->num_branch_jobs,
+            (retro_time_t)(slice * 1000000.0 / dsp->sample_rate));
+
+      for (i = 0; i < dsp->num_lanes; i++)
+      {
+         if (dsp->lanes[i].slice_frames)
+            mix_branches(&dsp->lanes[i]);
+      }
+   }
+}
+
+void retro_dsp_filter_process(retro_dsp_filter_t *dsp,
+      struct retro_dsp_data *data)
+{
+   retro_dsp_filter_process_pairs(dsp, data, 1);
 }
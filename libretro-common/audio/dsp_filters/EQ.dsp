@@ -7,11 +7,17 @@ filter0 = eq
 # Lower values will allow better frequency resolution, but more ripple.
 # eq_window_beta = 4.0
 
-# The block size on which FFT is done.
-# Too high value requires more processing as well as longer latency but
-# allows finer-grained control over the spectrum.
+# Length of the designed filter.
+# Higher values require more processing but allow finer-grained
+# control over the spectrum. The filter delays the sound by half
+# its length, as it is linear phase.
 # eq_block_size_log2 = 8
 
+# The filter is applied in partitions of this size with FFT, which
+# sets the latency (64 frames by default) regardless of the filter length.
+# Smaller partitions lower latency but cost more processing.
+# eq_partition_size_log2 = 6
+
 # An array of which frequencies to control.
 # You can create an arbitrary amount of these sampling points.
 # The EQ will try to create a frequency response which fits well to these points.
@@ -39,3 +45,9 @@ filter0 = eq
 # freqz(res, 1, 4096, 48000);
 #
 # It will give the response in Hz; 48000 is the default Output Rate of RetroArch
+
+# Uses an impulse response from a WAV file instead of designing one,
+# e.g. for room correction. The file may be mono or stereo, 8 or 16-bit,
+# of any length, and must be at the output rate as it isn't resampled.
+# The frequencies and gains above are ignored then.
+# eq_impulse_response_input = "room_correction.wav"
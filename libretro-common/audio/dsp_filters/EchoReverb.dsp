@@ -1,12 +1,12 @@
 filters = 2
 filter0 = echo
-filter1 = reverb
+filter1 = fdnreverb
 
 echo_delay = "200"
 echo_feedback = "0.6"
 echo_amp = "0.25"
 
-reverb_roomwidth = 0.75
-reverb_roomsize = 0.75
-reverb_damping = 1.0
-reverb_wettime = 0.3
+fdnreverb_roomwidth = 0.75
+fdnreverb_roomsize = 0.75
+fdnreverb_damping = 1.0
+fdnreverb_wettime = 0.3
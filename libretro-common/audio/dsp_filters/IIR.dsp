@@ -7,6 +7,10 @@ filter0 = iir
 #iir_gain = 0.0
 #iir_type = LPF
 
+# Number of times the filter is applied in a row, up to 8.
+# Each one adds 12 dB per octave to the slope of LPF and HPF.
+#iir_stages = 1
+
 # Filter types:
 # LPF: Low-pass
 # HPF: High-pass
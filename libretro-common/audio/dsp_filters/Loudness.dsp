@@ -0,0 +1,24 @@
+filters = 1
+filter0 = loudnorm
+
+# Defaults.
+
+# Integrated loudness to aim for, in LUFS.
+# loudnorm_target = -18.0
+
+# Most the level is raised, in dB, and how fast it may change, in
+# dB per second.
+# loudnorm_max_gain = 12.0
+# loudnorm_gain_rate = 2.0
+
+# True-peak ceiling in dBTP, and the limiter's lookahead and release
+# times in milliseconds. The lookahead delays the audio.
+# loudnorm_ceiling = -1.0
+# loudnorm_lookahead = 5.0
+# loudnorm_release = 100.0
+
+# Directory keeping the measurement of each content between runs,
+# so that the level is right from the start the next time. The host
+# names the content with retro_dsp_filter_set_string(dsp, "content",
+# path); nothing is kept until it does.
+# loudnorm_state_dir = ""
@@ -1,10 +1,16 @@
 filters = 1
-filter0 = reverb
+filter0 = fdnreverb
 
 # Defaults.
-# reverb_drytime = 0.43
-# reverb_wettime = 0.4
-# reverb_damping = 0.8
-# reverb_roomwidth = 0.56
-# reverb_roomsize = 0.56
+# fdnreverb_drytime = 0.43
+# fdnreverb_wettime = 0.4
+# fdnreverb_damping = 0.8
+# fdnreverb_roomwidth = 0.56
+# fdnreverb_roomsize = 0.56
 
+# Seconds for the tail to die down by 60 dB, from the room size
+# unless set.
+# fdnreverb_decay = 1.14
+
+# The older comb filter reverb takes the same settings, minus the
+# decay, with "reverb" in place of "fdnreverb".
@@ -0,0 +1,12 @@
+filters = 1
+filter0 = wsola
+
+# Defaults.
+
+# Playback speed, from 0.25 to 4.0, without changing the pitch. The
+# host can change it while running with retro_dsp_filter_set_float().
+# wsola_speed = 1.0
+
+# Grain length in milliseconds, rounded up to a power of two frames.
+# Longer grains suit music, shorter ones speech.
+# wsola_window = 20.0
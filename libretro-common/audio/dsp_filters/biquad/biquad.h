@@ -0,0 +1,438 @@
+/* Copyright  (C) 2010-2018 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (biquad.h).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef RARCH_BIQUAD_H__
+#define RARCH_BIQUAD_H__
+
+#include <string.h>
+
+#include <boolean.h>
+#include <retro_inline.h>
+#include <retro_miscellaneous.h>
+
+#if defined(__FMA__)
+#include <immintrin.h>
+#define BIQUAD_MADD(a, b, c)  _mm_fmadd_ps(a, b, c)
+#define BIQUAD_NMADD(a, b, c) _mm_fnmadd_ps(a, b, c)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define BIQUAD_MADD(a, b, c)  _mm_add_ps(_mm_mul_ps(a, b), c)
+#define BIQUAD_NMADD(a, b, c) _mm_sub_ps(c, _mm_mul_ps(a, b))
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+#include <arm_neon.h>
+#endif
+
+/* Cascade of biquad sections filtering interleaved stereo samples,
+ * both channels side by side in one SIMD register. Each section is
+ * in transposed direct form II, with coefficients divided by a0
+ * up front.
+ *
+ * New coefficients are reached with a linear ramp over a set number
+ * of frames, so that filters retuned while running don't zipper.
+ * Interpolating between two stable sections gives stable sections,
+ * as the stable a1/a2 values form a triangle.
+ *
+ * Everything is static, so that each filter can include this
+ * file. */
+
+#define BIQUAD_MAX_STAGES 8
+
+struct biquad_coefs
+{
+   float b0, b1, b2;
+   float a1, a2;
+};
+
+struct biquad_stage
+{
+   struct biquad_coefs coefs;
+   struct biquad_coefs target;
+   struct biquad_coefs step;
+   /* Left and right state. */
+   float z1[2];
+   float z2[2];
+};
+
+struct biquad_cascade
+{
+   struct biquad_stage stages[BIQUAD_MAX_STAGES];
+   unsigned num_stages;
+   unsigned ramp_frames;
+   /* Frames left until the targets are reached. */
+   unsigned ramp;
+   bool dirty;
+};
+
+static INLINE void biquad_coefs_normalize(struct biquad_coefs *coefs,
+      double b0, double b1, double b2, double a0, double a1, double a2)
+{
+   coefs->b0 = (float)(b0 / a0);
+   coefs->b1 = (float)(b1 / a0);
+   coefs->b2 = (float)(b2 / a0);
+   coefs->a1 = (float)(a1 / a0);
+   coefs->a2 = (float)(a2 / a0);
+}
+
+/**
+ * biquad_cascade_init:
+ * @bq                 : Cascade to set up.
+ * @num_stages         : Number of sections, at most BIQUAD_MAX_STAGES.
+ * @ramp_frames        : Length of the coefficient ramps, 0 to change
+ *                       them at once.
+ *
+ * All sections pass the signal through until set.
+ **/
+static INLINE void biquad_cascade_init(struct biquad_cascade *bq,
+      unsigned num_stages, unsigned ramp_frames)
+{
+   unsigned i;
+
+   memset(bq, 0, sizeof(*bq));
+   bq->num_stages  = MIN(num_stages, BIQUAD_MAX_STAGES);
+   bq->ramp_frames = ramp_frames;
+
+   for (i = 0; i < BIQUAD_MAX_STAGES; i++)
+   {
+      bq->stages[i].coefs.b0  = 1.0f;
+      bq->stages[i].target.b0 = 1.0f;
+   }
+}
+
+/**
+ * biquad_cascade_set:
+ * @bq                 : Cascade handle.
+ * @stage              : Section to change.
+ * @coefs              : New coefficients, from biquad_coefs_normalize().
+ *
+ * The section gets there over the ramp length, starting with the
+ * next frame processed.
+ **/
+static INLINE void biquad_cascade_set(struct biquad_cascade *bq,
+      unsigned stage, const struct biquad_coefs *coefs)
+{
+   bq->stages[stage].target = *coefs;
+
+   if (bq->ramp_frames)
+      bq->dirty = true;
+   else
+      bq->stages[stage].coefs = *coefs;
+}
+
+static void biquad_cascade_start_ramp(struct biquad_cascade *bq)
+{
+   unsigned i;
+   float scale = 1.0f / bq->ramp_frames;
+
+   for (i = 0; i < bq->num_stages; i++)
+   {
+      struct biquad_stage *s = &bq->stages[i];
+      s->step.b0 = (s->target.b0 - s->coefs.b0) * scale;
+      s->step.b1 = (s->target.b1 - s->coefs.b1) * scale;
+      s->step.b2 = (s->target.b2 - s->coefs.b2) * scale;
+      s->step.a1 = (s->target.a1 - s->coefs.a1) * scale;
+      s->step.a2 = (s->target.a2 - s->coefs.a2) * scale;
+   }
+
+   bq->ramp  = bq->ramp_frames;
+   bq->dirty = false;
+}
+
+/* Runs one section over all frames, the first @ramp of them
+ * moving the coefficients by a step each. */
+static void biquad_stage_process(struct biquad_stage *s,
+      float *samples, unsigned frames, unsigned ramp)
+{
+   unsigned i = 0;
+
+#if defined(__SSE2__)
+   __m128 b0 = _mm_set1_ps(s->coefs.b0);
+   __m128 b1 = _mm_set1_ps(s->coefs.b1);
+   __m128 b2 = _mm_set1_ps(s->coefs.b2);
+   __m128 a1 = _mm_set1_ps(s->coefs.a1);
+   __m128 a2 = _mm_set1_ps(s->coefs.a2);
+   __m128 z1 = _mm_castpd_ps(_mm_load_sd((const double*)s->z1));
+   __m128 z2 = _mm_castpd_ps(_mm_load_sd((const double*)s->z2));
+
+   for (; i < frames; i++, samples += 2)
+   {
+      __m128 x = _mm_castpd_ps(_mm_load_sd((const double*)samples));
+      __m128 y = BIQUAD_MADD(b0, x, z1);
+
+      z1 = BIQUAD_NMADD(a1, y, BIQUAD_MADD(b1, x, z2));
+      z2 = BIQUAD_NMADD(a2, y, _mm_mul_ps(b2, x));
+
+      _mm_store_sd((double*)samples, _mm_castps_pd(y));
+
+      if (i < ramp)
+      {
+         b0 = _mm_add_ps(b0, _mm_set1_ps(s->step.b0));
+         b1 = _mm_add_ps(b1, _mm_set1_ps(s->step.b1));
+         b2 = _mm_add_ps(b2, _mm_set1_ps(s->step.b2));
+         a1 = _mm_add_ps(a1, _mm_set1_ps(s->step.a1));
+         a2 = _mm_add_ps(a2, _mm_set1_ps(s->step.a2));
+      }
+   }
+
+   _mm_store_sd((double*)s->z1, _mm_castps_pd(z1));
+   _mm_store_sd((double*)s->z2, _mm_castps_pd(z2));
+   s->coefs.b0 = _mm_cvtss_f32(b0);
+   s->coefs.b1 = _mm_cvtss_f32(b1);
+   s->coefs.b2 = _mm_cvtss_f32(b2);
+   s->coefs.a1 = _mm_cvtss_f32(a1);
+   s->coefs.a2 = _mm_cvtss_f32(a2);
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+   float32x2_t b0 = vdup_n_f32(s->coefs.b0);
+   float32x2_t b1 = vdup_n_f32(s->coefs.b1);
+   float32x2_t b2 = vdup_n_f32(s->coefs.b2);
+   float32x2_t a1 = vdup_n_f32(s->coefs.a1);
+   float32x2_t a2 = vdup_n_f32(s->coefs.a2);
+   float32x2_t z1 = vld1_f32(s->z1);
+   float32x2_t z2 = vld1_f32(s->z2);
+
+   for (; i < frames; i++, samples += 2)
+   {
+      float32x2_t x = vld1_f32(samples);
+      float32x2_t y = vmla_f32(z1, b0, x);
+
+      z1 = vmls_f32(vmla_f32(z2, b1, x), a1, y);
+      z2 = vmls_f32(vmul_f32(b2, x), a2, y);
+
+      vst1_f32(samples, y);
+
+      if (i < ramp)
+      {
+         b0 = vadd_f32(b0, vdup_n_f32(s->step.b0));
+         b1 = vadd_f32(b1, vdup_n_f32(s->step.b1));
+         b2 = vadd_f32(b2, vdup_n_f32(s->step.b2));
+         a1 = vadd_f32(a1, vdup_n_f32(s->step.a1));
+         a2 = vadd_f32(a2, vdup_n_f32(s->step.a2));
+      }
+   }
+
+   vst1_f32(s->z1, z1);
+   vst1_f32(s->z2, z2);
+   s->coefs.b0 = vget_lane_f32(b0, 0);
+   s->coefs.b1 = vget_lane_f32(b1, 0);
+   s->coefs.b2 = vget_lane_f32(b2, 0);
+   s->coefs.a1 = vget_lane_f32(a1, 0);
+   s->coefs.a2 = vget_lane_f32(a2, 0);
+#else
+   struct biquad_coefs c = s->coefs;
+   float z1_l            = s->z1[0];
+   float z1_r            = s->z1[1];
+   float z2_l            = s->z2[0];
+   float z2_r            = s->z2[1];
+
+   for (; i < frames; i++, samples += 2)
+   {
+      float x_l  = samples[0];
+      float x_r  = samples[1];
+      float y_l  = c.b0 * x_l + z1_l;
+      float y_r  = c.b0 * x_r + z1_r;
+
+      z1_l       = c.b1 * x_l + z2_l - c.a1 * y_l;
+      z1_r       = c.b1 * x_r + z2_r - c.a1 * y_r;
+      z2_l       = c.b2 * x_l - c.a2 * y_l;
+      z2_r       = c.b2 * x_r - c.a2 * y_r;
+
+      samples[0] = y_l;
+      samples[1] = y_r;
+
+      if (i < ramp)
+      {
+         c.b0 += s->step.b0;
+         c.b1 += s->step.b1;
+         c.b2 += s->step.b2;
+         c.a1 += s->step.a1;
+         c.a2 += s->step.a2;
+      }
+   }
+
+   s->z1[0] = z1_l;
+   s->z1[1] = z1_r;
+   s->z2[0] = z2_l;
+   s->z2[1] = z2_r;
+   s->coefs = c;
+#endif
+}
+
+#if defined(__SSE2__)
+#define BIQUAD_SET_PAIR(lo, hi) _mm_setr_ps(lo, lo, hi, hi)
+
+/* One frame of two sections, @lo in the low lanes and @hi in the
+ * high ones. */
+static INLINE __m128 biquad_pair_tick(__m128 x, __m128 *z1, __m128 *z2,
+      __m128 b0, __m128 b1, __m128 b2, __m128 a1, __m128 a2)
+{
+   __m128 y = BIQUAD_MADD(b0, x, *z1);
+
+   *z1      = BIQUAD_NMADD(a1, y, BIQUAD_MADD(b1, x, *z2));
+   *z2      = BIQUAD_NMADD(a2, y, _mm_mul_ps(b2, x));
+   return y;
+}
+
+/* Runs two sections in a row, the second one trailing a frame behind
+ * so that it takes what the first one just put out. Their feedback
+ * loops then overlap, instead of the second one only starting when
+ * the first one is done with the whole block. The first and last
+ * iterations only count for one of the sections; the state of the
+ * other one is put back afterwards. */
+static void biquad_pair_process(struct biquad_stage *lo,
+      struct biquad_stage *hi, float *samples, unsigned frames,
+      unsigned ramp)
+{
+   unsigned i;
+   __m128 mask_lo = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, 0, 0));
+   __m128 b0      = BIQUAD_SET_PAIR(lo->coefs.b0, hi->coefs.b0);
+   __m128 b1      = BIQUAD_SET_PAIR(lo->coefs.b1, hi->coefs.b1);
+   __m128 b2      = BIQUAD_SET_PAIR(lo->coefs.b2, hi->coefs.b2);
+   __m128 a1      = BIQUAD_SET_PAIR(lo->coefs.a1, hi->coefs.a1);
+   __m128 a2      = BIQUAD_SET_PAIR(lo->coefs.a2, hi->coefs.a2);
+   __m128 db0     = BIQUAD_SET_PAIR(lo->step.b0, hi->step.b0);
+   __m128 db1     = BIQUAD_SET_PAIR(lo->step.b1, hi->step.b1);
+   __m128 db2     = BIQUAD_SET_PAIR(lo->step.b2, hi->step.b2);
+   __m128 da1     = BIQUAD_SET_PAIR(lo->step.a1, hi->step.a1);
+   __m128 da2     = BIQUAD_SET_PAIR(lo->step.a2, hi->step.a2);
+   __m128 z1      = _mm_loadh_pi(_mm_castpd_ps(
+            _mm_load_sd((const double*)lo->z1)), (const __m64*)hi->z1);
+   __m128 z2      = _mm_loadh_pi(_mm_castpd_ps(
+            _mm_load_sd((const double*)lo->z2)), (const __m64*)hi->z2);
+   __m128 z1_hi   = z1;
+   __m128 z2_hi   = z2;
+   __m128 x       = _mm_castpd_ps(_mm_load_sd((const double*)samples));
+   __m128 y       = biquad_pair_tick(x, &z1, &z2, b0, b1, b2, a1, a2);
+
+   /* Only the first section has seen frame 0 yet. */
+   z1 = _mm_or_ps(_mm_and_ps(mask_lo, z1), _mm_andnot_ps(mask_lo, z1_hi));
+   z2 = _mm_or_ps(_mm_and_ps(mask_lo, z2), _mm_andnot_ps(mask_lo, z2_hi));
+
+   if (ramp)
+   {
+      b0 = _mm_add_ps(b0, _mm_and_ps(mask_lo, db0));
+      b1 = _mm_add_ps(b1, _mm_and_ps(mask_lo, db1));
+      b2 = _mm_add_ps(b2, _mm_and_ps(mask_lo, db2));
+      a1 = _mm_add_ps(a1, _mm_and_ps(mask_lo, da1));
+      a2 = _mm_add_ps(a2, _mm_and_ps(mask_lo, da2));
+   }
+
+   for (i = 1; i < frames; i++)
+   {
+      x = _mm_movelh_ps(_mm_castpd_ps(
+               _mm_load_sd((const double*)(samples + 2 * i))), y);
+      y = biquad_pair_tick(x, &z1, &z2, b0, b1, b2, a1, a2);
+      _mm_storeh_pi((__m64*)(samples + 2 * (i - 1)), y);
+
+      if (i <= ramp)
+      {
+         /* Frame i for the low section, i - 1 for the high one. */
+         __m128 mask = i < ramp ? _mm_castsi128_ps(_mm_set1_epi32(-1))
+            : _mm_andnot_ps(mask_lo, _mm_castsi128_ps(_mm_set1_epi32(-1)));
+         b0 = _mm_add_ps(b0, _mm_and_ps(mask, db0));
+         b1 = _mm_add_ps(b1, _mm_and_ps(mask, db1));
+         b2 = _mm_add_ps(b2, _mm_and_ps(mask, db2));
+         a1 = _mm_add_ps(a1, _mm_and_ps(mask, da1));
+         a2 = _mm_add_ps(a2, _mm_and_ps(mask, da2));
+      }
+   }
+
+   /* The high section still has to see the last frame. */
+   z1_hi = z1;
+   z2_hi = z2;
+   x     = _mm_movelh_ps(y, y);
+   y     = biquad_pair_tick(x, &z1, &z2, b0, b1, b2, a1, a2);
+   _mm_storeh_pi((__m64*)(samples + 2 * (frames - 1)), y);
+
+   z1    = _mm_or_ps(_mm_and_ps(mask_lo, z1_hi), _mm_andnot_ps(mask_lo, z1));
+   z2    = _mm_or_ps(_mm_and_ps(mask_lo, z2_hi), _mm_andnot_ps(mask_lo, z2));
+
+   if (frames <= ramp)
+   {
+      b0 = _mm_add_ps(b0, _mm_andnot_ps(mask_lo, db0));
+      b1 = _mm_add_ps(b1, _mm_andnot_ps(mask_lo, db1));
+      b2 = _mm_add_ps(b2, _mm_andnot_ps(mask_lo, db2));
+      a1 = _mm_add_ps(a1, _mm_andnot_ps(mask_lo, da1));
+      a2 = _mm_add_ps(a2, _mm_andnot_ps(mask_lo, da2));
+   }
+
+   _mm_storel_pi((__m64*)lo->z1, z1);
+   _mm_storel_pi((__m64*)lo->z2, z2);
+   _mm_storeh_pi((__m64*)hi->z1, z1);
+   _mm_storeh_pi((__m64*)hi->z2, z2);
+   lo->coefs.b0 = _mm_cvtss_f32(b0);
+   lo->coefs.b1 = _mm_cvtss_f32(b1);
+   lo->coefs.b2 = _mm_cvtss_f32(b2);
+   lo->coefs.a1 = _mm_cvtss_f32(a1);
+   lo->coefs.a2 = _mm_cvtss_f32(a2);
+   hi->coefs.b0 = _mm_cvtss_f32(_mm_movehl_ps(b0, b0));
+   hi->coefs.b1 = _mm_cvtss_f32(_mm_movehl_ps(b1, b1));
+   hi->coefs.b2 = _mm_cvtss_f32(_mm_movehl_ps(b2, b2));
+   hi->coefs.a1 = _mm_cvtss_f32(_mm_movehl_ps(a1, a1));
+   hi->coefs.a2 = _mm_cvtss_f32(_mm_movehl_ps(a2, a2));
+}
+#endif
+
+/**
+ * biquad_cascade_process:
+ * @bq                 : Cascade handle.
+ * @samples            : Interleaved stereo samples, filtered in place.
+ * @frames             : Number of frames.
+ **/
+static INLINE void biquad_cascade_process(struct biquad_cascade *bq,
+      float *samples, unsigned frames)
+{
+   unsigned i;
+   unsigned ramp;
+
+   if (!frames)
+      return;
+
+   if (bq->dirty)
+      biquad_cascade_start_ramp(bq);
+
+   ramp = MIN(bq->ramp, frames);
+
+   /* A section, or with SSE a pair of them, at a time keeps the
+    * state in registers, which beats going through all of them for
+    * each frame. */
+   for (i = 0; i < bq->num_stages; i++)
+   {
+#if defined(__SSE2__)
+      if (i + 1 < bq->num_stages)
+      {
+         biquad_pair_process(&bq->stages[i], &bq->stages[i + 1],
+               samples, frames, ramp);
+         i++;
+         continue;
+      }
+#endif
+      biquad_stage_process(&bq->stages[i], samples, frames, ramp);
+   }
+
+   bq->ramp -= ramp;
+
+   /* Land exactly on the targets. */
+   if (ramp && !bq->ramp)
+      for (i = 0; i < bq->num_stages; i++)
+         bq->stages[i].coefs = bq->stages[i].target;
+}
+
+#endif
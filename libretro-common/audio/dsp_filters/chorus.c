@@ -144,6 +144,9 @@ static const struct dspfilter_implementation chorus_plug = {
    DSPFILTER_API_VERSION,
    "Chorus",
    "chorus",
+
+   DSPFILTER_FLAG_IN_PLACE,
+   NULL,
 };
 
 #ifdef HAVE_FILTERS_BUILTIN
@@ -76,6 +76,8 @@ static const struct dspfilter_implementation delta_plug = {
    DSPFILTER_API_VERSION,
    "Delta Sharpening",
    "crystalizer",
+   DSPFILTER_FLAG_IN_PLACE,
+   NULL,
 };
 
 #ifdef HAVE_FILTERS_BUILTIN
@@ -166,6 +166,9 @@ static const struct dspfilter_implementation echo_plug = {
    DSPFILTER_API_VERSION,
    "Multi-Echo",
    "echo",
+
+   DSPFILTER_FLAG_IN_PLACE,
+   NULL,
 };
 
 #ifdef HAVE_FILTERS_BUILTIN
@@ -30,18 +30,18 @@
 #include <libretro_dspfilter.h>
 
 #include "fft/fft.c"
+#include "fft/convolver.c"
+
+#ifndef HAVE_FILTERS_BUILTIN
+#include "../../formats/wav/rwav.c"
+#else
+#include <formats/rwav.h>
+#endif
 
 struct eq_data
 {
-   fft_t *fft;
-   float buffer[8 * 1024];
-
-   float *save;
-   float *block;
-   fft_complex_t *filter;
-   fft_complex_t *fftblock;
-   unsigned block_size;
-   unsigned block_ptr;
+   fft_convolver_t *conv;
+   unsigned latency;
 };
 
 struct eq_gain
@@ -56,67 +56,25 @@ static void eq_free(void *data)
    if (!eq)
       return;
 
-   fft_free(eq->fft);
-   free(eq->save);
-   free(eq->block);
-   free(eq->fftblock);
-   free(eq->filter);
+   fft_convolver_free(eq->conv);
    free(eq);
 }
 
 static void eq_process(void *data, struct dspfilter_output *output,
       const struct dspfilter_input *input)
 {
-   float *out;
-   const float *in;
-   unsigned input_frames;
    struct eq_data *eq = (struct eq_data*)data;
 
-   output->samples    = eq->buffer;
-   output->frames     = 0;
-
-   out                = eq->buffer;
-   in                 = input->samples;
-   input_frames       = input->frames;
-
-   while (input_frames)
-   {
-      unsigned write_avail = eq->block_size - eq->block_ptr;
-
-      if (input_frames < write_avail)
-         write_avail = input_frames;
-
-      memcpy(eq->block + eq->block_ptr * 2, in, write_avail * 2 * sizeof(float));
-
-      in += write_avail * 2;
-      input_frames -= write_avail;
-      eq->block_ptr += write_avail;
-
-      // Convolve a new block.
-      if (eq->block_ptr == eq->block_size)
-      {
-         unsigned i, c;
+   output->samples    = input->samples;
+   output->frames     = input->frames;
 
-         for (c = 0; c < 2; c++)
-         {
-            fft_process_forward(eq->fft, eq->fftblock, eq->block + c, 2);
-            for (i = 0; i < 2 * eq->block_size; i++)
-               eq->fftblock[i] = fft_complex_mul(eq->fftblock[i], eq->filter[i]);
-            fft_process_inverse(eq->fft, out + c, eq->fftblock, 2);
-         }
-
-         // Overlap add method, so add in saved block now.
-         for (i = 0; i < 2 * eq->block_size; i++)
-            out[i] += eq->save[i];
-
-         // Save block for later.
-         memcpy(eq->save, out + 2 * eq->block_size, 2 * eq->block_size * sizeof(float));
+   fft_convolver_process(eq->conv, output->samples, input->frames);
+}
 
-         out += eq->block_size * 2;
-         output->frames += eq->block_size;
-         eq->block_ptr = 0;
-      }
-   }
+static void eq_query(void *data, struct dspfilter_properties *props)
+{
+   struct eq_data *eq = (struct eq_data*)data;
+   props->latency     = eq->latency;
 }
 
 static int gains_cmp(const void *a_, const void *b_)
@@ -191,26 +149,31 @@ static void generate_response(fft_complex_t *response,
    }
 }
 
-static void create_filter(struct eq_data *eq, unsigned size_log2,
+/* Designs a linear phase filter of block_size - 1 taps, written to
+ * both channels of @filter. */
+static bool create_filter(float *filter, unsigned size_log2,
       struct eq_gain *gains, unsigned num_gains, double beta, const char *filter_path)
 {
    int i;
-   int half_block_size = eq->block_size >> 1;
-   double window_mod = 1.0 / kaiser_window_function(0.0, beta);
+   int block_size      = 1 << size_log2;
+   int half_block_size = block_size >> 1;
+   double window_mod   = 1.0 / kaiser_window_function(0.0, beta);
 
    fft_t *fft = fft_new(size_log2);
-   float *time_filter = (float*)calloc(eq->block_size * 2 + 1, sizeof(*time_filter));
-   if (!fft || !time_filter)
+   fft_complex_t *response = (fft_complex_t*)calloc(block_size + 1, sizeof(*response));
+   float *time_filter = (float*)calloc(block_size, sizeof(*time_filter));
+   bool ret = false;
+   if (!fft || !response || !time_filter)
       goto end;
 
    /* Make sure bands are in correct order. */
    qsort(gains, num_gains, sizeof(*gains), gains_cmp);
 
    /* Compute desired filter response. */
-   generate_response(eq->filter, gains, num_gains, half_block_size);
+   generate_response(response, gains, num_gains, half_block_size);
 
    /* Get equivalent time-domain filter. */
-   fft_process_inverse(fft, time_filter, eq->filter, 1);
+   fft_process_inverse(fft, time_filter, response, 1);
 
    /* ifftshift() to create the correct linear phase filter.
     * The filter response was designed with zero phase, which
@@ -225,10 +188,10 @@ static void create_filter(struct eq_data *eq, unsigned size_log2,
    }
 
    /* Apply a window to smooth out the frequency repsonse. */
-   for (i = 0; i < (int)eq->block_size; i++)
+   for (i = 0; i < block_size; i++)
    {
       /* Kaiser window. */
-      double phase = (double)i / eq->block_size;
+      double phase = (double)i / block_size;
       phase = 2.0 * (phase - 0.5);
       time_filter[i] *= window_mod * kaiser_window_function(phase, beta);
    }
@@ -239,21 +202,142 @@ static void create_filter(struct eq_data *eq, unsigned size_log2,
       FILE *file = fopen(filter_path, "w");
       if (file)
       {
-         for (i = 0; i < (int)eq->block_size - 1; i++)
+         for (i = 0; i < block_size - 1; i++)
             fprintf(file, "%.8f\n", time_filter[i + 1]);
          fclose(file);
       }
    }
 
-   /* Padded FFT to create our FFT filter.
-    * Make our even-length filter odd by discarding the first coefficient.
+   /* Make our even-length filter odd by discarding the first coefficient.
     * For some interesting reason, this allows us to design an odd-length linear phase filter.
     */
-   fft_process_forward(eq->fft, eq->filter, time_filter + 1, 1);
+   for (i = 0; i < block_size - 1; i++)
+   {
+      filter[2 * i + 0] = time_filter[i + 1];
+      filter[2 * i + 1] = time_filter[i + 1];
+   }
+   ret = true;
 
 end:
    fft_free(fft);
+   free(response);
    free(time_filter);
+   return ret;
+}
+
+/* Zero crossings on each side of the kernel used to resample
+ * an impulse response, and its Kaiser window beta. */
+#define IR_RESAMPLE_ZEROS 16
+#define IR_RESAMPLE_BETA  8.0
+
+/* Resamples the interleaved stereo taps @in by @ratio with a windowed
+ * sinc, lowpassed to the new rate when shrinking. The result is scaled
+ * so that it has the same frequency response at the new rate. */
+static float *resample_impulse_response(const float *in, size_t frames,
+      double ratio, size_t *out_frames)
+{
+   size_t i;
+   double cutoff   = MIN(ratio, 1.0);
+   double half     = IR_RESAMPLE_ZEROS / cutoff;
+   double gain     = cutoff / ratio /
+      kaiser_window_function(0.0, IR_RESAMPLE_BETA);
+   size_t out_size = (size_t)ceil(frames * ratio);
+   float *out      = (float*)calloc(out_size, 2 * sizeof(*out));
+   if (!out)
+      return NULL;
+
+   for (i = 0; i < out_size; i++)
+   {
+      long k;
+      double t    = i / ratio;
+      long first  = MAX((long)ceil(t - half), 0);
+      long last   = MIN((long)floor(t + half), (long)frames - 1);
+      double l    = 0.0;
+      double r    = 0.0;
+
+      for (k = first; k <= last; k++)
+      {
+         double d = t - k;
+         double w = sinc(M_PI * cutoff * d) *
+            kaiser_window_function(MIN(fabs(d) / half, 1.0),
+                  IR_RESAMPLE_BETA);
+
+         l += w * in[2 * k + 0];
+         r += w * in[2 * k + 1];
+      }
+
+      out[2 * i + 0] = gain * l;
+      out[2 * i + 1] = gain * r;
+   }
+
+   *out_frames = out_size;
+   return out;
+}
+
+/* Reads an 8 or 16-bit WAV file, mono or stereo, into interleaved
+ * stereo taps at @rate. */
+static float *load_impulse_response(const char *path, float rate,
+      unsigned *taps)
+{
+   size_t frames;
+   rwav_t wav;
+   size_t i;
+   long len;
+   void *buf     = NULL;
+   float *filter = NULL;
+   FILE *file    = fopen(path, "rb");
+   if (!file)
+      return NULL;
+
+   fseek(file, 0, SEEK_END);
+   len = ftell(file);
+   fseek(file, 0, SEEK_SET);
+
+   if (len > 0)
+      buf = malloc(len);
+
+   if (!buf || fread(buf, 1, len, file) != (size_t)len)
+      goto end;
+
+   wav.samples = NULL;
+   if (rwav_load(&wav, buf, len) != RWAV_ITERATE_DONE)
+      goto end;
+
+   filter = (float*)malloc(wav.numsamples * 2 * sizeof(*filter));
+
+   for (i = 0; filter && i < wav.numsamples; i++)
+   {
+      unsigned c;
+      for (c = 0; c < 2; c++)
+      {
+         size_t idx = i * wav.numchannels + MIN(c, wav.numchannels - 1);
+
+         if (wav.bitspersample == 16)
+            filter[2 * i + c] = ((const int16_t*)wav.samples)[idx] / 32768.0f;
+         else
+            filter[2 * i + c] = (((const uint8_t*)wav.samples)[idx] - 128) / 128.0f;
+      }
+   }
+
+   frames = wav.numsamples;
+
+   /* Responses are often measured at another rate than the stream's. */
+   if (filter && rate > 0.0f && wav.samplerate > 0 &&
+         wav.samplerate != rate)
+   {
+      float *resampled = resample_impulse_response(filter, frames,
+            rate / wav.samplerate, &frames);
+      free(filter);
+      filter = resampled;
+   }
+
+   *taps = (unsigned)frames;
+   rwav_free(&wav);
+
+end:
+   free(buf);
+   fclose(file);
+   return filter;
 }
 
 static void *eq_init(const struct dspfilter_info *info,
@@ -261,10 +345,13 @@ static void *eq_init(const struct dspfilter_info *info,
 {
    float *frequencies, *gain;
    unsigned num_freq, num_gain, i, size;
-   int size_log2;
+   unsigned taps = 0;
+   int size_log2, partition_size_log2;
    float beta;
    struct eq_gain *gains = NULL;
    char *filter_path = NULL;
+   char *ir_path = NULL;
+   float *filter = NULL;
    const float default_freq[] = { 0.0f, info->input_rate };
    const float default_gain[] = { 0.0f, 0.0f };
    struct eq_data *eq = (struct eq_data*)calloc(1, sizeof(*eq));
@@ -277,6 +364,8 @@ static void *eq_init(const struct dspfilter_info *info,
    config->get_int(userdata, "block_size_log2", &size_log2, 8);
    size = 1 << size_log2;
 
+   config->get_int(userdata, "partition_size_log2", &partition_size_log2, 6);
+
    config->get_float_array(userdata, "frequencies", &frequencies, &num_freq, default_freq, 2);
    config->get_float_array(userdata, "gains", &gain, &num_gain, default_gain, 2);
 
@@ -286,6 +375,13 @@ static void *eq_init(const struct dspfilter_info *info,
       filter_path = NULL;
    }
 
+   /* A measured response, such as for room correction, replaces
+    * the designed one. */
+   if (config->get_string(userdata, "impulse_response_input", &ir_path, ""))
+      filter = load_impulse_response(ir_path,
+            info->input_rate, &taps);
+   config->free(ir_path);
+
    num_gain = num_freq = MIN(num_gain, num_freq);
 
    gains = (struct eq_gain*)calloc(num_gain, sizeof(*gains));
@@ -300,29 +396,35 @@ static void *eq_init(const struct dspfilter_info *info,
    config->free(frequencies);
    config->free(gain);
 
-   eq->block_size = size;
-
-   eq->save     = (float*)calloc(    size, 2 * sizeof(*eq->save));
-   eq->block    = (float*)calloc(2 * size, 2 * sizeof(*eq->block));
-   eq->fftblock = (fft_complex_t*)calloc(2 * size, sizeof(*eq->fftblock));
-   eq->filter   = (fft_complex_t*)calloc(2 * size, sizeof(*eq->filter));
-
-   /* Use an FFT which is twice the block size with zero-padding
-    * to make circular convolution => proper convolution.
-    */
-   eq->fft = fft_new(size_log2 + 1);
-
-   if (!eq->fft || !eq->fftblock || !eq->save || !eq->block || !eq->filter)
-      goto error;
-
-   create_filter(eq, size_log2, gains, num_gain, beta, filter_path);
+   if (!filter)
+   {
+      taps   = size - 1;
+      filter = (float*)calloc(size, 2 * sizeof(*filter));
+      if (!filter || !create_filter(filter, size_log2,
+               gains, num_gain, beta, filter_path))
+         goto error;
+
+      /* Linear phase, so the designed filter delays everything
+       * by half its length. */
+      eq->latency = taps / 2;
+   }
    config->free(filter_path);
    filter_path = NULL;
 
+   /* Convolve in small partitions, so that latency doesn't grow
+    * with the filter length. */
+   eq->conv = fft_convolver_new(filter, taps, partition_size_log2);
+   if (!eq->conv)
+      goto error;
+   eq->latency += 1 << partition_size_log2;
+
+   free(filter);
    free(gains);
    return eq;
 
 error:
+   config->free(filter_path);
+   free(filter);
    free(gains);
    eq_free(eq);
    return NULL;
@@ -336,6 +438,9 @@ static const struct dspfilter_implementation eq_plug = {
    DSPFILTER_API_VERSION,
    "Linear-Phase FFT Equalizer",
    "eq",
+
+   DSPFILTER_FLAG_IN_PLACE,
+   eq_query,
 };
 
 #ifdef HAVE_FILTERS_BUILTIN
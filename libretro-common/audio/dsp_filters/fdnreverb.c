@@ -0,0 +1,453 @@
+/* Copyright  (C) 2010-2017 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (fdnreverb.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <retro_inline.h>
+#include <retro_miscellaneous.h>
+#include <libretro_dspfilter.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+#include <arm_neon.h>
+#endif
+
+/* Feedback delay network reverb.
+ *
+ * Eight delay lines feed back into each other through a Householder
+ * matrix, I - 2/8 * ones, which is lossless and mixes every line
+ * into every other one with a single sum. Each line has a gain
+ * setting its decay time, and a one-pole low-pass so that highs die
+ * away sooner. The left input goes to the even lines and the right
+ * input to the odd ones, and the outputs are taken the same way.
+ *
+ * All lines share one ring buffer, a frame of eight floats per
+ * sample, so each frame is written with a single vector store and
+ * the line outputs are loaded into a single register. The ring is
+ * kept twice in a row, so that the reads never have to wrap within
+ * a block: a block only ends where the write position does. */
+
+#define FDN_LINES 8
+
+/* Added to what goes into the lines, so that a dying tail settles
+ * at a tiny offset instead of turning into slow denormals. */
+#define FDN_DENORMAL_BIAS 1e-18f
+
+/* Brings the wet level close to that of the comb filter reverb with
+ * the same settings. */
+#define FDN_WET_SCALE 4.0f
+
+/* Line lengths in frames at 48 kHz, for a room size of 0.5. Picked
+ * to have no common factors, so that the echoes don't pile up. */
+static const unsigned fdn_base_lengths[FDN_LINES] = {
+   1109, 1223, 1361, 1493, 1613, 1759, 1907, 2053,
+};
+
+/* Which way round each line takes its input and gives its output,
+ * so that the lines don't all start out in phase. */
+static const float fdn_input_signs[FDN_LINES] = {
+   1.0f, 1.0f, -1.0f, 1.0f, 1.0f, -1.0f, -1.0f, -1.0f,
+};
+
+static const float fdn_output_signs[FDN_LINES] = {
+   1.0f, -1.0f, 1.0f, 1.0f, -1.0f, 1.0f, -1.0f, -1.0f,
+};
+
+struct fdnreverb_data
+{
+   float gain[FDN_LINES];
+   float damp[FDN_LINES];
+   float input_gain[FDN_LINES];
+   float output_gain[FDN_LINES];
+   float state[FDN_LINES];
+
+   /* Two copies of size frames each. */
+   float *ring;
+   unsigned size;
+   unsigned pos;
+   /* Read offsets from the frame being written, in floats. */
+   int offsets[FDN_LINES];
+
+   float dry;
+   float wet_direct;
+   float wet_cross;
+};
+
+static void fdnreverb_free(void *data)
+{
+   struct fdnreverb_data *fdn = (struct fdnreverb_data*)data;
+
+   if (!fdn)
+      return;
+
+   free(fdn->ring);
+   free(fdn);
+}
+
+/* Runs @frames frames, which must not take the write position past
+ * the end of the first copy of the ring. */
+static void fdnreverb_process_block(struct fdnreverb_data *fdn,
+      float *samples, unsigned frames)
+{
+   unsigned i;
+   float *write        = fdn->ring + fdn->pos * FDN_LINES;
+   float *mirror       = write + fdn->size * FDN_LINES;
+   const int *offsets  = fdn->offsets;
+   float mix           = -2.0f / FDN_LINES;
+
+#if defined(__AVX__)
+   __m256 gain         = _mm256_loadu_ps(fdn->gain);
+   __m256 damp         = _mm256_loadu_ps(fdn->damp);
+   __m256 input_gain   = _mm256_loadu_ps(fdn->input_gain);
+   __m256 output_gain  = _mm256_loadu_ps(fdn->output_gain);
+   __m256 state        = _mm256_loadu_ps(fdn->state);
+
+   for (i = 0; i < frames; i++, samples += 2,
+         write += FDN_LINES, mirror += FDN_LINES)
+   {
+      __m128 sum, out;
+      __m256 in, x;
+      __m256 v = _mm256_setr_ps(
+            mirror[offsets[0]], mirror[offsets[1]],
+            mirror[offsets[2]], mirror[offsets[3]],
+            mirror[offsets[4]], mirror[offsets[5]],
+            mirror[offsets[6]], mirror[offsets[7]]);
+
+      /* Left and right line outputs, in the even and odd lanes. */
+      x     = _mm256_mul_ps(v, output_gain);
+      out   = _mm_add_ps(_mm256_castps256_ps128(x),
+            _mm256_extractf128_ps(x, 1));
+      out   = _mm_add_ps(out, _mm_movehl_ps(out, out));
+
+      state = _mm256_add_ps(state, _mm256_mul_ps(damp,
+               _mm256_sub_ps(v, state)));
+      x     = _mm256_mul_ps(state, gain);
+
+      /* Householder feedback, which only needs the sum of all lines. */
+      sum   = _mm_add_ps(_mm256_castps256_ps128(x),
+            _mm256_extractf128_ps(x, 1));
+      sum   = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+      sum   = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+      sum   = _mm_mul_ss(sum, _mm_set_ss(mix));
+
+      in    = _mm256_castpd_ps(_mm256_broadcast_sd((const double*)samples));
+      x     = _mm256_add_ps(x, _mm256_set1_ps(_mm_cvtss_f32(sum) + FDN_DENORMAL_BIAS));
+      x     = _mm256_add_ps(x, _mm256_mul_ps(in, input_gain));
+
+      _mm256_storeu_ps(write, x);
+      _mm256_storeu_ps(mirror, x);
+
+      {
+         float left  = samples[0];
+         float right = samples[1];
+         float out_l = _mm_cvtss_f32(out);
+         float out_r = _mm_cvtss_f32(_mm_shuffle_ps(out, out, _MM_SHUFFLE(1, 1, 1, 1)));
+
+         samples[0]  = fdn->dry * left  + fdn->wet_direct * out_l + fdn->wet_cross * out_r;
+         samples[1]  = fdn->dry * right + fdn->wet_direct * out_r + fdn->wet_cross * out_l;
+      }
+   }
+
+   _mm256_storeu_ps(fdn->state, state);
+#elif defined(__SSE2__)
+   __m128 gain_lo        = _mm_loadu_ps(fdn->gain);
+   __m128 gain_hi        = _mm_loadu_ps(fdn->gain + 4);
+   __m128 damp_lo        = _mm_loadu_ps(fdn->damp);
+   __m128 damp_hi        = _mm_loadu_ps(fdn->damp + 4);
+   __m128 input_gain_lo  = _mm_loadu_ps(fdn->input_gain);
+   __m128 input_gain_hi  = _mm_loadu_ps(fdn->input_gain + 4);
+   __m128 output_gain_lo = _mm_loadu_ps(fdn->output_gain);
+   __m128 output_gain_hi = _mm_loadu_ps(fdn->output_gain + 4);
+   __m128 state_lo       = _mm_loadu_ps(fdn->state);
+   __m128 state_hi       = _mm_loadu_ps(fdn->state + 4);
+
+   for (i = 0; i < frames; i++, samples += 2,
+         write += FDN_LINES, mirror += FDN_LINES)
+   {
+      __m128 out, sum, in;
+      __m128 v_lo = _mm_setr_ps(
+            mirror[offsets[0]], mirror[offsets[1]],
+            mirror[offsets[2]], mirror[offsets[3]]);
+      __m128 v_hi = _mm_setr_ps(
+            mirror[offsets[4]], mirror[offsets[5]],
+            mirror[offsets[6]], mirror[offsets[7]]);
+
+      out      = _mm_add_ps(_mm_mul_ps(v_lo, output_gain_lo),
+            _mm_mul_ps(v_hi, output_gain_hi));
+      out      = _mm_add_ps(out, _mm_movehl_ps(out, out));
+
+      state_lo = _mm_add_ps(state_lo, _mm_mul_ps(damp_lo,
+               _mm_sub_ps(v_lo, state_lo)));
+      state_hi = _mm_add_ps(state_hi, _mm_mul_ps(damp_hi,
+               _mm_sub_ps(v_hi, state_hi)));
+      v_lo     = _mm_mul_ps(state_lo, gain_lo);
+      v_hi     = _mm_mul_ps(state_hi, gain_hi);
+
+      sum      = _mm_add_ps(v_lo, v_hi);
+      sum      = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+      sum      = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(2, 3, 0, 1)));
+      sum      = _mm_mul_ps(_mm_shuffle_ps(sum, sum, _MM_SHUFFLE(0, 0, 0, 0)),
+            _mm_set1_ps(mix));
+      sum      = _mm_add_ps(sum, _mm_set1_ps(FDN_DENORMAL_BIAS));
+
+      in       = _mm_castpd_ps(_mm_load1_pd((const double*)samples));
+      v_lo     = _mm_add_ps(_mm_add_ps(v_lo, sum), _mm_mul_ps(in, input_gain_lo));
+      v_hi     = _mm_add_ps(_mm_add_ps(v_hi, sum), _mm_mul_ps(in, input_gain_hi));
+
+      _mm_storeu_ps(write, v_lo);
+      _mm_storeu_ps(write + 4, v_hi);
+      _mm_storeu_ps(mirror, v_lo);
+      _mm_storeu_ps(mirror + 4, v_hi);
+
+      {
+         float left  = samples[0];
+         float right = samples[1];
+         float out_l = _mm_cvtss_f32(out);
+         float out_r = _mm_cvtss_f32(_mm_shuffle_ps(out, out, _MM_SHUFFLE(1, 1, 1, 1)));
+
+         samples[0]  = fdn->dry * left  + fdn->wet_direct * out_l + fdn->wet_cross * out_r;
+         samples[1]  = fdn->dry * right + fdn->wet_direct * out_r + fdn->wet_cross * out_l;
+      }
+   }
+
+   _mm_storeu_ps(fdn->state, state_lo);
+   _mm_storeu_ps(fdn->state + 4, state_hi);
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+   float32x4_t gain_lo        = vld1q_f32(fdn->gain);
+   float32x4_t gain_hi        = vld1q_f32(fdn->gain + 4);
+   float32x4_t damp_lo        = vld1q_f32(fdn->damp);
+   float32x4_t damp_hi        = vld1q_f32(fdn->damp + 4);
+   float32x4_t input_gain_lo  = vld1q_f32(fdn->input_gain);
+   float32x4_t input_gain_hi  = vld1q_f32(fdn->input_gain + 4);
+   float32x4_t output_gain_lo = vld1q_f32(fdn->output_gain);
+   float32x4_t output_gain_hi = vld1q_f32(fdn->output_gain + 4);
+   float32x4_t state_lo       = vld1q_f32(fdn->state);
+   float32x4_t state_hi       = vld1q_f32(fdn->state + 4);
+
+   for (i = 0; i < frames; i++, samples += 2,
+         write += FDN_LINES, mirror += FDN_LINES)
+   {
+      float32x2_t out, sum, in;
+      float32x4_t in_q;
+      float32x4_t v_lo = vdupq_n_f32(0.0f);
+      float32x4_t v_hi = vdupq_n_f32(0.0f);
+
+      v_lo     = vld1q_lane_f32(mirror + offsets[0], v_lo, 0);
+      v_lo     = vld1q_lane_f32(mirror + offsets[1], v_lo, 1);
+      v_lo     = vld1q_lane_f32(mirror + offsets[2], v_lo, 2);
+      v_lo     = vld1q_lane_f32(mirror + offsets[3], v_lo, 3);
+      v_hi     = vld1q_lane_f32(mirror + offsets[4], v_hi, 0);
+      v_hi     = vld1q_lane_f32(mirror + offsets[5], v_hi, 1);
+      v_hi     = vld1q_lane_f32(mirror + offsets[6], v_hi, 2);
+      v_hi     = vld1q_lane_f32(mirror + offsets[7], v_hi, 3);
+
+      in_q     = vmlaq_f32(vmulq_f32(v_lo, output_gain_lo),
+            v_hi, output_gain_hi);
+      out      = vadd_f32(vget_low_f32(in_q), vget_high_f32(in_q));
+
+      state_lo = vmlaq_f32(state_lo, damp_lo, vsubq_f32(v_lo, state_lo));
+      state_hi = vmlaq_f32(state_hi, damp_hi, vsubq_f32(v_hi, state_hi));
+      v_lo     = vmulq_f32(state_lo, gain_lo);
+      v_hi     = vmulq_f32(state_hi, gain_hi);
+
+      in_q     = vaddq_f32(v_lo, v_hi);
+      sum      = vadd_f32(vget_low_f32(in_q), vget_high_f32(in_q));
+      sum      = vpadd_f32(sum, sum);
+      sum      = vmla_n_f32(vdup_n_f32(FDN_DENORMAL_BIAS), sum, mix);
+
+      in       = vld1_f32(samples);
+      in_q     = vcombine_f32(in, in);
+      v_lo     = vmlaq_f32(vaddq_f32(v_lo, vcombine_f32(sum, sum)), in_q, input_gain_lo);
+      v_hi     = vmlaq_f32(vaddq_f32(v_hi, vcombine_f32(sum, sum)), in_q, input_gain_hi);
+
+      vst1q_f32(write, v_lo);
+      vst1q_f32(write + 4, v_hi);
+      vst1q_f32(mirror, v_lo);
+      vst1q_f32(mirror + 4, v_hi);
+
+      {
+         float left  = samples[0];
+         float right = samples[1];
+         float out_l = vget_lane_f32(out, 0);
+         float out_r = vget_lane_f32(out, 1);
+
+         samples[0]  = fdn->dry * left  + fdn->wet_direct * out_l + fdn->wet_cross * out_r;
+         samples[1]  = fdn->dry * right + fdn->wet_direct * out_r + fdn->wet_cross * out_l;
+      }
+   }
+
+   vst1q_f32(fdn->state, state_lo);
+   vst1q_f32(fdn->state + 4, state_hi);
+#else
+   float state[FDN_LINES];
+
+   memcpy(state, fdn->state, sizeof(state));
+
+   for (i = 0; i < frames; i++, samples += 2,
+         write += FDN_LINES, mirror += FDN_LINES)
+   {
+      unsigned j;
+      float x[FDN_LINES];
+      float out[2] = {0.0f, 0.0f};
+      float sum    = 0.0f;
+
+      for (j = 0; j < FDN_LINES; j++)
+      {
+         float v   = mirror[offsets[j]];
+
+         out[j & 1] += v * fdn->output_gain[j];
+
+         state[j] += fdn->damp[j] * (v - state[j]);
+         x[j]      = state[j] * fdn->gain[j];
+         sum      += x[j];
+      }
+
+      for (j = 0; j < FDN_LINES; j++)
+      {
+         write[j]  = x[j] + mix * sum + FDN_DENORMAL_BIAS
+            + samples[j & 1] * fdn->input_gain[j];
+         mirror[j] = write[j];
+      }
+
+      {
+         float left  = samples[0];
+         float right = samples[1];
+
+         samples[0]  = fdn->dry * left  + fdn->wet_direct * out[0] + fdn->wet_cross * out[1];
+         samples[1]  = fdn->dry * right + fdn->wet_direct * out[1] + fdn->wet_cross * out[0];
+      }
+   }
+
+   memcpy(fdn->state, state, sizeof(state));
+#endif
+}
+
+static void fdnreverb_process(void *data, struct dspfilter_output *output,
+      const struct dspfilter_input *input)
+{
+   struct fdnreverb_data *fdn = (struct fdnreverb_data*)data;
+   float *samples             = input->samples;
+   unsigned frames            = input->frames;
+
+   output->samples            = input->samples;
+   output->frames             = input->frames;
+
+   while (frames)
+   {
+      unsigned block = MIN(frames, fdn->size - fdn->pos);
+
+      fdnreverb_process_block(fdn, samples, block);
+
+      fdn->pos      += block;
+      if (fdn->pos == fdn->size)
+         fdn->pos    = 0;
+
+      samples       += block * 2;
+      frames        -= block;
+   }
+}
+
+static void *fdnreverb_init(const struct dspfilter_info *info,
+      const struct dspfilter_config *config, void *userdata)
+{
+   unsigned i;
+   float drytime, wettime, damping, roomwidth, roomsize, decay;
+   unsigned longest           = 0;
+   struct fdnreverb_data *fdn = (struct fdnreverb_data*)
+      calloc(1, sizeof(*fdn));
+   if (!fdn)
+      return NULL;
+
+   /* Same settings as the comb filter reverb, plus the decay time. */
+   config->get_float(userdata, "drytime", &drytime, 0.43f);
+   config->get_float(userdata, "wettime", &wettime, 0.4f);
+   config->get_float(userdata, "damping", &damping, 0.8f);
+   config->get_float(userdata, "roomwidth", &roomwidth, 0.56f);
+   config->get_float(userdata, "roomsize", &roomsize, 0.56f);
+   config->get_float(userdata, "decay", &decay, 0.3f + 1.5f * roomsize);
+
+   roomsize = MAX(roomsize, 0.0f);
+   decay    = MAX(decay, 0.01f);
+   damping  = MIN(MAX(damping, 0.0f), 1.0f);
+
+   for (i = 0; i < FDN_LINES; i++)
+   {
+      double length = fdn_base_lengths[i] * (0.5 + roomsize)
+         * info->input_rate / 48000.0;
+      unsigned frames = MAX((unsigned)length, 1);
+
+      /* Loses 60 dB over the decay time, going around the loop
+       * every line length. */
+      fdn->gain[i]        = (float)pow(10.0, -3.0 * frames
+            / (decay * info->input_rate));
+      fdn->damp[i]        = 1.0f - 0.7f * damping;
+      fdn->input_gain[i]  = fdn_input_signs[i] * 0.5f;
+      fdn->output_gain[i] = fdn_output_signs[i] * 0.5f;
+      fdn->offsets[i]     = -(int)(frames * FDN_LINES) + (int)i;
+
+      longest             = MAX(longest, frames);
+   }
+
+   fdn->size       = longest + 1;
+   fdn->ring       = (float*)calloc(2 * fdn->size * FDN_LINES, sizeof(float));
+   if (!fdn->ring)
+   {
+      fdnreverb_free(fdn);
+      return NULL;
+   }
+
+   fdn->dry        = drytime;
+   fdn->wet_direct = FDN_WET_SCALE * wettime * (0.5f + 0.5f * roomwidth);
+   fdn->wet_cross  = FDN_WET_SCALE * wettime * (0.5f - 0.5f * roomwidth);
+
+   return fdn;
+}
+
+static const struct dspfilter_implementation fdnreverb_plug = {
+   fdnreverb_init,
+   fdnreverb_process,
+   fdnreverb_free,
+
+   DSPFILTER_API_VERSION,
+   "Feedback Delay Network Reverb",
+   "fdnreverb",
+
+   DSPFILTER_FLAG_IN_PLACE,
+   NULL,
+};
+
+#ifdef HAVE_FILTERS_BUILTIN
+#define dspfilter_get_implementation fdnreverb_dspfilter_get_implementation
+#endif
+
+const struct dspfilter_implementation *dspfilter_get_implementation(dspfilter_simd_mask_t mask)
+{
+   (void)mask;
+   return &fdnreverb_plug;
+}
+
+#undef dspfilter_get_implementation
@@ -0,0 +1,321 @@
+/* Copyright  (C) 2010-2018 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (convolver.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <retro_miscellaneous.h>
+
+#include "fft.h"
+#include "convolver.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+#include <arm_neon.h>
+#endif
+
+/* Both channels of a block are transformed together, the left one
+ * in the real part and the right one in the imaginary part, and
+ * split into the spectra of each. The spectra are stored in slots of
+ * 4 * block_size values: the real parts of the left and right bins,
+ * then their imaginary parts, so that the products can be summed
+ * without any shuffling. The bins above the Nyquist frequency are
+ * left out as they mirror the ones below, and the Nyquist bin, which
+ * is real like the DC one, is stored as the imaginary part of bin 0. */
+struct fft_convolver
+{
+   fft_t *fft;
+
+   /* One slot per partition. */
+   float *filter;
+   float *delay_line;
+   float *sum;
+
+   /* Previous and current input block. */
+   fft_complex_t *input;
+   fft_complex_t *spectrum;
+   /* The second half holds the output block. */
+   fft_complex_t *output;
+
+   unsigned block_size;
+   unsigned partitions;
+   /* Slot of the newest block, the one of the block before it
+    * follows. */
+   unsigned delay_pos;
+   unsigned block_ptr;
+};
+
+static void fft_convolver_split(float *slot, const fft_complex_t *z,
+      unsigned block_size)
+{
+   unsigned k;
+   unsigned n      = 2 * block_size;
+   float *left_re  = slot;
+   float *right_re = slot + block_size;
+   float *left_im  = slot + 2 * block_size;
+   float *right_im = slot + 3 * block_size;
+
+   left_re[0]  = z[0].real;
+   right_re[0] = z[0].imag;
+   left_im[0]  = z[block_size].real;
+   right_im[0] = z[block_size].imag;
+
+   for (k = 1; k < block_size; k++)
+   {
+      fft_complex_t a = z[k];
+      fft_complex_t b = z[n - k];
+
+      left_re[k]  = 0.5f * (a.real + b.real);
+      left_im[k]  = 0.5f * (a.imag - b.imag);
+      right_re[k] = 0.5f * (a.imag + b.imag);
+      right_im[k] = 0.5f * (b.real - a.real);
+   }
+}
+
+/* Inverse of fft_convolver_split(). */
+static void fft_convolver_merge(fft_complex_t *z, const float *slot,
+      unsigned block_size)
+{
+   unsigned k;
+   unsigned n            = 2 * block_size;
+   const float *left_re  = slot;
+   const float *right_re = slot + block_size;
+   const float *left_im  = slot + 2 * block_size;
+   const float *right_im = slot + 3 * block_size;
+
+   z[0].real          = left_re[0];
+   z[0].imag          = right_re[0];
+   z[block_size].real = left_im[0];
+   z[block_size].imag = right_im[0];
+
+   for (k = 1; k < block_size; k++)
+   {
+      z[k].real     = left_re[k] - right_im[k];
+      z[k].imag     = left_im[k] + right_re[k];
+      z[n - k].real = left_re[k] + right_im[k];
+      z[n - k].imag = right_re[k] - left_im[k];
+   }
+}
+
+/* Adds the products of @bins complex values of @x and @h to @sum. */
+static void fft_convolver_mac(float *sum, const float *x,
+      const float *h, unsigned bins)
+{
+   unsigned i         = 0;
+   float *sum_im      = sum + bins;
+   const float *x_im  = x + bins;
+   const float *h_im  = h + bins;
+
+#if defined(__AVX__)
+   for (; i + 8 <= bins; i += 8)
+   {
+      __m256 xr = _mm256_loadu_ps(x + i);
+      __m256 xi = _mm256_loadu_ps(x_im + i);
+      __m256 hr = _mm256_loadu_ps(h + i);
+      __m256 hi = _mm256_loadu_ps(h_im + i);
+
+      _mm256_storeu_ps(sum + i, _mm256_add_ps(_mm256_loadu_ps(sum + i),
+               _mm256_sub_ps(_mm256_mul_ps(xr, hr), _mm256_mul_ps(xi, hi))));
+      _mm256_storeu_ps(sum_im + i, _mm256_add_ps(_mm256_loadu_ps(sum_im + i),
+               _mm256_add_ps(_mm256_mul_ps(xr, hi), _mm256_mul_ps(xi, hr))));
+   }
+#elif defined(__SSE2__)
+   for (; i + 4 <= bins; i += 4)
+   {
+      __m128 xr = _mm_loadu_ps(x + i);
+      __m128 xi = _mm_loadu_ps(x_im + i);
+      __m128 hr = _mm_loadu_ps(h + i);
+      __m128 hi = _mm_loadu_ps(h_im + i);
+
+      _mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i),
+               _mm_sub_ps(_mm_mul_ps(xr, hr), _mm_mul_ps(xi, hi))));
+      _mm_storeu_ps(sum_im + i, _mm_add_ps(_mm_loadu_ps(sum_im + i),
+               _mm_add_ps(_mm_mul_ps(xr, hi), _mm_mul_ps(xi, hr))));
+   }
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+   for (; i + 4 <= bins; i += 4)
+   {
+      float32x4_t xr = vld1q_f32(x + i);
+      float32x4_t xi = vld1q_f32(x_im + i);
+      float32x4_t hr = vld1q_f32(h + i);
+      float32x4_t hi = vld1q_f32(h_im + i);
+
+      vst1q_f32(sum + i, vmlsq_f32(vmlaq_f32(vld1q_f32(sum + i),
+                  xr, hr), xi, hi));
+      vst1q_f32(sum_im + i, vmlaq_f32(vmlaq_f32(vld1q_f32(sum_im + i),
+                  xr, hi), xi, hr));
+   }
+#endif
+
+   for (; i < bins; i++)
+   {
+      sum[i]    += x[i] * h[i] - x_im[i] * h_im[i];
+      sum_im[i] += x[i] * h_im[i] + x_im[i] * h[i];
+   }
+}
+
+static void fft_convolver_block(fft_convolver_t *conv)
+{
+   unsigned i, c;
+   unsigned block_size = conv->block_size;
+   unsigned slot_size  = 4 * block_size;
+   unsigned first;
+
+   conv->delay_pos     = (conv->delay_pos ? conv->delay_pos
+         : conv->partitions) - 1;
+   first               = conv->partitions - conv->delay_pos;
+
+   fft_process_forward_complex(conv->fft, conv->spectrum, conv->input, 1);
+   fft_convolver_split(conv->delay_line + conv->delay_pos * slot_size,
+         conv->spectrum, block_size);
+
+   memset(conv->sum, 0, slot_size * sizeof(*conv->sum));
+
+   /* The delay line wraps around once. */
+   for (i = 0; i < first; i++)
+      fft_convolver_mac(conv->sum,
+            conv->delay_line + (conv->delay_pos + i) * slot_size,
+            conv->filter + i * slot_size, 2 * block_size);
+   for (; i < conv->partitions; i++)
+      fft_convolver_mac(conv->sum,
+            conv->delay_line + (i - first) * slot_size,
+            conv->filter + i * slot_size, 2 * block_size);
+
+   /* Bin 0 holds two real values, which were multiplied as if they
+    * were one complex value. */
+   for (c = 0; c < 2 * block_size; c += block_size)
+   {
+      float dc      = 0.0f;
+      float nyquist = 0.0f;
+
+      for (i = 0; i < conv->partitions; i++)
+      {
+         const float *x = conv->delay_line + c
+            + ((conv->delay_pos + i) % conv->partitions) * slot_size;
+         const float *h = conv->filter + c + i * slot_size;
+
+         dc      += x[0] * h[0];
+         nyquist += x[2 * block_size] * h[2 * block_size];
+      }
+
+      conv->sum[c]                  = dc;
+      conv->sum[c + 2 * block_size] = nyquist;
+   }
+
+   fft_convolver_merge(conv->spectrum, conv->sum, block_size);
+   fft_process_inverse_complex(conv->fft, conv->output, conv->spectrum);
+
+   memcpy(conv->input, conv->input + block_size,
+         block_size * sizeof(*conv->input));
+}
+
+fft_convolver_t *fft_convolver_new(const float *filter, unsigned taps,
+      unsigned block_size_log2)
+{
+   unsigned i;
+   unsigned block_size   = 1 << block_size_log2;
+   unsigned slot_size    = 4 * block_size;
+   fft_convolver_t *conv = (fft_convolver_t*)calloc(1, sizeof(*conv));
+   if (!conv)
+      return NULL;
+
+   conv->block_size = block_size;
+   conv->partitions = taps ? (taps + block_size - 1) >> block_size_log2 : 1;
+
+   conv->fft        = fft_new(block_size_log2 + 1);
+   conv->filter     = (float*)calloc(conv->partitions * slot_size, sizeof(float));
+   conv->delay_line = (float*)calloc(conv->partitions * slot_size, sizeof(float));
+   conv->sum        = (float*)calloc(slot_size, sizeof(float));
+   conv->input      = (fft_complex_t*)calloc(2 * block_size, sizeof(fft_complex_t));
+   conv->spectrum   = (fft_complex_t*)calloc(2 * block_size, sizeof(fft_complex_t));
+   conv->output     = (fft_complex_t*)calloc(2 * block_size, sizeof(fft_complex_t));
+
+   if (!conv->fft || !conv->filter || !conv->delay_line || !conv->sum
+         || !conv->input || !conv->spectrum || !conv->output)
+   {
+      fft_convolver_free(conv);
+      return NULL;
+   }
+
+   /* Transform each partition padded with zeroes, which is where
+    * the previous block goes in the input. */
+   for (i = 0; i < conv->partitions; i++)
+   {
+      unsigned start = i * block_size;
+
+      if (start < taps)
+         memcpy(conv->input, filter + 2 * start,
+               MIN(block_size, taps - start) * sizeof(*conv->input));
+
+      fft_process_forward_complex(conv->fft, conv->spectrum,
+            conv->input, 1);
+      fft_convolver_split(conv->filter + i * slot_size,
+            conv->spectrum, block_size);
+
+      memset(conv->input, 0, block_size * sizeof(*conv->input));
+   }
+
+   return conv;
+}
+
+void fft_convolver_free(fft_convolver_t *conv)
+{
+   if (!conv)
+      return;
+
+   fft_free(conv->fft);
+   free(conv->filter);
+   free(conv->delay_line);
+   free(conv->sum);
+   free(conv->input);
+   free(conv->spectrum);
+   free(conv->output);
+   free(conv);
+}
+
+void fft_convolver_process(fft_convolver_t *conv, float *samples,
+      unsigned frames)
+{
+   while (frames)
+   {
+      unsigned ptr   = conv->block_ptr;
+      unsigned avail = MIN(frames, conv->block_size - ptr);
+
+      memcpy(conv->input + conv->block_size + ptr, samples,
+            avail * sizeof(*conv->input));
+      memcpy(samples, conv->output + conv->block_size + ptr,
+            avail * sizeof(*conv->output));
+
+      samples         += 2 * avail;
+      frames          -= avail;
+      conv->block_ptr += avail;
+
+      if (conv->block_ptr == conv->block_size)
+      {
+         fft_convolver_block(conv);
+         conv->block_ptr = 0;
+      }
+   }
+}
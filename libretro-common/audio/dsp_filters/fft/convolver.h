@@ -0,0 +1,65 @@
+/* Copyright  (C) 2010-2018 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (convolver.h).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef RARCH_FFT_CONVOLVER_H__
+#define RARCH_FFT_CONVOLVER_H__
+
+/* Uniformly partitioned overlap-save convolution of interleaved
+ * stereo samples with a filter of any length.
+ *
+ * The filter is cut into partitions of the block size, each one
+ * transformed once at setup. Every block of input is transformed
+ * once, and kept in a frequency-domain delay line with one slot per
+ * partition; the output block is the inverse transform of the sum of
+ * slot and partition spectra products. Latency is thus one block no
+ * matter how long the filter is, and each block costs the same, with
+ * no larger transform coming due every so often.
+ */
+typedef struct fft_convolver fft_convolver_t;
+
+/**
+ * fft_convolver_new:
+ * @filter             : Interleaved stereo filter taps, the left
+ *                       channel is filtered with the left taps and
+ *                       the right one with the right taps.
+ * @taps               : Number of taps per channel.
+ * @block_size_log2    : Latency and partition size, in frames.
+ *
+ * Returns: new convolver, or NULL on failure.
+ **/
+fft_convolver_t *fft_convolver_new(const float *filter, unsigned taps,
+      unsigned block_size_log2);
+
+void fft_convolver_free(fft_convolver_t *conv);
+
+/**
+ * fft_convolver_process:
+ * @conv               : Convolver handle.
+ * @samples            : Interleaved stereo samples, filtered in place.
+ * @frames             : Number of frames.
+ *
+ * Output is delayed by the block size.
+ **/
+void fft_convolver_process(fft_convolver_t *conv, float *samples,
+      unsigned frames);
+
+#endif
@@ -25,181 +25,628 @@
 
 #include "fft.h"
 
+#include <boolean.h>
 #include <retro_miscellaneous.h>
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+#include <arm_neon.h>
+#endif
+
+/* Radix-4 Stockham transform. Each stage reads one buffer and writes
+ * the other, so the output comes out in order without a bit reversal
+ * pass, and all loads and stores are contiguous runs of complex
+ * values that SIMD can work on. A radix-2 stage finishes the
+ * transform when the size is an odd power of two. */
 struct fft
 {
-   fft_complex_t *interleave_buffer;
-   fft_complex_t *phase_lut;
-   unsigned *bitinverse_buffer;
+   /* Two scratch buffers of size complex values each. */
+   fft_complex_t *buffer;
+   /* Twiddle factors of each stage but the last one, see
+    * build_twiddles(). */
+   fft_complex_t *twiddles;
+   fft_complex_t *twiddles_inverse;
    unsigned size;
+   unsigned stages;
 };
 
-static unsigned bitswap(unsigned x, unsigned size_log2)
+/* Lays out the twiddle factors in the order the stages use them.
+ * A stage working on blocks of n values gets n / 4 values of
+ * w^p, then of w^2p, then of w^3p, with w = e^(-2 pi i / n). The last
+ * stage has none, as they are all 1 there. */
+static void build_twiddles(fft_complex_t *out, unsigned size, int dir)
 {
-   unsigned i;
-   unsigned ret = 0;
-   for (i = 0; i < size_log2; i++)
-      ret |= ((x >> i) & 1) << (size_log2 - i - 1);
-   return ret;
+   unsigned n;
+
+   for (n = size; n > 4; n >>= 2)
+   {
+      unsigned p, k;
+      unsigned n1 = n >> 2;
+
+      for (k = 1; k <= 3; k++)
+      {
+         for (p = 0; p < n1; p++, out++)
+         {
+            double phase = dir * 2.0 * M_PI * (double)(k * p) / n;
+            out->real    = (float)cos(phase);
+            out->imag    = (float)sin(phase);
+         }
+      }
+   }
 }
 
-static void build_bitinverse(unsigned *bitinverse, unsigned size_log2)
+fft_t *fft_new(unsigned block_size_log2)
 {
-   unsigned i;
-   unsigned size = 1 << size_log2;
-   for (i = 0; i < size; i++)
-      bitinverse[i] = bitswap(i, size_log2);
+   unsigned size;
+   fft_t *fft = (fft_t*)calloc(1, sizeof(*fft));
+   if (!fft)
+      return NULL;
+
+   size                   = 1 << block_size_log2;
+   fft->buffer            = (fft_complex_t*)calloc(2 * size, sizeof(*fft->buffer));
+   fft->twiddles          = (fft_complex_t*)calloc(size, sizeof(*fft->twiddles));
+   fft->twiddles_inverse  = (fft_complex_t*)calloc(size, sizeof(*fft->twiddles_inverse));
+
+   if (!fft->buffer || !fft->twiddles || !fft->twiddles_inverse)
+      goto error;
+
+   fft->size   = size;
+   fft->stages = (block_size_log2 + 1) >> 1;
+
+   build_twiddles(fft->twiddles, size, -1);
+   build_twiddles(fft->twiddles_inverse, size, 1);
+   return fft;
+
+error:
+   fft_free(fft);
+   return NULL;
+}
+
+void fft_free(fft_t *fft)
+{
+   if (!fft)
+      return;
+
+   free(fft->buffer);
+   free(fft->twiddles);
+   free(fft->twiddles_inverse);
+   free(fft);
 }
 
-static fft_complex_t exp_imag(double phase)
+/* Multiplies by i, or by -i for the inverse transform. */
+static INLINE fft_complex_t fft_rotate(fft_complex_t a, bool inverse)
 {
-   fft_complex_t out = { cos(phase), sin(phase) };
+   fft_complex_t out;
+   out.real = inverse ?  a.imag : -a.imag;
+   out.imag = inverse ? -a.real :  a.real;
    return out;
 }
 
-static void build_phase_lut(fft_complex_t *out, int size)
+static INLINE fft_complex_t fft_scale(fft_complex_t a, float gain)
 {
-   int i;
-   out += size;
-   for (i = -size; i <= size; i++)
-      out[i] = exp_imag((M_PI * i) / size);
+   a.real *= gain;
+   a.imag *= gain;
+   return a;
 }
 
-static void interleave_complex(const unsigned *bitinverse,
-      fft_complex_t *out, const fft_complex_t *in,
-      unsigned samples, unsigned step)
+/* Sign to flip after swapping real and imaginary parts, to multiply
+ * by i (real parts) or -i (imaginary parts). */
+#if defined(__AVX__)
+#define FFT_ROTATE_SIGN_AVX(inverse) ((inverse) \
+      ? _mm256_set_ps(-0.0f, 0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f, 0.0f) \
+      : _mm256_set_ps(0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f))
+#endif
+
+#if defined(__SSE2__)
+#define FFT_ROTATE_SIGN_SSE(inverse) ((inverse) \
+      ? _mm_set_ps(-0.0f, 0.0f, -0.0f, 0.0f) \
+      : _mm_set_ps(0.0f, -0.0f, 0.0f, -0.0f))
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+static const float fft_rotate_sign_neon[2][4] = {
+   { -0.0f, 0.0f, -0.0f, 0.0f },
+   { 0.0f, -0.0f, 0.0f, -0.0f }
+};
+
+#define FFT_ROTATE_SIGN_NEON(inverse) \
+   vreinterpretq_u32_f32(vld1q_f32(fft_rotate_sign_neon[(inverse) ? 1 : 0]))
+#endif
+
+#if defined(__AVX__)
+static INLINE __m256 fft_cmul_avx(__m256 a, __m256 w)
 {
-   unsigned i;
-   for (i = 0; i < samples; i++, in += step)
-      out[bitinverse[i]] = *in;
+   __m256 re   = _mm256_moveldup_ps(w);
+   __m256 im   = _mm256_movehdup_ps(w);
+   __m256 swap = _mm256_permute_ps(a, _MM_SHUFFLE(2, 3, 0, 1));
+   return _mm256_addsub_ps(_mm256_mul_ps(a, re), _mm256_mul_ps(swap, im));
 }
 
-static void interleave_float(const unsigned *bitinverse,
-      fft_complex_t *out, const float *in,
-      unsigned samples, unsigned step)
+static INLINE __m256 fft_rotate_avx(__m256 a, __m256 sign)
 {
-   unsigned i;
-   for (i = 0; i < samples; i++, in += step)
-   {
-      unsigned inv_i = bitinverse[i];
-      out[inv_i].real = *in;
-      out[inv_i].imag = 0.0f;
-   }
+   return _mm256_xor_ps(_mm256_permute_ps(a, _MM_SHUFFLE(2, 3, 0, 1)), sign);
 }
 
-static void resolve_float(float *out, const fft_complex_t *in, unsigned samples,
-      float gain, unsigned step)
+/* Broadcasts a single complex value. */
+static INLINE __m256 fft_load1_avx(const fft_complex_t *w)
 {
-   unsigned i;
-   for (i = 0; i < samples; i++, in++, out += step)
-      *out = gain * in->real;
+   return _mm256_castpd_ps(_mm256_broadcast_sd((const double*)w));
 }
+#endif
 
-fft_t *fft_new(unsigned block_size_log2)
+#if defined(__SSE2__)
+static INLINE __m128 fft_cmul_sse(__m128 a, __m128 w)
 {
-   unsigned size;
-   fft_t *fft = (fft_t*)calloc(1, sizeof(*fft));
-   if (!fft)
-      return NULL;
+   __m128 re   = _mm_shuffle_ps(w, w, _MM_SHUFFLE(2, 2, 0, 0));
+   __m128 im   = _mm_shuffle_ps(w, w, _MM_SHUFFLE(3, 3, 1, 1));
+   __m128 swap = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1));
+   return _mm_add_ps(_mm_mul_ps(a, re),
+         _mm_xor_ps(_mm_mul_ps(swap, im), FFT_ROTATE_SIGN_SSE(false)));
+}
 
-   size                   = 1 << block_size_log2;
-   fft->interleave_buffer = (fft_complex_t*)calloc(size, sizeof(*fft->interleave_buffer));
-   fft->bitinverse_buffer = (unsigned*)calloc(size, sizeof(*fft->bitinverse_buffer));
-   fft->phase_lut         = (fft_complex_t*)calloc(2 * size + 1, sizeof(*fft->phase_lut));
+static INLINE __m128 fft_rotate_sse(__m128 a, __m128 sign)
+{
+   return _mm_xor_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), sign);
+}
 
-   if (!fft->interleave_buffer || !fft->bitinverse_buffer || !fft->phase_lut)
-      goto error;
+static INLINE __m128 fft_load1_sse(const fft_complex_t *w)
+{
+   return _mm_castpd_ps(_mm_load1_pd((const double*)w));
+}
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+static INLINE float32x4_t fft_cmul_neon(float32x4_t a, float32x4_t w)
+{
+   float32x4x2_t parts = vtrnq_f32(w, w);
+   uint32x4_t sign     = FFT_ROTATE_SIGN_NEON(false);
+   float32x4_t swap    = vmulq_f32(vrev64q_f32(a), parts.val[1]);
 
-   fft->size = size;
+   return vaddq_f32(vmulq_f32(a, parts.val[0]), vreinterpretq_f32_u32(
+            veorq_u32(vreinterpretq_u32_f32(swap), sign)));
+}
 
-   build_bitinverse(fft->bitinverse_buffer, block_size_log2);
-   build_phase_lut(fft->phase_lut, size);
-   return fft;
+static INLINE float32x4_t fft_rotate_neon(float32x4_t a, uint32x4_t sign)
+{
+   return vreinterpretq_f32_u32(veorq_u32(
+            vreinterpretq_u32_f32(vrev64q_f32(a)), sign));
+}
 
-error:
-   fft_free(fft);
-   return NULL;
+static INLINE float32x4_t fft_load1_neon(const fft_complex_t *w)
+{
+   float32x2_t v = vld1_f32(&w->real);
+   return vcombine_f32(v, v);
 }
+#endif
 
-void fft_free(fft_t *fft)
+/* One radix-4 step of the Stockham transform, turning n / 4 groups
+ * of s values into n / 4 groups of 4 * s values. */
+static void fft_radix4(fft_complex_t *y, const fft_complex_t *x,
+      const fft_complex_t *w, unsigned n, unsigned s, bool inverse)
 {
-   if (!fft)
-      return;
+   unsigned p   = 0;
+   unsigned n1  = n >> 2;
+   const fft_complex_t *w1 = w;
+   const fft_complex_t *w2 = w + n1;
+   const fft_complex_t *w3 = w + 2 * n1;
 
-   free(fft->interleave_buffer);
-   free(fft->bitinverse_buffer);
-   free(fft->phase_lut);
-   free(fft);
+   if (s == 1)
+   {
+      /* First step, the twiddles differ between neighbouring values,
+       * and the results need to be transposed before storing. */
+#if defined(__AVX__)
+      __m256 sign = FFT_ROTATE_SIGN_AVX(inverse);
+
+      for (; p + 4 <= n1; p += 4)
+      {
+         __m256 a    = _mm256_loadu_ps(&x[p].real);
+         __m256 b    = _mm256_loadu_ps(&x[p + n1].real);
+         __m256 c    = _mm256_loadu_ps(&x[p + 2 * n1].real);
+         __m256 d    = _mm256_loadu_ps(&x[p + 3 * n1].real);
+         __m256 apc  = _mm256_add_ps(a, c);
+         __m256 amc  = _mm256_sub_ps(a, c);
+         __m256 bpd  = _mm256_add_ps(b, d);
+         __m256 jbmd = fft_rotate_avx(_mm256_sub_ps(b, d), sign);
+         __m256d y0  = _mm256_castps_pd(_mm256_add_ps(apc, bpd));
+         __m256d y1  = _mm256_castps_pd(fft_cmul_avx(_mm256_sub_ps(amc, jbmd),
+                  _mm256_loadu_ps(&w1[p].real)));
+         __m256d y2  = _mm256_castps_pd(fft_cmul_avx(_mm256_sub_ps(apc, bpd),
+                  _mm256_loadu_ps(&w2[p].real)));
+         __m256d y3  = _mm256_castps_pd(fft_cmul_avx(_mm256_add_ps(amc, jbmd),
+                  _mm256_loadu_ps(&w3[p].real)));
+         __m256d t0  = _mm256_unpacklo_pd(y0, y1);
+         __m256d t1  = _mm256_unpackhi_pd(y0, y1);
+         __m256d t2  = _mm256_unpacklo_pd(y2, y3);
+         __m256d t3  = _mm256_unpackhi_pd(y2, y3);
+
+         _mm256_storeu_pd((double*)&y[4 * p],
+               _mm256_permute2f128_pd(t0, t2, 0x20));
+         _mm256_storeu_pd((double*)&y[4 * p + 4],
+               _mm256_permute2f128_pd(t1, t3, 0x20));
+         _mm256_storeu_pd((double*)&y[4 * p + 8],
+               _mm256_permute2f128_pd(t0, t2, 0x31));
+         _mm256_storeu_pd((double*)&y[4 * p + 12],
+               _mm256_permute2f128_pd(t1, t3, 0x31));
+      }
+#elif defined(__SSE2__)
+      __m128 sign = FFT_ROTATE_SIGN_SSE(inverse);
+
+      for (; p + 2 <= n1; p += 2)
+      {
+         __m128 a    = _mm_loadu_ps(&x[p].real);
+         __m128 b    = _mm_loadu_ps(&x[p + n1].real);
+         __m128 c    = _mm_loadu_ps(&x[p + 2 * n1].real);
+         __m128 d    = _mm_loadu_ps(&x[p + 3 * n1].real);
+         __m128 apc  = _mm_add_ps(a, c);
+         __m128 amc  = _mm_sub_ps(a, c);
+         __m128 bpd  = _mm_add_ps(b, d);
+         __m128 jbmd = fft_rotate_sse(_mm_sub_ps(b, d), sign);
+         __m128 y0   = _mm_add_ps(apc, bpd);
+         __m128 y1   = fft_cmul_sse(_mm_sub_ps(amc, jbmd),
+               _mm_loadu_ps(&w1[p].real));
+         __m128 y2   = fft_cmul_sse(_mm_sub_ps(apc, bpd),
+               _mm_loadu_ps(&w2[p].real));
+         __m128 y3   = fft_cmul_sse(_mm_add_ps(amc, jbmd),
+               _mm_loadu_ps(&w3[p].real));
+
+         _mm_storeu_ps(&y[4 * p].real,     _mm_movelh_ps(y0, y1));
+         _mm_storeu_ps(&y[4 * p + 2].real, _mm_movelh_ps(y2, y3));
+         _mm_storeu_ps(&y[4 * p + 4].real, _mm_movehl_ps(y1, y0));
+         _mm_storeu_ps(&y[4 * p + 6].real, _mm_movehl_ps(y3, y2));
+      }
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+      uint32x4_t sign = FFT_ROTATE_SIGN_NEON(inverse);
+
+      for (; p + 2 <= n1; p += 2)
+      {
+         float32x4_t a    = vld1q_f32(&x[p].real);
+         float32x4_t b    = vld1q_f32(&x[p + n1].real);
+         float32x4_t c    = vld1q_f32(&x[p + 2 * n1].real);
+         float32x4_t d    = vld1q_f32(&x[p + 3 * n1].real);
+         float32x4_t apc  = vaddq_f32(a, c);
+         float32x4_t amc  = vsubq_f32(a, c);
+         float32x4_t bpd  = vaddq_f32(b, d);
+         float32x4_t jbmd = fft_rotate_neon(vsubq_f32(b, d), sign);
+         float32x4_t y0   = vaddq_f32(apc, bpd);
+         float32x4_t y1   = fft_cmul_neon(vsubq_f32(amc, jbmd),
+               vld1q_f32(&w1[p].real));
+         float32x4_t y2   = fft_cmul_neon(vsubq_f32(apc, bpd),
+               vld1q_f32(&w2[p].real));
+         float32x4_t y3   = fft_cmul_neon(vaddq_f32(amc, jbmd),
+               vld1q_f32(&w3[p].real));
+
+         vst1q_f32(&y[4 * p].real,
+               vcombine_f32(vget_low_f32(y0), vget_low_f32(y1)));
+         vst1q_f32(&y[4 * p + 2].real,
+               vcombine_f32(vget_low_f32(y2), vget_low_f32(y3)));
+         vst1q_f32(&y[4 * p + 4].real,
+               vcombine_f32(vget_high_f32(y0), vget_high_f32(y1)));
+         vst1q_f32(&y[4 * p + 6].real,
+               vcombine_f32(vget_high_f32(y2), vget_high_f32(y3)));
+      }
+#endif
+   }
+
+   for (; p < n1; p++)
+   {
+      unsigned q = 0;
+      const fft_complex_t *xp = x + s * p;
+      fft_complex_t *yp       = y + 4 * s * p;
+
+#if defined(__AVX__)
+      __m256 sign = FFT_ROTATE_SIGN_AVX(inverse);
+      __m256 v1   = fft_load1_avx(&w1[p]);
+      __m256 v2   = fft_load1_avx(&w2[p]);
+      __m256 v3   = fft_load1_avx(&w3[p]);
+
+      for (; q + 4 <= s; q += 4)
+      {
+         __m256 a    = _mm256_loadu_ps(&xp[q].real);
+         __m256 b    = _mm256_loadu_ps(&xp[q + s * n1].real);
+         __m256 c    = _mm256_loadu_ps(&xp[q + 2 * s * n1].real);
+         __m256 d    = _mm256_loadu_ps(&xp[q + 3 * s * n1].real);
+         __m256 apc  = _mm256_add_ps(a, c);
+         __m256 amc  = _mm256_sub_ps(a, c);
+         __m256 bpd  = _mm256_add_ps(b, d);
+         __m256 jbmd = fft_rotate_avx(_mm256_sub_ps(b, d), sign);
+
+         _mm256_storeu_ps(&yp[q].real, _mm256_add_ps(apc, bpd));
+         _mm256_storeu_ps(&yp[q + s].real,
+               fft_cmul_avx(_mm256_sub_ps(amc, jbmd), v1));
+         _mm256_storeu_ps(&yp[q + 2 * s].real,
+               fft_cmul_avx(_mm256_sub_ps(apc, bpd), v2));
+         _mm256_storeu_ps(&yp[q + 3 * s].real,
+               fft_cmul_avx(_mm256_add_ps(amc, jbmd), v3));
+      }
+#elif defined(__SSE2__)
+      __m128 sign = FFT_ROTATE_SIGN_SSE(inverse);
+      __m128 v1   = fft_load1_sse(&w1[p]);
+      __m128 v2   = fft_load1_sse(&w2[p]);
+      __m128 v3   = fft_load1_sse(&w3[p]);
+
+      for (; q + 2 <= s; q += 2)
+      {
+         __m128 a    = _mm_loadu_ps(&xp[q].real);
+         __m128 b    = _mm_loadu_ps(&xp[q + s * n1].real);
+         __m128 c    = _mm_loadu_ps(&xp[q + 2 * s * n1].real);
+         __m128 d    = _mm_loadu_ps(&xp[q + 3 * s * n1].real);
+         __m128 apc  = _mm_add_ps(a, c);
+         __m128 amc  = _mm_sub_ps(a, c);
+         __m128 bpd  = _mm_add_ps(b, d);
+         __m128 jbmd = fft_rotate_sse(_mm_sub_ps(b, d), sign);
+
+         _mm_storeu_ps(&yp[q].real, _mm_add_ps(apc, bpd));
+         _mm_storeu_ps(&yp[q + s].real,
+               fft_cmul_sse(_mm_sub_ps(amc, jbmd), v1));
+         _mm_storeu_ps(&yp[q + 2 * s].real,
+               fft_cmul_sse(_mm_sub_ps(apc, bpd), v2));
+         _mm_storeu_ps(&yp[q + 3 * s].real,
+               fft_cmul_sse(_mm_add_ps(amc, jbmd), v3));
+      }
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+      uint32x4_t sign = FFT_ROTATE_SIGN_NEON(inverse);
+      float32x4_t v1  = fft_load1_neon(&w1[p]);
+      float32x4_t v2  = fft_load1_neon(&w2[p]);
+      float32x4_t v3  = fft_load1_neon(&w3[p]);
+
+      for (; q + 2 <= s; q += 2)
+      {
+         float32x4_t a    = vld1q_f32(&xp[q].real);
+         float32x4_t b    = vld1q_f32(&xp[q + s * n1].real);
+         float32x4_t c    = vld1q_f32(&xp[q + 2 * s * n1].real);
+         float32x4_t d    = vld1q_f32(&xp[q + 3 * s * n1].real);
+         float32x4_t apc  = vaddq_f32(a, c);
+         float32x4_t amc  = vsubq_f32(a, c);
+         float32x4_t bpd  = vaddq_f32(b, d);
+         float32x4_t jbmd = fft_rotate_neon(vsubq_f32(b, d), sign);
+
+         vst1q_f32(&yp[q].real, vaddq_f32(apc, bpd));
+         vst1q_f32(&yp[q + s].real,
+               fft_cmul_neon(vsubq_f32(amc, jbmd), v1));
+         vst1q_f32(&yp[q + 2 * s].real,
+               fft_cmul_neon(vsubq_f32(apc, bpd), v2));
+         vst1q_f32(&yp[q + 3 * s].real,
+               fft_cmul_neon(vaddq_f32(amc, jbmd), v3));
+      }
+#endif
+
+      for (; q < s; q++)
+      {
+         fft_complex_t a    = xp[q];
+         fft_complex_t b    = xp[q + s * n1];
+         fft_complex_t c    = xp[q + 2 * s * n1];
+         fft_complex_t d    = xp[q + 3 * s * n1];
+         fft_complex_t apc  = fft_complex_add(a, c);
+         fft_complex_t amc  = fft_complex_sub(a, c);
+         fft_complex_t bpd  = fft_complex_add(b, d);
+         fft_complex_t jbmd = fft_rotate(fft_complex_sub(b, d), inverse);
+
+         yp[q]         = fft_complex_add(apc, bpd);
+         yp[q + s]     = fft_complex_mul(fft_complex_sub(amc, jbmd), w1[p]);
+         yp[q + 2 * s] = fft_complex_mul(fft_complex_sub(apc, bpd), w2[p]);
+         yp[q + 3 * s] = fft_complex_mul(fft_complex_add(amc, jbmd), w3[p]);
+      }
+   }
 }
 
-static void butterfly(fft_complex_t *a, fft_complex_t *b, fft_complex_t mod)
+/* Last radix-4 step, where all twiddles are 1. Also applies the
+ * gain of the transform. */
+static void fft_radix4_last(fft_complex_t *y, const fft_complex_t *x,
+      unsigned s, bool inverse, float gain)
 {
-   mod = fft_complex_mul(mod, *b);
-   *b  = fft_complex_sub(*a, mod);
-   *a  = fft_complex_add(*a, mod);
+   unsigned q = 0;
+
+#if defined(__AVX__)
+   __m256 g    = _mm256_set1_ps(gain);
+   __m256 sign = FFT_ROTATE_SIGN_AVX(inverse);
+
+   for (; q + 4 <= s; q += 4)
+   {
+      __m256 a    = _mm256_loadu_ps(&x[q].real);
+      __m256 b    = _mm256_loadu_ps(&x[q + s].real);
+      __m256 c    = _mm256_loadu_ps(&x[q + 2 * s].real);
+      __m256 d    = _mm256_loadu_ps(&x[q + 3 * s].real);
+      __m256 apc  = _mm256_mul_ps(_mm256_add_ps(a, c), g);
+      __m256 amc  = _mm256_mul_ps(_mm256_sub_ps(a, c), g);
+      __m256 bpd  = _mm256_mul_ps(_mm256_add_ps(b, d), g);
+      __m256 jbmd = _mm256_mul_ps(fft_rotate_avx(_mm256_sub_ps(b, d), sign), g);
+
+      _mm256_storeu_ps(&y[q].real,         _mm256_add_ps(apc, bpd));
+      _mm256_storeu_ps(&y[q + s].real,     _mm256_sub_ps(amc, jbmd));
+      _mm256_storeu_ps(&y[q + 2 * s].real, _mm256_sub_ps(apc, bpd));
+      _mm256_storeu_ps(&y[q + 3 * s].real, _mm256_add_ps(amc, jbmd));
+   }
+#elif defined(__SSE2__)
+   __m128 g    = _mm_set1_ps(gain);
+   __m128 sign = FFT_ROTATE_SIGN_SSE(inverse);
+
+   for (; q + 2 <= s; q += 2)
+   {
+      __m128 a    = _mm_loadu_ps(&x[q].real);
+      __m128 b    = _mm_loadu_ps(&x[q + s].real);
+      __m128 c    = _mm_loadu_ps(&x[q + 2 * s].real);
+      __m128 d    = _mm_loadu_ps(&x[q + 3 * s].real);
+      __m128 apc  = _mm_mul_ps(_mm_add_ps(a, c), g);
+      __m128 amc  = _mm_mul_ps(_mm_sub_ps(a, c), g);
+      __m128 bpd  = _mm_mul_ps(_mm_add_ps(b, d), g);
+      __m128 jbmd = _mm_mul_ps(fft_rotate_sse(_mm_sub_ps(b, d), sign), g);
+
+      _mm_storeu_ps(&y[q].real,         _mm_add_ps(apc, bpd));
+      _mm_storeu_ps(&y[q + s].real,     _mm_sub_ps(amc, jbmd));
+      _mm_storeu_ps(&y[q + 2 * s].real, _mm_sub_ps(apc, bpd));
+      _mm_storeu_ps(&y[q + 3 * s].real, _mm_add_ps(amc, jbmd));
+   }
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+   uint32x4_t sign = FFT_ROTATE_SIGN_NEON(inverse);
+
+   for (; q + 2 <= s; q += 2)
+   {
+      float32x4_t a    = vld1q_f32(&x[q].real);
+      float32x4_t b    = vld1q_f32(&x[q + s].real);
+      float32x4_t c    = vld1q_f32(&x[q + 2 * s].real);
+      float32x4_t d    = vld1q_f32(&x[q + 3 * s].real);
+      float32x4_t apc  = vmulq_n_f32(vaddq_f32(a, c), gain);
+      float32x4_t amc  = vmulq_n_f32(vsubq_f32(a, c), gain);
+      float32x4_t bpd  = vmulq_n_f32(vaddq_f32(b, d), gain);
+      float32x4_t jbmd = vmulq_n_f32(
+            fft_rotate_neon(vsubq_f32(b, d), sign), gain);
+
+      vst1q_f32(&y[q].real,         vaddq_f32(apc, bpd));
+      vst1q_f32(&y[q + s].real,     vsubq_f32(amc, jbmd));
+      vst1q_f32(&y[q + 2 * s].real, vsubq_f32(apc, bpd));
+      vst1q_f32(&y[q + 3 * s].real, vaddq_f32(amc, jbmd));
+   }
+#endif
+
+   for (; q < s; q++)
+   {
+      fft_complex_t apc  = fft_scale(fft_complex_add(x[q], x[q + 2 * s]), gain);
+      fft_complex_t amc  = fft_scale(fft_complex_sub(x[q], x[q + 2 * s]), gain);
+      fft_complex_t bpd  = fft_scale(fft_complex_add(x[q + s], x[q + 3 * s]), gain);
+      fft_complex_t jbmd = fft_scale(fft_rotate(
+               fft_complex_sub(x[q + s], x[q + 3 * s]), inverse), gain);
+
+      y[q]         = fft_complex_add(apc, bpd);
+      y[q + s]     = fft_complex_sub(amc, jbmd);
+      y[q + 2 * s] = fft_complex_sub(apc, bpd);
+      y[q + 3 * s] = fft_complex_add(amc, jbmd);
+   }
 }
 
-static void butterflies(fft_complex_t *butterfly_buf,
-      const fft_complex_t *phase_lut,
-      int phase_dir, unsigned step_size, unsigned samples)
+/* Last step for odd powers of two. */
+static void fft_radix2_last(fft_complex_t *y, const fft_complex_t *x,
+      unsigned s, float gain)
 {
-   unsigned i, j;
-   for (i = 0; i < samples; i += step_size << 1)
+   unsigned q = 0;
+
+#if defined(__AVX__)
+   __m256 g = _mm256_set1_ps(gain);
+
+   for (; q + 4 <= s; q += 4)
    {
-      int phase_step = (int)samples * phase_dir / (int)step_size;
-      for (j = i; j < i + step_size; j++)
-         butterfly(&butterfly_buf[j], &butterfly_buf[j + step_size],
-               phase_lut[phase_step * (int)(j - i)]);
+      __m256 a = _mm256_mul_ps(_mm256_loadu_ps(&x[q].real), g);
+      __m256 b = _mm256_mul_ps(_mm256_loadu_ps(&x[q + s].real), g);
+
+      _mm256_storeu_ps(&y[q].real,     _mm256_add_ps(a, b));
+      _mm256_storeu_ps(&y[q + s].real, _mm256_sub_ps(a, b));
+   }
+#elif defined(__SSE2__)
+   __m128 g = _mm_set1_ps(gain);
+
+   for (; q + 2 <= s; q += 2)
+   {
+      __m128 a = _mm_mul_ps(_mm_loadu_ps(&x[q].real), g);
+      __m128 b = _mm_mul_ps(_mm_loadu_ps(&x[q + s].real), g);
+
+      _mm_storeu_ps(&y[q].real,     _mm_add_ps(a, b));
+      _mm_storeu_ps(&y[q + s].real, _mm_sub_ps(a, b));
+   }
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+   for (; q + 2 <= s; q += 2)
+   {
+      float32x4_t a = vmulq_n_f32(vld1q_f32(&x[q].real), gain);
+      float32x4_t b = vmulq_n_f32(vld1q_f32(&x[q + s].real), gain);
+
+      vst1q_f32(&y[q].real,     vaddq_f32(a, b));
+      vst1q_f32(&y[q + s].real, vsubq_f32(a, b));
+   }
+#endif
+
+   for (; q < s; q++)
+   {
+      fft_complex_t a = fft_scale(x[q], gain);
+      fft_complex_t b = fft_scale(x[q + s], gain);
+
+      y[q]     = fft_complex_add(a, b);
+      y[q + s] = fft_complex_sub(a, b);
    }
 }
 
+/* Buffer the first step writes to, chosen so that the last one
+ * writes to @out. */
+static fft_complex_t *fft_first_output(fft_t *fft, fft_complex_t *out)
+{
+   return (fft->stages & 1) ? out : fft->buffer;
+}
+
+/* Runs all steps on @in. @in may only be the buffer returned by
+ * fft_first_output() if there are no steps at all. */
+static void fft_run(fft_t *fft, fft_complex_t *out,
+      const fft_complex_t *in, bool inverse, float gain)
+{
+   unsigned s                 = 1;
+   unsigned n                 = fft->size;
+   const fft_complex_t *w     = inverse ? fft->twiddles_inverse : fft->twiddles;
+   fft_complex_t *dst         = fft_first_output(fft, out);
+
+   for (; n > 4; n >>= 2, s <<= 2)
+   {
+      fft_radix4(dst, in, w, n, s, inverse);
+      w  += 3 * (n >> 2);
+      in  = dst;
+      dst = (dst == out) ? fft->buffer : out;
+   }
+
+   if (n == 4)
+      fft_radix4_last(dst, in, s, inverse, gain);
+   else if (n == 2)
+      fft_radix2_last(dst, in, s, gain);
+   else if (out != in)
+      *out = fft_scale(*in, gain);
+}
+
+/* Where strided or real input is gathered to before a transform. */
+static fft_complex_t *fft_gather_buffer(fft_t *fft, fft_complex_t *out)
+{
+   if (!fft->stages)
+      return out;
+   return (fft_first_output(fft, out) == out) ? fft->buffer : out;
+}
+
 void fft_process_forward_complex(fft_t *fft,
       fft_complex_t *out, const fft_complex_t *in, unsigned step)
 {
-   unsigned step_size;
-   unsigned samples = fft->size;
-   interleave_complex(fft->bitinverse_buffer, out, in, samples, step);
-
-   for (step_size = 1; step_size < samples; step_size <<= 1)
+   if (step != 1)
    {
-      butterflies(out,
-            fft->phase_lut + samples,
-            -1, step_size, samples);
+      unsigned i;
+      fft_complex_t *buf = fft_gather_buffer(fft, out);
+
+      for (i = 0; i < fft->size; i++, in += step)
+         buf[i] = *in;
+      in = buf;
    }
+
+   fft_run(fft, out, in, false, 1.0f);
 }
 
 void fft_process_forward(fft_t *fft,
       fft_complex_t *out, const float *in, unsigned step)
 {
-   unsigned step_size;
-   unsigned samples = fft->size;
-   interleave_float(fft->bitinverse_buffer, out, in, samples, step);
+   unsigned i;
+   fft_complex_t *buf = fft_gather_buffer(fft, out);
 
-   for (step_size = 1; step_size < fft->size; step_size <<= 1)
+   for (i = 0; i < fft->size; i++, in += step)
    {
-      butterflies(out,
-            fft->phase_lut + samples,
-            -1, step_size, samples);
+      buf[i].real = *in;
+      buf[i].imag = 0.0f;
    }
+
+   fft_run(fft, out, buf, false, 1.0f);
+}
+
+void fft_process_inverse_complex(fft_t *fft,
+      fft_complex_t *out, const fft_complex_t *in)
+{
+   fft_run(fft, out, in, true, 1.0f / fft->size);
 }
 
 void fft_process_inverse(fft_t *fft,
       float *out, const fft_complex_t *in, unsigned step)
 {
-   unsigned step_size;
-   unsigned samples = fft->size;
-
-   interleave_complex(fft->bitinverse_buffer, fft->interleave_buffer,
-         in, samples, 1);
+   unsigned i;
+   fft_complex_t *buf = fft->buffer + fft->size;
 
-   for (step_size = 1; step_size < samples; step_size <<= 1)
-   {
-      butterflies(fft->interleave_buffer,
-            fft->phase_lut + samples,
-            1, step_size, samples);
-   }
+   fft_run(fft, buf, in, true, 1.0f / fft->size);
 
-   resolve_float(out, fft->interleave_buffer, samples, 1.0f / samples, step);
+   for (i = 0; i < fft->size; i++, out += step)
+      *out = buf[i].real;
 }
-
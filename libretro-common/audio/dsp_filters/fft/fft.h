@@ -28,10 +28,20 @@
 
 typedef struct fft fft_t;
 
+/**
+ * fft_new:
+ * @block_size_log2    : Transform size, as a power of two.
+ *
+ * Returns: new FFT plan, or NULL on failure.
+ **/
 fft_t *fft_new(unsigned block_size_log2);
 
 void fft_free(fft_t *fft);
 
+/* The forward transforms aren't scaled, the inverse ones divide by
+ * the transform size. @step is the distance between the strided
+ * values, in elements. @in and @out must not overlap. */
+
 void fft_process_forward_complex(fft_t *fft,
       fft_complex_t *out, const fft_complex_t *in, unsigned step);
 
@@ -41,6 +51,20 @@ void fft_process_forward(fft_t *fft,
 void fft_process_inverse(fft_t *fft,
       float *out, const fft_complex_t *in, unsigned step);
 
+/**
+ * fft_process_inverse_complex:
+ * @fft                : FFT plan.
+ * @out                : Output samples.
+ * @in                 : Spectrum.
+ *
+ * Inverse transform which keeps the imaginary part of the output.
+ * Two real signals can be transformed at once by putting the second
+ * one in the imaginary part: after a forward transform, multiplying
+ * by the spectrum of a real filter and an inverse transform, the
+ * real and imaginary parts hold both filtered signals.
+ **/
+void fft_process_inverse_complex(fft_t *fft,
+      fft_complex_t *out, const fft_complex_t *in);
 
 #endif
 
@@ -0,0 +1,687 @@
+/* Copyright  (C) 2010-2017 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (loudnorm.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <retro_inline.h>
+#include <retro_miscellaneous.h>
+#include <libretro_dspfilter.h>
+
+#include "biquad/biquad.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+#include <arm_neon.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Loudness normalisation as measured by EBU R128 / ITU-R BS.1770.
+ *
+ * A K-weighted copy of the input is cut into 400 ms blocks, 100 ms
+ * apart, and the loudness of each goes into a histogram. The gated
+ * integrated loudness is worked out from the histogram, so memory
+ * and time don't grow with the length of what is played. The gain
+ * then heads for the target at a limited rate, ramped sample by
+ * sample.
+ *
+ * A lookahead limiter keeps the result under a true-peak ceiling.
+ * Peaks are estimated from the samples and three interpolated points
+ * between each pair of them, and the largest one in the lookahead
+ * window is kept in a monotonic deque. Every frame costs the same,
+ * give or take the deque, which takes at most one push and one pop
+ * per frame on average. */
+
+/* Work is done in blocks of at most this many frames. */
+#define LOUDNORM_BLOCK_FRAMES 256
+
+/* True-peak interpolator: four phases, the first one being the
+ * samples themselves, of twelve taps each. */
+#define LOUDNORM_PHASES 4
+#define LOUDNORM_TAPS   12
+#define LOUDNORM_PEAK_DELAY (LOUDNORM_TAPS / 2)
+
+/* Block loudness histogram, 0.1 LU steps from the absolute gate up. */
+#define LOUDNORM_BINS          1000
+#define LOUDNORM_BIN_MIN       -70.0
+#define LOUDNORM_BIN_WIDTH     0.1
+#define LOUDNORM_RELATIVE_GATE -10.0
+
+/* Gated blocks needed before the measurement is trusted. */
+#define LOUDNORM_MIN_BLOCKS 30
+
+struct loudnorm_data
+{
+   /* Measurement. */
+   struct biquad_cascade kweight;
+   float weighted[2 * LOUDNORM_BLOCK_FRAMES];
+   unsigned step_frames;
+   unsigned step_pos;
+   double step_sum;
+   double steps[4];
+   unsigned num_steps;
+   unsigned histogram[LOUDNORM_BINS];
+   double bin_energy[LOUDNORM_BINS];
+   unsigned blocks;
+
+   /* Loudness gain. */
+   float target;
+   float max_gain;
+   float gain_rate;
+   float gain_db;
+   float desired_db;
+   float gain;
+
+   /* True-peak estimation, each tap repeated for a whole vector. */
+   float taps[LOUDNORM_PHASES - 1][LOUDNORM_TAPS][4];
+   float history[2][LOUDNORM_TAPS - 1 + LOUDNORM_BLOCK_FRAMES];
+   float peaks[LOUDNORM_BLOCK_FRAMES];
+
+   /* Limiter. */
+   float *delay;
+   unsigned delay_frames;
+   unsigned delay_pos;
+   float *deque_peak;
+   unsigned *deque_frame;
+   unsigned window;
+   unsigned deque_head;
+   unsigned deque_count;
+   unsigned frame;
+   float ceiling;
+   float attack;
+   float release;
+   float limit;
+
+   /* Where the state of each content is kept, and the file of the
+    * content playing, if any. */
+   char *state_dir;
+   char *state_path;
+};
+
+static double loudnorm_lufs(double energy)
+{
+   return -0.691 + 10.0 * log10(energy);
+}
+
+static unsigned loudnorm_bin(double lufs)
+{
+   double bin = (lufs - LOUDNORM_BIN_MIN) / LOUDNORM_BIN_WIDTH;
+
+   if (bin < 0.0)
+      return 0;
+   if (bin >= LOUDNORM_BINS - 1)
+      return LOUDNORM_BINS - 1;
+   return (unsigned)bin;
+}
+
+/* Works out the gated integrated loudness from the histogram, and
+ * the gain that takes it to the target. */
+static void loudnorm_update_gain(struct loudnorm_data *ln)
+{
+   unsigned i;
+   unsigned count = 0;
+   double sum     = 0.0;
+   double lufs;
+
+   if (ln->blocks < LOUDNORM_MIN_BLOCKS)
+      return;
+
+   /* Everything in the histogram has passed the absolute gate. */
+   for (i = 0; i < LOUDNORM_BINS; i++)
+      sum += ln->histogram[i] * ln->bin_energy[i];
+
+   i   = loudnorm_bin(loudnorm_lufs(sum / ln->blocks)
+         + LOUDNORM_RELATIVE_GATE);
+   sum = 0.0;
+
+   for (; i < LOUDNORM_BINS; i++)
+   {
+      sum   += ln->histogram[i] * ln->bin_energy[i];
+      count += ln->histogram[i];
+   }
+
+   if (!count)
+      return;
+
+   lufs           = loudnorm_lufs(sum / count);
+   ln->desired_db = (float)MIN(ln->target - lufs, ln->max_gain);
+}
+
+/* Takes the mean square of a 100 ms step, and the 400 ms block
+ * ending with it to the histogram. */
+static void loudnorm_end_step(struct loudnorm_data *ln)
+{
+   double energy;
+
+   ln->steps[ln->num_steps++ & 3] = ln->step_sum / ln->step_frames;
+   ln->step_sum                   = 0.0;
+   ln->step_pos                   = 0;
+
+   if (ln->num_steps < 4)
+      return;
+
+   energy = 0.25 * (ln->steps[0] + ln->steps[1]
+         + ln->steps[2] + ln->steps[3]);
+
+   if (energy <= 0.0 || loudnorm_lufs(energy) < LOUDNORM_BIN_MIN)
+      return;
+
+   ln->histogram[loudnorm_bin(loudnorm_lufs(energy))]++;
+   ln->blocks++;
+
+   loudnorm_update_gain(ln);
+}
+
+static void loudnorm_measure(struct loudnorm_data *ln,
+      const float *samples, unsigned frames)
+{
+   unsigned i;
+   float sum = 0.0f;
+
+   memcpy(ln->weighted, samples, frames * 2 * sizeof(float));
+   biquad_cascade_process(&ln->kweight, ln->weighted, frames);
+
+   for (i = 0; i < frames * 2; i++)
+      sum += ln->weighted[i] * ln->weighted[i];
+
+   ln->step_sum += sum;
+   ln->step_pos += frames;
+
+   if (ln->step_pos == ln->step_frames)
+      loudnorm_end_step(ln);
+}
+
+/* Largest absolute value per frame, among both channels' samples and
+ * the points interpolated between them, into ln->peaks. */
+static void loudnorm_find_peaks(struct loudnorm_data *ln,
+      const float *samples, unsigned frames)
+{
+   unsigned i = 0;
+   unsigned c, p, k;
+   float *left  = ln->history[0];
+   float *right = ln->history[1];
+
+   for (c = 0; c < frames; c++)
+   {
+      left[LOUDNORM_TAPS - 1 + c]  = samples[2 * c + 0];
+      right[LOUDNORM_TAPS - 1 + c] = samples[2 * c + 1];
+   }
+
+#if defined(__SSE2__)
+   {
+      __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+      for (; i + 4 <= frames; i += 4)
+      {
+         __m128 peak = _mm_setzero_ps();
+
+         for (c = 0; c < 2; c++)
+         {
+            const float *h = ln->history[c] + i;
+
+            peak = _mm_max_ps(peak, _mm_and_ps(abs_mask,
+                     _mm_loadu_ps(h + LOUDNORM_PEAK_DELAY)));
+
+            for (p = 0; p < LOUDNORM_PHASES - 1; p++)
+            {
+               __m128 sum = _mm_setzero_ps();
+
+               for (k = 0; k < LOUDNORM_TAPS; k++)
+                  sum = _mm_add_ps(sum, _mm_mul_ps(
+                           _mm_loadu_ps(ln->taps[p][k]),
+                           _mm_loadu_ps(h + k)));
+
+               peak = _mm_max_ps(peak, _mm_and_ps(abs_mask, sum));
+            }
+         }
+
+         _mm_storeu_ps(ln->peaks + i, peak);
+      }
+   }
+#elif defined(__ARM_NEON__) && !defined(DONT_WANT_ARM_OPTIMIZATIONS)
+   for (; i + 4 <= frames; i += 4)
+   {
+      float32x4_t peak = vdupq_n_f32(0.0f);
+
+      for (c = 0; c < 2; c++)
+      {
+         const float *h = ln->history[c] + i;
+
+         peak = vmaxq_f32(peak, vabsq_f32(vld1q_f32(h + LOUDNORM_PEAK_DELAY)));
+
+         for (p = 0; p < LOUDNORM_PHASES - 1; p++)
+         {
+            float32x4_t sum = vdupq_n_f32(0.0f);
+
+            for (k = 0; k < LOUDNORM_TAPS; k++)
+               sum = vmlaq_f32(sum, vld1q_f32(ln->taps[p][k]),
+                     vld1q_f32(h + k));
+
+            peak = vmaxq_f32(peak, vabsq_f32(sum));
+         }
+      }
+
+      vst1q_f32(ln->peaks + i, peak);
+   }
+#endif
+
+   for (; i < frames; i++)
+   {
+      float peak = 0.0f;
+
+      for (c = 0; c < 2; c++)
+      {
+         const float *h = ln->history[c] + i;
+
+         peak = MAX(peak, fabsf(h[LOUDNORM_PEAK_DELAY]));
+
+         for (p = 0; p < LOUDNORM_PHASES - 1; p++)
+         {
+            float sum = 0.0f;
+
+            for (k = 0; k < LOUDNORM_TAPS; k++)
+               sum += ln->taps[p][k][0] * h[k];
+
+            peak = MAX(peak, fabsf(sum));
+         }
+      }
+
+      ln->peaks[i] = peak;
+   }
+
+   memmove(left, left + frames, (LOUDNORM_TAPS - 1) * sizeof(*left));
+   memmove(right, right + frames, (LOUDNORM_TAPS - 1) * sizeof(*right));
+}
+
+/* Applies both gains to the delayed signal, ramping the loudness
+ * gain from @gain to @next_gain over the block. */
+static void loudnorm_apply(struct loudnorm_data *ln, float *samples,
+      unsigned frames, float gain, float next_gain)
+{
+   unsigned i;
+   float gain_step = (next_gain - gain) / frames;
+   float *peaks    = ln->deque_peak;
+   unsigned *when  = ln->deque_frame;
+
+   for (i = 0; i < frames; i++, samples += 2)
+   {
+      float left, right, target, loudest;
+      float *delayed = ln->delay + 2 * ln->delay_pos;
+      unsigned back;
+
+      /* Drop the peak leaving the window first, so that the deque
+       * never holds more than the window. */
+      if (ln->deque_count
+            && ln->frame - when[ln->deque_head] >= ln->window)
+      {
+         ln->deque_head = (ln->deque_head + 1) % ln->window;
+         ln->deque_count--;
+      }
+
+      /* Then the peaks which the new one hides for as long as they
+       * would stay in the window. */
+      back = ln->deque_head + ln->deque_count;
+      while (ln->deque_count
+            && peaks[(back - 1) % ln->window] <= ln->peaks[i])
+      {
+         ln->deque_count--;
+         back--;
+      }
+
+      peaks[back % ln->window] = ln->peaks[i];
+      when[back % ln->window]  = ln->frame;
+      ln->deque_count++;
+
+      ln->frame++;
+
+      loudest = peaks[ln->deque_head] * gain;
+      target  = loudest > ln->ceiling ? ln->ceiling / loudest : 1.0f;
+
+      ln->limit += (target < ln->limit ? ln->attack : ln->release)
+         * (target - ln->limit);
+
+      left       = delayed[0];
+      right      = delayed[1];
+      delayed[0] = samples[0];
+      delayed[1] = samples[1];
+
+      if (++ln->delay_pos == ln->delay_frames)
+         ln->delay_pos = 0;
+
+      samples[0] = left * gain * ln->limit;
+      samples[1] = right * gain * ln->limit;
+
+      gain      += gain_step;
+   }
+}
+
+static void loudnorm_process(void *data, struct dspfilter_output *output,
+      const struct dspfilter_input *input)
+{
+   struct loudnorm_data *ln = (struct loudnorm_data*)data;
+   float *samples           = input->samples;
+   unsigned frames          = input->frames;
+
+   output->samples          = input->samples;
+   output->frames           = input->frames;
+
+   while (frames)
+   {
+      float gain;
+      unsigned block = MIN(frames, LOUDNORM_BLOCK_FRAMES);
+
+      /* Don't run past the end of a measurement step. */
+      block = MIN(block, ln->step_frames - ln->step_pos);
+
+      loudnorm_measure(ln, samples, block);
+      loudnorm_find_peaks(ln, samples, block);
+
+      gain = ln->gain;
+
+      if (ln->gain_db < ln->desired_db)
+         ln->gain_db = MIN(ln->gain_db + ln->gain_rate * block, ln->desired_db);
+      else
+         ln->gain_db = MAX(ln->gain_db - ln->gain_rate * block, ln->desired_db);
+
+      ln->gain = (float)pow(10.0, ln->gain_db / 20.0);
+
+      loudnorm_apply(ln, samples, block, gain, ln->gain);
+
+      samples += block * 2;
+      frames  -= block;
+   }
+}
+
+/* A state file holds the gain reached and the histogram, so that
+ * playing the same thing again starts out at the right level. */
+static void loudnorm_load_state(struct loudnorm_data *ln)
+{
+   char line[64];
+   FILE *file = fopen(ln->state_path, "r");
+
+   if (!file)
+      return;
+
+   while (fgets(line, sizeof(line), file))
+   {
+      float gain;
+      unsigned bin, count;
+
+      if (sscanf(line, "gain %f", &gain) == 1)
+         ln->gain_db = gain;
+      else if (sscanf(line, "bin %u %u", &bin, &count) == 2
+            && bin < LOUDNORM_BINS)
+      {
+         ln->histogram[bin] += count;
+         ln->blocks         += count;
+      }
+   }
+
+   fclose(file);
+
+   ln->desired_db = ln->gain_db;
+   ln->gain       = (float)pow(10.0, ln->gain_db / 20.0);
+   loudnorm_update_gain(ln);
+}
+
+static void loudnorm_save_state(struct loudnorm_data *ln)
+{
+   unsigned i;
+   FILE *file = fopen(ln->state_path, "w");
+
+   if (!file)
+      return;
+
+   fprintf(file, "gain %.3f\n", ln->gain_db);
+
+   for (i = 0; i < LOUDNORM_BINS; i++)
+   {
+      if (ln->histogram[i])
+         fprintf(file, "bin %u %u\n", i, ln->histogram[i]);
+   }
+
+   fclose(file);
+}
+
+/* Forgets the measurement, when switching to other content. */
+static void loudnorm_reset(struct loudnorm_data *ln)
+{
+   memset(ln->steps, 0, sizeof(ln->steps));
+   memset(ln->histogram, 0, sizeof(ln->histogram));
+   ln->step_pos   = 0;
+   ln->step_sum   = 0.0;
+   ln->num_steps  = 0;
+   ln->blocks     = 0;
+   ln->gain_db    = 0.0f;
+   ln->desired_db = 0.0f;
+   ln->gain       = 1.0f;
+}
+
+/* The state of each content goes in its own file in the state
+ * directory, named after a hash of the content's key. */
+static int loudnorm_set_string(void *data, const char *key,
+      const char *value)
+{
+   char path[PATH_MAX_LENGTH];
+   uint64_t hash            = 0xcbf29ce484222325ULL; /* FNV-1a */
+   struct loudnorm_data *ln = (struct loudnorm_data*)data;
+
+   if (strcmp(key, "content"))
+      return 0;
+
+   if (!ln->state_dir)
+      return 1;
+
+   if (ln->state_path)
+      loudnorm_save_state(ln);
+   free(ln->state_path);
+   ln->state_path = NULL;
+
+   loudnorm_reset(ln);
+
+   if (!value || !*value)
+      return 1;
+
+   for (; *value; value++)
+      hash = (hash ^ (uint8_t)*value) * 0x100000001b3ULL;
+
+   snprintf(path, sizeof(path), "%s/%08x%08x.loudnorm", ln->state_dir,
+         (unsigned)(hash >> 32), (unsigned)hash);
+
+   ln->state_path = strdup(path);
+   if (ln->state_path)
+      loudnorm_load_state(ln);
+   return 1;
+}
+
+static void loudnorm_free(void *data)
+{
+   struct loudnorm_data *ln = (struct loudnorm_data*)data;
+
+   if (!ln)
+      return;
+
+   if (ln->state_path)
+      loudnorm_save_state(ln);
+
+   free(ln->state_dir);
+   free(ln->state_path);
+   free(ln->delay);
+   free(ln->deque_peak);
+   free(ln->deque_frame);
+   free(ln);
+}
+
+static void loudnorm_query(void *data, struct dspfilter_properties *props)
+{
+   struct loudnorm_data *ln = (struct loudnorm_data*)data;
+   props->latency           = ln->delay_frames;
+}
+
+/* K-weighting, a high shelf for the head followed by a high-pass,
+ * as in BS.1770 but designed for any sample rate. */
+static void loudnorm_init_kweight(struct loudnorm_data *ln, double rate)
+{
+   struct biquad_coefs coefs;
+   double k  = tan(M_PI * 1681.974450955533 / rate);
+   double q  = 0.7071752369554196;
+   double vh = pow(10.0, 3.999843853973347 / 20.0);
+   double vb = pow(vh, 0.4996667741545416);
+
+   biquad_cascade_init(&ln->kweight, 2, 0);
+
+   biquad_coefs_normalize(&coefs,
+         vh + vb * k / q + k * k, 2.0 * (k * k - vh), vh - vb * k / q + k * k,
+         1.0 + k / q + k * k, 2.0 * (k * k - 1.0), 1.0 - k / q + k * k);
+   biquad_cascade_set(&ln->kweight, 0, &coefs);
+
+   k = tan(M_PI * 38.13547087602444 / rate);
+   q = 0.5003270373238773;
+
+   biquad_coefs_normalize(&coefs, 1.0, -2.0, 1.0,
+         1.0 + k / q + k * k, 2.0 * (k * k - 1.0), 1.0 - k / q + k * k);
+   biquad_cascade_set(&ln->kweight, 1, &coefs);
+}
+
+/* Windowed sinc interpolation at a quarter, half and three quarters
+ * of the way between the middle two taps. */
+static void loudnorm_init_taps(struct loudnorm_data *ln)
+{
+   unsigned p, k, c;
+
+   for (p = 1; p < LOUDNORM_PHASES; p++)
+   {
+      double h[LOUDNORM_TAPS];
+      double sum = 0.0;
+
+      for (k = 0; k < LOUDNORM_TAPS; k++)
+      {
+         double x = k - (LOUDNORM_PEAK_DELAY - 1) - (double)p / LOUDNORM_PHASES;
+         double w = 0.5 + 0.5 * cos(M_PI * x / LOUDNORM_PEAK_DELAY);
+
+         h[k]     = w * sin(M_PI * x) / (M_PI * x);
+         sum     += h[k];
+      }
+
+      for (k = 0; k < LOUDNORM_TAPS; k++)
+         for (c = 0; c < 4; c++)
+            ln->taps[p - 1][k][c] = (float)(h[k] / sum);
+   }
+}
+
+static void *loudnorm_init(const struct dspfilter_info *info,
+      const struct dspfilter_config *config, void *userdata)
+{
+   unsigned i;
+   float target, max_gain, gain_rate, ceiling, lookahead, release;
+   char *state_dir          = NULL;
+   struct loudnorm_data *ln = (struct loudnorm_data*)
+      calloc(1, sizeof(*ln));
+   if (!ln)
+      return NULL;
+
+   config->get_float(userdata, "target", &target, -18.0f);
+   config->get_float(userdata, "max_gain", &max_gain, 12.0f);
+   config->get_float(userdata, "gain_rate", &gain_rate, 2.0f);
+   config->get_float(userdata, "ceiling", &ceiling, -1.0f);
+   config->get_float(userdata, "lookahead", &lookahead, 5.0f);
+   config->get_float(userdata, "release", &release, 100.0f);
+
+   ln->target      = target;
+   ln->max_gain    = max_gain;
+   /* dB per second to dB per frame. */
+   ln->gain_rate   = gain_rate / info->input_rate;
+   ln->gain        = 1.0f;
+   ln->ceiling     = (float)pow(10.0, ceiling / 20.0);
+   ln->limit       = 1.0f;
+   ln->step_frames = MAX((unsigned)(info->input_rate / 10.0f), 1);
+
+   for (i = 0; i < LOUDNORM_BINS; i++)
+      ln->bin_energy[i] = pow(10.0, (LOUDNORM_BIN_MIN
+               + (i + 0.5) * LOUDNORM_BIN_WIDTH + 0.691) / 10.0);
+
+   loudnorm_init_kweight(ln, info->input_rate);
+   loudnorm_init_taps(ln);
+
+   /* The audio waits for the lookahead, plus the interpolator's
+    * delay; the window spans that with the frame itself. */
+   ln->delay_frames = (unsigned)(lookahead * info->input_rate / 1000.0f)
+      + LOUDNORM_PEAK_DELAY;
+   ln->window       = ln->delay_frames + 1;
+   ln->delay        = (float*)calloc(ln->delay_frames, 2 * sizeof(float));
+   ln->deque_peak   = (float*)calloc(ln->window, sizeof(float));
+   ln->deque_frame  = (unsigned*)calloc(ln->window, sizeof(unsigned));
+   if (!ln->delay || !ln->deque_peak || !ln->deque_frame)
+      goto error;
+
+   /* Reach the lower gain over the lookahead, let go over the
+    * release time. */
+   ln->attack  = 1.0f - (float)exp(-5.0 / MAX(ln->delay_frames
+            - LOUDNORM_PEAK_DELAY, 1));
+   ln->release = 1.0f - (float)exp(-1000.0
+         / (MAX(release, 1.0f) * info->input_rate));
+
+   /* Per content, once the host says what is playing. */
+   if (config->get_string(userdata, "state_dir", &state_dir, "")
+         && *state_dir)
+      ln->state_dir = strdup(state_dir);
+   config->free(state_dir);
+
+   return ln;
+
+error:
+   loudnorm_free(ln);
+   return NULL;
+}
+
+static const struct dspfilter_implementation loudnorm_plug = {
+   loudnorm_init,
+   loudnorm_process,
+   loudnorm_free,
+
+   DSPFILTER_API_VERSION,
+   "Loudness Normalizer",
+   "loudnorm",
+
+   DSPFILTER_FLAG_IN_PLACE,
+   loudnorm_query,
+   NULL,
+   loudnorm_set_string,
+};
+
+#ifdef HAVE_FILTERS_BUILTIN
+#define dspfilter_get_implementation loudnorm_dspfilter_get_implementation
+#endif
+
+const struct dspfilter_implementation *dspfilter_get_implementation(dspfilter_simd_mask_t mask)
+{
+   (void)mask;
+   return &loudnorm_plug;
+}
+
+#undef dspfilter_get_implementation
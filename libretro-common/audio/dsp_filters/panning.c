@@ -95,6 +95,9 @@ static const struct dspfilter_implementation panning = {
    DSPFILTER_API_VERSION,
    "Panning",
    "panning",
+
+   DSPFILTER_FLAG_IN_PLACE,
+   NULL,
 };
 
 #ifdef HAVE_FILTERS_BUILTIN
@@ -130,6 +130,9 @@ static const struct dspfilter_implementation phaser_plug = {
    DSPFILTER_API_VERSION,
    "Phaser",
    "phaser",
+
+   DSPFILTER_FLAG_IN_PLACE,
+   NULL,
 };
 
 #ifdef HAVE_FILTERS_BUILTIN
@@ -310,6 +310,9 @@ static const struct dspfilter_implementation reverb_plug = {
    DSPFILTER_API_VERSION,
    "Reverb",
    "reverb",
+
+   DSPFILTER_FLAG_IN_PLACE,
+   NULL,
 };
 
 #ifdef HAVE_FILTERS_BUILTIN
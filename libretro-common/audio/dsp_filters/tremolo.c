@@ -117,6 +117,9 @@ static const struct dspfilter_implementation tremolo_plug = {
    DSPFILTER_API_VERSION,
    "Tremolo",
    "tremolo",
+
+   DSPFILTER_FLAG_IN_PLACE,
+   NULL,
 };
 
 #ifdef HAVE_FILTERS_BUILTIN
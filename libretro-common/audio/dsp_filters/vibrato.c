@@ -153,6 +153,9 @@ static const struct dspfilter_implementation vibrato_plug = {
    DSPFILTER_API_VERSION,
    "Vibrato",
    "vibrato",
+
+   DSPFILTER_FLAG_IN_PLACE,
+   NULL,
 };
 
 #ifdef HAVE_FILTERS_BUILTIN
@@ -27,21 +27,19 @@
 #include <retro_miscellaneous.h>
 #include <libretro_dspfilter.h>
 
+#include "biquad/biquad.h"
+
 #define WAHWAH_LFO_SKIP_SAMPLES 30
 
 struct wahwah_data
 {
    float phase;
    float lfoskip;
-   float b0, b1, b2, a0, a1, a2;
    float freq, startphase;
    float depth, freqofs, res;
    unsigned long skipcount;
 
-   struct
-   {
-      float xn1, xn2, yn1, yn2;
-   } l, r;
+   struct biquad_cascade biquad;
 };
 
 static void wahwah_free(void *data)
@@ -53,22 +51,25 @@ static void wahwah_free(void *data)
 static void wahwah_process(void *data, struct dspfilter_output *output,
       const struct dspfilter_input *input)
 {
-   unsigned i;
    struct wahwah_data *wah = (struct wahwah_data*)data;
    float *out              = output->samples;
+   unsigned frames         = input->frames;
 
    output->samples         = input->samples;
    output->frames          = input->frames;
 
-   for (i = 0; i < input->frames; i++, out += 2)
+   while (frames)
    {
-      float out_l, out_r;
-      float in[2] = { out[0], out[1] };
+      unsigned pos = wah->skipcount % WAHWAH_LFO_SKIP_SAMPLES;
+      unsigned len = MIN(frames, WAHWAH_LFO_SKIP_SAMPLES - pos);
 
-      if ((wah->skipcount++ % WAHWAH_LFO_SKIP_SAMPLES) == 0)
+      /* The filter glides to each new setting over the frames until
+       * the next one, instead of jumping there. */
+      if (pos == 0)
       {
+         struct biquad_coefs coefs;
          float omega, sn, cs, alpha;
-         float frequency = (1.0 + cos(wah->skipcount * wah->lfoskip + wah->phase)) / 2.0;
+         float frequency = (1.0 + cos((wah->skipcount + 1) * wah->lfoskip + wah->phase)) / 2.0;
 
          frequency = frequency * wah->depth * (1.0 - wah->freqofs) + wah->freqofs;
          frequency = exp((frequency - 1.0) * 6.0);
@@ -78,29 +79,17 @@ static void wahwah_process(void *data, struct dspfilter_output *output,
          cs        = cos(omega);
          alpha     = sn / (2.0 * wah->res);
 
-         wah->b0   = (1.0 - cs) / 2.0;
-         wah->b1   = 1.0 - cs;
-         wah->b2   = (1.0 - cs) / 2.0;
-         wah->a0   = 1.0 + alpha;
-         wah->a1   = -2.0 * cs;
-         wah->a2   = 1.0 - alpha;
+         biquad_coefs_normalize(&coefs,
+               (1.0 - cs) / 2.0, 1.0 - cs, (1.0 - cs) / 2.0,
+               1.0 + alpha, -2.0 * cs, 1.0 - alpha);
+         biquad_cascade_set(&wah->biquad, 0, &coefs);
       }
 
-      out_l      = (wah->b0 * in[0] + wah->b1 * wah->l.xn1 + wah->b2 * wah->l.xn2 - wah->a1 * wah->l.yn1 - wah->a2 * wah->l.yn2) / wah->a0;
-      out_r      = (wah->b0 * in[1] + wah->b1 * wah->r.xn1 + wah->b2 * wah->r.xn2 - wah->a1 * wah->r.yn1 - wah->a2 * wah->r.yn2) / wah->a0;
-
-      wah->l.xn2 = wah->l.xn1;
-      wah->l.xn1 = in[0];
-      wah->l.yn2 = wah->l.yn1;
-      wah->l.yn1 = out_l;
+      biquad_cascade_process(&wah->biquad, out, len);
 
-      wah->r.xn2 = wah->r.xn1;
-      wah->r.xn1 = in[1];
-      wah->r.yn2 = wah->r.yn1;
-      wah->r.yn1 = out_r;
-
-      out[0]     = out_l;
-      out[1]     = out_r;
+      wah->skipcount += len;
+      out            += 2 * len;
+      frames         -= len;
    }
 }
 
@@ -120,6 +109,8 @@ static void *wahwah_init(const struct dspfilter_info *info,
    wah->lfoskip = wah->freq * 2.0 * M_PI / info->input_rate;
    wah->phase   = wah->startphase * M_PI / 180.0;
 
+   biquad_cascade_init(&wah->biquad, 1, WAHWAH_LFO_SKIP_SAMPLES);
+
    return wah;
 }
 
@@ -131,6 +122,9 @@ static const struct dspfilter_implementation wahwah_plug = {
    DSPFILTER_API_VERSION,
    "Wah-Wah",
    "wahwah",
+
+   DSPFILTER_FLAG_IN_PLACE,
+   NULL,
 };
 
 #ifdef HAVE_FILTERS_BUILTIN
@@ -0,0 +1,368 @@
+/* Copyright  (C) 2010-2017 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (wsola.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <boolean.h>
+#include <retro_inline.h>
+#include <retro_miscellaneous.h>
+#include <libretro_dspfilter.h>
+
+#ifndef HAVE_FILTERS_BUILTIN
+#include "fft/fft.c"
+#else
+#include "fft/fft.h"
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Time stretching by waveform similarity overlap-add (WSOLA).
+ *
+ * Output is built from Hann windowed grains, half a window apart.
+ * Each grain is taken from near where the input would be at the
+ * playback speed, at the offset where it best matches the input
+ * that followed the previous grain, so that the waveforms line up
+ * where they overlap and the pitch stays the same.
+ *
+ * The match is found by cross-correlating the two over the whole
+ * search range at once with the FFT, which costs three transforms
+ * of one window per grain however fast the audio plays. */
+
+#define WSOLA_MIN_SPEED 0.25f
+#define WSOLA_MAX_SPEED 4.0f
+
+struct wsola_data
+{
+   fft_t *fft;
+   float speed;
+
+   /* Grain length, and the spacing of grains in the output. */
+   unsigned window;
+   unsigned hop;
+   /* Frames a grain may be moved by either way. */
+   unsigned tolerance;
+   float *hann;
+
+   /* Grains being added up, one window of interleaved frames. */
+   float *overlap;
+
+   /* Correlation, over hop + 2 * tolerance = window frames. */
+   float *mono;
+   float *correlation;
+   fft_complex_t *spectrum;
+   fft_complex_t *template_spectrum;
+
+   /* Input kept for the grains to come. */
+   float *input;
+   unsigned input_frames;
+   unsigned input_capacity;
+
+   float *output;
+   unsigned output_capacity;
+
+   /* Where the next grain would start going by the speed alone, and
+    * where the previous one did start, in input frames. */
+   double ideal;
+   unsigned prev;
+   bool has_prev;
+};
+
+/* Makes sure @buffer holds @frames frames, only ever growing it. */
+static bool wsola_reserve(float **buffer, unsigned *capacity,
+      unsigned frames)
+{
+   float *new_buffer;
+
+   if (frames <= *capacity)
+      return true;
+
+   frames     = MAX(frames, *capacity * 2);
+   new_buffer = (float*)realloc(*buffer, frames * 2 * sizeof(float));
+   if (!new_buffer)
+      return false;
+
+   *buffer   = new_buffer;
+   *capacity = frames;
+   return true;
+}
+
+/* Mid channel of @frames frames, doubled. */
+static void wsola_downmix(float *out, const float *in, unsigned frames)
+{
+   unsigned i;
+   for (i = 0; i < frames; i++)
+      out[i] = in[2 * i + 0] + in[2 * i + 1];
+}
+
+/* Finds the grain starting from @start to @start + 2 * tolerance
+ * whose first hop frames look most like the ones at @natural.
+ *
+ * Returns: start of the chosen grain. */
+static unsigned wsola_search(struct wsola_data *ws, unsigned start,
+      unsigned natural)
+{
+   unsigned i;
+   unsigned best       = 0;
+   float best_score    = 0.0f;
+   double energy       = 0.0;
+   float *mono         = ws->mono;
+   const float *search = ws->input + 2 * start;
+
+   wsola_downmix(mono, search, ws->window);
+   fft_process_forward(ws->fft, ws->spectrum, mono, 1);
+
+   for (i = 0; i < ws->hop; i++)
+      energy += mono[i] * mono[i];
+
+   wsola_downmix(mono, ws->input + 2 * natural, ws->hop);
+   memset(mono + ws->hop, 0, (ws->window - ws->hop) * sizeof(*mono));
+   fft_process_forward(ws->fft, ws->template_spectrum, mono, 1);
+
+   for (i = 0; i < ws->window; i++)
+      ws->spectrum[i] = fft_complex_mul(ws->spectrum[i],
+            fft_complex_conj(ws->template_spectrum[i]));
+
+   fft_process_inverse(ws->fft, ws->correlation, ws->spectrum, 1);
+
+   /* Normalise by the candidate's energy, updated as the window
+    * slides, so louder stretches aren't favoured. The scores are
+    * squared, keeping the sign, to do without a square root. */
+   for (i = 0; i <= 2 * ws->tolerance; i++)
+   {
+      float c     = ws->correlation[i];
+      float score = c * fabsf(c) / (float)(energy + 1e-9);
+      float out   = search[2 * i] + search[2 * i + 1];
+      float in    = search[2 * (i + ws->hop)] + search[2 * (i + ws->hop) + 1];
+
+      if (i == 0 || score > best_score)
+      {
+         best       = i;
+         best_score = score;
+      }
+
+      energy = MAX(energy + in * in - out * out, 0.0);
+   }
+
+   return start + best;
+}
+
+/* Adds the grain starting at @grain, and moves the hop frames it
+ * completes to @out. */
+static void wsola_add_grain(struct wsola_data *ws, unsigned grain,
+      float *out)
+{
+   unsigned i;
+   const float *in = ws->input + 2 * grain;
+
+   for (i = 0; i < ws->window; i++)
+   {
+      ws->overlap[2 * i + 0] += ws->hann[i] * in[2 * i + 0];
+      ws->overlap[2 * i + 1] += ws->hann[i] * in[2 * i + 1];
+   }
+
+   memcpy(out, ws->overlap, ws->hop * 2 * sizeof(float));
+   memmove(ws->overlap, ws->overlap + 2 * ws->hop,
+         (ws->window - ws->hop) * 2 * sizeof(float));
+   memset(ws->overlap + 2 * (ws->window - ws->hop), 0,
+         ws->hop * 2 * sizeof(float));
+}
+
+static void wsola_process(void *data, struct dspfilter_output *output,
+      const struct dspfilter_input *input)
+{
+   unsigned drop;
+   unsigned frames          = 0;
+   struct wsola_data *ws    = (struct wsola_data*)data;
+   double step              = ws->hop * ws->speed;
+
+   output->samples          = ws->output;
+   output->frames           = 0;
+
+   if (!wsola_reserve(&ws->input, &ws->input_capacity,
+            ws->input_frames + input->frames))
+      return;
+
+   memcpy(ws->input + 2 * ws->input_frames, input->samples,
+         input->frames * 2 * sizeof(float));
+   ws->input_frames += input->frames;
+
+   if (!wsola_reserve(&ws->output, &ws->output_capacity,
+            (unsigned)(ws->input_frames / step + 1) * ws->hop))
+      return;
+
+   for (;;)
+   {
+      unsigned grain;
+      unsigned start   = (unsigned)ws->ideal - ws->tolerance;
+      unsigned natural = ws->prev + ws->hop;
+
+      if (start + 2 * ws->tolerance + ws->window > ws->input_frames)
+         break;
+
+      if (ws->has_prev)
+      {
+         if (natural + ws->hop > ws->input_frames)
+            break;
+         grain = wsola_search(ws, start, natural);
+      }
+      else
+         grain = start + ws->tolerance;
+
+      wsola_add_grain(ws, grain, ws->output + 2 * frames);
+      frames       += ws->hop;
+
+      ws->prev      = grain;
+      ws->has_prev  = true;
+      ws->ideal    += step;
+   }
+
+   /* Drop the input no grain will look at again. */
+   drop = MIN((unsigned)ws->ideal - ws->tolerance, ws->input_frames);
+   if (ws->has_prev)
+      drop = MIN(drop, ws->prev + ws->hop);
+
+   memmove(ws->input, ws->input + 2 * drop,
+         (ws->input_frames - drop) * 2 * sizeof(float));
+   ws->input_frames -= drop;
+   ws->ideal        -= drop;
+   ws->prev         -= drop;
+
+   output->samples   = ws->output;
+   output->frames    = frames;
+}
+
+static int wsola_set_float(void *data, const char *key, float value)
+{
+   struct wsola_data *ws = (struct wsola_data*)data;
+
+   if (strcmp(key, "speed"))
+      return false;
+
+   ws->speed = MAX(MIN(value, WSOLA_MAX_SPEED), WSOLA_MIN_SPEED);
+   return true;
+}
+
+static void wsola_free(void *data)
+{
+   struct wsola_data *ws = (struct wsola_data*)data;
+   if (!ws)
+      return;
+
+   fft_free(ws->fft);
+   free(ws->hann);
+   free(ws->overlap);
+   free(ws->mono);
+   free(ws->correlation);
+   free(ws->spectrum);
+   free(ws->template_spectrum);
+   free(ws->input);
+   free(ws->output);
+   free(ws);
+}
+
+static void *wsola_init(const struct dspfilter_info *info,
+      const struct dspfilter_config *config, void *userdata)
+{
+   unsigned i;
+   float speed, window_ms;
+   unsigned window_log2  = 6;
+   struct wsola_data *ws = (struct wsola_data*)calloc(1, sizeof(*ws));
+   if (!ws)
+      return NULL;
+
+   config->get_float(userdata, "speed", &speed, 1.0f);
+   config->get_float(userdata, "window", &window_ms, 20.0f);
+
+   wsola_set_float(ws, "speed", speed);
+
+   while ((1u << window_log2) < info->input_rate * window_ms / 1000.0f
+         && window_log2 < 14)
+      window_log2++;
+
+   ws->window    = 1 << window_log2;
+   ws->hop       = ws->window / 2;
+   ws->tolerance = ws->window / 4;
+
+   ws->fft               = fft_new(window_log2);
+   ws->hann              = (float*)calloc(ws->window, sizeof(float));
+   ws->overlap           = (float*)calloc(ws->window, 2 * sizeof(float));
+   ws->mono              = (float*)calloc(ws->window, sizeof(float));
+   ws->correlation       = (float*)calloc(ws->window, sizeof(float));
+   ws->spectrum          = (fft_complex_t*)
+      calloc(ws->window, sizeof(fft_complex_t));
+   ws->template_spectrum = (fft_complex_t*)
+      calloc(ws->window, sizeof(fft_complex_t));
+
+   if (!ws->fft || !ws->hann || !ws->overlap || !ws->mono
+         || !ws->correlation || !ws->spectrum || !ws->template_spectrum)
+      goto error;
+
+   /* Periodic, so that grains half a window apart add up to one. */
+   for (i = 0; i < ws->window; i++)
+      ws->hann[i] = 0.5f - 0.5f * (float)cos(2.0 * M_PI * i / ws->window);
+
+   /* Room for a few calls' worth of input up front. Silence before
+    * the start lets the first grains be searched for too. */
+   if (!wsola_reserve(&ws->input, &ws->input_capacity, 4 * ws->window)
+         || !wsola_reserve(&ws->output, &ws->output_capacity, 4 * ws->window))
+      goto error;
+
+   memset(ws->input, 0, ws->tolerance * 2 * sizeof(float));
+   ws->input_frames = ws->tolerance;
+   ws->ideal        = ws->tolerance;
+
+   return ws;
+
+error:
+   wsola_free(ws);
+   return NULL;
+}
+
+static const struct dspfilter_implementation wsola_plug = {
+   wsola_init,
+   wsola_process,
+   wsola_free,
+
+   DSPFILTER_API_VERSION,
+   "WSOLA Time Stretch",
+   "wsola",
+
+   0,
+   NULL,
+   wsola_set_float,
+};
+
+#ifdef HAVE_FILTERS_BUILTIN
+#define dspfilter_get_implementation wsola_dspfilter_get_implementation
+#endif
+
+const struct dspfilter_implementation *dspfilter_get_implementation(dspfilter_simd_mask_t mask)
+{
+   (void)mask;
+   return &wsola_plug;
+}
+
+#undef dspfilter_get_implementation
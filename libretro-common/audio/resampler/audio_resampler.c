@@ -30,6 +30,7 @@
 
 static const retro_resampler_t *resampler_drivers[] = {
    &sinc_resampler,
+   &polyphase_resampler,
 #ifdef HAVE_CC_RESAMPLER
    &CC_resampler,
 #endif
@@ -45,6 +46,8 @@ static const struct resampler_config resampler_config = {
    config_userdata_get_int_array,
    config_userdata_get_string,
    config_userdata_free,
+   2,
+   2,
 };
 
 /**
@@ -119,6 +122,7 @@ static const retro_resampler_t *find_resampler_driver(const char *ident)
  * resampler_append_plugs:
  * @re                         : Resampler handle
  * @backend                    : Resampler backend that is about to be set.
+ * @config                     : Resampler configuration.
  * @bw_ratio                   : Bandwidth ratio.
  *
  * Initializes resampler driver based on queried CPU features.
@@ -128,12 +132,13 @@ static const retro_resampler_t *find_resampler_driver(const char *ident)
 static bool resampler_append_plugs(void **re,
       const retro_resampler_t **backend,
       enum resampler_quality quality,
+      const struct resampler_config *config,
       double bw_ratio)
 {
    resampler_simd_mask_t mask = (resampler_simd_mask_t)cpu_features_get();
 
    if (*backend)
-      *re = (*backend)->init(&resampler_config, bw_ratio, quality, mask);
+      *re = (*backend)->init(config, bw_ratio, quality, mask);
 
    if (!*re)
       return false;
@@ -155,13 +160,41 @@ static bool resampler_append_plugs(void **re,
 bool retro_resampler_realloc(void **re, const retro_resampler_t **backend,
       const char *ident, enum resampler_quality quality, double bw_ratio)
 {
+   return retro_resampler_realloc_channels(re, backend, ident, quality,
+         2, 2, bw_ratio);
+}
+
+/**
+ * retro_resampler_realloc_channels:
+ * @re                         : Resampler handle
+ * @backend                    : Resampler backend that is about to be set.
+ * @ident                      : Identifier name for resampler we want.
+ * @channels                   : Number of interleaved input channels.
+ * @out_channels               : Number of interleaved output channels.
+ * @bw_ratio                   : Bandwidth ratio.
+ *
+ * Same as retro_resampler_realloc(), but for multichannel audio.
+ * Input with more channels than @out_channels is downmixed.
+ *
+ * Returns: true (1) if successful, otherwise false (0).
+ **/
+bool retro_resampler_realloc_channels(void **re,
+      const retro_resampler_t **backend,
+      const char *ident, enum resampler_quality quality,
+      unsigned channels, unsigned out_channels, double bw_ratio)
+{
+   struct resampler_config config = resampler_config;
+
+   config.channels     = channels;
+   config.out_channels = out_channels;
+
    if (*re && *backend)
       (*backend)->free(*re);
 
    *re      = NULL;
    *backend = find_resampler_driver(ident);
 
-   if (!resampler_append_plugs(re, backend, quality, bw_ratio))
+   if (!resampler_append_plugs(re, backend, quality, &config, bw_ratio))
    {
       if (!*re)
          *backend = NULL;
@@ -66,12 +66,17 @@ static void *resampler_nearest_init(const struct resampler_config *config,
       enum resampler_quality quality,
       resampler_simd_mask_t mask)
 {
-   rarch_nearest_resampler_t *re = (rarch_nearest_resampler_t*)
-      calloc(1, sizeof(rarch_nearest_resampler_t));
+   rarch_nearest_resampler_t *re = NULL;
 
-   (void)config;
    (void)mask;
 
+   /* Stereo only. */
+   if (config && ((config->channels && config->channels != 2) ||
+         (config->out_channels && config->out_channels != 2)))
+      return NULL;
+
+   re = (rarch_nearest_resampler_t*)calloc(1, sizeof(rarch_nearest_resampler_t));
+
    if (!re)
       return NULL;
 
@@ -0,0 +1,549 @@
+/* Copyright  (C) 2010-2018 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (polyphase_resampler.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Polyphase resampler for fixed rational ratios.
+ *
+ * When the output/input ratio is L/M with a small L (e.g. 160/147
+ * for 44.1 kHz to 48 kHz), every output frame falls exactly on one
+ * of L phases, so a bank of L Kaiser-windowed sinc filters is
+ * precomputed and no interpolation between phases is needed.
+ *
+ * Other ratios, non-stereo audio, and ratios which drift away from
+ * the one given at init (dynamic rate control) are handed over to
+ * the sinc resampler.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+#include <boolean.h>
+#include <retro_inline.h>
+#include <filters.h>
+#include <memalign.h>
+
+#include <audio/audio_resampler.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+/* Largest numerator accepted for the ratio, i.e. the number of
+ * filters in the bank. */
+#define POLYPHASE_MAX_PHASES 1024
+
+/* Largest denominator accepted for the ratio, which keeps the
+ * phase accumulator from overflowing. */
+#define POLYPHASE_MAX_STEP   65536
+
+/* Number of input frames filtered in one go. */
+#define POLYPHASE_CHUNK 512
+
+/* Relative error below which a ratio is considered exactly L/M. */
+#define POLYPHASE_RATIO_EPSILON 1e-9
+
+typedef struct rarch_polyphase_resampler rarch_polyphase_resampler_t;
+
+typedef void (*polyphase_kernel_t)(rarch_polyphase_resampler_t *resamp,
+      struct resampler_data *data);
+
+struct rarch_polyphase_resampler
+{
+   /* The ratio is phases / step: step input frames
+    * produce exactly phases output frames. */
+   unsigned phases;
+   unsigned step;
+   unsigned taps;
+   unsigned time;
+   double ratio;
+
+   /* A single aligned allocation holding the filter bank, followed
+    * by the left and right inputs. Each input starts with the last
+    * taps frames of history, oldest first, followed by room for
+    * POLYPHASE_CHUNK new frames, so filters read straight from it. */
+   float *main_buffer;
+   float *phase_table;
+   float *input_l;
+   float *input_r;
+
+   polyphase_kernel_t kernel;
+
+   /* Sinc resampler taking over for other ratios. */
+   void *sinc;
+   resampler_process_t sinc_process;
+   bool fallback;
+};
+
+typedef void (*polyphase_dot_t)(float *out, const float *input_l,
+      const float *input_r, const float *phase, unsigned taps);
+
+static INLINE void resampler_polyphase_process_chunks(
+      rarch_polyphase_resampler_t *resamp, struct resampler_data *data,
+      polyphase_dot_t dot)
+{
+   const float *input = data->data_in;
+   float *output      = data->data_out;
+   size_t frames      = data->input_frames;
+   size_t out_frames  = 0;
+   unsigned phases    = resamp->phases;
+   unsigned step      = resamp->step;
+   unsigned taps      = resamp->taps;
+   unsigned time      = resamp->time;
+   float *input_l     = resamp->input_l;
+   float *input_r     = resamp->input_r;
+   const float *table = resamp->phase_table;
+
+   while (frames)
+   {
+      unsigned i;
+      unsigned pos = 0;
+      unsigned n   = frames < POLYPHASE_CHUNK
+         ? (unsigned)frames : POLYPHASE_CHUNK;
+
+      for (i = 0; i < n; i++)
+      {
+         input_l[taps + i] = input[2 * i + 0];
+         input_r[taps + i] = input[2 * i + 1];
+      }
+
+      for (;;)
+      {
+         while (time >= phases)
+         {
+            if (pos == n)
+               goto chunk_done;
+            pos++;
+            time -= phases;
+         }
+
+         /* The newest frame in the window is the last one consumed. */
+         dot(output, input_l + pos, input_r + pos,
+               table + time * taps, taps);
+
+         output += 2;
+         out_frames++;
+         time   += step;
+      }
+
+chunk_done:
+      memmove(input_l, input_l + n, taps * sizeof(float));
+      memmove(input_r, input_r + n, taps * sizeof(float));
+
+      input  += 2 * n;
+      frames -= n;
+   }
+
+   resamp->time        = time;
+   data->output_frames = out_frames;
+}
+
+#if defined(__AVX__)
+static INLINE void polyphase_dot_avx(float *out, const float *input_l,
+      const float *input_r, const float *phase, unsigned taps)
+{
+   unsigned i;
+   __m256 sum_l = _mm256_setzero_ps();
+   __m256 sum_r = _mm256_setzero_ps();
+   __m128 l, r;
+
+   for (i = 0; i < taps; i += 8)
+   {
+      __m256 sinc = _mm256_load_ps(phase + i);
+      sum_l       = _mm256_add_ps(sum_l,
+            _mm256_mul_ps(_mm256_loadu_ps(input_l + i), sinc));
+      sum_r       = _mm256_add_ps(sum_r,
+            _mm256_mul_ps(_mm256_loadu_ps(input_r + i), sinc));
+   }
+
+   l = _mm_add_ps(_mm256_castps256_ps128(sum_l),
+         _mm256_extractf128_ps(sum_l, 1));
+   r = _mm_add_ps(_mm256_castps256_ps128(sum_r),
+         _mm256_extractf128_ps(sum_r, 1));
+
+   /* { l0 + l2, l1 + l3, r0 + r2, r1 + r3 } */
+   l = _mm_add_ps(_mm_shuffle_ps(l, r, _MM_SHUFFLE(1, 0, 1, 0)),
+         _mm_shuffle_ps(l, r, _MM_SHUFFLE(3, 2, 3, 2)));
+   /* { L, X, R, X } */
+   l = _mm_add_ps(_mm_shuffle_ps(l, l, _MM_SHUFFLE(3, 3, 1, 1)), l);
+
+   _mm_storel_pi((__m64*)out, _mm_shuffle_ps(l, l, _MM_SHUFFLE(2, 2, 2, 0)));
+}
+
+static void resampler_polyphase_process_avx(
+      rarch_polyphase_resampler_t *resamp, struct resampler_data *data)
+{
+   resampler_polyphase_process_chunks(resamp, data, polyphase_dot_avx);
+}
+#endif
+
+#if defined(__SSE__)
+static INLINE void polyphase_dot_sse(float *out, const float *input_l,
+      const float *input_r, const float *phase, unsigned taps)
+{
+   unsigned i;
+   __m128 sum_l = _mm_setzero_ps();
+   __m128 sum_r = _mm_setzero_ps();
+   __m128 sum;
+
+   for (i = 0; i < taps; i += 4)
+   {
+      __m128 sinc = _mm_load_ps(phase + i);
+      sum_l       = _mm_add_ps(sum_l,
+            _mm_mul_ps(_mm_loadu_ps(input_l + i), sinc));
+      sum_r       = _mm_add_ps(sum_r,
+            _mm_mul_ps(_mm_loadu_ps(input_r + i), sinc));
+   }
+
+   /* { l0 + l2, l1 + l3, r0 + r2, r1 + r3 } */
+   sum = _mm_add_ps(_mm_shuffle_ps(sum_l, sum_r, _MM_SHUFFLE(1, 0, 1, 0)),
+         _mm_shuffle_ps(sum_l, sum_r, _MM_SHUFFLE(3, 2, 3, 2)));
+   /* { L, X, R, X } */
+   sum = _mm_add_ps(_mm_shuffle_ps(sum, sum, _MM_SHUFFLE(3, 3, 1, 1)), sum);
+
+   _mm_storel_pi((__m64*)out,
+         _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(2, 2, 2, 0)));
+}
+
+static void resampler_polyphase_process_sse(
+      rarch_polyphase_resampler_t *resamp, struct resampler_data *data)
+{
+   resampler_polyphase_process_chunks(resamp, data, polyphase_dot_sse);
+}
+#endif
+
+static INLINE void polyphase_dot_c(float *out, const float *input_l,
+      const float *input_r, const float *phase, unsigned taps)
+{
+   unsigned i;
+   float sum_l = 0.0f;
+   float sum_r = 0.0f;
+
+   for (i = 0; i < taps; i++)
+   {
+      sum_l += input_l[i] * phase[i];
+      sum_r += input_r[i] * phase[i];
+   }
+
+   out[0] = sum_l;
+   out[1] = sum_r;
+}
+
+static void resampler_polyphase_process_c(
+      rarch_polyphase_resampler_t *resamp, struct resampler_data *data)
+{
+   resampler_polyphase_process_chunks(resamp, data, polyphase_dot_c);
+}
+
+/**
+ * resampler_polyphase_start_fallback:
+ * @resamp                     : Polyphase resampler handle.
+ *
+ * Switches to the sinc resampler for good. Its history is primed
+ * with the frames currently in the filter window, so the switch
+ * does not produce a burst of silence.
+ **/
+static void resampler_polyphase_start_fallback(
+      rarch_polyphase_resampler_t *resamp, double ratio)
+{
+   unsigned i;
+   float *frames  = NULL;
+   float *scratch = NULL;
+   size_t out_max = (size_t)ceil(resamp->taps * ratio) + 2;
+
+   resamp->fallback = true;
+
+   if (!resamp->phase_table)
+      return;
+
+   frames  = (float*)malloc(2 * resamp->taps * sizeof(float));
+   scratch = (float*)malloc(2 * out_max * sizeof(float));
+
+   if (frames && scratch)
+   {
+      struct resampler_data data;
+
+      for (i = 0; i < resamp->taps; i++)
+      {
+         frames[2 * i + 0] = resamp->input_l[i];
+         frames[2 * i + 1] = resamp->input_r[i];
+      }
+
+      data.data_in       = frames;
+      data.data_out      = scratch;
+      data.input_frames  = resamp->taps;
+      data.output_frames = 0;
+      data.ratio         = ratio;
+
+      resamp->sinc_process(resamp->sinc, &data);
+   }
+
+   free(frames);
+   free(scratch);
+}
+
+static void resampler_polyphase_process(void *re_,
+      struct resampler_data *data)
+{
+   rarch_polyphase_resampler_t *resamp =
+      (rarch_polyphase_resampler_t*)re_;
+
+   if (!resamp->fallback &&
+         fabs(data->ratio - resamp->ratio) >
+         resamp->ratio * POLYPHASE_RATIO_EPSILON)
+      resampler_polyphase_start_fallback(resamp, data->ratio);
+
+   if (resamp->fallback)
+      resamp->sinc_process(resamp->sinc, data);
+   else
+      resamp->kernel(resamp, data);
+}
+
+static void resampler_polyphase_free(void *re_)
+{
+   rarch_polyphase_resampler_t *resamp =
+      (rarch_polyphase_resampler_t*)re_;
+
+   if (!resamp)
+      return;
+
+   if (resamp->sinc)
+      sinc_resampler.free(resamp->sinc);
+   memalign_free(resamp->main_buffer);
+   free(resamp);
+}
+
+/**
+ * polyphase_find_ratio:
+ * @ratio                      : Output/input sample rate ratio.
+ * @num                        : Numerator of @ratio.
+ * @den                        : Denominator of @ratio.
+ *
+ * Finds L/M equal to @ratio with L and M at most POLYPHASE_MAX_PHASES
+ * and POLYPHASE_MAX_STEP, by walking the continued fraction expansion of @ratio.
+ *
+ * Returns: true (1) if such a fraction exists, otherwise false (0).
+ **/
+static bool polyphase_find_ratio(double ratio,
+      unsigned *num, unsigned *den)
+{
+   double x      = ratio;
+   uint64_t h0   = 0, h1 = 1;
+   uint64_t k0   = 1, k1 = 0;
+   unsigned i;
+
+   if (!(ratio > 0.0))
+      return false;
+
+   for (i = 0; i < 32; i++)
+   {
+      double a   = floor(x);
+      uint64_t h = (uint64_t)a * h1 + h0;
+      uint64_t k = (uint64_t)a * k1 + k0;
+
+      if (h > POLYPHASE_MAX_PHASES || k > POLYPHASE_MAX_STEP)
+         return false;
+
+      if (fabs((double)h / k - ratio) <= ratio * POLYPHASE_RATIO_EPSILON)
+      {
+         *num = (unsigned)h;
+         *den = (unsigned)k;
+         return true;
+      }
+
+      h0 = h1;
+      h1 = h;
+      k0 = k1;
+      k1 = k;
+
+      if (x - a < POLYPHASE_RATIO_EPSILON)
+         return false;
+      x = 1.0 / (x - a);
+   }
+
+   return false;
+}
+
+static void polyphase_init_table(rarch_polyphase_resampler_t *resamp,
+      double cutoff, double beta)
+{
+   unsigned i, j;
+   unsigned phases   = resamp->phases;
+   unsigned taps     = resamp->taps;
+   double window_mod = kaiser_window_function(0.0, beta); /* Need to normalize w(0) to 1.0. */
+   double sidelobes  = taps / 2.0;
+
+   /* Same filters as the sinc resampler, but with one row per
+    * exact phase. The sinc resampler's history is newest first,
+    * so rows are stored reversed to match the input buffers. */
+   for (i = 0; i < phases; i++)
+   {
+      float *row = resamp->phase_table + i * taps;
+      double sum = 0.0;
+
+      for (j = 0; j < taps; j++)
+      {
+         int n               = j * phases + i;
+         double window_phase = (double)n / ((double)phases * taps); /* [0, 1). */
+         double sinc_phase;
+
+         window_phase        = 2.0 * window_phase - 1.0; /* [-1, 1) */
+         sinc_phase          = sidelobes * window_phase;
+
+         row[taps - 1 - j]   = cutoff *
+            sinc(M_PI * sinc_phase * cutoff) *
+            kaiser_window_function(window_phase, beta) / window_mod;
+         sum                += row[taps - 1 - j];
+      }
+
+      /* Truncating the sinc leaves each phase with a slightly
+       * different DC gain, which shows up as a tone at the
+       * phase rate. The bank is exact, so normalize it away. */
+      for (j = 0; j < taps; j++)
+         row[j] /= sum;
+   }
+}
+
+static void *resampler_polyphase_new(const struct resampler_config *config,
+      double bandwidth_mod, enum resampler_quality quality,
+      resampler_simd_mask_t mask)
+{
+   size_t elems                        = 0;
+   double cutoff                       = 0.0;
+   double beta                         = 0.0;
+   unsigned sidelobes                  = 0;
+   rarch_polyphase_resampler_t *resamp = (rarch_polyphase_resampler_t*)
+      calloc(1, sizeof(*resamp));
+
+   if (!resamp)
+      return NULL;
+
+   /* Set up the fallback first. */
+   resamp->sinc         = sinc_resampler.init(config, bandwidth_mod,
+         quality, mask);
+   resamp->sinc_process = sinc_resampler.process;
+   resamp->ratio        = bandwidth_mod;
+
+   if (!resamp->sinc)
+      goto error;
+
+   if ((config && config->channels && config->channels != 2) ||
+         (config && config->out_channels && config->out_channels != 2) ||
+         !polyphase_find_ratio(bandwidth_mod,
+            &resamp->phases, &resamp->step))
+   {
+      resamp->fallback = true;
+      return resamp;
+   }
+
+   switch (quality)
+   {
+      case RESAMPLER_QUALITY_LOWEST:
+         cutoff    = 0.825;
+         sidelobes = 4;
+         beta      = 4.5;
+         break;
+      case RESAMPLER_QUALITY_LOWER:
+         cutoff    = 0.825;
+         sidelobes = 6;
+         beta      = 5.0;
+         break;
+      case RESAMPLER_QUALITY_HIGHER:
+         cutoff    = 0.90;
+         sidelobes = 32;
+         beta      = 10.5;
+         break;
+      case RESAMPLER_QUALITY_HIGHEST:
+         cutoff    = 0.962;
+         sidelobes = 128;
+         beta      = 14.5;
+         break;
+      case RESAMPLER_QUALITY_NORMAL:
+      case RESAMPLER_QUALITY_DONTCARE:
+         cutoff    = 0.825;
+         sidelobes = 8;
+         beta      = 5.5;
+         break;
+   }
+
+   resamp->taps = sidelobes * 2;
+
+   /* Downsampling, must lower cutoff, and extend number of
+    * taps accordingly to keep same stopband attenuation. */
+   if (bandwidth_mod < 1.0)
+   {
+      cutoff      *= bandwidth_mod;
+      resamp->taps = (unsigned)ceil(resamp->taps / bandwidth_mod);
+   }
+
+   /* Be SIMD-friendly. */
+   resamp->taps        = (resamp->taps + 7) & ~7;
+
+   elems               = (size_t)resamp->phases * resamp->taps +
+      2 * (resamp->taps + POLYPHASE_CHUNK);
+   resamp->main_buffer = (float*)memalign_alloc(128, sizeof(float) * elems);
+
+   if (!resamp->main_buffer)
+      goto error;
+
+   memset(resamp->main_buffer, 0, sizeof(float) * elems);
+
+   resamp->phase_table = resamp->main_buffer;
+   resamp->input_l     = resamp->phase_table +
+      (size_t)resamp->phases * resamp->taps;
+   resamp->input_r     = resamp->input_l + resamp->taps + POLYPHASE_CHUNK;
+
+   polyphase_init_table(resamp, cutoff, beta);
+
+   resamp->kernel      = resampler_polyphase_process_c;
+
+   /* Only consider instruction sets this file was built with, so
+    * an AVX capable CPU still gets the SSE kernel without AVX. */
+#if defined(__AVX__)
+   if (mask & RESAMPLER_SIMD_AVX)
+      resamp->kernel   = resampler_polyphase_process_avx;
+   else
+#endif
+#if defined(__SSE__)
+   if (mask & RESAMPLER_SIMD_SSE)
+      resamp->kernel   = resampler_polyphase_process_sse;
+#endif
+
+   return resamp;
+
+error:
+   resampler_polyphase_free(resamp);
+   return NULL;
+}
+
+retro_resampler_t polyphase_resampler = {
+   resampler_polyphase_new,
+   resampler_polyphase_process,
+   resampler_polyphase_free,
+   RESAMPLER_API_VERSION,
+   "polyphase",
+   "polyphase"
+};
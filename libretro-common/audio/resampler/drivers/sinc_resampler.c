@@ -38,7 +38,7 @@
 #include <xmmintrin.h>
 #endif
 
-#if defined(__AVX__)
+#if defined(__AVX__) || defined(__FMA__)
 #include <immintrin.h>
 #endif
 
@@ -78,13 +78,37 @@ typedef struct rarch_sinc_resampler
    float kaiser_beta;
    enum sinc_window window_type;
 
+   /* Number of channels kept in the history buffers and written
+    * to the output, and number of interleaved input channels. */
+   unsigned channels;
+   unsigned in_channels;
+
+   /* Length of each channel's history ring. Equal to taps, except
+    * in block mode where it also holds the frames pushed while a
+    * tile of output frames is gathered. */
+   unsigned ring;
+
+   /* Number of taps per coefficient/delta pair in the Kaiser phase
+    * table in block mode, or 0 if block mode is not used. */
+   unsigned block_width;
+
    /* A buffer for phase_table, buffer_l and buffer_r
     * are created in a single calloc().
-    * Ensure that we get as good cache locality as we can hope for. */
+    * Ensure that we get as good cache locality as we can hope for.
+    * For more than two channels, the history of channel N
+    * starts at buffer_l + N * 2 * taps. */
    float *main_buffer;
    float *phase_table;
    float *buffer_l;
    float *buffer_r;
+
+   /* channels x in_channels matrix applied to every input frame,
+    * or NULL if the input is not downmixed. */
+   float *downmix;
+
+   /* Kernel picked for this instance, which the layout of the
+    * buffers above depends on. */
+   resampler_process_t process;
 } rarch_sinc_resampler_t;
 
 #if defined(__ARM_NEON__)
@@ -149,8 +173,7 @@ static void resampler_sinc_process_neon(void *re_, struct resampler_data *data)
 }
 #endif
 
-#if defined(__AVX__)
-static void resampler_sinc_process_avx(void *re_, struct resampler_data *data)
+static void resampler_sinc_process_c(void *re_, struct resampler_data *data)
 {
    rarch_sinc_resampler_t *resamp = (rarch_sinc_resampler_t*)re_;
    unsigned phases                = 1 << (resamp->phase_bits + resamp->subphase_bits);
@@ -170,87 +193,117 @@ static void resampler_sinc_process_avx(void *re_, struct resampler_data *data)
             resamp->ptr = resamp->taps;
          resamp->ptr--;
 
-         resamp->buffer_l[resamp->ptr + resamp->taps] =
-         resamp->buffer_l[resamp->ptr]                = *input++;
+         resamp->buffer_l[resamp->ptr + resamp->taps]    =
+            resamp->buffer_l[resamp->ptr]                = *input++;
 
-         resamp->buffer_r[resamp->ptr + resamp->taps] =
-         resamp->buffer_r[resamp->ptr]                = *input++;
+         resamp->buffer_r[resamp->ptr + resamp->taps]    =
+            resamp->buffer_r[resamp->ptr]                = *input++;
 
-         resamp->time                                -= phases;
+         resamp->time                                   -= phases;
          frames--;
       }
 
       while (resamp->time < phases)
       {
          unsigned i;
-         __m256 delta, sum_l, sum_r;
-         float *delta_table       = NULL;
+         float delta              = 0.0f;
+         float sum_l              = 0.0f;
+         float sum_r              = 0.0f;
          float *phase_table       = NULL;
+         float *delta_table       = NULL;
          const float *buffer_l    = resamp->buffer_l + resamp->ptr;
          const float *buffer_r    = resamp->buffer_r + resamp->ptr;
          unsigned taps            = resamp->taps;
          unsigned phase           = resamp->time >> resamp->subphase_bits;
 
-         phase_table              = resamp->phase_table + phase * taps;
-
          if (resamp->window_type == SINC_WINDOW_KAISER)
          {
-            phase_table              = resamp->phase_table + phase * taps * 2;
-            delta_table              = phase_table + taps;
-            delta                    = _mm256_set1_ps((float)
-                  (resamp->time & resamp->subphase_mask) * resamp->subphase_mod);
+            phase_table           = resamp->phase_table + phase * taps * 2;
+            delta_table           = phase_table + taps;
+            delta                 = (float)
+               (resamp->time & resamp->subphase_mask) * resamp->subphase_mod;
+         }
+         else
+         {
+            phase_table           = resamp->phase_table + phase * taps;
          }
 
-         sum_l                    = _mm256_setzero_ps();
-         sum_r                    = _mm256_setzero_ps();
-
-         for (i = 0; i < taps; i += 8)
+         for (i = 0; i < taps; i++)
          {
-            __m256 sinc;
-            __m256 buf_l  = _mm256_loadu_ps(buffer_l + i);
-            __m256 buf_r  = _mm256_loadu_ps(buffer_r + i);
+            float sinc_val        = phase_table[i];
 
             if (resamp->window_type == SINC_WINDOW_KAISER)
-            {
-               __m256 deltas = _mm256_load_ps(delta_table + i);
-               sinc          = _mm256_add_ps(_mm256_load_ps((const float*)phase_table + i),
-                     _mm256_mul_ps(deltas, delta));
-            }
-            else
-            {
-               sinc          = _mm256_load_ps((const float*)phase_table + i);
-            }
+               sinc_val           = sinc_val + delta_table[i] * delta;
 
-            sum_l         = _mm256_add_ps(sum_l, _mm256_mul_ps(buf_l, sinc));
-            sum_r         = _mm256_add_ps(sum_r, _mm256_mul_ps(buf_r, sinc));
+            sum_l                += buffer_l[i] * sinc_val;
+            sum_r                += buffer_r[i] * sinc_val;
          }
 
-         /* hadd on AVX is weird, and acts on low-lanes
-          * and high-lanes separately. */
-         __m256 res_l = _mm256_hadd_ps(sum_l, sum_l);
-         __m256 res_r = _mm256_hadd_ps(sum_r, sum_r);
-         res_l        = _mm256_hadd_ps(res_l, res_l);
-         res_r        = _mm256_hadd_ps(res_r, res_r);
-         res_l        = _mm256_add_ps(_mm256_permute2f128_ps(res_l, res_l, 1), res_l);
-         res_r        = _mm256_add_ps(_mm256_permute2f128_ps(res_r, res_r, 1), res_r);
-
-         /* This is optimized to mov %xmmN, [mem].
-          * There doesn't seem to be any _mm256_store_ss intrinsic. */
-         _mm_store_ss(output + 0, _mm256_extractf128_ps(res_l, 0));
-         _mm_store_ss(output + 1, _mm256_extractf128_ps(res_r, 0));
+         output[0]                = sum_l;
+         output[1]                = sum_r;
 
-         output += 2;
+         output                  += 2;
          out_frames++;
-         resamp->time += ratio;
+         resamp->time            += ratio;
       }
+
    }
 
    data->output_frames = out_frames;
 }
-#endif
 
-#if defined(__SSE__)
-static void resampler_sinc_process_sse(void *re_, struct resampler_data *data)
+/* Multichannel variants.
+ *
+ * Input frames are downmixed as they are pushed into the planar
+ * history buffers, so the filter only runs over output channels.
+ * The kernels compute each sinc coefficient once and apply it to
+ * every channel.
+ */
+
+static INLINE void resampler_sinc_push_multi(
+      rarch_sinc_resampler_t *resamp, const float *input)
+{
+   unsigned c, k;
+   unsigned taps     = resamp->taps;
+   float *buffer     = resamp->buffer_l + resamp->ptr;
+
+   for (c = 0; c < resamp->channels; c++, buffer += 2 * taps)
+   {
+      float val;
+
+      if (resamp->downmix)
+      {
+         const float *row = resamp->downmix + c * resamp->in_channels;
+
+         val              = 0.0f;
+         for (k = 0; k < resamp->in_channels; k++)
+            val          += row[k] * input[k];
+      }
+      else
+         val              = input[c];
+
+      buffer[taps] = buffer[0] = val;
+   }
+}
+
+#define SINC_PUSH_MULTI(resamp, input, frames, phases) \
+   while (frames && resamp->time >= phases) \
+   { \
+      /* Push in reverse to make filter more obvious. */ \
+      if (!resamp->ptr) \
+         resamp->ptr = resamp->taps; \
+      resamp->ptr--; \
+      resampler_sinc_push_multi(resamp, input); \
+      input        += resamp->in_channels; \
+      resamp->time -= phases; \
+      frames--; \
+   }
+
+#ifdef WANT_NEON
+#include <arm_neon.h>
+
+static void resampler_sinc_process_multi_neon(void *re_,
+      struct resampler_data *data)
 {
    rarch_sinc_resampler_t *resamp = (rarch_sinc_resampler_t*)re_;
    unsigned phases                = 1 << (resamp->phase_bits + resamp->subphase_bits);
@@ -260,100 +313,133 @@ static void resampler_sinc_process_sse(void *re_, struct resampler_data *data)
    float *output                  = data->data_out;
    size_t frames                  = data->input_frames;
    size_t out_frames              = 0;
+   unsigned channels              = resamp->channels;
+   unsigned taps                  = resamp->taps;
 
    while (frames)
    {
-      while (frames && resamp->time >= phases)
-      {
-         /* Push in reverse to make filter more obvious. */
-         if (!resamp->ptr)
-            resamp->ptr = resamp->taps;
-         resamp->ptr--;
-
-         resamp->buffer_l[resamp->ptr + resamp->taps] =
-         resamp->buffer_l[resamp->ptr]                = *input++;
-
-         resamp->buffer_r[resamp->ptr + resamp->taps] =
-         resamp->buffer_r[resamp->ptr]                = *input++;
-
-         resamp->time                                -= phases;
-         frames--;
-      }
+      SINC_PUSH_MULTI(resamp, input, frames, phases);
 
       while (resamp->time < phases)
       {
-         unsigned i;
-         __m128 sum, sum_l, sum_r, delta;
-         float *phase_table       = NULL;
-         float *delta_table       = NULL;
-         const float *buffer_l    = resamp->buffer_l + resamp->ptr;
-         const float *buffer_r    = resamp->buffer_r + resamp->ptr;
-         unsigned taps            = resamp->taps;
+         unsigned i, c;
+         float32x4_t sum[RESAMPLER_MAX_CHANNELS];
+         float32x4_t delta        = vdupq_n_f32(0.0f);
+         const float *buffer      = resamp->buffer_l + resamp->ptr;
+         const float *phase_table = NULL;
+         const float *delta_table = NULL;
          unsigned phase           = resamp->time >> resamp->subphase_bits;
 
          if (resamp->window_type == SINC_WINDOW_KAISER)
          {
-            phase_table              = resamp->phase_table + phase * taps * 2;
-            delta_table              = phase_table + taps;
-            delta                    = _mm_set1_ps((float)
+            phase_table           = resamp->phase_table + phase * taps * 2;
+            delta_table           = phase_table + taps;
+            delta                 = vdupq_n_f32((float)
                   (resamp->time & resamp->subphase_mask) * resamp->subphase_mod);
          }
          else
-         {
-            phase_table              = resamp->phase_table + phase * taps;
-         }
+            phase_table           = resamp->phase_table + phase * taps;
 
-         sum_l                    = _mm_setzero_ps();
-         sum_r                    = _mm_setzero_ps();
+         for (c = 0; c < channels; c++)
+            sum[c]                = vdupq_n_f32(0.0f);
 
          for (i = 0; i < taps; i += 4)
          {
-            __m128 deltas, _sinc;
-            __m128 buf_l = _mm_loadu_ps(buffer_l + i);
-            __m128 buf_r = _mm_loadu_ps(buffer_r + i);
+            float32x4_t sinc      = vld1q_f32(phase_table + i);
 
-            if (resamp->window_type == SINC_WINDOW_KAISER)
-            {
-               deltas = _mm_load_ps(delta_table + i);
-               _sinc  = _mm_add_ps(_mm_load_ps((const float*)phase_table + i),
-                     _mm_mul_ps(deltas, delta));
-            }
-            else
-            {
-               _sinc  = _mm_load_ps((const float*)phase_table + i);
-            }
-            sum_l        = _mm_add_ps(sum_l, _mm_mul_ps(buf_l, _sinc));
-            sum_r        = _mm_add_ps(sum_r, _mm_mul_ps(buf_r, _sinc));
+            if (delta_table)
+               sinc               = vmlaq_f32(sinc, vld1q_f32(delta_table + i), delta);
+
+            for (c = 0; c < channels; c++)
+               sum[c]             = vmlaq_f32(sum[c],
+                     vld1q_f32(buffer + c * 2 * taps + i), sinc);
          }
 
-         /* Them annoying shuffles.
-          * sum_l = { l3, l2, l1, l0 }
-          * sum_r = { r3, r2, r1, r0 }
-          */
+         for (c = 0; c < channels; c++)
+         {
+            float32x2_t half      = vadd_f32(vget_low_f32(sum[c]),
+                  vget_high_f32(sum[c]));
+            output[c]             = vget_lane_f32(vpadd_f32(half, half), 0);
+         }
+
+         output                  += channels;
+         out_frames++;
+         resamp->time            += ratio;
+      }
+   }
+
+   data->output_frames = out_frames;
+}
+#endif
 
-         sum = _mm_add_ps(_mm_shuffle_ps(sum_l, sum_r,
-                  _MM_SHUFFLE(1, 0, 1, 0)),
-               _mm_shuffle_ps(sum_l, sum_r, _MM_SHUFFLE(3, 2, 3, 2)));
+#if defined(__AVX__)
+static void resampler_sinc_process_multi_avx(void *re_,
+      struct resampler_data *data)
+{
+   rarch_sinc_resampler_t *resamp = (rarch_sinc_resampler_t*)re_;
+   unsigned phases                = 1 << (resamp->phase_bits + resamp->subphase_bits);
 
-         /* sum   = { r1, r0, l1, l0 } + { r3, r2, l3, l2 }
-          * sum   = { R1, R0, L1, L0 }
-          */
+   uint32_t ratio                 = phases / data->ratio;
+   const float *input             = data->data_in;
+   float *output                  = data->data_out;
+   size_t frames                  = data->input_frames;
+   size_t out_frames              = 0;
+   unsigned channels              = resamp->channels;
+   unsigned taps                  = resamp->taps;
 
-         sum = _mm_add_ps(_mm_shuffle_ps(sum, sum, _MM_SHUFFLE(3, 3, 1, 1)), sum);
+   while (frames)
+   {
+      SINC_PUSH_MULTI(resamp, input, frames, phases);
 
-         /* sum   = {R1, R1, L1, L1 } + { R1, R0, L1, L0 }
-          * sum   = { X,  R,  X,  L }
-          */
+      while (resamp->time < phases)
+      {
+         unsigned i, c;
+         __m256 sum[RESAMPLER_MAX_CHANNELS];
+         __m256 delta             = _mm256_setzero_ps();
+         const float *buffer      = resamp->buffer_l + resamp->ptr;
+         const float *phase_table = NULL;
+         const float *delta_table = NULL;
+         unsigned phase           = resamp->time >> resamp->subphase_bits;
 
-         /* Store L */
-         _mm_store_ss(output + 0, sum);
+         if (resamp->window_type == SINC_WINDOW_KAISER)
+         {
+            phase_table           = resamp->phase_table + phase * taps * 2;
+            delta_table           = phase_table + taps;
+            delta                 = _mm256_set1_ps((float)
+                  (resamp->time & resamp->subphase_mask) * resamp->subphase_mod);
+         }
+         else
+            phase_table           = resamp->phase_table + phase * taps;
 
-         /* movehl { X, R, X, L } == { X, R, X, R } */
-         _mm_store_ss(output + 1, _mm_movehl_ps(sum, sum));
+         for (c = 0; c < channels; c++)
+            sum[c]                = _mm256_setzero_ps();
 
-         output += 2;
+         for (i = 0; i < taps; i += 8)
+         {
+            __m256 sinc           = _mm256_load_ps(phase_table + i);
+
+            if (delta_table)
+               sinc               = _mm256_add_ps(sinc,
+                     _mm256_mul_ps(_mm256_load_ps(delta_table + i), delta));
+
+            for (c = 0; c < channels; c++)
+               sum[c]             = _mm256_add_ps(sum[c], _mm256_mul_ps(
+                        _mm256_loadu_ps(buffer + c * 2 * taps + i), sinc));
+         }
+
+         for (c = 0; c < channels; c++)
+         {
+            __m128 res            = _mm_add_ps(_mm256_castps256_ps128(sum[c]),
+                  _mm256_extractf128_ps(sum[c], 1));
+            res                   = _mm_add_ps(res, _mm_movehl_ps(res, res));
+            res                   = _mm_add_ss(res,
+                  _mm_shuffle_ps(res, res, _MM_SHUFFLE(1, 1, 1, 1)));
+            _mm_store_ss(output + c, res);
+         }
+
+         output                  += channels;
          out_frames++;
-         resamp->time += ratio;
+         resamp->time            += ratio;
       }
    }
 
@@ -361,7 +447,9 @@ static void resampler_sinc_process_sse(void *re_, struct resampler_data *data)
 }
 #endif
 
-static void resampler_sinc_process_c(void *re_, struct resampler_data *data)
+#if defined(__SSE__)
+static void resampler_sinc_process_multi_sse(void *re_,
+      struct resampler_data *data)
 {
    rarch_sinc_resampler_t *resamp = (rarch_sinc_resampler_t*)re_;
    unsigned phases                = 1 << (resamp->phase_bits + resamp->subphase_bits);
@@ -371,37 +459,93 @@ static void resampler_sinc_process_c(void *re_, struct resampler_data *data)
    float *output                  = data->data_out;
    size_t frames                  = data->input_frames;
    size_t out_frames              = 0;
+   unsigned channels              = resamp->channels;
+   unsigned taps                  = resamp->taps;
 
    while (frames)
    {
-      while (frames && resamp->time >= phases)
+      SINC_PUSH_MULTI(resamp, input, frames, phases);
+
+      while (resamp->time < phases)
       {
-         /* Push in reverse to make filter more obvious. */
-         if (!resamp->ptr)
-            resamp->ptr = resamp->taps;
-         resamp->ptr--;
+         unsigned i, c;
+         __m128 sum[RESAMPLER_MAX_CHANNELS];
+         __m128 delta             = _mm_setzero_ps();
+         const float *buffer      = resamp->buffer_l + resamp->ptr;
+         const float *phase_table = NULL;
+         const float *delta_table = NULL;
+         unsigned phase           = resamp->time >> resamp->subphase_bits;
 
-         resamp->buffer_l[resamp->ptr + resamp->taps]    =
-            resamp->buffer_l[resamp->ptr]                = *input++;
+         if (resamp->window_type == SINC_WINDOW_KAISER)
+         {
+            phase_table           = resamp->phase_table + phase * taps * 2;
+            delta_table           = phase_table + taps;
+            delta                 = _mm_set1_ps((float)
+                  (resamp->time & resamp->subphase_mask) * resamp->subphase_mod);
+         }
+         else
+            phase_table           = resamp->phase_table + phase * taps;
 
-         resamp->buffer_r[resamp->ptr + resamp->taps]    =
-            resamp->buffer_r[resamp->ptr]                = *input++;
+         for (c = 0; c < channels; c++)
+            sum[c]                = _mm_setzero_ps();
 
-         resamp->time                                   -= phases;
-         frames--;
+         for (i = 0; i < taps; i += 4)
+         {
+            __m128 sinc           = _mm_load_ps(phase_table + i);
+
+            if (delta_table)
+               sinc               = _mm_add_ps(sinc,
+                     _mm_mul_ps(_mm_load_ps(delta_table + i), delta));
+
+            for (c = 0; c < channels; c++)
+               sum[c]             = _mm_add_ps(sum[c], _mm_mul_ps(
+                        _mm_loadu_ps(buffer + c * 2 * taps + i), sinc));
+         }
+
+         for (c = 0; c < channels; c++)
+         {
+            __m128 res            = _mm_add_ps(sum[c], _mm_movehl_ps(sum[c], sum[c]));
+            res                   = _mm_add_ss(res,
+                  _mm_shuffle_ps(res, res, _MM_SHUFFLE(1, 1, 1, 1)));
+            _mm_store_ss(output + c, res);
+         }
+
+         output                  += channels;
+         out_frames++;
+         resamp->time            += ratio;
       }
+   }
+
+   data->output_frames = out_frames;
+}
+#endif
+
+static void resampler_sinc_process_multi_c(void *re_,
+      struct resampler_data *data)
+{
+   rarch_sinc_resampler_t *resamp = (rarch_sinc_resampler_t*)re_;
+   unsigned phases                = 1 << (resamp->phase_bits + resamp->subphase_bits);
+
+   uint32_t ratio                 = phases / data->ratio;
+   const float *input             = data->data_in;
+   float *output                  = data->data_out;
+   size_t frames                  = data->input_frames;
+   size_t out_frames              = 0;
+   unsigned channels              = resamp->channels;
+   unsigned taps                  = resamp->taps;
+
+   while (frames)
+   {
+      SINC_PUSH_MULTI(resamp, input, frames, phases);
 
       while (resamp->time < phases)
       {
-         unsigned i;
+         unsigned i, c;
+         float sum[RESAMPLER_MAX_CHANNELS];
          float delta              = 0.0f;
-         float sum_l              = 0.0f;
-         float sum_r              = 0.0f;
-         float *phase_table       = NULL;
-         float *delta_table       = NULL;
-         const float *buffer_l    = resamp->buffer_l + resamp->ptr;
-         const float *buffer_r    = resamp->buffer_r + resamp->ptr;
-         unsigned taps            = resamp->taps;
+         const float *buffer      = resamp->buffer_l + resamp->ptr;
+         const float *phase_table = NULL;
+         const float *delta_table = NULL;
          unsigned phase           = resamp->time >> resamp->subphase_bits;
 
          if (resamp->window_type == SINC_WINDOW_KAISER)
@@ -412,39 +556,469 @@ static void resampler_sinc_process_c(void *re_, struct resampler_data *data)
                (resamp->time & resamp->subphase_mask) * resamp->subphase_mod;
          }
          else
-         {
             phase_table           = resamp->phase_table + phase * taps;
-         }
+
+         for (c = 0; c < channels; c++)
+            sum[c]                = 0.0f;
 
          for (i = 0; i < taps; i++)
          {
             float sinc_val        = phase_table[i];
 
-            if (resamp->window_type == SINC_WINDOW_KAISER)
+            if (delta_table)
                sinc_val           = sinc_val + delta_table[i] * delta;
 
-            sum_l                += buffer_l[i] * sinc_val;
-            sum_r                += buffer_r[i] * sinc_val;
+            for (c = 0; c < channels; c++)
+               sum[c]            += buffer[c * 2 * taps + i] * sinc_val;
          }
 
-         output[0]                = sum_l;
-         output[1]                = sum_r;
+         for (c = 0; c < channels; c++)
+            output[c]             = sum[c];
 
-         output                  += 2;
+         output                  += channels;
          out_frames++;
          resamp->time            += ratio;
       }
+   }
+
+   data->output_frames = out_frames;
+}
+
+#undef SINC_PUSH_MULTI
+
+/**
+ * resampler_sinc_init_downmix:
+ * @resamp             : Resampler handle.
+ *
+ * Creates the matrix used to map input channels to output channels.
+ * 5.1 and 7.1 (FL FR FC LFE BL BR [SL SR]) to stereo use the ITU-R
+ * BS.775 coefficients. Mono output averages all channels. Otherwise
+ * the first channels are passed through and the rest are dropped.
+ *
+ * Returns: true (1) if successful, otherwise false (0).
+ **/
+static bool resampler_sinc_init_downmix(rarch_sinc_resampler_t *resamp)
+{
+   unsigned c, k;
+   const float center   = 0.7071f;
+   unsigned channels    = resamp->channels;
+   unsigned in_channels = resamp->in_channels;
+   float *m             = (float*)calloc(channels * in_channels, sizeof(float));
+
+   if (!m)
+      return false;
+
+   if (channels == 2 && (in_channels == 6 || in_channels == 8))
+   {
+      float norm = 1.0f / (1.0f + center + center * (in_channels == 8 ? 2 : 1));
+
+      for (c = 0; c < 2; c++)
+      {
+         float *row = m + c * in_channels;
+
+         row[c]     = norm;          /* FL / FR */
+         row[2]     = norm * center; /* FC */
+         row[4 + c] = norm * center; /* BL / BR */
+         if (in_channels == 8)
+            row[6 + c] = norm * center; /* SL / SR */
+      }
+   }
+   else if (channels == 1)
+   {
+      for (k = 0; k < in_channels; k++)
+         m[k] = 1.0f / in_channels;
+   }
+   else
+   {
+      for (c = 0; c < channels && c < in_channels; c++)
+         m[c * in_channels + c] = 1.0f;
+   }
+
+   resamp->downmix = m;
+   return true;
+}
+
+/* Block mode.
+ *
+ * Output frames are gathered in tiles of SINC_BLOCK_FRAMES. Each
+ * frame of a tile is filtered on its own, since interleaving them
+ * runs out of registers at the higher qualities, but the horizontal
+ * sums and the interleaved stores are shared. The history ring is
+ * extended by SINC_BLOCK_HISTORY frames so input can be pushed while
+ * a tile is gathered without overwriting the windows of earlier
+ * frames.
+ *
+ * For the Kaiser window, each row of the phase table is transposed
+ * into blocks of block_width coefficients followed by their deltas,
+ * so both are read from a single aligned stream.
+ */
+
+#define SINC_BLOCK_FRAMES  4
+#define SINC_BLOCK_HISTORY 16
+
+typedef void (*sinc_tile_t)(const rarch_sinc_resampler_t *resamp,
+      const unsigned *ptr, const uint32_t *time, float *out);
 
+static INLINE void resampler_sinc_process_block(
+      rarch_sinc_resampler_t *resamp, struct resampler_data *data,
+      sinc_tile_t tile)
+{
+   unsigned j;
+   unsigned ptr[SINC_BLOCK_FRAMES];
+   uint32_t time[SINC_BLOCK_FRAMES];
+   float out[2 * SINC_BLOCK_FRAMES];
+   unsigned phases                = 1 << (resamp->phase_bits + resamp->subphase_bits);
+
+   uint32_t ratio                 = phases / data->ratio;
+   const float *input             = data->data_in;
+   float *output                  = data->data_out;
+   size_t frames                  = data->input_frames;
+   size_t out_frames              = 0;
+   unsigned n                     = 0;
+   unsigned pushed                = 0;
+
+   /* Keep the resampler state in locals, as stores to the history
+    * and output could otherwise alias it. */
+   float *buffer_l                = resamp->buffer_l;
+   float *buffer_r                = resamp->buffer_r;
+   unsigned ring                  = resamp->ring;
+   unsigned rptr                  = resamp->ptr;
+   uint32_t rtime                 = resamp->time;
+
+   if (!frames)
+   {
+      data->output_frames = 0;
+      return;
    }
 
+   for (;;)
+   {
+      while (rtime >= phases)
+      {
+         if (!frames)
+            goto end;
+
+         /* The ring cannot hold more input without overwriting
+          * the window of the first gathered frame. */
+         if (n && pushed == SINC_BLOCK_HISTORY)
+         {
+            for (j = n; j < SINC_BLOCK_FRAMES; j++)
+            {
+               ptr[j]  = ptr[n - 1];
+               time[j] = time[n - 1];
+            }
+
+            tile(resamp, ptr, time, out);
+            memcpy(output, out, 2 * n * sizeof(float));
+            output     += 2 * n;
+            out_frames += n;
+            n           = 0;
+         }
+
+         /* Push in reverse to make filter more obvious. */
+         if (!rptr)
+            rptr = ring;
+         rptr--;
+
+         buffer_l[rptr + ring] = buffer_l[rptr] = input[0];
+         buffer_r[rptr + ring] = buffer_r[rptr] = input[1];
+
+         input  += 2;
+         rtime  -= phases;
+         frames--;
+         pushed++;
+      }
+
+      if (!n)
+         pushed       = 0;
+
+      ptr[n]          = rptr;
+      time[n]         = rtime;
+      rtime          += ratio;
+
+      if (++n == SINC_BLOCK_FRAMES)
+      {
+         tile(resamp, ptr, time, output);
+         output      += 2 * SINC_BLOCK_FRAMES;
+         out_frames  += SINC_BLOCK_FRAMES;
+         n            = 0;
+      }
+   }
+
+end:
+   if (n)
+   {
+      for (j = n; j < SINC_BLOCK_FRAMES; j++)
+      {
+         ptr[j]  = ptr[n - 1];
+         time[j] = time[n - 1];
+      }
+
+      tile(resamp, ptr, time, out);
+      memcpy(output, out, 2 * n * sizeof(float));
+      out_frames += n;
+   }
+
+   resamp->ptr         = rptr;
+   resamp->time        = rtime;
    data->output_frames = out_frames;
 }
 
+#if defined(__SSE__)
+#if defined(__FMA__)
+#define SINC_MADD_PS(a, b, c)    _mm_fmadd_ps(a, b, c)
+#define SINC_MADD256_PS(a, b, c) _mm256_fmadd_ps(a, b, c)
+#else
+#define SINC_MADD_PS(a, b, c)    _mm_add_ps(_mm_mul_ps(a, b), c)
+#define SINC_MADD256_PS(a, b, c) _mm256_add_ps(_mm256_mul_ps(a, b), c)
+#endif
+
+/* Returns { sum(a), sum(b), sum(c), sum(d) }. */
+static INLINE __m128 sinc_hsum4_sse(__m128 a, __m128 b, __m128 c, __m128 d)
+{
+   __m128 ab = _mm_add_ps(_mm_unpacklo_ps(a, b), _mm_unpackhi_ps(a, b));
+   __m128 cd = _mm_add_ps(_mm_unpacklo_ps(c, d), _mm_unpackhi_ps(c, d));
+   return _mm_add_ps(_mm_movelh_ps(ab, cd), _mm_movehl_ps(cd, ab));
+}
+
+/* Stores four stereo frames from per-channel sums. */
+static INLINE void sinc_store_tile_sse(float *out, __m128 l, __m128 r)
+{
+   _mm_storeu_ps(out + 0, _mm_unpacklo_ps(l, r));
+   _mm_storeu_ps(out + 4, _mm_unpackhi_ps(l, r));
+}
+#endif
+
+#if defined(__AVX__)
+static void resampler_sinc_tile_avx(const rarch_sinc_resampler_t *resamp,
+      const unsigned *ptr, const uint32_t *time, float *out)
+{
+   unsigned i, j;
+   __m128 sum_l[SINC_BLOCK_FRAMES], sum_r[SINC_BLOCK_FRAMES];
+   unsigned taps = resamp->taps;
+   bool kaiser   = resamp->window_type == SINC_WINDOW_KAISER;
+
+   for (j = 0; j < SINC_BLOCK_FRAMES; j++)
+   {
+      const float *buffer_l = resamp->buffer_l + ptr[j];
+      const float *buffer_r = resamp->buffer_r + ptr[j];
+      unsigned phase        = time[j] >> resamp->subphase_bits;
+      __m256 l              = _mm256_setzero_ps();
+      __m256 r              = _mm256_setzero_ps();
+
+      if (kaiser)
+      {
+         const float *t     = resamp->phase_table + phase * taps * 2;
+         __m256 delta       = _mm256_set1_ps((float)
+               (time[j] & resamp->subphase_mask) * resamp->subphase_mod);
+
+         for (i = 0; i < taps; i += 8, t += 16)
+         {
+            __m256 sinc     = SINC_MADD256_PS(_mm256_load_ps(t + 8), delta,
+                  _mm256_load_ps(t));
+            l               = SINC_MADD256_PS(_mm256_loadu_ps(buffer_l + i),
+                  sinc, l);
+            r               = SINC_MADD256_PS(_mm256_loadu_ps(buffer_r + i),
+                  sinc, r);
+         }
+      }
+      else
+      {
+         const float *t     = resamp->phase_table + phase * taps;
+
+         for (i = 0; i < taps; i += 8)
+         {
+            __m256 sinc     = _mm256_load_ps(t + i);
+            l               = SINC_MADD256_PS(_mm256_loadu_ps(buffer_l + i),
+                  sinc, l);
+            r               = SINC_MADD256_PS(_mm256_loadu_ps(buffer_r + i),
+                  sinc, r);
+         }
+      }
+
+      /* Fold to 128 bits here and leave the horizontal sums to the tile. */
+      sum_l[j]              = _mm_add_ps(_mm256_castps256_ps128(l),
+            _mm256_extractf128_ps(l, 1));
+      sum_r[j]              = _mm_add_ps(_mm256_castps256_ps128(r),
+            _mm256_extractf128_ps(r, 1));
+   }
+
+   sinc_store_tile_sse(out,
+         sinc_hsum4_sse(sum_l[0], sum_l[1], sum_l[2], sum_l[3]),
+         sinc_hsum4_sse(sum_r[0], sum_r[1], sum_r[2], sum_r[3]));
+}
+
+static void resampler_sinc_process_block_avx(void *re_,
+      struct resampler_data *data)
+{
+   resampler_sinc_process_block((rarch_sinc_resampler_t*)re_, data,
+         resampler_sinc_tile_avx);
+}
+#endif
+
+#if defined(__SSE__)
+static void resampler_sinc_tile_sse(const rarch_sinc_resampler_t *resamp,
+      const unsigned *ptr, const uint32_t *time, float *out)
+{
+   unsigned i, j;
+   __m128 sum_l[SINC_BLOCK_FRAMES], sum_r[SINC_BLOCK_FRAMES];
+   unsigned taps = resamp->taps;
+   bool kaiser   = resamp->window_type == SINC_WINDOW_KAISER;
+
+   for (j = 0; j < SINC_BLOCK_FRAMES; j++)
+   {
+      const float *buffer_l = resamp->buffer_l + ptr[j];
+      const float *buffer_r = resamp->buffer_r + ptr[j];
+      unsigned phase        = time[j] >> resamp->subphase_bits;
+      __m128 l              = _mm_setzero_ps();
+      __m128 r              = _mm_setzero_ps();
+
+      if (kaiser)
+      {
+         const float *t     = resamp->phase_table + phase * taps * 2;
+         __m128 delta       = _mm_set1_ps((float)
+               (time[j] & resamp->subphase_mask) * resamp->subphase_mod);
+
+         for (i = 0; i < taps; i += 4, t += 8)
+         {
+            __m128 sinc     = SINC_MADD_PS(_mm_load_ps(t + 4), delta,
+                  _mm_load_ps(t));
+            l               = SINC_MADD_PS(_mm_loadu_ps(buffer_l + i), sinc, l);
+            r               = SINC_MADD_PS(_mm_loadu_ps(buffer_r + i), sinc, r);
+         }
+      }
+      else
+      {
+         const float *t     = resamp->phase_table + phase * taps;
+
+         for (i = 0; i < taps; i += 4)
+         {
+            __m128 sinc     = _mm_load_ps(t + i);
+            l               = SINC_MADD_PS(_mm_loadu_ps(buffer_l + i), sinc, l);
+            r               = SINC_MADD_PS(_mm_loadu_ps(buffer_r + i), sinc, r);
+         }
+      }
+
+      sum_l[j]              = l;
+      sum_r[j]              = r;
+   }
+
+   sinc_store_tile_sse(out,
+         sinc_hsum4_sse(sum_l[0], sum_l[1], sum_l[2], sum_l[3]),
+         sinc_hsum4_sse(sum_r[0], sum_r[1], sum_r[2], sum_r[3]));
+}
+
+static void resampler_sinc_process_block_sse(void *re_,
+      struct resampler_data *data)
+{
+   resampler_sinc_process_block((rarch_sinc_resampler_t*)re_, data,
+         resampler_sinc_tile_sse);
+}
+#endif
+
+static void resampler_sinc_tile_c(const rarch_sinc_resampler_t *resamp,
+      const unsigned *ptr, const uint32_t *time, float *out)
+{
+   unsigned i, j, k;
+   unsigned taps = resamp->taps;
+   bool kaiser   = resamp->window_type == SINC_WINDOW_KAISER;
+
+   for (j = 0; j < SINC_BLOCK_FRAMES; j++)
+   {
+      float sum_l[4]        = {0.0f};
+      float sum_r[4]        = {0.0f};
+      const float *buffer_l = resamp->buffer_l + ptr[j];
+      const float *buffer_r = resamp->buffer_r + ptr[j];
+      unsigned phase        = time[j] >> resamp->subphase_bits;
+      float delta           = (float)
+         (time[j] & resamp->subphase_mask) * resamp->subphase_mod;
+
+      if (kaiser)
+      {
+         const float *t     = resamp->phase_table + phase * taps * 2;
+
+         for (i = 0; i < taps; i += 4, t += 8)
+         {
+            for (k = 0; k < 4; k++)
+            {
+               float sinc_val = t[k] + t[4 + k] * delta;
+               sum_l[k]      += buffer_l[i + k] * sinc_val;
+               sum_r[k]      += buffer_r[i + k] * sinc_val;
+            }
+         }
+      }
+      else
+      {
+         const float *t     = resamp->phase_table + phase * taps;
+
+         for (i = 0; i < taps; i += 4)
+         {
+            for (k = 0; k < 4; k++)
+            {
+               sum_l[k]      += buffer_l[i + k] * t[i + k];
+               sum_r[k]      += buffer_r[i + k] * t[i + k];
+            }
+         }
+      }
+
+      out[2 * j + 0] = (sum_l[0] + sum_l[2]) + (sum_l[1] + sum_l[3]);
+      out[2 * j + 1] = (sum_r[0] + sum_r[2]) + (sum_r[1] + sum_r[3]);
+   }
+}
+
+static void resampler_sinc_process_block_c(void *re_,
+      struct resampler_data *data)
+{
+   resampler_sinc_process_block((rarch_sinc_resampler_t*)re_, data,
+         resampler_sinc_tile_c);
+}
+
+/**
+ * sinc_transpose_table:
+ * @resamp             : Resampler handle.
+ * @width              : Number of taps per block.
+ *
+ * Rewrites each row of the Kaiser phase table from all coefficients
+ * followed by all deltas, into blocks of @width coefficients each
+ * followed by their @width deltas.
+ *
+ * Returns: true (1) if successful, otherwise false (0).
+ **/
+static bool sinc_transpose_table(rarch_sinc_resampler_t *resamp,
+      unsigned width)
+{
+   unsigned p, b;
+   unsigned taps = resamp->taps;
+   float *tmp    = (float*)malloc(2 * taps * sizeof(float));
+
+   if (!tmp)
+      return false;
+
+   for (p = 0; p < (1u << resamp->phase_bits); p++)
+   {
+      float *row = resamp->phase_table + p * taps * 2;
+
+      memcpy(tmp, row, 2 * taps * sizeof(float));
+
+      for (b = 0; b < taps; b += width)
+      {
+         memcpy(row + 2 * b,         tmp + b,        width * sizeof(float));
+         memcpy(row + 2 * b + width, tmp + taps + b, width * sizeof(float));
+      }
+   }
+
+   free(tmp);
+   return true;
+}
+
 static void resampler_sinc_free(void *data)
 {
    rarch_sinc_resampler_t *resamp = (rarch_sinc_resampler_t*)data;
    if (resamp)
+   {
       memalign_free(resamp->main_buffer);
+      free(resamp->downmix);
+   }
    free(resamp);
 }
 
@@ -578,6 +1152,18 @@ static void *resampler_sinc_new(const struct resampler_config *config,
       return NULL;
 
    re->window_type                = SINC_WINDOW_NONE;
+   re->process                    = resampler_sinc_process_c;
+   re->in_channels                = config && config->channels
+      ? config->channels : 2;
+   re->channels                   = config && config->out_channels
+      ? config->out_channels : re->in_channels;
+
+   if (re->in_channels > RESAMPLER_MAX_CHANNELS ||
+         re->channels > re->in_channels)
+      goto error;
+
+   if (re->channels != re->in_channels && !resampler_sinc_init_downmix(re))
+      goto error;
 
    switch (quality)
    {
@@ -653,18 +1239,76 @@ static void *resampler_sinc_new(const struct resampler_config *config,
 #endif
    }
 
+   re->ring        = re->taps;
+
+   if (re->channels != 2 || re->downmix)
+   {
+      re->process = resampler_sinc_process_multi_c;
+
+      if (mask & RESAMPLER_SIMD_AVX && re->enable_avx)
+      {
+#if defined(__AVX__)
+         re->process = resampler_sinc_process_multi_avx;
+#endif
+      }
+      else if (mask & RESAMPLER_SIMD_SSE)
+      {
+#if defined(__SSE__)
+         re->process = resampler_sinc_process_multi_sse;
+#endif
+      }
+      else if (mask & RESAMPLER_SIMD_NEON)
+      {
+#if defined(WANT_NEON)
+         re->process = resampler_sinc_process_multi_neon;
+#endif
+      }
+   }
+   else
+   {
+      re->process     = resampler_sinc_process_block_c;
+      re->block_width = 4;
+
+      if (mask & RESAMPLER_SIMD_AVX && re->enable_avx)
+      {
+#if defined(__AVX__)
+         re->process     = resampler_sinc_process_block_avx;
+         re->block_width = 8;
+#endif
+      }
+      else if (mask & RESAMPLER_SIMD_SSE)
+      {
+#if defined(__SSE__)
+         re->process = resampler_sinc_process_block_sse;
+#endif
+      }
+      else if (mask & RESAMPLER_SIMD_NEON && re->window_type != SINC_WINDOW_KAISER)
+      {
+#if defined(WANT_NEON)
+         re->process     = resampler_sinc_process_neon;
+         re->block_width = 0;
+#endif
+      }
+
+      if (re->block_width)
+         re->ring = re->taps + SINC_BLOCK_HISTORY;
+   }
+
    phase_elems     = ((1 << re->phase_bits) * re->taps);
    if (re->window_type == SINC_WINDOW_KAISER)
       phase_elems  = phase_elems * 2;
-   elems           = phase_elems + 4 * re->taps;
+   elems           = phase_elems + 2 * re->ring * re->channels;
 
    re->main_buffer = (float*)memalign_alloc(128, sizeof(float) * elems);
    if (!re->main_buffer)
       goto error;
 
+   memset(re->main_buffer + phase_elems, 0,
+         sizeof(float) * 2 * re->ring * re->channels);
+
    re->phase_table = re->main_buffer;
    re->buffer_l    = re->main_buffer + phase_elems;
-   re->buffer_r    = re->buffer_l + 2 * re->taps;
+   re->buffer_r    = re->buffer_l + 2 * re->ring;
 
    switch (re->window_type)
    {
@@ -675,32 +1319,13 @@ static void *resampler_sinc_new(const struct resampler_config *config,
       case SINC_WINDOW_KAISER:
          sinc_init_table_kaiser(re, cutoff, re->phase_table,
                1 << re->phase_bits, re->taps, true);
+         if (re->block_width && !sinc_transpose_table(re, re->block_width))
+            goto error;
          break;
       case SINC_WINDOW_NONE:
          goto error;
    }
 
-   sinc_resampler.process = resampler_sinc_process_c;
-
-   if (mask & RESAMPLER_SIMD_AVX && re->enable_avx)
-   {
-#if defined(__AVX__)
-      sinc_resampler.process = resampler_sinc_process_avx;
-#endif
-   }
-   else if (mask & RESAMPLER_SIMD_SSE)
-   {
-#if defined(__SSE__)
-      sinc_resampler.process = resampler_sinc_process_sse;
-#endif
-   }
-   else if (mask & RESAMPLER_SIMD_NEON && re->window_type != SINC_WINDOW_KAISER)
-   {
-#if defined(WANT_NEON)
-      sinc_resampler.process = resampler_sinc_process_neon;
-#endif
-   }
-
    return re;
 
 error:
@@ -708,9 +1333,15 @@ error:
    return NULL;
 }
 
+static void resampler_sinc_process(void *re_, struct resampler_data *data)
+{
+   rarch_sinc_resampler_t *resamp = (rarch_sinc_resampler_t*)re_;
+   resamp->process(re_, data);
+}
+
 retro_resampler_t sinc_resampler = {
    resampler_sinc_new,
-   resampler_sinc_process_c,
+   resampler_sinc_process,
    resampler_sinc_free,
    RESAMPLER_API_VERSION,
    "sinc",
@@ -46,6 +46,52 @@ struct rwav_iterator
    int step;
 };
 
+/* Checks the header and fills everything but the samples. */
+static enum rwav_state rwav_parse_header(rwav_t *rwav,
+      const uint8_t *data, size_t size)
+{
+   if (size < 44)
+      return RWAV_ITERATE_ERROR; /* buffer is smaller than an empty wave file */
+
+   if (data[0] != 'R' || data[1] != 'I' || data[2] != 'F' || data[3] != 'F')
+      return RWAV_ITERATE_ERROR;
+
+   if (data[8] != 'W' || data[9] != 'A' || data[10] != 'V' || data[11] != 'E')
+      return RWAV_ITERATE_ERROR;
+
+   if (data[12] != 'f' || data[13] != 'm' || data[14] != 't' || data[15] != ' ')
+      return RWAV_ITERATE_ERROR; /* we don't support non-PCM or compressed data */
+
+   if (data[16] != 16 || data[17] != 0 || data[18] != 0 || data[19] != 0)
+      return RWAV_ITERATE_ERROR;
+
+   if (data[20] != 1 || data[21] != 0)
+      return RWAV_ITERATE_ERROR; /* we don't support non-PCM or compressed data */
+
+   if (data[36] != 'd' || data[37] != 'a' || data[38] != 't' || data[39] != 'a')
+      return RWAV_ITERATE_ERROR;
+
+   rwav->bitspersample = data[34] | data[35] << 8;
+
+   if (rwav->bitspersample != 8 && rwav->bitspersample != 16)
+      return RWAV_ITERATE_ERROR; /* we only support 8 and 16 bps */
+
+   rwav->subchunk2size = data[40] | data[41] << 8 | data[42] << 16 | data[43] << 24;
+
+   if (rwav->subchunk2size > size - 44)
+      return RWAV_ITERATE_ERROR; /* too few bytes in buffer */
+
+   rwav->numchannels = data[22] | data[23] << 8;
+
+   if (rwav->numchannels == 0)
+      return RWAV_ITERATE_ERROR;
+
+   rwav->numsamples  = rwav->subchunk2size * 8 / rwav->bitspersample / rwav->numchannels;
+   rwav->samplerate  = data[24] | data[25] << 8 | data[26] << 16 | data[27] << 24;
+
+   return RWAV_ITERATE_DONE;
+}
+
 void rwav_init(rwav_iterator_t* iter, rwav_t* out, const void* buf, size_t size)
 {
    iter->out    = out;
@@ -67,45 +113,14 @@ enum rwav_state rwav_iterate(rwav_iterator_t *iter)
    switch (iter->step)
    {
       case ITER_BEGIN:
-         if (iter->size < 44)
-            return RWAV_ITERATE_ERROR; /* buffer is smaller than an empty wave file */
-
-         if (data[0] != 'R' || data[1] != 'I' || data[2] != 'F' || data[3] != 'F')
+         if (rwav_parse_header(rwav, data, iter->size) != RWAV_ITERATE_DONE)
             return RWAV_ITERATE_ERROR;
 
-         if (data[8] != 'W' || data[9] != 'A' || data[10] != 'V' || data[11] != 'E')
-            return RWAV_ITERATE_ERROR;
-
-         if (data[12] != 'f' || data[13] != 'm' || data[14] != 't' || data[15] != ' ')
-            return RWAV_ITERATE_ERROR; /* we don't support non-PCM or compressed data */
-
-         if (data[16] != 16 || data[17] != 0 || data[18] != 0 || data[19] != 0)
-            return RWAV_ITERATE_ERROR;
-
-         if (data[20] != 1 || data[21] != 0)
-            return RWAV_ITERATE_ERROR; /* we don't support non-PCM or compressed data */
-
-         if (data[36] != 'd' || data[37] != 'a' || data[38] != 't' || data[39] != 'a')
-            return RWAV_ITERATE_ERROR;
-
-         rwav->bitspersample = data[34] | data[35] << 8;
-
-         if (rwav->bitspersample != 8 && rwav->bitspersample != 16)
-            return RWAV_ITERATE_ERROR; /* we only support 8 and 16 bps */
-
-         rwav->subchunk2size = data[40] | data[41] << 8 | data[42] << 16 | data[43] << 24;
-
-         if (rwav->subchunk2size > iter->size - 44)
-            return RWAV_ITERATE_ERROR; /* too few bytes in buffer */
-
          samples = malloc(rwav->subchunk2size);
 
          if (samples == NULL)
             return RWAV_ITERATE_ERROR;
 
-         rwav->numchannels = data[22] | data[23] << 8;
-         rwav->numsamples  = rwav->subchunk2size * 8 / rwav->bitspersample / rwav->numchannels;
-         rwav->samplerate  = data[24] | data[25] << 8 | data[26] << 16 | data[27] << 24;
          rwav->samples     = samples;
 
          iter->step = ITER_COPY_SAMPLES;
@@ -180,6 +195,19 @@ enum rwav_state rwav_load(rwav_t* out, const void* buf, size_t size)
    return res;
 }
 
+enum rwav_state rwav_parse(rwav_t* out, const void* buf, size_t size)
+{
+   const uint8_t *data = (const uint8_t*)buf;
+
+   out->samples = NULL;
+
+   if (rwav_parse_header(out, data, size) != RWAV_ITERATE_DONE)
+      return RWAV_ITERATE_ERROR;
+
+   out->samples = data + 44;
+   return RWAV_ITERATE_DONE;
+}
+
 void rwav_free(rwav_t *rwav)
 {
    free((void*)rwav->samples);
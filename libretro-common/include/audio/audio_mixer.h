@@ -43,7 +43,8 @@ enum audio_mixer_type
    AUDIO_MIXER_TYPE_OGG,
    AUDIO_MIXER_TYPE_MOD,
    AUDIO_MIXER_TYPE_FLAC,
-   AUDIO_MIXER_TYPE_MP3
+   AUDIO_MIXER_TYPE_MP3,
+   AUDIO_MIXER_TYPE_WAV_STREAM
 };
 
 typedef struct audio_mixer_sound audio_mixer_sound_t;
@@ -61,18 +62,39 @@ void audio_mixer_init(unsigned rate);
 void audio_mixer_done(void);
 
 audio_mixer_sound_t* audio_mixer_load_wav(void *buffer, int32_t size);
+/* Same as audio_mixer_load_wav(), but the samples are converted and
+ * resampled while mixing, instead of up front. Like the compressed
+ * formats below, the sound keeps using and frees the buffer. */
+audio_mixer_sound_t* audio_mixer_load_wav_stream(void *buffer, int32_t size);
+/* Same as audio_mixer_load_wav_stream(), reading the file through a
+ * read-only mapping where mmap is available, so that only the pages
+ * being mixed are kept in memory. Reads it into a buffer otherwise. */
+audio_mixer_sound_t* audio_mixer_load_wav_file(const char *path);
 audio_mixer_sound_t* audio_mixer_load_ogg(void *buffer, int32_t size);
 audio_mixer_sound_t* audio_mixer_load_mod(void *buffer, int32_t size);
 audio_mixer_sound_t* audio_mixer_load_flac(void *buffer, int32_t size);
 audio_mixer_sound_t* audio_mixer_load_mp3(void *buffer, int32_t size);
 
+/* Can be called from any thread, including from a stop callback,
+ * and never waits. The sound is only freed by the next
+ * audio_mixer_play() or audio_mixer_done() call, which also stops
+ * the voices still playing it, or by a later one if the mixer
+ * hasn't let go of it yet. */
 void audio_mixer_destroy(audio_mixer_sound_t* sound);
 
+/* Voices are controlled by posting commands that the next
+ * audio_mixer_mix() call applies, so the thread mixing never waits
+ * on the one playing sounds. Stop callbacks are therefore always
+ * invoked from audio_mixer_mix(), on the thread mixing, and must
+ * not block. They may destroy the sound. */
+
 audio_mixer_voice_t* audio_mixer_play(audio_mixer_sound_t* sound,
       bool repeat, float volume, audio_mixer_stop_cb_t stop_cb);
 
 void audio_mixer_stop(audio_mixer_voice_t* voice);
 
+void audio_mixer_voice_set_volume(audio_mixer_voice_t* voice, float volume);
+
 void audio_mixer_mix(float* buffer, size_t num_frames, float volume_override, bool override);
 
 RETRO_END_DECLS
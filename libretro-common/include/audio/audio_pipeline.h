@@ -0,0 +1,103 @@
+/* Copyright  (C) 2010-2018 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (audio_pipeline.h).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __LIBRETRO_SDK_AUDIO_PIPELINE_H__
+#define __LIBRETRO_SDK_AUDIO_PIPELINE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <boolean.h>
+#include <retro_common_api.h>
+
+#include <audio/audio_resampler.h>
+#include <audio/dsp_filter.h>
+
+RETRO_BEGIN_DECLS
+
+/* Number of input frames that go through all stages at once. */
+#define AUDIO_PIPELINE_BLOCK_FRAMES 256
+
+/* Turns interleaved stereo s16 samples into float, resamples and
+ * filters them, and converts them back to s16. Instead of running
+ * each stage over the whole buffer, the stages are chained over
+ * blocks small enough to stay in the cache, and all intermediate
+ * data lives in a single buffer allocated up front. */
+typedef struct audio_pipeline audio_pipeline_t;
+
+struct audio_pipeline_config
+{
+   /* Resampler driver, NULL for the default one. */
+   const char *resampler_ident;
+   enum resampler_quality quality;
+
+   /* Highest ratio audio_pipeline_process() will be called with,
+    * 0.0 to not resample at all. */
+   double max_ratio;
+
+   /* Optional filter, which must output as many frames as it gets:
+    * audio_pipeline_new() fails unless retro_dsp_filter_in_place()
+    * is true for it. It isn't freed with the pipeline. */
+   retro_dsp_filter_t *dsp;
+
+   /* Gain applied when converting to float. */
+   float gain;
+};
+
+/**
+ * audio_pipeline_new:
+ * @config             : Stages to set up.
+ *
+ * Returns: new pipeline, or NULL on failure.
+ **/
+audio_pipeline_t *audio_pipeline_new(const struct audio_pipeline_config *config);
+
+void audio_pipeline_free(audio_pipeline_t *pipe);
+
+/**
+ * audio_pipeline_max_output_frames:
+ * @pipe               : Pipeline handle.
+ * @frames             : Number of input frames.
+ *
+ * Returns: number of frames @out must hold when processing @frames
+ * input frames.
+ **/
+size_t audio_pipeline_max_output_frames(audio_pipeline_t *pipe,
+      size_t frames);
+
+/**
+ * audio_pipeline_process:
+ * @pipe               : Pipeline handle.
+ * @out                : Output samples.
+ * @in                 : Input samples.
+ * @frames             : Number of input frames.
+ * @ratio              : Resampling ratio, clamped to the configured
+ *                       max_ratio. Ignored when not resampling.
+ *
+ * Returns: number of frames written to @out.
+ **/
+size_t audio_pipeline_process(audio_pipeline_t *pipe, int16_t *out,
+      const int16_t *in, size_t frames, double ratio);
+
+RETRO_END_DECLS
+
+#endif
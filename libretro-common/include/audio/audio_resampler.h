@@ -65,6 +65,10 @@ typedef unsigned resampler_simd_mask_t;
 
 #define RESAMPLER_API_VERSION 1
 
+/* Maximum number of interleaved channels accepted by multichannel
+ * resamplers, enough for 7.1 audio. */
+#define RESAMPLER_MAX_CHANNELS 8
+
 struct resampler_data
 {
    const float *data_in;
@@ -113,6 +117,16 @@ struct resampler_config
    /* Avoid problems where resampler plug and host are
     * linked against different C runtimes. */
    resampler_config_free_t free;
+
+   /* Number of interleaved channels in resampler_data::data_in.
+    * 0 is treated as 2 (stereo). Drivers which only handle
+    * stereo fail to initialize for any other count. */
+   unsigned channels;
+
+   /* Number of interleaved channels in resampler_data::data_out.
+    * 0 means the same as channels. When it differs, input frames are
+    * downmixed (e.g. 5.1/7.1 to stereo) before filtering. */
+   unsigned out_channels;
 };
 
 /* Bandwidth factor. Will be < 1.0 for downsampling, > 1.0 for upsampling.
@@ -151,6 +165,7 @@ typedef struct audio_frame_float
 } audio_frame_float_t;
 
 extern retro_resampler_t sinc_resampler;
+extern retro_resampler_t polyphase_resampler;
 #ifdef HAVE_CC_RESAMPLER
 extern retro_resampler_t CC_resampler;
 #endif
@@ -190,6 +205,25 @@ const char *audio_resampler_driver_find_ident(int index);
 bool retro_resampler_realloc(void **re, const retro_resampler_t **backend,
       const char *ident, enum resampler_quality quality, double bw_ratio);
 
+/**
+ * retro_resampler_realloc_channels:
+ * @re                         : Resampler handle
+ * @backend                    : Resampler backend that is about to be set.
+ * @ident                      : Identifier name for resampler we want.
+ * @channels                   : Number of interleaved input channels.
+ * @out_channels               : Number of interleaved output channels.
+ * @bw_ratio                   : Bandwidth ratio.
+ *
+ * Same as retro_resampler_realloc(), but for multichannel audio.
+ * Input with more channels than @out_channels is downmixed.
+ *
+ * Returns: true (1) if successful, otherwise false (0).
+ **/
+bool retro_resampler_realloc_channels(void **re,
+      const retro_resampler_t **backend,
+      const char *ident, enum resampler_quality quality,
+      unsigned channels, unsigned out_channels, double bw_ratio);
+
 RETRO_END_DECLS
 
 #endif
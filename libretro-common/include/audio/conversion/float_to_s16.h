@@ -30,6 +30,29 @@ RETRO_BEGIN_DECLS
 #include <stdint.h>
 #include <stddef.h>
 
+enum convert_float_to_s16_dither
+{
+   /* Plain rounding. */
+   CONVERT_FLOAT_TO_S16_DITHER_NONE = 0,
+   /* Triangular noise of +/- 1 LSB added before rounding. */
+   CONVERT_FLOAT_TO_S16_DITHER_TPDF,
+   /* Same, with the rounding error of each channel fed back into
+    * its next sample, which moves the noise to higher frequencies. */
+   CONVERT_FLOAT_TO_S16_DITHER_TPDF_SHAPED
+};
+
+#define CONVERT_FLOAT_TO_S16_MAX_CHANNELS 8
+
+/* Noise generators and shaping error of one stream. Each stream
+ * needs its own, so that they don't disturb each other. */
+struct convert_float_to_s16_dither_state
+{
+   enum convert_float_to_s16_dither dither;
+   unsigned channels;
+   uint32_t seed[16];
+   float error[CONVERT_FLOAT_TO_S16_MAX_CHANNELS];
+};
+
 /**
  * convert_float_to_s16:
  * @out               : output buffer
@@ -50,6 +73,34 @@ void convert_float_to_s16(int16_t *out,
  **/
 void convert_float_to_s16_init_simd(void);
 
+/**
+ * convert_float_to_s16_init_dither:
+ * @state             : dithering state to set up
+ * @dither            : dithering to use
+ * @channels          : number of interleaved channels, at most
+ *                      CONVERT_FLOAT_TO_S16_MAX_CHANNELS
+ *
+ * Sets up the dithering state of a stream.
+ **/
+void convert_float_to_s16_init_dither(
+      struct convert_float_to_s16_dither_state *state,
+      enum convert_float_to_s16_dither dither, unsigned channels);
+
+/**
+ * convert_float_to_s16_dithered:
+ * @state             : dithering state of the stream
+ * @out               : output buffer
+ * @in                : input buffer
+ * @samples           : size of samples to be converted, a multiple
+ *                      of the number of channels
+ *
+ * Same as convert_float_to_s16(), dithering as set up in @state,
+ * which keeps what it needs between calls.
+ **/
+void convert_float_to_s16_dithered(
+      struct convert_float_to_s16_dither_state *state,
+      int16_t *out, const float *in, size_t samples);
+
 RETRO_END_DECLS
 
 #endif
@@ -23,10 +23,32 @@
 #ifndef __LIBRETRO_SDK_AUDIO_DSP_FILTER_H
 #define __LIBRETRO_SDK_AUDIO_DSP_FILTER_H
 
+#include <boolean.h>
 #include <retro_common_api.h>
 
 RETRO_BEGIN_DECLS
 
+/* A graph of DSP plugs, set up from a config file.
+ *
+ * filters = N and filter0 .. filterN-1 name plugs run one after
+ * another. branches = M then feeds their output to M chains, each
+ * set up the same way with branchK_filters and branchK_filter0 and
+ * so on, whose outputs are added up, scaled by branchK_mix (1.0 by
+ * default). A branch without filters passes its input through, as
+ * the dry signal of a dry/wet split. Branches are delayed to line up
+ * with the one with the most latency. Only filters that declare
+ * DSPFILTER_FLAG_IN_PLACE can be used in branches, as their outputs
+ * have to line up frame for frame.
+ *
+ * channel_pairs = P sets the graph up once for each of P stereo
+ * pairs, such as the four of 7.1 audio, to be processed together
+ * with retro_dsp_filter_process_pairs().
+ *
+ * Independent pairs and branches are run concurrently when built
+ * with HAVE_THREADS, on a pool of threads - 1 workers plus the
+ * calling thread. threads = 0, the default, picks a count from the
+ * cores and the work available; threads = 1 runs everything on the
+ * calling thread. */
 typedef struct retro_dsp_filter retro_dsp_filter_t;
 
 retro_dsp_filter_t *retro_dsp_filter_new(const char *filter_config,
@@ -44,9 +66,87 @@ struct retro_dsp_data
    unsigned output_frames;
 };
 
+/**
+ * retro_dsp_filter_process:
+ * @dsp                : Filter graph handle.
+ * @data               : Samples to filter.
+ *
+ * Filters that declare DSPFILTER_FLAG_IN_PLACE are run a block at a
+ * time over @data->input, which then also holds the output unless
+ * some other filter returns a buffer of its own. Branches are mixed
+ * back into that same buffer. Same as retro_dsp_filter_process_pairs()
+ * with one pair.
+ **/
 void retro_dsp_filter_process(retro_dsp_filter_t *dsp,
       struct retro_dsp_data *data);
 
+/**
+ * retro_dsp_filter_process_pairs:
+ * @dsp                : Filter graph handle.
+ * @data               : One entry per channel pair.
+ * @num_pairs          : Number of entries in @data. Pairs beyond
+ *                       those the graph was set up for are passed
+ *                       through.
+ *
+ * The work is spread over the worker threads only when, going by
+ * previous calls, doing it all on the calling thread would take up
+ * a good part of the time the block plays for.
+ **/
+void retro_dsp_filter_process_pairs(retro_dsp_filter_t *dsp,
+      struct retro_dsp_data *data, unsigned num_pairs);
+
+/* Returns: number of channel pairs the graph was set up for. */
+unsigned retro_dsp_filter_channel_pairs(retro_dsp_filter_t *dsp);
+
+/**
+ * retro_dsp_filter_in_place:
+ * @dsp                : Filter graph handle.
+ *
+ * Returns: true (1) if every filter of the graph declares
+ * DSPFILTER_FLAG_IN_PLACE, so that retro_dsp_filter_process()
+ * always outputs as many frames as it gets, in the input buffer.
+ **/
+bool retro_dsp_filter_in_place(retro_dsp_filter_t *dsp);
+
+/**
+ * retro_dsp_filter_latency:
+ * @dsp                : Filter graph handle.
+ *
+ * Returns: number of frames the output lags behind the input, as
+ * reported by the filters.
+ **/
+unsigned retro_dsp_filter_latency(retro_dsp_filter_t *dsp);
+
+/**
+ * retro_dsp_filter_set_float:
+ * @dsp                : Filter graph handle.
+ * @key                : Setting, named as in the config without a
+ *                       prefix, such as "speed".
+ * @value              : New value.
+ *
+ * Hands a setting to every filter in the graph which can change it
+ * while running. Must not be called during processing.
+ *
+ * Returns: true if any filter took it.
+ **/
+bool retro_dsp_filter_set_float(retro_dsp_filter_t *dsp,
+      const char *key, float value);
+
+/**
+ * retro_dsp_filter_set_string:
+ * @dsp                : Filter graph handle.
+ * @key                : Setting, such as "content".
+ * @value              : New value, which isn't kept.
+ *
+ * Same as retro_dsp_filter_set_float(), for strings. Filters which
+ * remember things per content, like the loudness normalizer, take
+ * a "content" key identifying what is played, such as its path.
+ *
+ * Returns: true if any filter took it.
+ **/
+bool retro_dsp_filter_set_string(retro_dsp_filter_t *dsp,
+      const char *key, const char *value);
+
 RETRO_END_DECLS
 
 #endif
@@ -77,6 +77,13 @@ enum rwav_state rwav_iterate(rwav_iterator_t *iter);
  */
 enum rwav_state rwav_load(rwav_t* out, const void* buf, size_t size);
 
+/**
+ * Parses the header only, without copying the data. The samples field then
+ * points into buf, which must outlive out, and 16-bit samples are left in
+ * little-endian order. Don't call rwav_free on the result.
+ */
+enum rwav_state rwav_parse(rwav_t* out, const void* buf, size_t size);
+
 /**
  * Frees parsed wave data.
  */
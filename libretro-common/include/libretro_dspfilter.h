@@ -58,7 +58,10 @@ typedef const struct dspfilter_implementation *(
 const struct dspfilter_implementation *dspfilter_get_implementation(
       dspfilter_simd_mask_t mask);
 
-#define DSPFILTER_API_VERSION 1
+/* Version 2 adds flags and query() to dspfilter_implementation,
+ * version 3 adds set_float(), version 4 set_string(). Hosts still
+ * load older plugs. */
+#define DSPFILTER_API_VERSION 4
 
 struct dspfilter_info
 {
@@ -165,6 +168,37 @@ typedef void (*dspfilter_free_t)(void *data);
 typedef void (*dspfilter_process_t)(void *data,
       struct dspfilter_output *output, const struct dspfilter_input *input);
 
+/* Every process() call writes its output over input->samples and
+ * returns as many frames as it got. The plug also doesn't mind its
+ * input being cut into smaller calls, so a host can run several such
+ * plugs over a block at a time, sharing one buffer. */
+#define DSPFILTER_FLAG_IN_PLACE (1 << 0)
+
+struct dspfilter_properties
+{
+   /* Frames by which the output lags behind the input. */
+   unsigned latency;
+
+   /* Most frames process() wants at once, 0 for no limit. */
+   unsigned max_frames;
+};
+
+/* Fills in what the host should know about an instance. @props is
+ * zeroed beforehand. */
+typedef void (*dspfilter_query_t)(void *data,
+      struct dspfilter_properties *props);
+
+/* Changes a setting while running. @key is named as in the config,
+ * without a prefix. Called between process() calls, on the same
+ * thread. Returns true if the key is known. */
+typedef int (*dspfilter_set_float_t)(void *data,
+      const char *key, float value);
+
+/* Same as dspfilter_set_float_t, for strings. @value is only valid
+ * during the call. */
+typedef int (*dspfilter_set_string_t)(void *data,
+      const char *key, const char *value);
+
 struct dspfilter_implementation
 {
    dspfilter_init_t     init;
@@ -180,6 +214,20 @@ struct dspfilter_implementation
    /* Computer-friendly short version of ident.
     * Lower case, no spaces and special characters, etc. */
    const char *short_ident;
+
+   /* The following are only read from version 2 plugs. */
+
+   /* DSPFILTER_FLAG_* bits. */
+   unsigned flags;
+
+   /* Optional, may be NULL if all properties are 0. */
+   dspfilter_query_t query;
+
+   /* Only read from version 3 plugs, may be NULL. */
+   dspfilter_set_float_t set_float;
+
+   /* Only read from version 4 plugs, may be NULL. */
+   dspfilter_set_string_t set_string;
 };
 
 RETRO_END_DECLS
@@ -33,7 +33,9 @@
 #include <errno.h>
 #include <io.h>
 #else
+#ifndef HAVE_MMAN
 #define HAVE_MMAN
+#endif
 #include <sys/mman.h>
 #endif
 
@@ -49,4 +51,27 @@ int memsync(void *start, void *end);
 
 int memprotect(void *addr, size_t len);
 
+/**
+ * memmap_ring_alloc:
+ * @size               : Size of the buffer. Rounded up to a multiple
+ *                       of the page size on success.
+ *
+ * Maps the same memory twice, back to back, so that the bytes at
+ * ptr + i and ptr + *size + i are the same for i < *size. A ring
+ * buffer built on it can hand out any *size bytes starting anywhere
+ * in the first mapping as one contiguous block.
+ *
+ * Only available on Linux.
+ *
+ * Returns: start of the first mapping, or NULL if not supported.
+ **/
+void *memmap_ring_alloc(size_t *size);
+
+/**
+ * memmap_ring_free:
+ * @ptr                : Memory returned by memmap_ring_alloc().
+ * @size               : Size set by memmap_ring_alloc().
+ **/
+void memmap_ring_free(void *ptr, size_t size);
+
 #endif
@@ -30,24 +30,31 @@
 #include <retro_common_api.h>
 #include <retro_inline.h>
 
+#include <queues/spsc_queue.h>
+
 RETRO_BEGIN_DECLS
 
+/* Byte FIFO. It is a single-producer/single-consumer lock-free
+ * queue, so one thread may write while another one reads without
+ * a lock. */
 struct fifo_buffer
 {
-   uint8_t *buffer;
-   size_t size;
-   size_t first;
-   size_t end;
+   spsc_queue_t queue;
 };
 
 typedef struct fifo_buffer fifo_buffer_t;
 
 fifo_buffer_t *fifo_new(size_t size);
 
+/* Same as fifo_new(), but backed by a mirrored queue where the
+ * platform supports it, see spsc_queue_init_mirrored(). Readers
+ * can then get all queued data as one block by calling
+ * spsc_queue_read_reserve() on &buffer->queue. */
+fifo_buffer_t *fifo_new_mirrored(size_t size);
+
 static INLINE void fifo_clear(fifo_buffer_t *buffer)
 {
-   buffer->first = 0;
-   buffer->end   = 0;
+   spsc_queue_clear(&buffer->queue);
 }
 
 void fifo_write(fifo_buffer_t *buffer, const void *in_buf, size_t size);
@@ -59,18 +66,18 @@ static INLINE void fifo_free(fifo_buffer_t *buffer)
    if (!buffer)
       return;
 
-   free(buffer->buffer);
+   spsc_queue_deinit(&buffer->queue);
    free(buffer);
 }
 
 static INLINE size_t fifo_read_avail(fifo_buffer_t *buffer)
 {
-   return (buffer->end + ((buffer->end < buffer->first) ? buffer->size : 0)) - buffer->first;
+   return spsc_queue_read_avail(&buffer->queue);
 }
 
 static INLINE size_t fifo_write_avail(fifo_buffer_t *buffer)
 {
-   return (buffer->size - 1) - ((buffer->end + ((buffer->end < buffer->first) ? buffer->size : 0)) - buffer->first);
+   return spsc_queue_write_avail(&buffer->queue);
 }
 
 RETRO_END_DECLS
@@ -0,0 +1,219 @@
+/* Copyright  (C) 2010-2018 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (spsc_queue.h).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __LIBRETRO_SDK_SPSC_QUEUE_H
+#define __LIBRETRO_SDK_SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <boolean.h>
+#include <retro_common_api.h>
+#include <retro_inline.h>
+#include <retro_atomic.h>
+
+RETRO_BEGIN_DECLS
+
+/* Lock-free byte ring buffer for one producer thread and one
+ * consumer thread.
+ *
+ * head and tail count bytes written and read since the last clear,
+ * and wrap around freely; the storage is a power of two so they are
+ * turned into offsets with a mask. Each index is only written by its
+ * own thread, and lives on its own cache line together with that
+ * thread's cached copy of the other index.
+ */
+struct spsc_queue
+{
+   uint8_t *buffer;
+   size_t size;
+   size_t mask;
+   /* Number of bytes the queue holds, which may be less than size. */
+   size_t capacity;
+   /* buffer is mapped twice in a row, see spsc_queue_init_mirrored(). */
+   bool mirrored;
+
+   uint8_t pad0[RETRO_CACHE_LINE_SIZE];
+
+   /* Producer. */
+   volatile size_t head;
+   size_t tail_cache;
+
+   uint8_t pad1[RETRO_CACHE_LINE_SIZE - 2 * sizeof(size_t)];
+
+   /* Consumer. */
+   volatile size_t tail;
+   size_t head_cache;
+
+   uint8_t pad2[RETRO_CACHE_LINE_SIZE - 2 * sizeof(size_t)];
+};
+
+typedef struct spsc_queue spsc_queue_t;
+
+/* Up to two contiguous regions of the ring, the second one
+ * starting at the beginning of the storage when the first one
+ * reaches its end. The second one is always empty for mirrored
+ * queues. */
+struct spsc_queue_span
+{
+   uint8_t *data[2];
+   size_t size[2];
+};
+
+/**
+ * spsc_queue_init:
+ * @queue              : Queue to initialize.
+ * @capacity           : Number of bytes the queue must hold.
+ *
+ * Returns: true (1) if successful, otherwise false (0).
+ **/
+bool spsc_queue_init(spsc_queue_t *queue, size_t capacity);
+
+/**
+ * spsc_queue_init_mirrored:
+ * @queue              : Queue to initialize.
+ * @capacity           : Number of bytes the queue must hold.
+ *
+ * Same as spsc_queue_init(), but where the platform allows it, the
+ * storage is mapped twice back to back with memmap_ring_alloc().
+ * Reservations are then always a single contiguous region, so
+ * readers and writers, such as SIMD sample converters, never have
+ * to handle a wrap-around. Falls back to a normal queue elsewhere;
+ * check queue->mirrored to know which one was created.
+ *
+ * Returns: true (1) if successful, otherwise false (0).
+ **/
+bool spsc_queue_init_mirrored(spsc_queue_t *queue, size_t capacity);
+
+/**
+ * spsc_queue_deinit:
+ * @queue              : Queue initialized with spsc_queue_init().
+ **/
+void spsc_queue_deinit(spsc_queue_t *queue);
+
+spsc_queue_t *spsc_queue_new(size_t capacity);
+
+spsc_queue_t *spsc_queue_new_mirrored(size_t capacity);
+
+void spsc_queue_free(spsc_queue_t *queue);
+
+/**
+ * spsc_queue_write_reserve:
+ * @queue              : Queue handle.
+ * @size               : Number of bytes wanted.
+ * @span               : Regions that may be written to.
+ *
+ * Producer only. Gives direct access to free space in the ring, so
+ * data can be produced in place. Nothing is visible to the consumer
+ * until spsc_queue_write_commit() is called.
+ *
+ * Returns: number of bytes reserved, at most @size.
+ **/
+size_t spsc_queue_write_reserve(spsc_queue_t *queue, size_t size,
+      struct spsc_queue_span *span);
+
+/**
+ * spsc_queue_write_commit:
+ * @queue              : Queue handle.
+ * @size               : Number of bytes written, at most as many
+ *                       as the last reservation returned.
+ *
+ * Producer only. Publishes written bytes to the consumer.
+ **/
+void spsc_queue_write_commit(spsc_queue_t *queue, size_t size);
+
+/**
+ * spsc_queue_read_reserve:
+ * @queue              : Queue handle.
+ * @size               : Number of bytes wanted.
+ * @span               : Regions that may be read from.
+ *
+ * Consumer only. Gives direct access to queued data. The data stays
+ * queued until spsc_queue_read_commit() is called.
+ *
+ * Returns: number of bytes available in @span, at most @size.
+ **/
+size_t spsc_queue_read_reserve(spsc_queue_t *queue, size_t size,
+      struct spsc_queue_span *span);
+
+/**
+ * spsc_queue_read_commit:
+ * @queue              : Queue handle.
+ * @size               : Number of bytes consumed, at most as many
+ *                       as the last reservation returned.
+ *
+ * Consumer only. Hands the space back to the producer.
+ **/
+void spsc_queue_read_commit(spsc_queue_t *queue, size_t size);
+
+/**
+ * spsc_queue_write:
+ * @queue              : Queue handle.
+ * @in_buf             : Data to copy into the queue.
+ * @size               : Size of @in_buf.
+ *
+ * Producer only.
+ *
+ * Returns: number of bytes written, less than @size if the queue
+ * is full.
+ **/
+size_t spsc_queue_write(spsc_queue_t *queue, const void *in_buf,
+      size_t size);
+
+/**
+ * spsc_queue_read:
+ * @queue              : Queue handle.
+ * @out_buf            : Buffer to copy queued data to.
+ * @size               : Size of @out_buf.
+ *
+ * Consumer only.
+ *
+ * Returns: number of bytes read, less than @size if the queue
+ * runs empty.
+ **/
+size_t spsc_queue_read(spsc_queue_t *queue, void *out_buf, size_t size);
+
+/* Empties the queue. Neither thread may use it meanwhile. */
+static INLINE void spsc_queue_clear(spsc_queue_t *queue)
+{
+   queue->head       = 0;
+   queue->tail_cache = 0;
+   queue->tail       = 0;
+   queue->head_cache = 0;
+}
+
+/* Called by the consumer, the data may only grow meanwhile. */
+static INLINE size_t spsc_queue_read_avail(spsc_queue_t *queue)
+{
+   return retro_atomic_load_acquire(&queue->head) -
+      retro_atomic_load_acquire(&queue->tail);
+}
+
+/* Called by the producer, the space may only grow meanwhile. */
+static INLINE size_t spsc_queue_write_avail(spsc_queue_t *queue)
+{
+   return queue->capacity - spsc_queue_read_avail(queue);
+}
+
+RETRO_END_DECLS
+
+#endif
@@ -42,6 +42,17 @@ enum task_type
    TASK_TYPE_BLOCKING
 };
 
+enum task_priority
+{
+   /* Work the user is waiting on, such as thumbnails on screen.
+    * Runs before all other tasks. */
+   TASK_PRIORITY_INTERACTIVE = -1,
+   TASK_PRIORITY_NORMAL      = 0,
+   /* Long jobs, such as hashing, which only run while
+    * no interactive task is unfinished. */
+   TASK_PRIORITY_BACKGROUND  = 1
+};
+
 
 typedef struct retro_task retro_task_t;
 typedef void (*retro_task_callback_t)(void *task_data,
@@ -110,8 +121,18 @@ struct retro_task
 
    enum task_type type;
 
-   /* don't touch this. */
+   enum task_priority priority;
+
+   /* 0 for none, otherwise a time from cpu_features_get_time_usec().
+    * Tasks of the same priority with a deadline run before those
+    * without, earliest first. */
+   int64_t deadline;
+
+   /* don't touch these. */
    retro_task_t *next;
+   retro_task_t *queue_next;
+   volatile size_t status;
+   volatile size_t published_title;
 };
 
 typedef struct task_finder_data
@@ -143,6 +164,10 @@ void task_queue_retriever_info_free(task_retriever_info_t *list);
  * it to complete. */
 void task_queue_cancel_task(void *task);
 
+/* The setters below can be called from any thread, including while
+ * the task runs on another one. Their changes and the task's own are
+ * published in the order the calls are made. Changing the task's
+ * fields directly is only safe from the handler. */
 void task_set_finished(retro_task_t *task, bool finished);
 
 void task_set_mute(retro_task_t *task, bool mute);
@@ -159,6 +184,9 @@ void task_set_cancelled(retro_task_t *task, bool cancelled);
 
 void task_free_title(retro_task_t *task);
 
+/* The getters below read what was last set through the setters
+ * above, or by the handler before returning, and are safe to call
+ * from any thread. */
 bool task_get_cancelled(retro_task_t *task);
 
 bool task_get_finished(retro_task_t *task);
@@ -179,6 +207,12 @@ void task_queue_unset_threaded(void);
 
 bool task_queue_is_threaded(void);
 
+/* Sets the number of worker threads the threaded implementation
+ * runs tasks on, from the next task_queue_init() on. Each unfinished
+ * task gets a slice on one of them at a time. 0, the default, starts
+ * one per CPU core. */
+void task_queue_set_worker_count(unsigned count);
+
 /**
  * Calls func for every running task
  * until it returns true.
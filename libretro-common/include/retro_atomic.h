@@ -0,0 +1,209 @@
+/* Copyright  (C) 2010-2018 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (retro_atomic.h).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __LIBRETRO_SDK_ATOMIC_H
+#define __LIBRETRO_SDK_ATOMIC_H
+
+#include <stddef.h>
+
+#include <boolean.h>
+#include <retro_inline.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+/* Minimal set of atomic operations on size_t, enough for lock-free
+ * queues and counters. Loads and stores come with acquire/release
+ * ordering, read-modify-write operations are sequentially consistent.
+ *
+ * GCC >= 4.7 and clang use the __atomic builtins, older GCC the
+ * __sync builtins, and MSVC its interlocked intrinsics. Other
+ * compilers get plain volatile accesses, which is only correct on
+ * single-core targets.
+ */
+
+/* Size of a cache line, used to keep data written by different
+ * threads apart. */
+#ifndef RETRO_CACHE_LINE_SIZE
+#define RETRO_CACHE_LINE_SIZE 64
+#endif
+
+#if defined(__clang__) || (defined(__GNUC__) && \
+      (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)))
+#define RETRO_ATOMIC_GCC_ATOMIC
+#elif defined(__GNUC__)
+#define RETRO_ATOMIC_GCC_SYNC
+#elif defined(_MSC_VER)
+#define RETRO_ATOMIC_MSVC
+#if defined(_M_IX86) || defined(_M_X64)
+#define RETRO_ATOMIC_MSVC_X86
+#endif
+#endif
+
+/**
+ * retro_atomic_load_acquire:
+ * @ptr                : Value to load.
+ *
+ * Later memory accesses can't be moved before this load.
+ *
+ * Returns: value at @ptr.
+ **/
+static INLINE size_t retro_atomic_load_acquire(const volatile size_t *ptr)
+{
+#if defined(RETRO_ATOMIC_GCC_ATOMIC)
+   return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#elif defined(RETRO_ATOMIC_GCC_SYNC)
+   size_t val = *ptr;
+   __sync_synchronize();
+   return val;
+#elif defined(RETRO_ATOMIC_MSVC_X86)
+   size_t val = *ptr;
+   _ReadWriteBarrier();
+   return val;
+#elif defined(RETRO_ATOMIC_MSVC) && defined(_WIN64)
+   return (size_t)_InterlockedCompareExchange64(
+         (volatile __int64*)ptr, 0, 0);
+#elif defined(RETRO_ATOMIC_MSVC)
+   return (size_t)_InterlockedCompareExchange(
+         (volatile long*)ptr, 0, 0);
+#else
+   return *ptr;
+#endif
+}
+
+/**
+ * retro_atomic_store_release:
+ * @ptr                : Value to store to.
+ * @val                : New value.
+ *
+ * Earlier memory accesses can't be moved after this store.
+ **/
+static INLINE void retro_atomic_store_release(volatile size_t *ptr,
+      size_t val)
+{
+#if defined(RETRO_ATOMIC_GCC_ATOMIC)
+   __atomic_store_n(ptr, val, __ATOMIC_RELEASE);
+#elif defined(RETRO_ATOMIC_GCC_SYNC)
+   __sync_synchronize();
+   *ptr = val;
+#elif defined(RETRO_ATOMIC_MSVC_X86)
+   _ReadWriteBarrier();
+   *ptr = val;
+#elif defined(RETRO_ATOMIC_MSVC) && defined(_WIN64)
+   _InterlockedExchange64((volatile __int64*)ptr, (__int64)val);
+#elif defined(RETRO_ATOMIC_MSVC)
+   _InterlockedExchange((volatile long*)ptr, (long)val);
+#else
+   *ptr = val;
+#endif
+}
+
+/**
+ * retro_atomic_fetch_add:
+ * @ptr                : Value to add to.
+ * @val                : Amount to add. Wraps around like any size_t.
+ *
+ * Returns: value at @ptr before the addition.
+ **/
+static INLINE size_t retro_atomic_fetch_add(volatile size_t *ptr,
+      size_t val)
+{
+#if defined(RETRO_ATOMIC_GCC_ATOMIC)
+   return __atomic_fetch_add(ptr, val, __ATOMIC_SEQ_CST);
+#elif defined(RETRO_ATOMIC_GCC_SYNC)
+   return __sync_fetch_and_add(ptr, val);
+#elif defined(RETRO_ATOMIC_MSVC) && defined(_WIN64)
+   return (size_t)_InterlockedExchangeAdd64(
+         (volatile __int64*)ptr, (__int64)val);
+#elif defined(RETRO_ATOMIC_MSVC)
+   return (size_t)_InterlockedExchangeAdd(
+         (volatile long*)ptr, (long)val);
+#else
+   size_t old = *ptr;
+   *ptr       = old + val;
+   return old;
+#endif
+}
+
+/**
+ * retro_atomic_exchange:
+ * @ptr                : Value to replace.
+ * @val                : New value.
+ *
+ * Returns: value at @ptr before it was replaced.
+ **/
+static INLINE size_t retro_atomic_exchange(volatile size_t *ptr,
+      size_t val)
+{
+#if defined(RETRO_ATOMIC_GCC_ATOMIC)
+   return __atomic_exchange_n(ptr, val, __ATOMIC_SEQ_CST);
+#elif defined(RETRO_ATOMIC_GCC_SYNC)
+   /* Only an acquire barrier on its own. */
+   __sync_synchronize();
+   return __sync_lock_test_and_set(ptr, val);
+#elif defined(RETRO_ATOMIC_MSVC) && defined(_WIN64)
+   return (size_t)_InterlockedExchange64(
+         (volatile __int64*)ptr, (__int64)val);
+#elif defined(RETRO_ATOMIC_MSVC)
+   return (size_t)_InterlockedExchange(
+         (volatile long*)ptr, (long)val);
+#else
+   size_t old = *ptr;
+   *ptr       = val;
+   return old;
+#endif
+}
+
+/**
+ * retro_atomic_cas:
+ * @ptr                : Value to update.
+ * @expected           : Value @ptr must hold.
+ * @desired            : New value.
+ *
+ * Sets @ptr to @desired if it holds @expected.
+ *
+ * Returns: true (1) if @ptr was updated, otherwise false (0).
+ **/
+static INLINE bool retro_atomic_cas(volatile size_t *ptr,
+      size_t expected, size_t desired)
+{
+#if defined(RETRO_ATOMIC_GCC_ATOMIC)
+   return __atomic_compare_exchange_n(ptr, &expected, desired, false,
+         __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#elif defined(RETRO_ATOMIC_GCC_SYNC)
+   return __sync_bool_compare_and_swap(ptr, expected, desired);
+#elif defined(RETRO_ATOMIC_MSVC) && defined(_WIN64)
+   return _InterlockedCompareExchange64((volatile __int64*)ptr,
+         (__int64)desired, (__int64)expected) == (__int64)expected;
+#elif defined(RETRO_ATOMIC_MSVC)
+   return _InterlockedCompareExchange((volatile long*)ptr,
+         (long)desired, (long)expected) == (long)expected;
+#else
+   if (*ptr != expected)
+      return false;
+   *ptr = desired;
+   return true;
+#endif
+}
+
+#endif
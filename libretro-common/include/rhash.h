@@ -88,6 +88,10 @@ int sha1_calculate(const char *path, char *result);
 
 uint32_t djb2_calculate(const char *str);
 
+uint32_t crc32_adjust(uint32_t checksum, uint8_t input);
+
+uint32_t crc32_calculate(const uint8_t *data, size_t length);
+
 /* Any 32-bit or wider unsigned integer data type will do */
 typedef unsigned int MD5_u32plus;
 
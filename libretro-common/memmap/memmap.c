@@ -23,6 +23,11 @@
 #include <stdint.h>
 #include <memmap.h>
 
+#if defined(__linux__) && defined(HAVE_MMAN)
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
 #ifndef PROT_READ
 #define PROT_READ         0x1  /* Page can be read */
 #endif
@@ -161,3 +166,70 @@ int memprotect(void *addr, size_t len)
 {
    return mprotect(addr, len, PROT_READ | PROT_WRITE | PROT_EXEC);
 }
+
+#if defined(__linux__) && defined(HAVE_MMAN) && defined(SYS_memfd_create)
+void *memmap_ring_alloc(size_t *size)
+{
+   uint8_t *base = NULL;
+   long page     = sysconf(_SC_PAGESIZE);
+   size_t len    = *size;
+   int fd;
+
+   if (page <= 0 || !len)
+      return NULL;
+
+   len = (len + page - 1) & ~((size_t)page - 1);
+
+   /* Called through syscall() as older C libraries lack the
+    * wrapper. */
+   fd  = (int)syscall(SYS_memfd_create, "retro_ring", 1 /* MFD_CLOEXEC */);
+   if (fd < 0)
+      return NULL;
+
+   if (ftruncate(fd, (off_t)len) != 0)
+      goto error;
+
+   /* Reserve room for both mappings, then map the file over it. */
+   base = (uint8_t*)mmap(NULL, 2 * len, PROT_NONE,
+         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if ((void*)base == MAP_FAILED)
+      goto error;
+
+   if (mmap(base, len, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+         mmap(base + len, len, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+   {
+      munmap(base, 2 * len);
+      goto error;
+   }
+
+   /* The mappings keep the memory alive. */
+   close(fd);
+
+   *size = len;
+   return base;
+
+error:
+   close(fd);
+   return NULL;
+}
+
+void memmap_ring_free(void *ptr, size_t size)
+{
+   if (ptr)
+      munmap(ptr, 2 * size);
+}
+#else
+void *memmap_ring_alloc(size_t *size)
+{
+   (void)size;
+   return NULL;
+}
+
+void memmap_ring_free(void *ptr, size_t size)
+{
+   (void)ptr;
+   (void)size;
+}
+#endif
@@ -21,64 +21,47 @@
  */
 
 #include <stdlib.h>
-#include <string.h>
 
 #include <queues/fifo_queue.h>
 
 fifo_buffer_t *fifo_new(size_t size)
 {
-   uint8_t    *buffer = NULL;
-   fifo_buffer_t *buf = (fifo_buffer_t*)calloc(1, sizeof(*buf));
+   fifo_buffer_t *buf = (fifo_buffer_t*)malloc(sizeof(*buf));
 
    if (!buf)
       return NULL;
 
-   buffer = (uint8_t*)calloc(1, size + 1);
-
-   if (!buffer)
+   if (!spsc_queue_init(&buf->queue, size))
    {
       free(buf);
       return NULL;
    }
 
-   buf->buffer = buffer;
-   buf->size   = size + 1;
-
    return buf;
 }
 
-void fifo_write(fifo_buffer_t *buffer, const void *in_buf, size_t size)
+fifo_buffer_t *fifo_new_mirrored(size_t size)
 {
-   size_t first_write = size;
-   size_t rest_write  = 0;
+   fifo_buffer_t *buf = (fifo_buffer_t*)malloc(sizeof(*buf));
+
+   if (!buf)
+      return NULL;
 
-   if (buffer->end + size > buffer->size)
+   if (!spsc_queue_init_mirrored(&buf->queue, size))
    {
-      first_write = buffer->size - buffer->end;
-      rest_write  = size - first_write;
+      free(buf);
+      return NULL;
    }
 
-   memcpy(buffer->buffer + buffer->end, in_buf, first_write);
-   memcpy(buffer->buffer, (const uint8_t*)in_buf + first_write, rest_write);
-
-   buffer->end = (buffer->end + size) % buffer->size;
+   return buf;
 }
 
+void fifo_write(fifo_buffer_t *buffer, const void *in_buf, size_t size)
+{
+   spsc_queue_write(&buffer->queue, in_buf, size);
+}
 
 void fifo_read(fifo_buffer_t *buffer, void *in_buf, size_t size)
 {
-   size_t first_read = size;
-   size_t rest_read  = 0;
-
-   if (buffer->first + size > buffer->size)
-   {
-      first_read = buffer->size - buffer->first;
-      rest_read  = size - first_read;
-   }
-
-   memcpy(in_buf, (const uint8_t*)buffer->buffer + buffer->first, first_read);
-   memcpy((uint8_t*)in_buf + first_read, buffer->buffer, rest_read);
-
-   buffer->first = (buffer->first + size) % buffer->size;
+   spsc_queue_read(&buffer->queue, in_buf, size);
 }
-
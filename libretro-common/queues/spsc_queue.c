@@ -0,0 +1,216 @@
+/* Copyright  (C) 2010-2018 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (spsc_queue.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <memmap.h>
+#include <queues/spsc_queue.h>
+
+bool spsc_queue_init(spsc_queue_t *queue, size_t capacity)
+{
+   size_t size = 1;
+
+   memset(queue, 0, sizeof(*queue));
+
+   while (size < capacity)
+      size <<= 1;
+
+   queue->buffer = (uint8_t*)calloc(1, size);
+
+   if (!queue->buffer)
+      return false;
+
+   queue->size     = size;
+   queue->mask     = size - 1;
+   queue->capacity = capacity;
+
+   return true;
+}
+
+bool spsc_queue_init_mirrored(spsc_queue_t *queue, size_t capacity)
+{
+   size_t size = 1;
+
+   memset(queue, 0, sizeof(*queue));
+
+   while (size < capacity)
+      size <<= 1;
+
+   /* Page sizes are powers of two, so the rounded up size still
+    * works with the index mask. */
+   queue->buffer = (uint8_t*)memmap_ring_alloc(&size);
+
+   if (!queue->buffer)
+      return spsc_queue_init(queue, capacity);
+
+   queue->size     = size;
+   queue->mask     = size - 1;
+   queue->capacity = capacity;
+   queue->mirrored = true;
+
+   return true;
+}
+
+void spsc_queue_deinit(spsc_queue_t *queue)
+{
+   if (queue->mirrored)
+      memmap_ring_free(queue->buffer, queue->size);
+   else
+      free(queue->buffer);
+   queue->buffer = NULL;
+}
+
+spsc_queue_t *spsc_queue_new(size_t capacity)
+{
+   spsc_queue_t *queue = (spsc_queue_t*)malloc(sizeof(*queue));
+
+   if (!queue)
+      return NULL;
+
+   if (!spsc_queue_init(queue, capacity))
+   {
+      free(queue);
+      return NULL;
+   }
+
+   return queue;
+}
+
+spsc_queue_t *spsc_queue_new_mirrored(size_t capacity)
+{
+   spsc_queue_t *queue = (spsc_queue_t*)malloc(sizeof(*queue));
+
+   if (!queue)
+      return NULL;
+
+   if (!spsc_queue_init_mirrored(queue, capacity))
+   {
+      free(queue);
+      return NULL;
+   }
+
+   return queue;
+}
+
+void spsc_queue_free(spsc_queue_t *queue)
+{
+   if (!queue)
+      return;
+
+   spsc_queue_deinit(queue);
+   free(queue);
+}
+
+static void spsc_queue_span(spsc_queue_t *queue, size_t pos, size_t size,
+      struct spsc_queue_span *span)
+{
+   size_t offset = pos & queue->mask;
+   size_t first  = queue->size - offset;
+
+   if (first > size || queue->mirrored)
+      first = size;
+
+   span->data[0] = queue->buffer + offset;
+   span->size[0] = first;
+   span->data[1] = queue->buffer;
+   span->size[1] = size - first;
+}
+
+size_t spsc_queue_write_reserve(spsc_queue_t *queue, size_t size,
+      struct spsc_queue_span *span)
+{
+   size_t head  = queue->head;
+   size_t space = queue->capacity - (head - queue->tail_cache);
+
+   /* Only look at the consumer's index when the cached one
+    * doesn't leave enough room, to keep its cache line quiet. */
+   if (space < size)
+   {
+      queue->tail_cache = retro_atomic_load_acquire(&queue->tail);
+      space             = queue->capacity - (head - queue->tail_cache);
+   }
+
+   if (size > space)
+      size = space;
+
+   spsc_queue_span(queue, head, size, span);
+   return size;
+}
+
+void spsc_queue_write_commit(spsc_queue_t *queue, size_t size)
+{
+   retro_atomic_store_release(&queue->head, queue->head + size);
+}
+
+size_t spsc_queue_read_reserve(spsc_queue_t *queue, size_t size,
+      struct spsc_queue_span *span)
+{
+   size_t tail  = queue->tail;
+   size_t avail = queue->head_cache - tail;
+
+   if (avail < size)
+   {
+      queue->head_cache = retro_atomic_load_acquire(&queue->head);
+      avail             = queue->head_cache - tail;
+   }
+
+   if (size > avail)
+      size = avail;
+
+   spsc_queue_span(queue, tail, size, span);
+   return size;
+}
+
+void spsc_queue_read_commit(spsc_queue_t *queue, size_t size)
+{
+   retro_atomic_store_release(&queue->tail, queue->tail + size);
+}
+
+size_t spsc_queue_write(spsc_queue_t *queue, const void *in_buf,
+      size_t size)
+{
+   struct spsc_queue_span span;
+
+   size = spsc_queue_write_reserve(queue, size, &span);
+
+   memcpy(span.data[0], in_buf, span.size[0]);
+   memcpy(span.data[1], (const uint8_t*)in_buf + span.size[0],
+         span.size[1]);
+
+   spsc_queue_write_commit(queue, size);
+   return size;
+}
+
+size_t spsc_queue_read(spsc_queue_t *queue, void *out_buf, size_t size)
+{
+   struct spsc_queue_span span;
+
+   size = spsc_queue_read_reserve(queue, size, &span);
+
+   memcpy(out_buf, span.data[0], span.size[0]);
+   memcpy((uint8_t*)out_buf + span.size[0], span.data[1],
+         span.size[1]);
+
+   spsc_queue_read_commit(queue, size);
+   return size;
+}
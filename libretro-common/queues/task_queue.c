@@ -20,13 +20,18 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
 
+#include <retro_atomic.h>
 #include <queues/task_queue.h>
 
 #ifdef HAVE_THREADS
+#include <retro_miscellaneous.h>
+#include <features/features_cpu.h>
 #include <rthreads/rthreads.h>
 #define SLOCK_LOCK(x) slock_lock(x)
 #define SLOCK_UNLOCK(x) slock_unlock(x)
@@ -35,12 +40,30 @@
 #define SLOCK_UNLOCK(x)
 #endif
 
+/* retro_task_t.status holds what other threads may read of a task
+ * while it runs: its progress in the low byte, and flags. Only the
+ * thread running the task writes it, but for the cancelled flag, so
+ * it is always updated with compare-and-swap. */
+#define TASK_STATUS_PROGRESS  0xff
+#define TASK_STATUS_FINISHED  (1 << 8)
+#define TASK_STATUS_MUTE      (1 << 9)
+#define TASK_STATUS_CANCELLED (1 << 10)
+
 typedef struct
 {
    retro_task_t *front;
    retro_task_t *back;
 } task_queue_t;
 
+/* Copy of a task's title, which the main thread can read while the
+ * task changes its own. Replaced copies are only freed by the main
+ * thread, at the start of the next gather. */
+struct task_title
+{
+   struct task_title *next;
+   char text[1];
+};
+
 struct retro_task_impl
 {
    retro_task_queue_msg_t msg_push;
@@ -62,6 +85,23 @@ static task_queue_t tasks_finished = {NULL, NULL};
 static struct retro_task_impl *impl_current = NULL;
 static bool task_threaded_enable            = false;
 
+/* Pushed tasks whose callbacks haven't run yet. */
+static volatile size_t tasks_pending  = 0;
+/* 1 while a TASK_TYPE_BLOCKING task is unfinished. */
+static volatile size_t tasks_blocking = 0;
+/* Unfinished TASK_PRIORITY_INTERACTIVE tasks, background tasks
+ * wait while there are any. */
+static volatile size_t tasks_interactive = 0;
+/* Stack of replaced title copies. */
+static volatile size_t titles_retired = 0;
+
+#ifdef HAVE_THREADS
+/* Guards retro_task_t.title itself, which any thread may get while
+ * the task changes it, and serializes publishing the task's state.
+ * Gathering reads the published copies instead. */
+static slock_t *title_lock = NULL;
+#endif
+
 static void task_queue_msg_push(retro_task_t *task,
       unsigned prio, unsigned duration,
       bool flush, const char *fmt, ...)
@@ -79,25 +119,40 @@ static void task_queue_msg_push(retro_task_t *task,
       impl_current->msg_push(buf, prio, duration, flush);
 }
 
+/* The title as last published. Only for the main thread, until the
+ * next gather. */
+static const char *task_published_title(retro_task_t *task)
+{
+   struct task_title *title = (struct task_title*)
+      retro_atomic_load_acquire(&task->published_title);
+
+   return title ? title->text : NULL;
+}
+
 static void task_queue_push_progress(retro_task_t *task)
 {
-   if (task->title && !task->mute)
+   size_t status     = retro_atomic_load_acquire(&task->status);
+   const char *title = task_published_title(task);
+
+   if (title && !(status & TASK_STATUS_MUTE))
    {
-      if (task->finished)
+      if (status & TASK_STATUS_FINISHED)
       {
          if (task->error)
             task_queue_msg_push(task, 1, 60, true, "%s: %s",
-               "Task failed", task->title);
+               "Task failed", title);
          else
-            task_queue_msg_push(task, 1, 60, false, "100%%: %s", task->title);
+            task_queue_msg_push(task, 1, 60, false, "100%%: %s", title);
       }
       else
       {
-         if (task->progress >= 0 && task->progress <= 100)
+         int8_t progress = (int8_t)(status & TASK_STATUS_PROGRESS);
+
+         if (progress >= 0 && progress <= 100)
             task_queue_msg_push(task, 1, 60, true, "%i%%: %s",
-                  task->progress, task->title);
+                  progress, title);
          else
-            task_queue_msg_push(task, 1, 60, false, "%s...", task->title);
+            task_queue_msg_push(task, 1, 60, false, "%s...", title);
       }
 
       if (task->progress_cb)
@@ -130,6 +185,105 @@ static retro_task_t *task_queue_get(task_queue_t *queue)
    return task;
 }
 
+/* Frees the title copies replaced since the last call. Only the main
+ * thread reads copies, and never across gathers, so none of these
+ * can still be in use. */
+static void task_title_free_retired(void)
+{
+   struct task_title *title = (struct task_title*)
+      retro_atomic_exchange(&titles_retired, 0);
+
+   while (title)
+   {
+      struct task_title *next = title->next;
+      free(title);
+      title = next;
+   }
+}
+
+static void task_title_retire(struct task_title *title)
+{
+   size_t head;
+
+   do
+   {
+      head        = retro_atomic_load_acquire(&titles_retired);
+      title->next = (struct task_title*)head;
+   } while (!retro_atomic_cas(&titles_retired, head, (size_t)title));
+}
+
+/* Makes the task's progress, flags and title visible to the other
+ * threads. Called by the thread running the task, and by whichever
+ * thread uses a setter, so the caller must hold title_lock: the last
+ * call then publishes what all of them set. */
+static void task_publish_locked(retro_task_t *task)
+{
+   size_t status, flags;
+   struct task_title *shown = (struct task_title*)
+      retro_atomic_load_acquire(&task->published_title);
+
+   if (task->title ? !shown || strcmp(shown->text, task->title) : !!shown)
+   {
+      struct task_title *title = NULL;
+
+      if (task->title)
+      {
+         size_t len = strlen(task->title);
+
+         title      = (struct task_title*)malloc(sizeof(*title) + len);
+         if (title)
+            memcpy(title->text, task->title, len + 1);
+      }
+
+      /* Only retire the copy this call replaced. */
+      shown = (struct task_title*)
+         retro_atomic_exchange(&task->published_title, (size_t)title);
+
+      if (shown)
+         task_title_retire(shown);
+   }
+
+   flags = (uint8_t)task->progress;
+   if (task->finished)
+      flags |= TASK_STATUS_FINISHED;
+   if (task->mute)
+      flags |= TASK_STATUS_MUTE;
+   if (task->cancelled)
+      flags |= TASK_STATUS_CANCELLED;
+
+   /* Keep a cancellation requested meanwhile. */
+   do
+   {
+      status = retro_atomic_load_acquire(&task->status);
+   } while (!retro_atomic_cas(&task->status, status,
+            flags | (status & TASK_STATUS_CANCELLED)));
+}
+
+static void task_publish(retro_task_t *task)
+{
+   SLOCK_LOCK(title_lock);
+   task_publish_locked(task);
+   SLOCK_UNLOCK(title_lock);
+}
+
+/* Runs a slice of the task, on whichever thread owns it for now. */
+static void task_run_slice(retro_task_t *task)
+{
+   if (retro_atomic_load_acquire(&task->status) & TASK_STATUS_CANCELLED)
+      task->cancelled = true;
+
+   task->handler(task);
+   task_publish(task);
+
+   if (!task->finished)
+      return;
+
+   if (task->type == TASK_TYPE_BLOCKING)
+      retro_atomic_store_release(&tasks_blocking, 0);
+   if (task->priority == TASK_PRIORITY_INTERACTIVE)
+      retro_atomic_fetch_add(&tasks_interactive, (size_t)-1);
+}
+
 static void retro_task_internal_gather(void)
 {
    retro_task_t *task = NULL;
@@ -149,7 +303,10 @@ static void retro_task_internal_gather(void)
       if (task->title)
          free(task->title);
 
+      free((struct task_title*)task->published_title);
       free(task);
+
+      retro_atomic_fetch_add(&tasks_pending, (size_t)-1);
    }
 }
 
@@ -160,8 +317,7 @@ static void retro_task_regular_push_running(retro_task_t *task)
 
 static void retro_task_regular_cancel(void *task)
 {
-   retro_task_t *t = (retro_task_t*)task;
-   t->cancelled    = true;
+   task_set_cancelled((retro_task_t*)task, true);
 }
 
 static void retro_task_regular_gather(void)
@@ -170,6 +326,8 @@ static void retro_task_regular_gather(void)
    retro_task_t *queue = NULL;
    retro_task_t *next  = NULL;
 
+   task_title_free_retired();
+
    while ((task = task_queue_get(&tasks_running)) != NULL)
    {
       task->next = queue;
@@ -179,7 +337,15 @@ static void retro_task_regular_gather(void)
    for (task = queue; task; task = next)
    {
       next = task->next;
-      task->handler(task);
+
+      if (task->priority == TASK_PRIORITY_BACKGROUND
+            && retro_atomic_load_acquire(&tasks_interactive))
+      {
+         retro_task_regular_push_running(task);
+         continue;
+      }
+
+      task_run_slice(task);
 
       task_queue_push_progress(task);
 
@@ -203,7 +369,7 @@ static void retro_task_regular_reset(void)
    retro_task_t *task = tasks_running.front;
 
    for (; task; task = task->next)
-      task->cancelled = true;
+      task_set_cancelled(task, true);
 }
 
 static void retro_task_regular_init(void)
@@ -214,10 +380,11 @@ static void retro_task_regular_deinit(void)
 {
 }
 
-static bool retro_task_regular_find(retro_task_finder_t func, void *user_data)
+/* Calls func for the tasks linked through next from task on, until
+ * it returns true. */
+static bool task_list_find(retro_task_t *task,
+      retro_task_finder_t func, void *user_data)
 {
-   retro_task_t *task = tasks_running.front;
-
    for (; task; task = task->next)
    {
       if (func(task, user_data))
@@ -227,13 +394,18 @@ static bool retro_task_regular_find(retro_task_finder_t func, void *user_data)
    return false;
 }
 
-static void retro_task_regular_retrieve(task_retriever_data_t *data)
+/* Adds what data->func gives for the matching tasks linked through
+ * next from task on to the end of data->list. */
+static void task_list_retrieve(retro_task_t *task,
+      task_retriever_data_t *data)
 {
-   retro_task_t *task          = NULL;
-   task_retriever_info_t *tail = NULL;
+   task_retriever_info_t *tail = data->list;
+
+   while (tail && tail->next)
+      tail = tail->next;
 
    /* Parse all running tasks and handle matching handlers */
-   for (task = tasks_running.front; task != NULL; task = task->next)
+   for (; task != NULL; task = task->next)
    {
       task_retriever_info_t *info = NULL;
       if (task->handler != data->handler)
@@ -271,6 +443,16 @@ static void retro_task_regular_retrieve(task_retriever_data_t *data)
    }
 }
 
+static bool retro_task_regular_find(retro_task_finder_t func, void *user_data)
+{
+   return task_list_find(tasks_running.front, func, user_data);
+}
+
+static void retro_task_regular_retrieve(task_retriever_data_t *data)
+{
+   task_list_retrieve(tasks_running.front, data);
+}
+
 static struct retro_task_impl impl_regular = {
    NULL,
    retro_task_regular_push_running,
@@ -285,77 +467,322 @@ static struct retro_task_impl impl_regular = {
 };
 
 #ifdef HAVE_THREADS
-static slock_t *running_lock    = NULL;
-static slock_t *finished_lock   = NULL;
-static slock_t *property_lock   = NULL;
-static slock_t *queue_lock      = NULL;
-static scond_t *worker_cond     = NULL;
-static sthread_t *worker_thread = NULL;
-static bool worker_continue     = true; /* use running_lock when touching it */
+#define TASK_PRIORITY_CLASSES 3
+
+/* Tasks waiting for a slice on one worker, in a queue for each
+ * priority. The worker takes them in turn from the front of the
+ * most urgent queue, and puts them back at the end; idle workers
+ * take from the front too, the task that has waited the longest.
+ * Tasks with a deadline are kept ahead of the others instead, the
+ * earliest first. */
+struct task_worker
+{
+   sthread_t *thread;
+   slock_t *lock;
+   retro_task_t *front[TASK_PRIORITY_CLASSES];
+   retro_task_t *back[TASK_PRIORITY_CLASSES];
+};
 
-static void task_queue_remove(task_queue_t *queue, retro_task_t *task)
+/* Only there for idle workers to sleep on. */
+static slock_t *worker_lock        = NULL;
+static scond_t *worker_cond        = NULL;
+static struct task_worker *workers = NULL;
+static unsigned num_workers        = 0;
+static unsigned worker_count       = 0; /* 0 for one per core */
+/* Cleared under worker_lock, so that sleeping workers can't miss it. */
+static volatile size_t worker_continue  = 1;
+static volatile size_t workers_sleeping = 0;
+/* Tasks of each priority in the intake and the worker queues, may
+ * be one too high while a task is being queued. */
+static volatile size_t ready_tasks[TASK_PRIORITY_CLASSES] = {0};
+
+/* Stacks any thread pushes to, and which are only ever emptied all
+ * at once, so that no lock is needed. A new task goes on the intake,
+ * linked through queue_next, from which a worker takes it, and on
+ * tasks_announced, linked through next, from which the main thread
+ * adds it to tasks_running. Workers hand finished tasks back through
+ * tasks_done.
+ *
+ * This leaves changing tasks_running to the main thread alone, so
+ * running tasks never hold up a gather. */
+static volatile size_t tasks_intake    = 0;
+static volatile size_t tasks_announced = 0;
+static volatile size_t tasks_done      = 0;
+
+/* Taken by the main thread to change tasks_running or to empty
+ * tasks_announced, and by any thread looking through them. The main
+ * thread only takes it when a task was pushed or finished since the
+ * last gather, and then only waits if a find, retrieve or cancel is
+ * in progress, such as one called by a task handler. */
+static slock_t *running_lock           = NULL;
+
+static void task_stack_push(volatile size_t *stack, retro_task_t *task,
+      retro_task_t **link)
 {
-   retro_task_t     *t = NULL;
-   retro_task_t *front = NULL;
+   size_t head;
 
-   slock_lock(queue_lock);
-   front = queue->front;
-   slock_unlock(queue_lock);
+   do
+   {
+      head  = retro_atomic_load_acquire(stack);
+      *link = (retro_task_t*)head;
+   } while (!retro_atomic_cas(stack, head, (size_t)task));
+}
+
+/* Empties a stack, returning its tasks in the order they were pushed. */
+static retro_task_t *task_stack_take(volatile size_t *stack, bool queue_link)
+{
+   retro_task_t *task = (retro_task_t*)retro_atomic_exchange(stack, 0);
+   retro_task_t *list = NULL;
 
-   /* Remove first element if needed */
-   if (task == front)
+   while (task)
    {
-      slock_lock(queue_lock);
-      queue->front = task->next;
-      slock_unlock(queue_lock);
-      task->next   = NULL;
+      retro_task_t **link = queue_link ? &task->queue_next : &task->next;
+      retro_task_t *next  = *link;
+
+      *link = list;
+      list  = task;
+      task  = next;
+   }
+
+   return list;
+}
 
+static void task_queue_remove(task_queue_t *queue, retro_task_t *task)
+{
+   retro_task_t *prev = NULL;
+   retro_task_t *t    = queue->front;
+
+   while (t && t != task)
+   {
+      prev = t;
+      t    = t->next;
+   }
+
+   if (!t)
       return;
+
+   if (prev)
+      prev->next   = task->next;
+   else
+      queue->front = task->next;
+
+   if (queue->back == task)
+      queue->back  = prev;
+
+   task->next      = NULL;
+}
+
+static unsigned task_priority_index(retro_task_t *task)
+{
+   return (unsigned)(task->priority - TASK_PRIORITY_INTERACTIVE);
+}
+
+static void task_worker_put(struct task_worker *worker, retro_task_t *task)
+{
+   unsigned prio      = task_priority_index(task);
+   retro_task_t *prev = NULL;
+   retro_task_t *next = NULL;
+
+   slock_lock(worker->lock);
+
+   if (task->deadline)
+   {
+      for (next = worker->front[prio];
+            next && next->deadline && next->deadline <= task->deadline;
+            next = next->queue_next)
+         prev = next;
    }
+   else
+      prev = worker->back[prio];
+
+   task->queue_next = next;
+
+   if (prev)
+      prev->queue_next = task;
+   else
+      worker->front[prio] = task;
+
+   if (!next)
+      worker->back[prio] = task;
+
+   slock_unlock(worker->lock);
+}
+
+static retro_task_t *task_worker_get(struct task_worker *worker,
+      unsigned prio)
+{
+   retro_task_t *task = NULL;
 
-   /* Parse queue */
-   t = front;
+   slock_lock(worker->lock);
+
+   task = worker->front[prio];
+   if (task)
+   {
+      worker->front[prio] = task->queue_next;
+      task->queue_next    = NULL;
+
+      if (!worker->front[prio])
+         worker->back[prio] = NULL;
+   }
+
+   slock_unlock(worker->lock);
+
+   if (task)
+      retro_atomic_fetch_add(&ready_tasks[prio], (size_t)-1);
+
+   return task;
+}
+
+/* Whether a worker has anything to take. */
+static bool task_worker_has_work(void)
+{
+   /* Read-modify-writes, see retro_task_threaded_push_running(). */
+   return retro_atomic_fetch_add(&ready_tasks[0], 0)
+      || retro_atomic_fetch_add(&ready_tasks[1], 0)
+      || (retro_atomic_fetch_add(&ready_tasks[2], 0)
+            && !retro_atomic_fetch_add(&tasks_interactive, 0));
+}
+
+/* Queues the new tasks from the intake on @self, then takes the most
+ * urgent task, from @self first and then from the other workers. */
+static retro_task_t *task_worker_take(struct task_worker *self)
+{
+   unsigned i, prio;
+   retro_task_t *task = NULL;
+   unsigned index     = (unsigned)(self - workers);
 
-   while (t && t->next)
+   if (retro_atomic_load_acquire(&tasks_intake))
    {
-      /* Remove task and update queue */
-      if (t->next == task)
+      retro_task_t *next = NULL;
+
+      for (task = task_stack_take(&tasks_intake, true); task; task = next)
       {
-         t->next    = task->next;
-         task->next = NULL;
-         break;
+         next = task->queue_next;
+         task_worker_put(self, task);
       }
+   }
 
-      /* Update iterator */
-      t = t->next;
+   for (prio = 0; prio < TASK_PRIORITY_CLASSES; prio++)
+   {
+      if (!retro_atomic_load_acquire(&ready_tasks[prio]))
+         continue;
+
+      if (prio == TASK_PRIORITY_BACKGROUND - TASK_PRIORITY_INTERACTIVE
+            && retro_atomic_load_acquire(&tasks_interactive))
+         break;
+
+      for (i = 0; i < num_workers; i++)
+      {
+         task = task_worker_get(&workers[(index + i) % num_workers], prio);
+         if (task)
+            return task;
+      }
    }
+
+   return NULL;
+}
+
+/* Wakes a sleeping worker up, or all of them. */
+static void task_worker_wake(bool all)
+{
+   if (!retro_atomic_fetch_add(&workers_sleeping, 0))
+      return;
+
+   slock_lock(worker_lock);
+   if (all)
+      scond_broadcast(worker_cond);
+   else
+      scond_signal(worker_cond);
+   slock_unlock(worker_lock);
 }
 
 static void retro_task_threaded_push_running(retro_task_t *task)
 {
+   task_stack_push(&tasks_announced, task, &task->next);
+
+   retro_atomic_fetch_add(&ready_tasks[task_priority_index(task)], 1);
+   task_stack_push(&tasks_intake, task, &task->queue_next);
+
+   /* Checks workers_sleeping with a read-modify-write, so that it is
+    * ordered after the update of ready_tasks, as the check of
+    * workers going to sleep is the other way around. */
+   task_worker_wake(false);
+}
+
+/* Adds the tasks pushed since the last call to tasks_running. The
+ * caller must hold running_lock, as the stack is relinked. */
+static void task_threaded_register_locked(void)
+{
+   retro_task_t *next = NULL;
+   retro_task_t *task = task_stack_take(&tasks_announced, false);
+
+   for (; task; task = next)
+   {
+      next = task->next;
+      task_queue_put(&tasks_running, task);
+   }
+}
+
+static void task_threaded_register(void)
+{
+   if (!retro_atomic_load_acquire(&tasks_announced))
+      return;
+
    slock_lock(running_lock);
-   slock_lock(queue_lock);
-   task_queue_put(&tasks_running, task);
-   scond_signal(worker_cond);
-   slock_unlock(queue_lock);
+   task_threaded_register_locked();
    slock_unlock(running_lock);
 }
 
-static void retro_task_threaded_cancel(void *task)
+/* Moves the tasks finished since the last call from tasks_running
+ * to tasks_finished. */
+static void task_threaded_collect(void)
 {
-   retro_task_t *t;
+   retro_task_t *next = NULL;
+   /* Taken before registering, so that these are all registered. */
+   retro_task_t *task = task_stack_take(&tasks_done, true);
+
+   if (!task)
+   {
+      task_threaded_register();
+      return;
+   }
 
    slock_lock(running_lock);
+   task_threaded_register_locked();
 
-   for (t = tasks_running.front; t; t = t->next)
+   for (; task; task = next)
    {
-      if (t == task)
-      {
-        t->cancelled = true;
-        break;
-      }
+      next = task->queue_next;
+      task_queue_remove(&tasks_running, task);
+      task_queue_put(&tasks_finished, task);
    }
+   slock_unlock(running_lock);
+}
+
+/* Calls func for every unfinished task, until it returns true. Tasks
+ * pushed since the last gather are still on tasks_announced, which
+ * can't be emptied while running_lock is held. */
+static bool task_threaded_find_locked(
+      retro_task_finder_t func, void *user_data)
+{
+   return task_list_find(tasks_running.front, func, user_data)
+      || task_list_find((retro_task_t*)
+            retro_atomic_load_acquire(&tasks_announced), func, user_data);
+}
 
+static bool task_threaded_cancel_finder(retro_task_t *task, void *user_data)
+{
+   if (task != user_data)
+      return false;
+
+   task_set_cancelled(task, true);
+   return true;
+}
+
+static void retro_task_threaded_cancel(void *task)
+{
+   slock_lock(running_lock);
+   task_threaded_find_locked(task_threaded_cancel_finder, task);
    slock_unlock(running_lock);
 }
 
@@ -363,164 +790,164 @@ static void retro_task_threaded_gather(void)
 {
    retro_task_t *task = NULL;
 
-   slock_lock(property_lock);
-   slock_lock(running_lock);
+   task_title_free_retired();
+   task_threaded_collect();
+
    for (task = tasks_running.front; task; task = task->next)
       task_queue_push_progress(task);
 
-   slock_unlock(running_lock);
-
-   slock_lock(finished_lock);
    retro_task_internal_gather();
-   slock_unlock(finished_lock);
-   slock_unlock(property_lock);
 }
 
 static void retro_task_threaded_wait(retro_task_condition_fn_t cond, void* data)
 {
-   bool wait = false;
-
    do
    {
       retro_task_threaded_gather();
-
-      slock_lock(running_lock);
-      wait = (tasks_running.front != NULL) &&
-             (!cond || cond(data));
-      slock_unlock(running_lock);
-   } while (wait);
+   } while (retro_atomic_load_acquire(&tasks_pending)
+         && (!cond || cond(data)));
 }
 
 static void retro_task_threaded_reset(void)
 {
-   retro_task_t *task = NULL;
-
-   slock_lock(running_lock);
-   for (task = tasks_running.front; task; task = task->next)
-      task->cancelled = true;
-   slock_unlock(running_lock);
+   task_threaded_register();
+   retro_task_regular_reset();
 }
 
-
 static bool retro_task_threaded_find(
       retro_task_finder_t func, void *user_data)
 {
-   retro_task_t *task = NULL;
-   bool result = false;
+   bool found;
 
    slock_lock(running_lock);
-   for (task = tasks_running.front; task; task = task->next)
-   {
-      if (func(task, user_data))
-      {
-         result = true;
-         break;
-      }
-   }
+   found = task_threaded_find_locked(func, user_data);
    slock_unlock(running_lock);
 
-   return result;
+   return found;
 }
 
 static void retro_task_threaded_retrieve(task_retriever_data_t *data)
 {
-   /* Protect access to running tasks */
    slock_lock(running_lock);
-
-   /* Call regular retrieve function */
-   retro_task_regular_retrieve(data);
-
-   /* Release access to running tasks */
+   task_list_retrieve(tasks_running.front, data);
+   task_list_retrieve((retro_task_t*)
+         retro_atomic_load_acquire(&tasks_announced), data);
    slock_unlock(running_lock);
 }
 
 static void threaded_worker(void *userdata)
 {
-   (void)userdata;
+   struct task_worker *self = (struct task_worker*)userdata;
 
    for (;;)
    {
-      retro_task_t *task  = NULL;
-      bool finished = false;
+      retro_task_t *task = NULL;
 
-      if (!worker_continue)
+      if (!retro_atomic_load_acquire(&worker_continue))
          break; /* should we keep running until all tasks finished? */
 
-      slock_lock(running_lock);
+      task = task_worker_take(self);
 
-      /* Get first task to run */
-      task = tasks_running.front;
-      if (task == NULL)
+      if (!task)
       {
-         scond_wait(worker_cond, running_lock);
-         slock_unlock(running_lock);
+         slock_lock(worker_lock);
+         retro_atomic_fetch_add(&workers_sleeping, 1);
+         while (worker_continue && !task_worker_has_work())
+            scond_wait(worker_cond, worker_lock);
+         retro_atomic_fetch_add(&workers_sleeping, (size_t)-1);
+         slock_unlock(worker_lock);
          continue;
       }
 
-      slock_unlock(running_lock);
-
-      task->handler(task);
-
-      slock_lock(property_lock);
-      finished = task->finished;
-      slock_unlock(property_lock);
+      task_run_slice(task);
 
-      slock_lock(running_lock);
-      task_queue_remove(&tasks_running, task);
-      slock_unlock(running_lock);
-
-      /* Update queue */
-      if (!finished)
-      {
-         /* Re-add task to running queue */
-         retro_task_threaded_push_running(task);
-      }
-      else
+      /* Unfinished tasks go back to this worker, where their data
+       * is likely still in the cache. */
+      if (!task->finished)
       {
-         /* Add task to finished queue */
-         slock_lock(finished_lock);
-         task_queue_put(&tasks_finished, task);
-         slock_unlock(finished_lock);
+         retro_atomic_fetch_add(&ready_tasks[task_priority_index(task)], 1);
+         task_worker_put(self, task);
+         continue;
       }
+
+      /* Background tasks may have been waiting on this one. */
+      if (task->priority == TASK_PRIORITY_INTERACTIVE
+            && !retro_atomic_fetch_add(&tasks_interactive, 0))
+         task_worker_wake(true);
+
+      task_stack_push(&tasks_done, task, &task->queue_next);
    }
 }
 
 static void retro_task_threaded_init(void)
 {
-   running_lock  = slock_new();
-   finished_lock = slock_new();
-   property_lock = slock_new();
-   queue_lock    = slock_new();
+   unsigned i;
+   retro_task_t *task = NULL;
+
+   worker_lock   = slock_new();
    worker_cond   = scond_new();
+   running_lock  = slock_new();
+   title_lock    = slock_new();
 
-   slock_lock(running_lock);
-   worker_continue = true;
-   slock_unlock(running_lock);
+   num_workers   = worker_count ? worker_count
+      : cpu_features_get_core_amount();
+   num_workers   = MAX(num_workers, 1);
+   workers       = (struct task_worker*)
+      calloc(num_workers, sizeof(*workers));
+
+   worker_continue  = 1;
+   workers_sleeping = 0;
+   memset((void*)ready_tasks, 0, sizeof(ready_tasks));
 
-   worker_thread = sthread_create(threaded_worker, NULL);
+   for (i = 0; i < num_workers; i++)
+      workers[i].lock = slock_new();
+
+   /* Tasks left on hold by the previous implementation. */
+   for (task = tasks_running.front; task; task = task->next)
+   {
+      ready_tasks[task_priority_index(task)]++;
+      task_worker_put(&workers[i++ % num_workers], task);
+   }
+
+   for (i = 0; i < num_workers; i++)
+      workers[i].thread = sthread_create(threaded_worker, &workers[i]);
 }
 
 static void retro_task_threaded_deinit(void)
 {
-   slock_lock(running_lock);
-   worker_continue = false;
-   scond_signal(worker_cond);
-   slock_unlock(running_lock);
+   unsigned i;
+
+   slock_lock(worker_lock);
+   retro_atomic_store_release(&worker_continue, 0);
+   scond_broadcast(worker_cond);
+   slock_unlock(worker_lock);
+
+   for (i = 0; i < num_workers; i++)
+      sthread_join(workers[i].thread);
+
+   /* Only once all workers stopped, as they lock each other's
+    * queues to steal tasks. */
+   for (i = 0; i < num_workers; i++)
+      slock_free(workers[i].lock);
 
-   sthread_join(worker_thread);
+   /* Unfinished tasks are all in tasks_running after this, so the
+    * intake and the worker queues can simply be dropped. */
+   task_threaded_collect();
+   tasks_intake  = 0;
+
+   free(workers);
 
    scond_free(worker_cond);
+   slock_free(worker_lock);
    slock_free(running_lock);
-   slock_free(finished_lock);
-   slock_free(property_lock);
-   slock_free(queue_lock);
+   slock_free(title_lock);
 
-   worker_thread = NULL;
+   workers       = NULL;
+   num_workers   = 0;
    worker_cond   = NULL;
+   worker_lock   = NULL;
    running_lock  = NULL;
-   finished_lock = NULL;
-   property_lock = NULL;
-   queue_lock = NULL;
+   title_lock    = NULL;
 }
 
 static struct retro_task_impl impl_threaded = {
@@ -581,6 +1008,13 @@ bool task_queue_is_threaded(void)
    return task_threaded_enable;
 }
 
+void task_queue_set_worker_count(unsigned count)
+{
+#ifdef HAVE_THREADS
+   worker_count = count;
+#endif
+}
+
 bool task_queue_find(task_finder_data_t *find_data)
 {
    if (!impl_current->find(find_data->func, find_data->userdata))
@@ -612,30 +1046,21 @@ void task_queue_check(void)
 void task_queue_push(retro_task_t *task)
 {
    /* Ignore this task if a related one is already running */
-   if (task->type == TASK_TYPE_BLOCKING)
+   if (task->type == TASK_TYPE_BLOCKING
+         && !retro_atomic_cas(&tasks_blocking, 0, 1))
    {
-      retro_task_t *running = NULL;
-      bool found = false;
-
-      SLOCK_LOCK(queue_lock);
-      running = tasks_running.front;
-
-      for (; running; running = running->next)
-      {
-         if (running->type == TASK_TYPE_BLOCKING)
-         {
-            found = true;
-            break;
-         }
-      }
-
-      SLOCK_UNLOCK(queue_lock);
-
       /* skip this task, user must try again later */
-      if (found)
-         return;
+      return;
    }
 
+   task->status          = 0;
+   task->published_title = 0;
+   task_publish(task);
+
+   retro_atomic_fetch_add(&tasks_pending, 1);
+   if (task->priority == TASK_PRIORITY_INTERACTIVE)
+      retro_atomic_fetch_add(&tasks_interactive, 1);
+
    /* The lack of NULL checks in the following functions
     * is proposital to ensure correct control flow by the users. */
    impl_current->push_running(task);
@@ -689,135 +1114,109 @@ void task_queue_retriever_info_free(task_retriever_info_t *list)
 
 void task_set_finished(retro_task_t *task, bool finished)
 {
-   SLOCK_LOCK(property_lock);
+   SLOCK_LOCK(title_lock);
    task->finished = finished;
-   SLOCK_UNLOCK(property_lock);
+   task_publish_locked(task);
+   SLOCK_UNLOCK(title_lock);
 }
 
 void task_set_mute(retro_task_t *task, bool mute)
 {
-   SLOCK_LOCK(property_lock);
+   SLOCK_LOCK(title_lock);
    task->mute = mute;
-   SLOCK_UNLOCK(property_lock);
+   task_publish_locked(task);
+   SLOCK_UNLOCK(title_lock);
 }
 
 void task_set_error(retro_task_t *task, char *error)
 {
-   SLOCK_LOCK(property_lock);
    task->error = error;
-   SLOCK_UNLOCK(property_lock);
 }
 
 void task_set_progress(retro_task_t *task, int8_t progress)
 {
-   SLOCK_LOCK(property_lock);
+   SLOCK_LOCK(title_lock);
    task->progress = progress;
-   SLOCK_UNLOCK(property_lock);
+   task_publish_locked(task);
+   SLOCK_UNLOCK(title_lock);
 }
 
 void task_set_title(retro_task_t *task, char *title)
 {
-   SLOCK_LOCK(property_lock);
+   SLOCK_LOCK(title_lock);
    task->title = title;
-   SLOCK_UNLOCK(property_lock);
+   task_publish_locked(task);
+   SLOCK_UNLOCK(title_lock);
 }
 
 void task_set_data(retro_task_t *task, void *data)
 {
-   SLOCK_LOCK(running_lock);
    task->task_data = data;
-   SLOCK_UNLOCK(running_lock);
 }
 
 void task_set_cancelled(retro_task_t *task, bool cancelled)
 {
-   SLOCK_LOCK(running_lock);
-   task->cancelled = cancelled;
-   SLOCK_UNLOCK(running_lock);
+   size_t status;
+
+   do
+   {
+      status = retro_atomic_load_acquire(&task->status);
+   } while (!retro_atomic_cas(&task->status, status, cancelled
+            ? status | TASK_STATUS_CANCELLED
+            : status & ~(size_t)TASK_STATUS_CANCELLED));
 }
 
 void task_free_title(retro_task_t *task)
 {
-   SLOCK_LOCK(property_lock);
+   SLOCK_LOCK(title_lock);
    if (task->title)
       free(task->title);
    task->title = NULL;
-   SLOCK_UNLOCK(property_lock);
+   task_publish_locked(task);
+   SLOCK_UNLOCK(title_lock);
 }
 
 void* task_get_data(retro_task_t *task)
 {
-   void *data = NULL;
-
-   SLOCK_LOCK(running_lock);
-   data = task->task_data;
-   SLOCK_UNLOCK(running_lock);
-
-   return data;
+   return task->task_data;
 }
 
 bool task_get_cancelled(retro_task_t *task)
 {
-   bool cancelled = false;
-
-   SLOCK_LOCK(running_lock);
-   cancelled = task->cancelled;
-   SLOCK_UNLOCK(running_lock);
-
-   return cancelled;
+   return (retro_atomic_load_acquire(&task->status)
+         & TASK_STATUS_CANCELLED) != 0;
 }
 
 bool task_get_finished(retro_task_t *task)
 {
-   bool finished = false;
-
-   SLOCK_LOCK(property_lock);
-   finished = task->finished;
-   SLOCK_UNLOCK(property_lock);
-
-   return finished;
+   return (retro_atomic_load_acquire(&task->status)
+         & TASK_STATUS_FINISHED) != 0;
 }
 
 bool task_get_mute(retro_task_t *task)
 {
-   bool mute = false;
-
-   SLOCK_LOCK(property_lock);
-   mute = task->mute;
-   SLOCK_UNLOCK(property_lock);
-
-   return mute;
+   return (retro_atomic_load_acquire(&task->status)
+         & TASK_STATUS_MUTE) != 0;
 }
 
 char* task_get_error(retro_task_t *task)
 {
-   char *error = NULL;
-
-   SLOCK_LOCK(property_lock);
-   error = task->error;
-   SLOCK_UNLOCK(property_lock);
-
-   return error;
+   return task->error;
 }
 
 int8_t task_get_progress(retro_task_t *task)
 {
-   int8_t progress = 0;
-
-   SLOCK_LOCK(property_lock);
-   progress = task->progress;
-   SLOCK_UNLOCK(property_lock);
-
-   return progress;
+   return (int8_t)(retro_atomic_load_acquire(&task->status)
+         & TASK_STATUS_PROGRESS);
 }
 
 char* task_get_title(retro_task_t *task)
 {
    char *title = NULL;
 
-   SLOCK_LOCK(property_lock);
+   SLOCK_LOCK(title_lock);
    title = task->title;
-   SLOCK_UNLOCK(property_lock);
+   SLOCK_UNLOCK(title_lock);
 
    return title;
 }
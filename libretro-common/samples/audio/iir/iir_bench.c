@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <features/features_cpu.h>
+
+/* For the static filter design and processing functions. */
+#include "../../../audio/dsp_filters/iir.c"
+
+#define BENCH_FRAMES (1024 * 1024)
+#define BENCH_BATCH  1024
+#define BENCH_RUNS   3
+
+/* The old filter divided by a0 for every sample. The designs here
+ * are normalised already, but keep the compiler from dropping the
+ * division. */
+static volatile float bench_a0 = 1.0f;
+
+/* The loop iir_process() used to run, one section at a time. */
+static void scalar_process(struct biquad_coefs *c, float a0,
+      float state[2][4], float *out, unsigned frames)
+{
+   unsigned i;
+   float xn1_l = state[0][0], xn2_l = state[0][1];
+   float yn1_l = state[0][2], yn2_l = state[0][3];
+   float xn1_r = state[1][0], xn2_r = state[1][1];
+   float yn1_r = state[1][2], yn2_r = state[1][3];
+
+   for (i = 0; i < frames; i++, out += 2)
+   {
+      float in_l = out[0];
+      float in_r = out[1];
+
+      float l    = (c->b0 * in_l + c->b1 * xn1_l + c->b2 * xn2_l - c->a1 * yn1_l - c->a2 * yn2_l) / a0;
+      float r    = (c->b0 * in_r + c->b1 * xn1_r + c->b2 * xn2_r - c->a1 * yn1_r - c->a2 * yn2_r) / a0;
+
+      xn2_l      = xn1_l;
+      xn1_l      = in_l;
+      yn2_l      = yn1_l;
+      yn1_l      = l;
+
+      xn2_r      = xn1_r;
+      xn1_r      = in_r;
+      yn2_r      = yn1_r;
+      yn1_r      = r;
+
+      out[0]     = l;
+      out[1]     = r;
+   }
+
+   state[0][0] = xn1_l; state[0][1] = xn2_l;
+   state[0][2] = yn1_l; state[0][3] = yn2_l;
+   state[1][0] = xn1_r; state[1][1] = xn2_r;
+   state[1][2] = yn1_r; state[1][3] = yn2_r;
+}
+
+static void bench_filter(const char *type, unsigned stages,
+      const float *in, float *ref, float *res)
+{
+   size_t i;
+   unsigned run, s;
+   struct iir_data iir;
+   struct biquad_coefs coefs;
+   float state[BIQUAD_MAX_STAGES][2][4];
+   retro_time_t ref_usec = 0;
+   retro_time_t res_usec = 0;
+   double err            = 0.0;
+   double peak           = 0.0;
+
+   iir_filter_init(&coefs, 48000.0f, 1000.0f, 0.707f, 6.0f,
+         str_to_type(type));
+
+   for (run = 0; run < BENCH_RUNS; run++)
+   {
+      retro_time_t start;
+
+      memcpy(ref, in, BENCH_FRAMES * 2 * sizeof(float));
+      memcpy(res, in, BENCH_FRAMES * 2 * sizeof(float));
+      memset(state, 0, sizeof(state));
+      biquad_cascade_init(&iir.biquad, stages, 0);
+      for (s = 0; s < stages; s++)
+         biquad_cascade_set(&iir.biquad, s, &coefs);
+
+      start = cpu_features_get_time_usec();
+
+      for (i = 0; i < BENCH_FRAMES; i += BENCH_BATCH)
+         for (s = 0; s < stages; s++)
+            scalar_process(&coefs, bench_a0, state[s], ref + i * 2, BENCH_BATCH);
+
+      start = cpu_features_get_time_usec() - start;
+      if (!ref_usec || start < ref_usec)
+         ref_usec = start;
+
+      start = cpu_features_get_time_usec();
+
+      for (i = 0; i < BENCH_FRAMES; i += BENCH_BATCH)
+      {
+         struct dspfilter_input input;
+         struct dspfilter_output output;
+
+         input.samples = res + i * 2;
+         input.frames  = BENCH_BATCH;
+         iir_process(&iir, &output, &input);
+      }
+
+      start = cpu_features_get_time_usec() - start;
+      if (!res_usec || start < res_usec)
+         res_usec = start;
+   }
+
+   for (i = 0; i < BENCH_FRAMES * 2; i++)
+   {
+      if (fabs(ref[i] - res[i]) > err)
+         err = fabs(ref[i] - res[i]);
+      if (fabs(ref[i]) > peak)
+         peak = fabs(ref[i]);
+   }
+
+   printf("%-10s stages %u  scalar %6.2f ns/frame  cascade %6.2f ns/frame"
+         "  %5.2fx  max error %.2g of %.2g\n",
+         type, stages,
+         ref_usec * 1000.0 / BENCH_FRAMES,
+         res_usec * 1000.0 / BENCH_FRAMES,
+         (double)ref_usec / (res_usec ? res_usec : 1),
+         err, peak);
+}
+
+int main(void)
+{
+   size_t i;
+   unsigned t;
+   static const char *types[] = { "LPF", "PEQ", "HSH" };
+   float *in  = (float*)malloc(BENCH_FRAMES * 2 * sizeof(float));
+   float *ref = (float*)malloc(BENCH_FRAMES * 2 * sizeof(float));
+   float *res = (float*)malloc(BENCH_FRAMES * 2 * sizeof(float));
+
+   if (!in || !ref || !res)
+      return 1;
+
+   /* Noise plus a tone, so that the filters never settle. */
+   srand(1);
+   for (i = 0; i < BENCH_FRAMES; i++)
+   {
+      float tone    = 0.25f * sinf(i * 0.05f);
+      in[2 * i + 0] = tone + 0.5f * (rand() / (float)RAND_MAX - 0.5f);
+      in[2 * i + 1] = tone + 0.5f * (rand() / (float)RAND_MAX - 0.5f);
+   }
+
+   for (t = 0; t < sizeof(types) / sizeof(*types); t++)
+   {
+      bench_filter(types[t], 1, in, ref, res);
+      bench_filter(types[t], 4, in, ref, res);
+   }
+
+   free(in);
+   free(ref);
+   free(res);
+   return 0;
+}
@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <features/features_cpu.h>
+#include <audio/audio_pipeline.h>
+#include <audio/conversion/float_to_s16.h>
+#include <audio/conversion/s16_to_float.h>
+
+#define BENCH_FRAMES (48000 * 20)
+#define BENCH_RATIO  (48000.0 / 44100.0)
+#define BENCH_RUNS   3
+
+/* The separate passes RetroArch runs over each batch, each with
+ * its own buffer. */
+struct multipass
+{
+   float *samples;
+   float *resampled;
+   const retro_resampler_t *resampler;
+   void *resampler_data;
+   retro_dsp_filter_t *dsp;
+};
+
+static size_t multipass_process(struct multipass *mp, int16_t *out,
+      const int16_t *in, size_t frames, double ratio)
+{
+   struct resampler_data data;
+   struct retro_dsp_data dsp_data;
+   float *samples = mp->resampled;
+
+   convert_s16_to_float(mp->samples, in, frames * 2, 1.0f);
+
+   data.data_in       = mp->samples;
+   data.data_out      = mp->resampled;
+   data.input_frames  = frames;
+   data.output_frames = 0;
+   data.ratio         = ratio;
+   mp->resampler->process(mp->resampler_data, &data);
+
+   frames             = data.output_frames;
+
+   if (mp->dsp)
+   {
+      dsp_data.input        = samples;
+      dsp_data.input_frames = (unsigned)frames;
+      retro_dsp_filter_process(mp->dsp, &dsp_data);
+      samples               = dsp_data.output;
+      frames                = dsp_data.output_frames;
+   }
+
+   convert_float_to_s16(out, samples, frames * 2);
+   return frames;
+}
+
+static retro_dsp_filter_t *bench_dsp_new(const char *path)
+{
+   if (!path)
+      return NULL;
+   return retro_dsp_filter_new(path, NULL, 48000.0f);
+}
+
+static void bench_batch(size_t batch, const int16_t *in,
+      int16_t *ref, int16_t *res, const char *dsp_path)
+{
+   size_t i;
+   unsigned run;
+   size_t ref_frames     = 0;
+   size_t res_frames     = 0;
+   retro_time_t ref_usec = 0;
+   retro_time_t res_usec = 0;
+   struct multipass mp;
+   struct audio_pipeline_config config;
+   audio_pipeline_t *pipe;
+   int err               = 0;
+
+   memset(&mp, 0, sizeof(mp));
+   mp.samples   = (float*)malloc(batch * 2 * sizeof(float));
+   mp.resampled = (float*)malloc(((size_t)(batch * BENCH_RATIO) + 16)
+         * 2 * sizeof(float));
+   mp.dsp       = bench_dsp_new(dsp_path);
+
+   if (!mp.samples || !mp.resampled ||
+         !retro_resampler_realloc(&mp.resampler_data, &mp.resampler,
+            "sinc", RESAMPLER_QUALITY_NORMAL, BENCH_RATIO))
+      return;
+
+   config.resampler_ident = "sinc";
+   config.quality         = RESAMPLER_QUALITY_NORMAL;
+   config.max_ratio       = BENCH_RATIO;
+   config.dsp             = bench_dsp_new(dsp_path);
+   config.gain            = 1.0f;
+
+   if (!(pipe = audio_pipeline_new(&config)))
+      return;
+
+   /* Best of a few runs, both keep their state between runs. */
+   for (run = 0; run < BENCH_RUNS; run++)
+   {
+      retro_time_t start = cpu_features_get_time_usec();
+
+      for (ref_frames = 0, i = 0; i + batch <= BENCH_FRAMES; i += batch)
+         ref_frames += multipass_process(&mp, ref + ref_frames * 2,
+               in + i * 2, batch, BENCH_RATIO);
+
+      start = cpu_features_get_time_usec() - start;
+      if (!ref_usec || start < ref_usec)
+         ref_usec = start;
+
+      start = cpu_features_get_time_usec();
+
+      for (res_frames = 0, i = 0; i + batch <= BENCH_FRAMES; i += batch)
+         res_frames += audio_pipeline_process(pipe, res + res_frames * 2,
+               in + i * 2, batch, BENCH_RATIO);
+
+      start = cpu_features_get_time_usec() - start;
+      if (!res_usec || start < res_usec)
+         res_usec = start;
+   }
+
+   /* convert_float_to_s16() rounds in its SIMD loop but truncates
+    * the remainder, so block boundaries may move samples by 1. */
+   for (i = 0; i < 2 * ref_frames && i < 2 * res_frames; i++)
+      if (abs(ref[i] - res[i]) > err)
+         err = abs(ref[i] - res[i]);
+
+   printf("batch %6u  multipass %6.2f ns/frame  pipeline %6.2f ns/frame"
+         "  %5.2fx  max error %d%s\n",
+         (unsigned)batch,
+         ref_usec * 1000.0 / BENCH_FRAMES,
+         res_usec * 1000.0 / BENCH_FRAMES,
+         (double)ref_usec / (res_usec ? res_usec : 1),
+         err,
+         ref_frames != res_frames ? "  (frame count differs)" : "");
+
+   audio_pipeline_free(pipe);
+   retro_dsp_filter_free(config.dsp);
+   retro_dsp_filter_free(mp.dsp);
+   mp.resampler->free(mp.resampler_data);
+   free(mp.samples);
+   free(mp.resampled);
+}
+
+int main(int argc, char *argv[])
+{
+   unsigned i;
+   static const size_t batches[] = { 256, 1024, 4096, 48000 };
+   const char *dsp_path = argc > 1 ? argv[1] : NULL;
+   size_t cap           = (size_t)(BENCH_FRAMES * BENCH_RATIO) + 4096;
+   int16_t *in          = (int16_t*)malloc(2 * BENCH_FRAMES * sizeof(int16_t));
+   int16_t *ref         = (int16_t*)malloc(2 * cap * sizeof(int16_t));
+   int16_t *res         = (int16_t*)malloc(2 * cap * sizeof(int16_t));
+
+   if (!in || !ref || !res)
+      return 1;
+
+   for (i = 0; i < BENCH_FRAMES; i++)
+   {
+      in[2 * i + 0] = (int16_t)(20000.0f * sinf(i * 0.01f));
+      in[2 * i + 1] = (int16_t)(14000.0f * cosf(i * 0.0137f));
+   }
+
+   printf("s16 -> float -> sinc -> %sfloat -> s16, ratio %f, %u frames\n",
+         dsp_path ? "dsp -> " : "", BENCH_RATIO, BENCH_FRAMES);
+
+   for (i = 0; i < sizeof(batches) / sizeof(batches[0]); i++)
+      bench_batch(batches[i], in, ref, res, dsp_path);
+
+   free(in);
+   free(ref);
+   free(res);
+   return 0;
+}
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <features/features_cpu.h>
+#include <audio/audio_resampler.h>
+
+#define BENCH_FRAMES 48000
+#define BENCH_RUNS   20
+
+/* The per-frame SIMD kernels, see sinc_frame.c. */
+extern retro_resampler_t sinc_frame_resampler;
+
+struct bench_result
+{
+   float *out;
+   size_t frames;
+   retro_time_t usec;
+};
+
+static const char *quality_names[] = {
+   "dontcare", "lowest", "lower", "normal", "higher", "highest"
+};
+
+static bool bench_run(retro_resampler_t *driver,
+      enum resampler_quality quality, resampler_simd_mask_t mask,
+      double ratio, const float *in, struct bench_result *res)
+{
+   unsigned i;
+   resampler_process_t process;
+   struct resampler_config config = {0};
+   void *re = driver->init(&config, ratio < 1.0 ? ratio : 1.0,
+         quality, mask);
+
+   if (!re)
+      return false;
+
+   /* The driver picks its kernel when it is initialized. */
+   process   = driver->process;
+   res->usec = 0;
+
+   for (i = 0; i < BENCH_RUNS; i++)
+   {
+      struct resampler_data data;
+      retro_time_t start;
+
+      data.data_in       = in;
+      data.data_out      = res->out;
+      data.input_frames  = BENCH_FRAMES;
+      data.output_frames = 0;
+      data.ratio         = ratio;
+
+      start              = cpu_features_get_time_usec();
+      process(re, &data);
+      res->usec         += cpu_features_get_time_usec() - start;
+      res->frames        = data.output_frames;
+   }
+
+   driver->free(re);
+   return true;
+}
+
+static void bench_quality(enum resampler_quality quality, double ratio,
+      const float *in, struct bench_result *ref, struct bench_result *res,
+      struct bench_result *old)
+{
+   unsigned i;
+   static const struct
+   {
+      const char *name;
+      resampler_simd_mask_t mask;
+   } variants[] = {
+      { "sse",  RESAMPLER_SIMD_SSE },
+      { "avx",  RESAMPLER_SIMD_SSE | RESAMPLER_SIMD_AVX },
+      { "neon", RESAMPLER_SIMD_NEON },
+   };
+   uint64_t cpu = cpu_features_get();
+
+   if (!bench_run(&sinc_resampler, quality, 0, ratio, in, ref))
+      return;
+
+   printf("%-8s c     %8.2f ns/frame\n", quality_names[quality],
+         ref->usec * 1000.0 / (BENCH_RUNS * (double)ref->frames));
+
+   for (i = 0; i < sizeof(variants) / sizeof(variants[0]); i++)
+   {
+      size_t j;
+      float err = 0.0f;
+
+      if ((cpu & variants[i].mask) != variants[i].mask)
+         continue;
+      if (!bench_run(&sinc_resampler, quality, variants[i].mask,
+               ratio, in, res))
+         continue;
+
+      for (j = 0; j < 2 * res->frames && j < 2 * ref->frames; j++)
+      {
+         float diff = fabsf(res->out[j] - ref->out[j]);
+         if (diff > err)
+            err = diff;
+      }
+
+      printf("%-8s %-5s %8.2f ns/frame  %5.2fx  max error %g%s\n",
+            quality_names[quality], variants[i].name,
+            res->usec * 1000.0 / (BENCH_RUNS * (double)res->frames),
+            (double)ref->usec / (res->usec ? res->usec : 1), err,
+            res->frames != ref->frames ? "  (frame count differs)" : "");
+
+      if (bench_run(&sinc_frame_resampler, quality, variants[i].mask,
+               ratio, in, old))
+         printf("%-8s %-5s %8.2f ns/frame  per-frame kernel, block is %.2fx\n",
+               quality_names[quality], variants[i].name,
+               old->usec * 1000.0 / (BENCH_RUNS * (double)old->frames),
+               (double)old->usec / (res->usec ? res->usec : 1));
+   }
+}
+
+int main(int argc, char *argv[])
+{
+   unsigned i;
+   struct bench_result ref, res, old;
+   double ratio = argc > 1 ? atof(argv[1]) : 48000.0 / 44100.0;
+   float *in    = (float*)malloc(2 * BENCH_FRAMES * sizeof(float));
+   size_t cap   = (size_t)(BENCH_FRAMES * ratio) + 16;
+
+   ref.out      = (float*)malloc(2 * cap * sizeof(float));
+   res.out      = (float*)malloc(2 * cap * sizeof(float));
+   old.out      = (float*)malloc(2 * cap * sizeof(float));
+
+   if (!in || !ref.out || !res.out || !old.out || ratio <= 0.0)
+      return 1;
+
+   for (i = 0; i < BENCH_FRAMES; i++)
+   {
+      in[2 * i + 0] = sinf(i * 0.01f);
+      in[2 * i + 1] = 0.7f * cosf(i * 0.0137f);
+   }
+
+   printf("sinc resampler, ratio %f, %u frames x %u runs\n",
+         ratio, BENCH_FRAMES, BENCH_RUNS);
+
+   for (i = RESAMPLER_QUALITY_LOWEST; i <= RESAMPLER_QUALITY_HIGHEST; i++)
+      bench_quality((enum resampler_quality)i, ratio, in, &ref, &res, &old);
+
+   free(in);
+   free(ref.out);
+   free(res.out);
+   free(old.out);
+   return 0;
+}
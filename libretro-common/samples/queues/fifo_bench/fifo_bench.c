@@ -0,0 +1,291 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <retro_timers.h>
+#include <rthreads/rthreads.h>
+#include <features/features_cpu.h>
+#include <queues/fifo_queue.h>
+#include <queues/spsc_queue.h>
+
+/* Streams BENCH_TOTAL bytes from a producer thread to a consumer
+ * thread in audio-sized chunks, through a 64 KiB queue. */
+#define BENCH_TOTAL    (256u * 1024 * 1024)
+#define BENCH_CHUNK    4096
+#define BENCH_CAPACITY (64 * 1024)
+
+enum bench_mode
+{
+   BENCH_FIFO_LOCKED = 0,
+   BENCH_FIFO,
+   BENCH_SPSC_ZERO_COPY,
+   BENCH_SPSC_MIRRORED
+};
+
+struct bench
+{
+   enum bench_mode mode;
+   fifo_buffer_t *fifo;
+   spsc_queue_t *spsc;
+   slock_t *lock;
+   bool corrupt;
+};
+
+/* The stream is made of 4 KiB blocks, each filled with its index.
+ * Only the ends of each run are checked, to keep the benchmark about
+ * the queue rather than about touching every byte. */
+static void bench_fill(uint8_t *dst, size_t pos, size_t size)
+{
+   while (size)
+   {
+      size_t run = BENCH_CHUNK - (pos % BENCH_CHUNK);
+      if (run > size)
+         run = size;
+
+      memset(dst, (uint8_t)(pos / BENCH_CHUNK), run);
+      dst  += run;
+      pos  += run;
+      size -= run;
+   }
+}
+
+static bool bench_check(const uint8_t *src, size_t pos, size_t size)
+{
+   while (size)
+   {
+      size_t run = BENCH_CHUNK - (pos % BENCH_CHUNK);
+      if (run > size)
+         run = size;
+
+      if (src[0] != (uint8_t)(pos / BENCH_CHUNK) ||
+            src[run - 1] != (uint8_t)(pos / BENCH_CHUNK))
+         return false;
+      src  += run;
+      pos  += run;
+      size -= run;
+   }
+
+   return true;
+}
+
+static void bench_producer(void *data)
+{
+   struct bench *b = (struct bench*)data;
+   uint8_t chunk[BENCH_CHUNK];
+   size_t written  = 0;
+
+   while (written < BENCH_TOTAL)
+   {
+      size_t size = BENCH_CHUNK;
+
+      if (b->mode == BENCH_SPSC_ZERO_COPY)
+      {
+         struct spsc_queue_span span;
+
+         /* Like a decoder, only produce whole blocks. */
+         if (spsc_queue_write_reserve(b->spsc, size, &span) < size)
+         {
+            retro_sleep(0);
+            continue;
+         }
+
+         /* Produce straight into the queue. */
+         bench_fill(span.data[0], written, span.size[0]);
+         bench_fill(span.data[1], written + span.size[0], span.size[1]);
+
+         spsc_queue_write_commit(b->spsc, size);
+         written += size;
+         continue;
+      }
+
+      bench_fill(chunk, written, size);
+
+      for (;;)
+      {
+         bool done = false;
+
+         if (b->lock)
+            slock_lock(b->lock);
+         if (fifo_write_avail(b->fifo) >= size)
+         {
+            fifo_write(b->fifo, chunk, size);
+            done = true;
+         }
+         if (b->lock)
+            slock_unlock(b->lock);
+
+         if (done)
+            break;
+         retro_sleep(0);
+      }
+
+      written += size;
+   }
+}
+
+static void bench_consumer(struct bench *b)
+{
+   uint8_t chunk[BENCH_CHUNK];
+   size_t read = 0;
+
+   while (read < BENCH_TOTAL)
+   {
+      size_t size = 0;
+
+      if (b->mode == BENCH_SPSC_ZERO_COPY)
+      {
+         struct spsc_queue_span span;
+
+         size = spsc_queue_read_reserve(b->spsc, BENCH_CHUNK, &span);
+
+         if (!bench_check(span.data[0], read, span.size[0]) ||
+               !bench_check(span.data[1], read + span.size[0],
+                  span.size[1]))
+            b->corrupt = true;
+
+         spsc_queue_read_commit(b->spsc, size);
+      }
+      else
+      {
+         if (b->lock)
+            slock_lock(b->lock);
+         size = fifo_read_avail(b->fifo);
+         if (size > BENCH_CHUNK)
+            size = BENCH_CHUNK;
+         fifo_read(b->fifo, chunk, size);
+         if (b->lock)
+            slock_unlock(b->lock);
+
+         if (!bench_check(chunk, read, size))
+            b->corrupt = true;
+      }
+
+      if (!size)
+         retro_sleep(0);
+      read += size;
+   }
+}
+
+static void bench_run(const char *name, enum bench_mode mode)
+{
+   struct bench b;
+   sthread_t *thread;
+   retro_time_t start, usec;
+
+   memset(&b, 0, sizeof(b));
+   b.mode = mode == BENCH_SPSC_MIRRORED ? BENCH_SPSC_ZERO_COPY : mode;
+
+   if (mode == BENCH_SPSC_MIRRORED)
+      b.spsc = spsc_queue_new_mirrored(BENCH_CAPACITY);
+   else if (mode == BENCH_SPSC_ZERO_COPY)
+      b.spsc = spsc_queue_new(BENCH_CAPACITY);
+   else
+      b.fifo = fifo_new(BENCH_CAPACITY);
+   if (mode == BENCH_FIFO_LOCKED)
+      b.lock = slock_new();
+
+   start  = cpu_features_get_time_usec();
+   thread = sthread_create(bench_producer, &b);
+   bench_consumer(&b);
+   sthread_join(thread);
+   usec   = cpu_features_get_time_usec() - start;
+
+   printf("%-28s %8.1f MiB/s%s\n", name,
+         (BENCH_TOTAL / (1024.0 * 1024.0)) / (usec / 1000000.0),
+         b.corrupt ? "  (data corrupted)" : "");
+
+   if (b.lock)
+      slock_free(b.lock);
+   fifo_free(b.fifo);
+   spsc_queue_free(b.spsc);
+}
+
+/* Same stream with both ends in one thread, alternating between
+ * a write and a read. This shows the cost of the queue itself,
+ * without the scheduler in the way. */
+static void bench_run_single(const char *name, enum bench_mode mode)
+{
+   struct bench b;
+   uint8_t chunk[BENCH_CHUNK];
+   size_t pos = 0;
+   retro_time_t start, usec;
+
+   memset(&b, 0, sizeof(b));
+
+   if (mode == BENCH_SPSC_MIRRORED)
+      b.spsc = spsc_queue_new_mirrored(BENCH_CAPACITY);
+   else if (mode == BENCH_SPSC_ZERO_COPY)
+      b.spsc = spsc_queue_new(BENCH_CAPACITY);
+   else
+      b.fifo = fifo_new(BENCH_CAPACITY);
+   if (mode == BENCH_FIFO_LOCKED)
+      b.lock = slock_new();
+
+   start = cpu_features_get_time_usec();
+
+   for (pos = 0; pos < BENCH_TOTAL; pos += BENCH_CHUNK)
+   {
+      if (mode == BENCH_SPSC_ZERO_COPY || mode == BENCH_SPSC_MIRRORED)
+      {
+         struct spsc_queue_span span;
+
+         spsc_queue_write_reserve(b.spsc, BENCH_CHUNK, &span);
+         bench_fill(span.data[0], pos, span.size[0]);
+         bench_fill(span.data[1], pos + span.size[0], span.size[1]);
+         spsc_queue_write_commit(b.spsc, BENCH_CHUNK);
+
+         spsc_queue_read_reserve(b.spsc, BENCH_CHUNK, &span);
+         if (!bench_check(span.data[0], pos, span.size[0]) ||
+               !bench_check(span.data[1], pos + span.size[0],
+                  span.size[1]))
+            b.corrupt = true;
+         spsc_queue_read_commit(b.spsc, BENCH_CHUNK);
+         continue;
+      }
+
+      bench_fill(chunk, pos, BENCH_CHUNK);
+
+      if (b.lock)
+         slock_lock(b.lock);
+      if (fifo_write_avail(b.fifo) >= BENCH_CHUNK)
+         fifo_write(b.fifo, chunk, BENCH_CHUNK);
+      if (b.lock)
+         slock_unlock(b.lock);
+
+      if (b.lock)
+         slock_lock(b.lock);
+      if (fifo_read_avail(b.fifo) >= BENCH_CHUNK)
+         fifo_read(b.fifo, chunk, BENCH_CHUNK);
+      if (b.lock)
+         slock_unlock(b.lock);
+
+      if (!bench_check(chunk, pos, BENCH_CHUNK))
+         b.corrupt = true;
+   }
+
+   usec = cpu_features_get_time_usec() - start;
+
+   printf("%-28s %8.1f MiB/s%s\n", name,
+         (BENCH_TOTAL / (1024.0 * 1024.0)) / (usec / 1000000.0),
+         b.corrupt ? "  (data corrupted)" : "");
+
+   if (b.lock)
+      slock_free(b.lock);
+   fifo_free(b.fifo);
+   spsc_queue_free(b.spsc);
+}
+
+int main(void)
+{
+   puts("Producer and consumer threads:");
+   bench_run("mutex + fifo",               BENCH_FIFO_LOCKED);
+   bench_run("lock-free fifo",             BENCH_FIFO);
+   bench_run("spsc reserve/commit",        BENCH_SPSC_ZERO_COPY);
+   bench_run("spsc mirrored",              BENCH_SPSC_MIRRORED);
+
+   puts("Single thread:");
+   bench_run_single("mutex + fifo",        BENCH_FIFO_LOCKED);
+   bench_run_single("lock-free fifo",      BENCH_FIFO);
+   bench_run_single("spsc reserve/commit", BENCH_SPSC_ZERO_COPY);
+   bench_run_single("spsc mirrored",       BENCH_SPSC_MIRRORED);
+   return 0;
+}
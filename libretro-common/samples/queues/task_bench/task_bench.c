@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <retro_atomic.h>
+#include <retro_timers.h>
+#include <rthreads/rthreads.h>
+#include <features/features_cpu.h>
+#include <queues/task_queue.h>
+
+/* Keeps BENCH_TASKS short tasks in flight for BENCH_USEC, pushed by
+ * a producer thread, while the main thread gathers them like a
+ * frontend's main loop does once per frame. Each slice reports its
+ * progress and renames the task, which is the worst case for the
+ * main thread reading them. */
+#define BENCH_USEC   2000000
+#define BENCH_TASKS  256
+#define BENCH_SLICES 16
+#define BENCH_WORK   2000
+
+struct bench_state
+{
+   unsigned left;
+};
+
+static volatile size_t bench_running  = 0;
+static volatile size_t bench_inflight = 0;
+static volatile size_t bench_slices   = 0;
+static volatile size_t bench_done     = 0;
+
+static void bench_handler(retro_task_t *task)
+{
+   char title[32];
+   unsigned i;
+   struct bench_state *state = (struct bench_state*)task->state;
+   volatile unsigned sum     = 0;
+
+   for (i = 0; i < BENCH_WORK; i++)
+      sum += i;
+
+   retro_atomic_fetch_add(&bench_slices, 1);
+
+   if (--state->left == 0 || task_get_cancelled(task))
+   {
+      task_set_finished(task, true);
+      return;
+   }
+
+   snprintf(title, sizeof(title), "Task %u", state->left);
+   task_free_title(task);
+   task_set_title(task, strdup(title));
+   task_set_progress(task,
+         (int8_t)(100 - state->left * 100 / BENCH_SLICES));
+}
+
+static void bench_callback(void *task_data,
+      void *user_data, const char *error)
+{
+   bench_done++;
+   retro_atomic_fetch_add(&bench_inflight, (size_t)-1);
+}
+
+static void bench_cleanup(retro_task_t *task)
+{
+   free(task->state);
+}
+
+static void bench_msg(const char *msg, unsigned prio,
+      unsigned duration, bool flush)
+{
+}
+
+static void bench_producer(void *data)
+{
+   while (retro_atomic_load_acquire(&bench_running))
+   {
+      retro_task_t *task;
+      struct bench_state *state;
+
+      if (retro_atomic_load_acquire(&bench_inflight) >= BENCH_TASKS)
+      {
+         retro_sleep(0);
+         continue;
+      }
+
+      task           = (retro_task_t*)calloc(1, sizeof(*task));
+      state          = (struct bench_state*)malloc(sizeof(*state));
+      state->left    = BENCH_SLICES;
+      task->state    = state;
+      task->handler  = bench_handler;
+      task->callback = bench_callback;
+      task->cleanup  = bench_cleanup;
+      task->title    = strdup("Task");
+
+      retro_atomic_fetch_add(&bench_inflight, 1);
+      task_queue_push(task);
+   }
+}
+
+static void bench_run(unsigned workers)
+{
+   sthread_t *producer;
+   retro_time_t start, now;
+   retro_time_t total   = 0;
+   retro_time_t longest = 0;
+   unsigned frames      = 0;
+
+   bench_slices  = 0;
+   bench_done    = 0;
+   bench_running = 1;
+
+   task_queue_set_worker_count(workers);
+   task_queue_init(true, bench_msg);
+
+   producer = sthread_create(bench_producer, NULL);
+   start    = cpu_features_get_time_usec();
+
+   do
+   {
+      retro_time_t gather = cpu_features_get_time_usec();
+      task_queue_check();
+      now     = cpu_features_get_time_usec();
+      gather  = now - gather;
+
+      total  += gather;
+      if (gather > longest)
+         longest = gather;
+      frames++;
+
+      retro_sleep(1);
+   } while (now - start < BENCH_USEC);
+
+   retro_atomic_store_release(&bench_running, 0);
+   sthread_join(producer);
+
+   printf("%2u workers  %8.0f slices/s  %6u tasks  "
+         "gather %6.1f us avg %8ld us max\n",
+         workers,
+         retro_atomic_load_acquire(&bench_slices)
+            / ((now - start) / 1000000.0),
+         (unsigned)bench_done,
+         (double)total / frames, (long)longest);
+
+   task_queue_reset();
+   task_queue_wait(NULL, NULL);
+   task_queue_deinit();
+}
+
+int main(void)
+{
+   unsigned workers;
+
+   printf("%u cores\n", cpu_features_get_core_amount());
+
+   for (workers = 1; workers <= 8; workers *= 2)
+      bench_run(workers);
+
+   return 0;
+}
@@ -0,0 +1,229 @@
+/* mpv media player libretro core
+ * Copyright (C) 2018 Mahyar Koshkouei
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <rhash.h>
+#include <streams/file_stream.h>
+
+#include "mediacache.h"
+
+#ifdef _WIN32
+#define PATH_SEPARATOR '\\'
+#else
+#define PATH_SEPARATOR '/'
+#endif
+
+#define CACHE_FILENAME		"mpv-libretro.cache"
+#define CACHE_MAGIC			"MPVC"
+#define CACHE_VERSION		3
+#define CACHE_MAX_ENTRIES	256
+
+/* Amount of data hashed at each end of the file. */
+#define FINGERPRINT_CHUNK	(64 * 1024)
+
+/* The cache is a header followed by entries, most recently stored first. */
+struct cache_header
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t count;
+	uint32_t reserved;
+};
+
+struct cache_entry
+{
+	struct media_fingerprint fp;
+	struct media_info info;
+};
+
+static bool hash_chunk(RFILE *f, int64_t offset, uint32_t *crc)
+{
+	uint8_t *buf = malloc(FINGERPRINT_CHUNK);
+	int64_t len;
+
+	if(buf == NULL)
+		return false;
+
+	if(filestream_seek(f, offset, RETRO_VFS_SEEK_POSITION_START) < 0 ||
+			(len = filestream_read(f, buf, FINGERPRINT_CHUNK)) < 0)
+	{
+		free(buf);
+		return false;
+	}
+
+	*crc = crc32_calculate(buf, (size_t)len);
+	free(buf);
+	return true;
+}
+
+bool media_cache_fingerprint(const char *path, struct media_fingerprint *fp)
+{
+	struct stat st;
+	RFILE *f;
+	bool ret;
+
+	memset(fp, 0, sizeof(*fp));
+
+	if(stat(path, &st) != 0)
+		return false;
+
+	fp->size = (uint64_t)st.st_size;
+	fp->mtime = (int64_t)st.st_mtime;
+
+	f = filestream_open(path, RETRO_VFS_FILE_ACCESS_READ,
+			RETRO_VFS_FILE_ACCESS_HINT_NONE);
+
+	if(f == NULL)
+		return false;
+
+	ret = hash_chunk(f, 0, &fp->crc_head);
+
+	if(ret && fp->size > FINGERPRINT_CHUNK)
+		ret = hash_chunk(f, (int64_t)fp->size - FINGERPRINT_CHUNK,
+				&fp->crc_tail);
+
+	filestream_close(f);
+	return ret;
+}
+
+static char *cache_path(const char *dir)
+{
+	size_t len = strlen(dir) + sizeof(CACHE_FILENAME) + 1;
+	char *path = malloc(len);
+
+	if(path != NULL)
+		snprintf(path, len, "%s%c%s", dir, PATH_SEPARATOR, CACHE_FILENAME);
+
+	return path;
+}
+
+/**
+ * Read all cache entries. Returns the number of entries read, and sets
+ * entries to an array with room for CACHE_MAX_ENTRIES.
+ */
+static unsigned read_cache(const char *path, struct cache_entry **entries)
+{
+	struct cache_header hdr;
+	RFILE *f;
+	unsigned count = 0;
+
+	if((*entries = calloc(CACHE_MAX_ENTRIES, sizeof(**entries))) == NULL)
+		return 0;
+
+	f = filestream_open(path, RETRO_VFS_FILE_ACCESS_READ,
+			RETRO_VFS_FILE_ACCESS_HINT_NONE);
+
+	if(f == NULL)
+		return 0;
+
+	if(filestream_read(f, &hdr, sizeof(hdr)) == sizeof(hdr) &&
+			memcmp(hdr.magic, CACHE_MAGIC, 4) == 0 &&
+			hdr.version == CACHE_VERSION &&
+			hdr.count <= CACHE_MAX_ENTRIES &&
+			filestream_read(f, *entries, hdr.count * sizeof(**entries)) ==
+				(int64_t)(hdr.count * sizeof(**entries)))
+		count = hdr.count;
+
+	filestream_close(f);
+	return count;
+}
+
+bool media_cache_load(const char *dir, const struct media_fingerprint *fp,
+		struct media_info *info)
+{
+	struct cache_entry *entries;
+	char *path = cache_path(dir);
+	unsigned count;
+	bool found = false;
+
+	if(path == NULL)
+		return false;
+
+	count = read_cache(path, &entries);
+
+	for(unsigned i = 0; i < count; i++)
+	{
+		if(memcmp(&entries[i].fp, fp, sizeof(*fp)) == 0)
+		{
+			*info = entries[i].info;
+			found = true;
+			break;
+		}
+	}
+
+	free(entries);
+	free(path);
+	return found;
+}
+
+bool media_cache_store(const char *dir, const struct media_fingerprint *fp,
+		const struct media_info *info)
+{
+	struct cache_header hdr = { CACHE_MAGIC, CACHE_VERSION };
+	struct cache_entry *entries;
+	char *path = cache_path(dir);
+	unsigned count, i;
+	RFILE *f;
+	bool ret = false;
+
+	if(path == NULL)
+		return false;
+
+	count = read_cache(path, &entries);
+
+	if(entries == NULL)
+		goto out;
+
+	/* Move the file to the front, dropping its previous entry or the oldest
+	 * entry if the cache is full. */
+	for(i = 0; i < count; i++)
+	{
+		if(memcmp(&entries[i].fp, fp, sizeof(*fp)) == 0)
+			break;
+	}
+
+	if(i == count && count < CACHE_MAX_ENTRIES)
+		count++;
+	else if(i == count)
+		i = count - 1;
+
+	memmove(&entries[1], &entries[0], i * sizeof(*entries));
+	entries[0].fp = *fp;
+	entries[0].info = *info;
+	hdr.count = count;
+
+	f = filestream_open(path, RETRO_VFS_FILE_ACCESS_WRITE,
+			RETRO_VFS_FILE_ACCESS_HINT_NONE);
+
+	if(f == NULL)
+		goto out;
+
+	ret = filestream_write(f, &hdr, sizeof(hdr)) == sizeof(hdr) &&
+		filestream_write(f, entries, count * sizeof(*entries)) ==
+			(int64_t)(count * sizeof(*entries));
+
+	filestream_close(f);
+
+out:
+	free(entries);
+	free(path);
+	return ret;
+}
@@ -0,0 +1,73 @@
+/* mpv media player libretro core
+ * Copyright (C) 2018 Mahyar Koshkouei
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBRETRO_MPV_MEDIACACHE_H
+#define LIBRETRO_MPV_MEDIACACHE_H
+
+#include <stdint.h>
+
+#include <boolean.h>
+
+/* Cheap identification of a media file that survives renames. */
+struct media_fingerprint
+{
+	uint64_t size;
+	int64_t mtime;
+	uint32_t crc_head;
+	uint32_t crc_tail;
+};
+
+/* Information remembered about a media file between plays. A value of zero
+ * means that it is unknown. */
+struct media_info
+{
+	int64_t position;
+	int64_t aid;
+	int64_t sid;
+	double fps;
+	int64_t width;
+	int64_t height;
+	double sample_rate;
+	/* Whether the file has been probed, as a file without audio also has
+	 * a sample_rate of zero. */
+	bool probed;
+};
+
+/**
+ * Fingerprint a file by its size, modification time and the CRC32 of its
+ * first and last 64 KiB.
+ *
+ * \return	false if the file could not be read.
+ */
+bool media_cache_fingerprint(const char *path, struct media_fingerprint *fp);
+
+/**
+ * Look up a file in the cache stored in the given directory.
+ *
+ * \return	false if the file is not in the cache.
+ */
+bool media_cache_load(const char *dir, const struct media_fingerprint *fp,
+		struct media_info *info);
+
+/**
+ * Add or update a file in the cache stored in the given directory. The least
+ * recently stored entry is dropped when the cache is full.
+ */
+bool media_cache_store(const char *dir, const struct media_fingerprint *fp,
+		const struct media_info *info);
+
+#endif
@@ -29,6 +29,8 @@
 
 #include <libretro.h>
 
+#include "mediacache.h"
+#include "thumbnail.h"
 #include "version.h"
 
 static struct retro_hw_render_callback hw_render;
@@ -52,8 +54,24 @@ static int64_t playback_time = 0;
 /* filepath required globaly as mpv is reopened on context change */
 static char *filepath = NULL;
 
+/* Information about the loaded file, remembered between plays in the save
+ * directory. */
+static char *save_dir = NULL;
+static struct media_fingerprint media_fp;
+static struct media_info media;
+static bool media_known = false;
+static bool media_finished = false;
+
 static volatile int frame_queue = 0;
 
+/* Second instance playing the next audio track muted and in sync with mpv,
+ * so that cycling the audio track only swaps which of them is muted. */
+static mpv_handle *preload = NULL;
+static bool preload_wanted = false;
+static bool preload_ready = false;
+/* The preloaded track is the one being heard, and mpv is muted. */
+static bool preload_audible = false;
+
 void on_mpv_redraw(void *cb_ctx)
 {
 	frame_queue++;
@@ -99,7 +117,10 @@ static void process_mpv_events(mpv_event_id event_block)
 				(struct mpv_event_end_file *)mp_event->data;
 
 			if(eof->reason == MPV_END_FILE_REASON_EOF)
+			{
+				media_finished = true;
 				environ_cb(RETRO_ENVIRONMENT_SHUTDOWN, NULL);
+			}
 #if 0
 			/* The following could be done instead if the file was not
 			 * closed once the end was reached - allowing the user to seek
@@ -123,6 +144,62 @@ static void process_mpv_events(mpv_event_id event_block)
 	while(1);
 }
 
+/**
+ * Returns true if the core option with the given key is set to "enabled".
+ */
+static bool option_enabled(const char *key)
+{
+	struct retro_variable var = { .key = key };
+
+	if(environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) == false ||
+			var.value == NULL)
+		return false;
+
+	return strcmp(var.value, "enabled") == 0;
+}
+
+/**
+ * Apply the playback position and tracks saved from a previous context or
+ * play of the file. Must be called before the file is loaded.
+ */
+static void restore_media_state(void)
+{
+	char val[32];
+
+	if(playback_time > 0)
+	{
+		snprintf(val, sizeof(val), "%lld", (long long)playback_time);
+		mpv_set_option_string(mpv, "start", val);
+	}
+
+	if(media.aid > 0)
+	{
+		snprintf(val, sizeof(val), "%lld", (long long)media.aid);
+		mpv_set_option_string(mpv, "aid", val);
+	}
+
+	if(media.sid > 0)
+	{
+		snprintf(val, sizeof(val), "%lld", (long long)media.sid);
+		mpv_set_option_string(mpv, "sid", val);
+	}
+}
+
+/**
+ * Remember the playback position and selected tracks of the running mpv
+ * instance.
+ */
+static void save_media_state(void)
+{
+	if(mpv == NULL)
+		return;
+
+	mpv_get_property(mpv, "playback-time", MPV_FORMAT_INT64, &playback_time);
+	mpv_get_property(preload_audible ? preload : mpv, "aid", MPV_FORMAT_INT64,
+			&media.aid);
+	mpv_get_property(mpv, "sid", MPV_FORMAT_INT64, &media.sid);
+}
+
 static void *get_proc_address_mpv(void *fn_ctx, const char *name)
 {
 	/* The "ISO C forbids conversion of function pointer to object pointer
@@ -139,6 +216,341 @@ static void *get_proc_address_mpv(void *fn_ctx, const char *name)
 	return proc_addr;
 }
 
+/**
+ * Read a property of the selected track of the given type from the track
+ * list, as parsed from the container header.
+ */
+static bool get_track_property(mpv_handle *handle, const char *type,
+		const char *name, mpv_format format, void *data)
+{
+	int64_t count = 0;
+	char key[64];
+
+	mpv_get_property(handle, "track-list/count", MPV_FORMAT_INT64, &count);
+
+	for(int64_t i = 0; i < count; i++)
+	{
+		char *track_type;
+		int selected = 0;
+		bool match;
+
+		snprintf(key, sizeof(key), "track-list/%lld/type", (long long)i);
+		if((track_type = mpv_get_property_string(handle, key)) == NULL)
+			continue;
+
+		match = strcmp(track_type, type) == 0;
+		mpv_free(track_type);
+
+		snprintf(key, sizeof(key), "track-list/%lld/selected", (long long)i);
+		mpv_get_property(handle, key, MPV_FORMAT_FLAG, &selected);
+
+		if(match == false || selected == 0)
+			continue;
+
+		snprintf(key, sizeof(key), "track-list/%lld/%s", (long long)i, name);
+		return mpv_get_property(handle, key, format, data) >= 0;
+	}
+
+	return false;
+}
+
+/**
+ * Read the video dimensions, frame rate and audio samplerate of a file
+ * without rendering it, so that the correct values can be given to
+ * retro_get_system_av_info() before playback starts.
+ */
+static bool probe_media(const char *path, struct media_info *info)
+{
+	const char *cmd[] = {"loadfile", path, NULL};
+	mpv_handle *probe = mpv_create();
+	bool loaded = false;
+	static const char *opts[][2] = {
+		{ "config", "no" },
+		{ "load-scripts", "no" },
+		{ "terminal", "no" },
+		{ "vo", "null" },
+		{ "ao", "null" },
+		{ "sid", "no" },
+		{ "pause", "yes" },
+		{ "hwdec", "no" },
+		{ "cache", "no" },
+		{ NULL, NULL }
+	};
+
+	if(probe == NULL)
+		return false;
+
+	for(unsigned i = 0; opts[i][0] != NULL; i++)
+		mpv_set_option_string(probe, opts[i][0], opts[i][1]);
+
+	if(mpv_initialize(probe) < 0 || mpv_command(probe, cmd) < 0)
+	{
+		mpv_terminate_destroy(probe);
+		return false;
+	}
+
+	/* The header has been parsed once the file is loaded, but the display
+	 * size is only known once the first frame has been decoded, which is
+	 * signalled by the playback restart even while paused. A timeout is
+	 * reported as MPV_EVENT_NONE. */
+	while(1)
+	{
+		mpv_event *ev = mpv_wait_event(probe, 5.0);
+
+		if(ev->event_id == MPV_EVENT_FILE_LOADED)
+			loaded = true;
+		else if(ev->event_id == MPV_EVENT_PLAYBACK_RESTART ||
+				ev->event_id == MPV_EVENT_NONE ||
+				ev->event_id == MPV_EVENT_END_FILE ||
+				ev->event_id == MPV_EVENT_SHUTDOWN)
+			break;
+	}
+
+	if(loaded)
+	{
+		int64_t samplerate = 0;
+
+		/* Same as read in retro_run(), which includes the aspect ratio and
+		 * rotation, so that the geometry is not renegotiated there. */
+		mpv_get_property(probe, "dwidth", MPV_FORMAT_INT64, &info->width);
+		mpv_get_property(probe, "dheight", MPV_FORMAT_INT64, &info->height);
+		if(get_track_property(probe, "audio", "demux-samplerate",
+					MPV_FORMAT_INT64, &samplerate))
+			info->sample_rate = samplerate;
+		mpv_get_property(probe, "container-fps", MPV_FORMAT_DOUBLE,
+				&info->fps);
+
+		log_cb(RETRO_LOG_INFO, "Probed %lldx%lld at %f fps, %f Hz\n",
+				(long long)info->width, (long long)info->height,
+				info->fps, info->sample_rate);
+	}
+
+	mpv_terminate_destroy(probe);
+	return loaded;
+}
+
+/**
+ * Return the id of the audio track following the given one in the track
+ * list, wrapping around to the first. Returns the given id if there is no
+ * other audio track.
+ */
+static int64_t next_audio_track(mpv_handle *handle, int64_t aid)
+{
+	int64_t count = 0, first = -1, next = -1;
+	char key[64];
+
+	mpv_get_property(handle, "track-list/count", MPV_FORMAT_INT64, &count);
+
+	for(int64_t i = 0; i < count; i++)
+	{
+		char *track_type;
+		int64_t id = -1;
+		bool match;
+
+		snprintf(key, sizeof(key), "track-list/%lld/type", (long long)i);
+		if((track_type = mpv_get_property_string(handle, key)) == NULL)
+			continue;
+
+		match = strcmp(track_type, "audio") == 0;
+		mpv_free(track_type);
+
+		snprintf(key, sizeof(key), "track-list/%lld/id", (long long)i);
+		if(match == false ||
+				mpv_get_property(handle, key, MPV_FORMAT_INT64, &id) < 0)
+			continue;
+
+		if(first < 0 || id < first)
+			first = id;
+		if(id > aid && (next < 0 || id < next))
+			next = id;
+	}
+
+	if(next >= 0)
+		return next;
+
+	return first >= 0 ? first : aid;
+}
+
+static void preload_stop(void)
+{
+	if(preload == NULL)
+		return;
+
+	mpv_terminate_destroy(preload);
+	preload = NULL;
+	preload_ready = false;
+	preload_audible = false;
+}
+
+/**
+ * Start playing the audio track following the selected one on a second,
+ * muted instance without video, from the current position. Waits for mpv to
+ * have loaded the track list, and gives up if the file has a single audio
+ * track.
+ */
+static void preload_start(void)
+{
+	const char *cmd[] = {"loadfile", filepath, NULL};
+	int64_t aid = 0, next, start = 0, count = 0;
+	int paused = 0;
+	char val[32];
+	static const char *opts[][2] = {
+		{ "config", "no" },
+		{ "load-scripts", "no" },
+		{ "terminal", "no" },
+		{ "vid", "no" },
+		{ "sid", "no" },
+		{ "vo", "null" },
+		{ "mute", "yes" },
+		{ "hwdec", "no" },
+		{ NULL, NULL }
+	};
+
+	if(mpv_get_property(mpv, "track-list/count", MPV_FORMAT_INT64,
+				&count) < 0 || count == 0)
+		return;
+
+	preload_wanted = false;
+
+	mpv_get_property(mpv, "aid", MPV_FORMAT_INT64, &aid);
+	if((next = next_audio_track(mpv, aid)) == aid ||
+			(preload = mpv_create()) == NULL)
+		return;
+
+	for(unsigned i = 0; opts[i][0] != NULL; i++)
+		mpv_set_option_string(preload, opts[i][0], opts[i][1]);
+
+	snprintf(val, sizeof(val), "%lld", (long long)next);
+	mpv_set_option_string(preload, "aid", val);
+
+	/* Same rate as mpv, see context_reset(). */
+	snprintf(val, sizeof(val), "%u", media.sample_rate > 0.0 ?
+			(unsigned)media.sample_rate : 48000);
+	mpv_set_option_string(preload, "audio-samplerate", val);
+
+	mpv_get_property(mpv, "playback-time", MPV_FORMAT_INT64, &start);
+	snprintf(val, sizeof(val), "%lld", (long long)start);
+	mpv_set_option_string(preload, "start", val);
+
+	mpv_get_property(mpv, "pause", MPV_FORMAT_FLAG, &paused);
+	mpv_set_option_string(preload, "pause", paused ? "yes" : "no");
+
+	if(mpv_initialize(preload) < 0 || mpv_command(preload, cmd) < 0)
+	{
+		log_cb(RETRO_LOG_WARN, "Unable to preload the next audio track\n");
+		mpv_terminate_destroy(preload);
+		preload = NULL;
+		return;
+	}
+
+	log_cb(RETRO_LOG_INFO, "Preloading audio track %lld\n", (long long)next);
+}
+
+/**
+ * Keep the preloading instance paused and positioned like mpv. Called every
+ * frame; the positions are only compared every half second, and the
+ * preloading instance is the one moved so that the video is not disturbed.
+ */
+static void preload_sync(void)
+{
+	static unsigned frames = 0;
+	int paused = 0, preload_paused = 0;
+	double time_pos = 0.0, preload_pos = 0.0;
+	char pos[32];
+	const char *cmd[] = {"seek", pos, "absolute+exact", NULL};
+
+	if(preload == NULL && preload_wanted)
+		preload_start();
+
+	if(preload == NULL)
+		return;
+
+	while(1)
+	{
+		mpv_event *ev = mpv_wait_event(preload, 0);
+
+		if(ev->event_id == MPV_EVENT_NONE)
+			break;
+		else if(ev->event_id == MPV_EVENT_PLAYBACK_RESTART)
+			preload_ready = true;
+		else if(ev->event_id == MPV_EVENT_END_FILE ||
+				ev->event_id == MPV_EVENT_SHUTDOWN)
+			preload_ready = false;
+	}
+
+	mpv_get_property(mpv, "pause", MPV_FORMAT_FLAG, &paused);
+	mpv_get_property(preload, "pause", MPV_FORMAT_FLAG, &preload_paused);
+	if(paused != preload_paused)
+		mpv_set_property(preload, "pause", MPV_FORMAT_FLAG, &paused);
+
+	if(preload_ready == false || ++frames < 30)
+		return;
+
+	frames = 0;
+
+	if(mpv_get_property(mpv, "time-pos", MPV_FORMAT_DOUBLE, &time_pos) < 0 ||
+			mpv_get_property(preload, "time-pos", MPV_FORMAT_DOUBLE,
+				&preload_pos) < 0)
+		return;
+
+	if(preload_pos - time_pos > 0.1 || time_pos - preload_pos > 0.1)
+	{
+		snprintf(pos, sizeof(pos), "%f", time_pos);
+		mpv_command(preload, cmd);
+	}
+}
+
+/**
+ * Send a command to mpv, and to the preloading instance if there is one.
+ */
+static void command_string_all(const char *cmd)
+{
+	mpv_command_string(mpv, cmd);
+
+	if(preload != NULL)
+		mpv_command_string(preload, cmd);
+}
+
+/**
+ * Switch to the next audio track. With a preloaded track, the instance
+ * playing it is unmuted and the other one muted, then set to the track
+ * following it while it can't be heard. Two-track files thus never change
+ * tracks after the preload has started. Until the preload is ready, the
+ * instance being heard cycles the track itself, with the gap that comes
+ * with it.
+ */
+static void cycle_audio(void)
+{
+	mpv_handle *heard = preload_audible ? preload : mpv;
+	mpv_handle *muted = preload_audible ? mpv : preload;
+	int64_t aid = 0, next = 0, muted_aid = 0;
+	int yes = 1, no = 0;
+
+	if(preload == NULL || preload_ready == false)
+		mpv_command_string(heard, "cycle audio");
+	else
+	{
+		mpv_handle *swap = heard;
+
+		heard = muted;
+		muted = swap;
+		preload_audible = !preload_audible;
+
+		mpv_set_property(heard, "mute", MPV_FORMAT_FLAG, &no);
+		mpv_set_property(muted, "mute", MPV_FORMAT_FLAG, &yes);
+	}
+
+	if(preload == NULL)
+		return;
+
+	mpv_get_property(heard, "aid", MPV_FORMAT_INT64, &aid);
+	mpv_get_property(muted, "aid", MPV_FORMAT_INT64, &muted_aid);
+	next = next_audio_track(heard, aid);
+
+	if(next != muted_aid)
+		mpv_set_property(muted, "aid", MPV_FORMAT_INT64, &next);
+}
+
 void retro_init(void)
 {
 	if(mpv_client_api_version() != MPV_CLIENT_API_VERSION)
@@ -190,28 +602,38 @@ void retro_get_system_info(struct retro_system_info *info)
 void retro_get_system_av_info(struct retro_system_av_info *info)
 {
 	float sampling_rate = 48000.0f;
+	double fps = 60.0;
+	unsigned base_width = 256, base_height = 144;
 
-	struct retro_variable var = { .key = "test_aspect" };
-	environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var);
+	/* Use the dimensions and rates probed in retro_load_game() or seen on a
+	 * previous play of the file, which avoids renegotiating them once
+	 * playback starts.
+	 */
+	if(media_known && media.sample_rate > 0.0)
+		sampling_rate = media.sample_rate;
 
-	var.key = "test_samplerate";
+	if(media_known && media.width > 0 && media.height > 0)
+	{
+		base_width = media.width;
+		base_height = media.height;
+	}
 
-	if(environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
-		sampling_rate = strtof(var.value, NULL);
+	if(media_known && media.fps > 0.0)
+		fps = media.fps;
 
 	info->timing = (struct retro_system_timing) {
-		.fps = 60.0,
+		.fps = fps,
 		.sample_rate = sampling_rate,
 	};
 
-	/* We don't know the dimensions of the video yet, so we set some good
+	/* If we don't know the dimensions of the video yet, we set some good
 	 * defaults in the meantime.
 	 */
 	info->geometry = (struct retro_game_geometry) {
-		.base_width   = 256,
-		.base_height  = 144,
-		.max_width    = 1920,
-		.max_height   = 1080,
+		.base_width   = base_width,
+		.base_height  = base_height,
+		.max_width    = base_width > 1920 ? base_width : 1920,
+		.max_height   = base_height > 1080 ? base_height : 1080,
 		.aspect_ratio = -1,
 	};
 }
@@ -221,10 +643,9 @@ void retro_set_environment(retro_environment_t cb)
 	environ_cb = cb;
 
 	static const struct retro_variable vars[] = {
-		{ "test_samplerate", "Sample Rate; 48000|30000|20000" },
-		{ "test_opt0", "Test option #0; false|true" },
-		{ "test_opt1", "Test option #1; 0" },
-		{ "test_opt2", "Test option #2; 0|1|foo|3" },
+		{ "mpv_seek_thumbnails", "Seek preview thumbnails; enabled|disabled" },
+		{ "mpv_resume", "Resume playback; enabled|disabled" },
+		{ "mpv_audio_preload", "Gapless audio track switching (decodes two tracks); disabled|enabled" },
 		{ NULL, NULL },
 	};
 
@@ -293,6 +714,8 @@ static void context_reset(void)
 				mpv_error_string(ret));
 	}
 
+	restore_media_state();
+
 	if((ret = mpv_command(mpv, cmd)) != 0)
 	{
 		log_cb(RETRO_LOG_ERROR, "mpv_command failed to load input file: %s\n",
@@ -300,11 +723,16 @@ static void context_reset(void)
 		goto err;
 	}
 
-	/* TODO #2: Check for the highest samplerate in audio stream, and use that.
-	 * Fall back to 48kHz otherwise.
-	 * We currently force the audio to be sampled at 48KHz.
+	/* Output audio at the samplerate of the audio stream, as reported to the
+	 * frontend. Fall back to 48kHz otherwise.
 	 */
-	mpv_set_option_string(mpv, "audio-samplerate", "48000");
+	{
+		char rate[16];
+
+		snprintf(rate, sizeof(rate), "%u", media.sample_rate > 0.0 ?
+				(unsigned)media.sample_rate : 48000);
+		mpv_set_option_string(mpv, "audio-samplerate", rate);
+	}
 	mpv_set_option_string(mpv, "opengl-swapinterval", "0");
 
 	/* Process any events whilst we wait for playback to begin. */
@@ -328,6 +756,9 @@ static void context_reset(void)
 	//mpv_set_option_string(mpv, "video-sync", "display-resample");
 	//mpv_set_option_string(mpv, "display-fps", "60");
 
+	/* Started from retro_run() once mpv has loaded the track list. */
+	preload_wanted = option_enabled("mpv_audio_preload");
+
 	log_cb(RETRO_LOG_INFO, "Context reset.\n");
 
 	return;
@@ -340,9 +771,11 @@ err:
 
 static void context_destroy(void)
 {
-	mpv_get_property(mpv, "playback-time", MPV_FORMAT_INT64, &playback_time);
+	save_media_state();
+	preload_stop();
 	mpv_render_context_free(mpv_gl);
 	mpv_terminate_destroy(mpv);
+	mpv = NULL;
 	log_cb(RETRO_LOG_INFO, "Context destroyed.\n");
 }
 
@@ -414,6 +847,54 @@ static void audio_callback(double fps)
 }
 #endif
 
+/**
+ * Show the thumbnail nearest to the current playback position above the
+ * progress bar. The overlay is only updated when a different thumbnail is
+ * selected, as mpv maps the sprite file on every "overlay-add".
+ */
+static void show_seek_thumbnail(int *shown)
+{
+	struct thumbnail thumb;
+	double time_pos = 0.0;
+	int64_t osd_w = 0, osd_h = 0;
+	int idx;
+	char x[16], y[16], offset[24], w[16], h[16], stride[16];
+	const char *cmd[] = {
+		"overlay-add", "0", x, y, NULL, offset, "bgra", w, h, stride, NULL
+	};
+
+	if(mpv_get_property(mpv, "time-pos", MPV_FORMAT_DOUBLE, &time_pos) < 0 ||
+			(idx = thumbnail_lookup(time_pos, &thumb)) < 0 ||
+			idx == *shown)
+		return;
+
+	mpv_get_property(mpv, "osd-width", MPV_FORMAT_INT64, &osd_w);
+	mpv_get_property(mpv, "osd-height", MPV_FORMAT_INT64, &osd_h);
+
+	if(osd_w < thumb.w || osd_h < thumb.h)
+		return;
+
+	snprintf(x, sizeof(x), "%u", (unsigned)(osd_w - thumb.w) / 2);
+	snprintf(y, sizeof(y), "%u", (unsigned)(osd_h - thumb.h - osd_h / 8));
+	snprintf(offset, sizeof(offset), "%lu", (unsigned long)thumb.offset);
+	snprintf(w, sizeof(w), "%u", thumb.w);
+	snprintf(h, sizeof(h), "%u", thumb.h);
+	snprintf(stride, sizeof(stride), "%u", thumb.stride);
+	cmd[4] = thumb.path;
+
+	if(mpv_command(mpv, cmd) == 0)
+		*shown = idx;
+}
+
+static void hide_seek_thumbnail(int *shown)
+{
+	if(*shown < 0)
+		return;
+
+	mpv_command_string(mpv, "overlay-remove 0");
+	*shown = -1;
+}
+
 static void retropad_update_input(void)
 {
 	struct Input
@@ -424,6 +905,7 @@ static void retropad_update_input(void)
 	};
 	struct Input current;
 	static struct Input last;
+	static int thumbnail_shown = -1;
 
 	input_poll_cb();
 
@@ -444,7 +926,7 @@ static void retropad_update_input(void)
 			0, RETRO_DEVICE_ID_JOYPAD_A) != 0 ? 1 : 0;
 
 	if(current.l == 1 && last.l == 0)
-		mpv_command_string(mpv, "cycle audio");
+		cycle_audio();
 
 	if(current.r == 1 && last.r == 0)
 		mpv_command_string(mpv, "cycle sub");
@@ -455,24 +937,29 @@ static void retropad_update_input(void)
 	/* TODO #3: Press and hold commands with small delay */
 	if(input_state_cb(0, RETRO_DEVICE_JOYPAD, 0,
 			RETRO_DEVICE_ID_JOYPAD_LEFT))
-		mpv_command_string(mpv, "seek -5");
+		command_string_all("seek -5");
 
 	if(input_state_cb(0, RETRO_DEVICE_JOYPAD, 0,
 			RETRO_DEVICE_ID_JOYPAD_RIGHT))
-		mpv_command_string(mpv, "seek 5");
+		command_string_all("seek 5");
 
 	if(input_state_cb(0, RETRO_DEVICE_JOYPAD, 0,
 			RETRO_DEVICE_ID_JOYPAD_UP))
-		mpv_command_string(mpv, "seek 60");
+		command_string_all("seek 60");
 
 	if(input_state_cb(0, RETRO_DEVICE_JOYPAD, 0,
 			RETRO_DEVICE_ID_JOYPAD_DOWN))
-		mpv_command_string(mpv, "seek -60");
+		command_string_all("seek -60");
 
 	/* Press and hold commands */
 	if(input_state_cb(0, RETRO_DEVICE_JOYPAD, 0,
 			RETRO_DEVICE_ID_JOYPAD_X))
+	{
 		mpv_command_string(mpv, "show-progress");
+		show_seek_thumbnail(&thumbnail_shown);
+	}
+	else
+		hide_seek_thumbnail(&thumbnail_shown);
 
 	/* Instead of copying the structs as though they were a union, we assign
 	 * each variable one-by-one to avoid endian issues.
@@ -517,7 +1004,9 @@ void retro_run(void)
 
 		struct retro_system_timing timing = {
 			.fps = container_fps,
-			.sample_rate = 48000.0f,
+			/* Same rate as mpv was told to output in context_reset(). */
+			.sample_rate = media.sample_rate > 0.0 ?
+				media.sample_rate : 48000.0f,
 		};
 
 		struct retro_system_av_info av_info = {
@@ -525,13 +1014,22 @@ void retro_run(void)
 			.timing = timing,
 		};
 
-		if(width > 0 && height > 0)
+		/* Skip the renegotiation if the cached values announced in
+		 * retro_get_system_av_info() were correct. */
+		if(width > 0 && height > 0 && (media_known == false ||
+					width != media.width || height != media.height ||
+					container_fps != media.fps))
 			environ_cb(RETRO_ENVIRONMENT_SET_SYSTEM_AV_INFO, &av_info);
 
+		media.width = width;
+		media.height = height;
+		media.fps = container_fps;
+
 		updated_video_dimensions = true;
 	}
 
 	retropad_update_input();
+	preload_sync();
 
 	/* TODO #2: Implement an audio callback feature in to libmpv */
 	//audio_callback(container_fps);
@@ -610,6 +1108,46 @@ bool retro_load_game(const struct retro_game_info *info)
 
 	strcpy(filepath,info->path);
 
+#ifdef HAVE_LOCALE
+	/* mpv refuses to create a context unless numbers use the C locale. */
+	setlocale(LC_NUMERIC, "C");
+#endif
+
+	playback_time = 0;
+	media_known = false;
+	media_finished = false;
+	memset(&media, 0, sizeof(media));
+
+	{
+		const char *dir = NULL;
+
+		if(environ_cb(RETRO_ENVIRONMENT_GET_SAVE_DIRECTORY, &dir) &&
+				dir != NULL && *dir != '\0' &&
+				(save_dir = malloc(strlen(dir)+1)) != NULL)
+			strcpy(save_dir, dir);
+	}
+
+	if(save_dir != NULL)
+	{
+		bool fp_valid = media_cache_fingerprint(filepath, &media_fp);
+
+		if(fp_valid)
+			media_known = media_cache_load(save_dir, &media_fp, &media);
+
+		if(media_known && option_enabled("mpv_resume"))
+			playback_time = media.position;
+
+		if(fp_valid && option_enabled("mpv_seek_thumbnails"))
+			thumbnail_start(filepath, &media_fp, save_dir, log_cb);
+	}
+
+	/* Files played before have their parameters cached already. */
+	if(media.probed == false && probe_media(filepath, &media))
+	{
+		media.probed = true;
+		media_known = true;
+	}
+
 	environ_cb(RETRO_ENVIRONMENT_SET_INPUT_DESCRIPTORS, desc);
 
 	/* Not bothered if this fails. Assuming the default is selected anyway. */
@@ -639,6 +1177,18 @@ bool retro_load_game_special(unsigned type, const struct retro_game_info *info,
 
 void retro_unload_game(void)
 {
+	thumbnail_stop();
+
+	if(save_dir != NULL)
+	{
+		save_media_state();
+		media.position = media_finished ? 0 : playback_time;
+		media_cache_store(save_dir, &media_fp, &media);
+	}
+
+	free(save_dir);
+	save_dir = NULL;
+
 	free(filepath);
 	filepath = NULL;
 
@@ -0,0 +1,513 @@
+/* mpv media player libretro core
+ * Copyright (C) 2018 Mahyar Koshkouei
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <mpv/client.h>
+
+#include <rthreads/rthreads.h>
+
+#include "thumbnail.h"
+
+#ifdef _WIN32
+#define PATH_SEPARATOR '\\'
+#else
+#define PATH_SEPARATOR '/'
+#endif
+
+#define SPRITE_MAGIC		"MPVT"
+#define SPRITE_VERSION		1
+
+/* Bounds on the number of thumbnails and the time between them. */
+#define SPRITE_MAX_COUNT	240
+#define SPRITE_MIN_INTERVAL	5.0
+
+/* The sprite file is a header, followed by the timestamp of each thumbnail,
+ * followed by the BGRA pixels of each thumbnail. The file is written in
+ * place so that mpv can map the pixels directly with "overlay-add" while the
+ * remaining thumbnails are still being generated.
+ */
+struct sprite_header
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t capacity;
+	uint32_t count;
+	uint32_t width;
+	uint32_t height;
+	uint32_t stride;
+	uint32_t complete;
+};
+
+static struct
+{
+	sthread_t *thread;
+	slock_t *lock;
+	mpv_handle *mpv;
+	retro_log_printf_t log_cb;
+	volatile bool quit;
+
+	char *media_path;
+	char *sprite_path;
+
+	/* Protected by lock. */
+	double *times;
+	unsigned capacity;
+	unsigned count;
+} thumbs;
+
+static size_t sprite_pixel_offset(unsigned capacity)
+{
+	return sizeof(struct sprite_header) + capacity * sizeof(double);
+}
+
+static size_t sprite_frame_size(void)
+{
+	return THUMBNAIL_WIDTH * 4 * THUMBNAIL_HEIGHT;
+}
+
+/**
+ * Wait until the thumbnail mpv handle emits the given event.
+ *
+ * \return	false if the file ended, mpv shut down or the generator was
+ *			asked to stop.
+ */
+static bool wait_for_event(mpv_handle *mpv, mpv_event_id wanted)
+{
+	while(thumbs.quit == false)
+	{
+		mpv_event *ev = mpv_wait_event(mpv, 1.0);
+
+		if(ev->event_id == wanted)
+			return true;
+
+		if(ev->event_id == MPV_EVENT_END_FILE ||
+				ev->event_id == MPV_EVENT_SHUTDOWN)
+			return false;
+	}
+
+	return false;
+}
+
+/**
+ * Copy a "bgr0" screenshot into a thumbnail cell, scaling with nearest
+ * neighbour and letterboxing to keep the aspect ratio. The alpha channel is
+ * made opaque, as mpv overlays use premultiplied alpha.
+ */
+static void blit_thumbnail(uint8_t *dst, const uint8_t *src,
+		int64_t src_w, int64_t src_h, int64_t src_stride)
+{
+	unsigned fit_w = THUMBNAIL_WIDTH;
+	unsigned fit_h = THUMBNAIL_HEIGHT;
+	unsigned off_x, off_y;
+
+	if(src_w * THUMBNAIL_HEIGHT > src_h * THUMBNAIL_WIDTH)
+		fit_h = (unsigned)(src_h * THUMBNAIL_WIDTH / src_w);
+	else
+		fit_w = (unsigned)(src_w * THUMBNAIL_HEIGHT / src_h);
+
+	off_x = (THUMBNAIL_WIDTH - fit_w) / 2;
+	off_y = (THUMBNAIL_HEIGHT - fit_h) / 2;
+
+	for(unsigned y = 0; y < THUMBNAIL_HEIGHT; y++)
+	{
+		uint32_t *row = (uint32_t *)(dst + y * THUMBNAIL_WIDTH * 4);
+
+		for(unsigned x = 0; x < THUMBNAIL_WIDTH; x++)
+		{
+			const uint8_t *px;
+
+			if(x < off_x || x >= off_x + fit_w ||
+					y < off_y || y >= off_y + fit_h)
+			{
+				row[x] = 0;
+				continue;
+			}
+
+			px = src + ((y - off_y) * src_h / fit_h) * src_stride +
+				((x - off_x) * src_w / fit_w) * 4;
+
+			((uint8_t *)&row[x])[0] = px[0];
+			((uint8_t *)&row[x])[1] = px[1];
+			((uint8_t *)&row[x])[2] = px[2];
+			((uint8_t *)&row[x])[3] = 0xFF;
+		}
+	}
+}
+
+/**
+ * Take a raw screenshot of the current frame and convert it into a
+ * thumbnail cell.
+ */
+static bool grab_thumbnail(mpv_handle *mpv, uint8_t *cell)
+{
+	const char *cmd[] = { "screenshot-raw", "video", NULL };
+	mpv_node res;
+	int64_t w = 0, h = 0, stride = 0;
+	mpv_byte_array *data = NULL;
+	bool ret = false;
+
+	if(mpv_command_ret(mpv, cmd, &res) < 0)
+		return false;
+
+	if(res.format != MPV_FORMAT_NODE_MAP)
+		goto out;
+
+	for(int i = 0; i < res.u.list->num; i++)
+	{
+		const char *key = res.u.list->keys[i];
+		mpv_node *val = &res.u.list->values[i];
+
+		if(strcmp(key, "w") == 0 && val->format == MPV_FORMAT_INT64)
+			w = val->u.int64;
+		else if(strcmp(key, "h") == 0 && val->format == MPV_FORMAT_INT64)
+			h = val->u.int64;
+		else if(strcmp(key, "stride") == 0 && val->format == MPV_FORMAT_INT64)
+			stride = val->u.int64;
+		else if(strcmp(key, "data") == 0 &&
+				val->format == MPV_FORMAT_BYTE_ARRAY)
+			data = val->u.ba;
+	}
+
+	if(w <= 0 || h <= 0 || stride < w * 4 || data == NULL ||
+			data->size < (size_t)(stride * h))
+		goto out;
+
+	blit_thumbnail(cell, data->data, w, h, stride);
+	ret = true;
+
+out:
+	mpv_free_node_contents(&res);
+	return ret;
+}
+
+/**
+ * Load a previously completed sprite file.
+ */
+static bool load_sprite(void)
+{
+	struct sprite_header hdr;
+	double *times;
+	FILE *f = fopen(thumbs.sprite_path, "rb");
+
+	if(f == NULL)
+		return false;
+
+	if(fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+			memcmp(hdr.magic, SPRITE_MAGIC, 4) != 0 ||
+			hdr.version != SPRITE_VERSION || hdr.complete == 0 ||
+			hdr.width != THUMBNAIL_WIDTH || hdr.height != THUMBNAIL_HEIGHT ||
+			hdr.count > hdr.capacity || hdr.capacity > SPRITE_MAX_COUNT ||
+			(times = calloc(hdr.capacity, sizeof(double))) == NULL)
+	{
+		fclose(f);
+		return false;
+	}
+
+	if(fread(times, sizeof(double), hdr.capacity, f) != hdr.capacity)
+	{
+		free(times);
+		fclose(f);
+		return false;
+	}
+
+	fclose(f);
+
+	slock_lock(thumbs.lock);
+	thumbs.times = times;
+	thumbs.capacity = hdr.capacity;
+	thumbs.count = hdr.count;
+	slock_unlock(thumbs.lock);
+
+	return true;
+}
+
+static mpv_handle *create_thumbnail_mpv(void)
+{
+	mpv_handle *mpv = mpv_create();
+	static const char *opts[][2] = {
+		{ "config", "no" },
+		{ "load-scripts", "no" },
+		{ "terminal", "no" },
+		{ "vo", "null" },
+		{ "ao", "null" },
+		{ "aid", "no" },
+		{ "sid", "no" },
+		{ "pause", "yes" },
+		{ "hwdec", "no" },
+		{ "hr-seek", "no" },
+		{ "cache", "no" },
+		{ "vd-lavc-skiploopfilter", "all" },
+		{ "vd-lavc-skipframe", "nonkey" },
+		{ "vf", "scale=160:90:force_original_aspect_ratio=decrease" },
+		{ NULL, NULL }
+	};
+
+	if(mpv == NULL)
+		return NULL;
+
+	for(unsigned i = 0; opts[i][0] != NULL; i++)
+		mpv_set_option_string(mpv, opts[i][0], opts[i][1]);
+
+	if(mpv_initialize(mpv) < 0)
+	{
+		mpv_terminate_destroy(mpv);
+		return NULL;
+	}
+
+	return mpv;
+}
+
+static void thumbnail_thread(void *data)
+{
+	const char *cmd[] = { "loadfile", thumbs.media_path, NULL };
+	struct sprite_header hdr = { SPRITE_MAGIC, SPRITE_VERSION };
+	double duration = 0.0, interval;
+	unsigned capacity;
+	bool failed = false;
+	uint8_t *cell = NULL;
+	double *times = NULL;
+	FILE *f = NULL;
+	mpv_handle *mpv;
+
+	(void)data;
+
+	if(load_sprite())
+		return;
+
+	if((mpv = create_thumbnail_mpv()) == NULL)
+	{
+		thumbs.log_cb(RETRO_LOG_WARN, "thumbnail: failed creating context\n");
+		return;
+	}
+
+	slock_lock(thumbs.lock);
+	thumbs.mpv = mpv;
+	slock_unlock(thumbs.lock);
+
+	if(mpv_command(mpv, cmd) < 0 ||
+			wait_for_event(mpv, MPV_EVENT_FILE_LOADED) == false ||
+			mpv_get_property(mpv, "duration", MPV_FORMAT_DOUBLE,
+				&duration) < 0 || duration <= 0.0)
+		goto out;
+
+	interval = duration / SPRITE_MAX_COUNT;
+	if(interval < SPRITE_MIN_INTERVAL)
+		interval = SPRITE_MIN_INTERVAL;
+
+	capacity = (unsigned)(duration / interval) + 1;
+	if(capacity > SPRITE_MAX_COUNT)
+		capacity = SPRITE_MAX_COUNT;
+
+	if((times = calloc(capacity, sizeof(double))) == NULL ||
+			(cell = malloc(sprite_frame_size())) == NULL ||
+			(f = fopen(thumbs.sprite_path, "w+b")) == NULL)
+		goto out;
+
+	hdr.capacity = capacity;
+	hdr.width = THUMBNAIL_WIDTH;
+	hdr.height = THUMBNAIL_HEIGHT;
+	hdr.stride = THUMBNAIL_WIDTH * 4;
+
+	if(fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+			fwrite(times, sizeof(double), capacity, f) != capacity)
+		goto out;
+
+	slock_lock(thumbs.lock);
+	thumbs.times = times;
+	thumbs.capacity = capacity;
+	slock_unlock(thumbs.lock);
+
+	for(unsigned i = 0; i < capacity && thumbs.quit == false; i++)
+	{
+		char target[32];
+		const char *seek[] = { "seek", target, "absolute+keyframes", NULL };
+		double pos = i * interval;
+
+		snprintf(target, sizeof(target), "%f", i * interval);
+
+		if(mpv_command(mpv, seek) < 0 ||
+				wait_for_event(mpv, MPV_EVENT_PLAYBACK_RESTART) == false)
+		{
+			failed = true;
+			break;
+		}
+
+		mpv_get_property(mpv, "time-pos", MPV_FORMAT_DOUBLE, &pos);
+
+		if(grab_thumbnail(mpv, cell) == false)
+			continue;
+
+		/* Write the pixels before publishing the timestamp, so that a lookup
+		 * never points the main mpv instance at an unwritten cell.
+		 */
+		if(fseek(f, (long)(sprite_pixel_offset(capacity) +
+						hdr.count * sprite_frame_size()), SEEK_SET) != 0 ||
+				fwrite(cell, sprite_frame_size(), 1, f) != 1 ||
+				fseek(f, (long)(sizeof(hdr) + hdr.count * sizeof(double)),
+					SEEK_SET) != 0 ||
+				fwrite(&pos, sizeof(pos), 1, f) != 1 ||
+				fflush(f) != 0)
+		{
+			failed = true;
+			break;
+		}
+
+		slock_lock(thumbs.lock);
+		thumbs.times[hdr.count] = pos;
+		thumbs.count = ++hdr.count;
+		slock_unlock(thumbs.lock);
+	}
+
+	/* Only reused on the next play if every position was tried, otherwise
+	 * it is generated again. */
+	hdr.complete = thumbs.quit == false && failed == false;
+
+	if(fseek(f, 0, SEEK_SET) == 0)
+		fwrite(&hdr, sizeof(hdr), 1, f);
+
+	thumbs.log_cb(RETRO_LOG_INFO, "thumbnail: generated %u of %u\n",
+			hdr.count, capacity);
+
+out:
+	if(f != NULL)
+		fclose(f);
+
+	/* Ownership of the timestamps is handed over to the index once
+	 * published. */
+	if(thumbs.times != times)
+		free(times);
+
+	free(cell);
+
+	slock_lock(thumbs.lock);
+	thumbs.mpv = NULL;
+	slock_unlock(thumbs.lock);
+
+	mpv_terminate_destroy(mpv);
+}
+
+bool thumbnail_start(const char *media_path,
+		const struct media_fingerprint *fp, const char *save_dir,
+		retro_log_printf_t log)
+{
+	/* Named after the fingerprint rather than the file name, so that a
+	 * file that was replaced or shares its name with another one does not
+	 * pick up the wrong sprite. */
+	char name[64];
+	size_t len;
+
+	thumbnail_stop();
+
+	snprintf(name, sizeof(name),
+			"%016" PRIx64 "%016" PRIx64 "%08" PRIx32 "%08" PRIx32 ".thumbs",
+			fp->size, (uint64_t)fp->mtime, fp->crc_head, fp->crc_tail);
+
+	len = strlen(save_dir) + strlen(name) + 2;
+
+	thumbs.log_cb = log;
+	thumbs.quit = false;
+
+	if((thumbs.media_path = malloc(strlen(media_path) + 1)) == NULL ||
+			(thumbs.sprite_path = malloc(len)) == NULL ||
+			(thumbs.lock = slock_new()) == NULL)
+		goto err;
+
+	strcpy(thumbs.media_path, media_path);
+
+	snprintf(thumbs.sprite_path, len, "%s%c%s",
+			save_dir, PATH_SEPARATOR, name);
+
+	if((thumbs.thread = sthread_create(thumbnail_thread, NULL)) == NULL)
+		goto err;
+
+	return true;
+
+err:
+	thumbnail_stop();
+	return false;
+}
+
+void thumbnail_stop(void)
+{
+	if(thumbs.thread != NULL)
+	{
+		slock_lock(thumbs.lock);
+		thumbs.quit = true;
+		if(thumbs.mpv != NULL)
+			mpv_wakeup(thumbs.mpv);
+		slock_unlock(thumbs.lock);
+
+		sthread_join(thumbs.thread);
+		thumbs.thread = NULL;
+	}
+
+	if(thumbs.lock != NULL)
+		slock_free(thumbs.lock);
+
+	free(thumbs.times);
+	free(thumbs.media_path);
+	free(thumbs.sprite_path);
+
+	thumbs.lock = NULL;
+	thumbs.times = NULL;
+	thumbs.media_path = NULL;
+	thumbs.sprite_path = NULL;
+	thumbs.capacity = 0;
+	thumbs.count = 0;
+}
+
+int thumbnail_lookup(double time, struct thumbnail *thumb)
+{
+	int best = -1;
+	double best_dist = 0.0;
+
+	if(thumbs.lock == NULL)
+		return -1;
+
+	slock_lock(thumbs.lock);
+
+	for(unsigned i = 0; i < thumbs.count; i++)
+	{
+		double dist = thumbs.times[i] > time ?
+			thumbs.times[i] - time : time - thumbs.times[i];
+
+		if(best < 0 || dist < best_dist)
+		{
+			best = (int)i;
+			best_dist = dist;
+		}
+	}
+
+	if(best >= 0)
+	{
+		thumb->path = thumbs.sprite_path;
+		thumb->offset = sprite_pixel_offset(thumbs.capacity) +
+			best * sprite_frame_size();
+		thumb->w = THUMBNAIL_WIDTH;
+		thumb->h = THUMBNAIL_HEIGHT;
+		thumb->stride = THUMBNAIL_WIDTH * 4;
+	}
+
+	slock_unlock(thumbs.lock);
+
+	return best;
+}
@@ -0,0 +1,72 @@
+/* mpv media player libretro core
+ * Copyright (C) 2018 Mahyar Koshkouei
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBRETRO_MPV_THUMBNAIL_H
+#define LIBRETRO_MPV_THUMBNAIL_H
+
+#include <stddef.h>
+
+#include <libretro.h>
+
+#include "mediacache.h"
+
+/* Dimensions of a single thumbnail in the sprite file. */
+#define THUMBNAIL_WIDTH		160
+#define THUMBNAIL_HEIGHT	90
+
+/* Location of a single thumbnail in the sprite file, in the form expected by
+ * mpv's "overlay-add" command. */
+struct thumbnail
+{
+	const char *path;
+	size_t offset;
+	unsigned w;
+	unsigned h;
+	unsigned stride;
+};
+
+/**
+ * Start building the keyframe thumbnail index of the given file in a
+ * background thread. If a complete sprite file for the same fingerprint
+ * already exists in the save directory, it is reused and no decoding takes
+ * place.
+ *
+ * \param media_path	Path of the file being played.
+ * \param fp			Fingerprint of the file, which names the sprite file.
+ * \param save_dir		Directory where the sprite file is stored.
+ * \param log			Logging callback.
+ * \return				false if the generator could not be started.
+ */
+bool thumbnail_start(const char *media_path,
+		const struct media_fingerprint *fp, const char *save_dir,
+		retro_log_printf_t log);
+
+/**
+ * Stop the generator thread, if running, and release the index.
+ */
+void thumbnail_stop(void);
+
+/**
+ * Find the thumbnail closest to the given playback time.
+ *
+ * \param time	Playback time in seconds.
+ * \param thumb	Location of the thumbnail on success.
+ * \return		Index of the thumbnail, or -1 if none is available yet.
+ */
+int thumbnail_lookup(double time, struct thumbnail *thumb);
+
+#endif